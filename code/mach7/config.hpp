@@ -50,11 +50,16 @@
 /// - Default syntax                   \see #XTL_DEFAULT_SYNTAX
 /// - Use of vtbl frequencies          \see #XTL_USE_VTBL_FREQUENCY
 /// - Use of memoized_cast             \see #XTL_USE_MEMOIZED_CAST
+/// - Cost-based reordering of patterns \see #XTL_REORDER_PATTERNS
+/// - Hashing of string literal clauses \see #XTL_USE_STRING_SWITCH
+/// - Use of BMI2 instructions         \see #XTL_USE_BMI2
+/// - Hash function of vtbl maps       \see #XTL_VTBL_HASH
+/// - Invalidation of unloaded modules \see #XTL_VTBL_INVALIDATION
 /// - Whether extractors might throw   \see #XTL_EXTRACTORS_MIGHT_THROW
 /// - Use of static local variables    \see #XTL_PRELOAD_LOCAL_STATIC_VARIABLES
 /// - Use number of case clauses init  \see #XTL_CLAUSES_NUM_ESTIMATES_TYPES_NUM
 /// - Certain under-the-hood types     \see #vtbl_count_t
-/// - Certain under-the-hood constants \see #XTL_MIN_LOG_SIZE, #XTL_MAX_LOG_INC, #XTL_MAX_STACK_LOG_SIZE, #XTL_IRRELEVANT_VTBL_BITS
+/// - Certain under-the-hood constants \see #XTL_MIN_LOG_SIZE, #XTL_MAX_LOG_SIZE, #XTL_MAX_LOG_INC, #XTL_MAX_STACK_LOG_SIZE, #XTL_VTBL_SAMPLE_LOG_SIZE, #XTL_IRRELEVANT_VTBL_BITS
 /// Most of the combinations of from this set are built with: make timing
 ///
 /// Options with semantic or convenience impact
@@ -67,8 +72,10 @@
 /// Options for logging and debugging
 /// - Compile-time messages            \see #XTL_MESSAGE_ENABLED
 /// - Trace of performance             \see #XTL_DUMP_PERFORMANCE
+/// - Run-time statistics of vtbl maps \see #XTL_VTBL_MAP_STATISTICS
 /// - Trace of memory leaks with lines \see #XTL_LEAKED_NEW_LOCATIONS
 /// - Trace of conditions likeliness   \see #XTL_TRACE_LIKELINESS 
+/// - Hints corrected by a trace      \see #XTL_LIKELINESS_HINTS
 ///
 
 #pragma once
@@ -83,22 +90,55 @@
 #endif
 #define XTL_DUMP_PERFORMANCE_ONLY(...)   XTL_IF(XTL_NOT(XTL_DUMP_PERFORMANCE), XTL_EMPTY(), XTL_EXPAND(__VA_ARGS__))
 
+#if !defined(XTL_DUMP_PERFORMANCE_FORMAT)
+    /// Format in which vtbl-maps dump their layout and statistics to std::clog
+    /// upon destruction when #XTL_DUMP_PERFORMANCE is enabled:
+    /// - 0 - human-readable text with binary vtbls and cache histogram
+    /// - 1 - one JSON object per map and line \see vtbl_map::write_json
+    /// - 2 - CSV with one row per cache entry  \see vtbl_map::write_csv
+    #define XTL_DUMP_PERFORMANCE_FORMAT 0
+#endif
+
+#if !defined(XTL_VTBL_MAP_STATISTICS)
+    /// Flag enabling run-time statistics of every vtbl-map in the program: hits,
+    /// misses, collisions, reconfigurations and the layout of the cache, which
+    /// can be obtained at any time with #snapshot_vtbl_maps. Unlike 
+    /// #XTL_DUMP_PERFORMANCE this only maintains a few relaxed counters per map
+    /// and does not print anything, so it is enabled by default.
+    #define XTL_VTBL_MAP_STATISTICS 1
+#endif
+
 //------------------------------------------------------------------------------
 
 #if !defined(XTL_TRACE_LIKELINESS)
     /// A macro that enables tracing of XTL_LIKELY and XTL_UNLIKELY macros to 
     /// ensure the actual calls match what we've put in code. Not for user code.
     /// By default we enable tracing only when we enabling performance tracing as
-    /// it too has an overhead per each condition with XTL_[UN]LIKELY.
-    #define XTL_TRACE_LIKELINESS XTL_DUMP_PERFORMANCE
+    /// it too has an overhead per each condition with XTL_[UN]LIKELY. It stays
+    /// off with machine-readable #XTL_DUMP_PERFORMANCE_FORMAT since its report 
+    /// would be interleaved with JSON or CSV in std::clog.
+    #define XTL_TRACE_LIKELINESS (XTL_DUMP_PERFORMANCE && XTL_DUMP_PERFORMANCE_FORMAT == 0)
+#endif
+
+#if !defined(XTL_TRACE_LIKELINESS_PERIOD)
+    /// Average number of evaluations of a condition hinted with XTL_LIKELY or 
+    /// XTL_UNLIKELY per one that is counted when #XTL_TRACE_LIKELINESS is on.
+    /// Must be a power of 2. The default of 1 counts every evaluation, while 
+    /// larger values bring the overhead down enough to trace production runs.
+    #define XTL_TRACE_LIKELINESS_PERIOD 1
 #endif
 
 #if XTL_TRACE_LIKELINESS
     #include "debug.hpp"
-    #define XTL_LIKELY(c)   (mch::trace_likeliness< true,__LINE__,decltype(XTL_FUNCTION)>(c,#c,__FILE__))
-    #define XTL_UNLIKELY(c) (mch::trace_likeliness<false,__LINE__,decltype(XTL_FUNCTION)>(c,#c,__FILE__))
+    #define XTL_LIKELY(...)   (mch::trace_likeliness< true,__LINE__,XTL_COUNTER,decltype(XTL_FUNCTION)>((__VA_ARGS__),#__VA_ARGS__,__FILE__))
+    #define XTL_UNLIKELY(...) (mch::trace_likeliness<false,__LINE__,XTL_COUNTER,decltype(XTL_FUNCTION)>((__VA_ARGS__),#__VA_ARGS__,__FILE__))
 #endif
 
+/// \def XTL_LIKELINESS_HINTS
+/// Name of a header generated by mch::write_likeliness_hints from a traced run
+/// that corrects the hints of XTL_LIKELY and XTL_UNLIKELY at the sites it lists.
+/// Undefined by default. \see hints.hpp
+
 //------------------------------------------------------------------------------
 
 #if !defined(XTL_MESSAGE_ENABLED)
@@ -109,14 +149,42 @@
 #if !defined(XTL_USE_VTBL_FREQUENCY)
     /// When this macro is defined, vtblmaps will count frequency of requests using a
     /// given vtbl pointer and will take it into account during rearranging of the map.
+    /// Each entry of the cache counts a sample of the lookups that found it \see
+    /// #XTL_VTBL_FREQUENCY_SAMPLING. Updates then prefer cache sizes and shifts that
+    /// give entries of their own to the hottest vtbls, while lookups of a vtbl 
+    /// colliding with a hotter one do not swap it out of its entry.
     /// \note This introduces a slight performance overhead to the most frequent path,
-    ///       but supposedly will pay when no zero conflict is possible.
-    /// \deprecated This macro will be deprecated as tracing frequency was not improving
-    ///       performance enough to justify the overhead it introduces.
+    ///       but supposedly will pay when no zero conflict is possible, especially 
+    ///       on skewed distributions of types.
     #define XTL_USE_VTBL_FREQUENCY 0
 #endif
 #define XTL_USE_VTBL_FREQUENCY_ONLY(...) XTL_IF(XTL_NOT(XTL_USE_VTBL_FREQUENCY), XTL_EMPTY(), XTL_EXPAND(__VA_ARGS__))
 
+#if !defined(XTL_VTBL_FREQUENCY_SAMPLING)
+    /// Log of the average number of lookups per one counted in the frequency of 
+    /// vtbl-map entries when #XTL_USE_VTBL_FREQUENCY is enabled.
+    #define XTL_VTBL_FREQUENCY_SAMPLING 6
+#endif
+
+#if !defined(XTL_DEFERRED_VTBL_UPDATE)
+    /// When this macro is 1, a vtbl_map that finds its cache inefficient does
+    /// not search for a better layout of it right away, but only queues a request
+    /// for one \see #maintain_caches, #cache_maintainer. Lookups then only adopt 
+    /// layouts found by maintenance or grow a full cache, which takes time linear
+    /// in its size, bounding the latency of the worst lookup.
+    #define XTL_DEFERRED_VTBL_UPDATE 0
+#endif
+#define XTL_DEFERRED_VTBL_UPDATE_ONLY(...) XTL_IF(XTL_NOT(XTL_DEFERRED_VTBL_UPDATE), XTL_EMPTY(), XTL_EXPAND(__VA_ARGS__))
+
+#if !defined(XTL_VTBL_INVALIDATION)
+    /// When this macro is 1, every vtbl-map registers itself on construction, so
+    /// that entries for classes of a module about to be unloaded can be purged
+    /// from all of them \see #unregister_module, #invalidate_vtbls. Registration
+    /// only costs a lock once per map, so it is enabled by default.
+    #define XTL_VTBL_INVALIDATION 1
+#endif
+#define XTL_VTBL_INVALIDATION_ONLY(...) XTL_IF(XTL_NOT(XTL_VTBL_INVALIDATION), XTL_EMPTY(), XTL_EXPAND(__VA_ARGS__))
+
 #if !defined(XTL_REDUNDANCY_CHECKING)
     /// When this macro is defined, our library will generate additional code that 
     /// will trigger compiler to check case clauses for redundancy.
@@ -152,9 +220,46 @@
     /// By default we enable preloading as it makes the code smaller and somewhat faster,
     /// but one should understand that preloading default initializes the object, so 
     /// passing additional arguments or deferred constatnt values is not possible.
+    /// Value 2 preloads the variables as C++17 inline variables placed into the 
+    /// #XTL_STATIC_DATA_SECTION, which keeps the static data of all the Match 
+    /// statements of the program next to each other.
+    #define XTL_PRELOAD_LOCAL_STATIC_VARIABLES 1
+#endif
+
+#if XTL_PRELOAD_LOCAL_STATIC_VARIABLES == 2 && !(defined(__cpp_inline_variables) && __cpp_inline_variables >= 201606L)
+    /// Inline variables are not supported, so fall back to preallocated static 
+    /// data members of class templates, which are just as guard-free.
+    #undef  XTL_PRELOAD_LOCAL_STATIC_VARIABLES
     #define XTL_PRELOAD_LOCAL_STATIC_VARIABLES 1
 #endif
 
+#if !defined(XTL_STATIC_DATA_SECTION)
+  #if XTL_PRELOAD_LOCAL_STATIC_VARIABLES == 2 && defined(__ELF__) && (defined(__GNUC__) || defined(__clang__))
+    /// Attribute placing preloaded static data of Match statements into the 
+    /// mach7_static_data section. Being a C identifier, the section name lets one 
+    /// find its bounds with __start_mach7_static_data and __stop_mach7_static_data.
+    /// \note GCC (at least up to 12) ignores section attributes on static data 
+    ///       members of class templates and puts each instantiation into its own
+    ///       .bss.<mangled name> section instead (with -fdata-sections when UID
+    ///       is a local type). Since all the names start with the mangled name 
+    ///       of mch::preallocated, linking with -Wl,--sort-section=name groups
+    ///       them just as well.
+    #define XTL_STATIC_DATA_SECTION __attribute__((section("mach7_static_data")))
+  #else
+    #define XTL_STATIC_DATA_SECTION
+  #endif
+#endif
+
+#if XTL_PRELOAD_LOCAL_STATIC_VARIABLES == 2
+    /// Specifiers of the static data member of #preallocated that make it an
+    /// inline variable, which does not need a definition outside of the class.
+    #define XTL_PREALLOCATED_STATIC XTL_STATIC_DATA_SECTION static inline
+#else
+    /// Specifiers of the static data member of #preallocated, which has to be 
+    /// defined outside of the class.
+    #define XTL_PREALLOCATED_STATIC static
+#endif
+
 #if XTL_PRELOAD_LOCAL_STATIC_VARIABLES
     /// In this case we simply introduce a local reference Name to the globally
     /// preallocated variable of type Type.
@@ -274,15 +379,84 @@
 
 //------------------------------------------------------------------------------
 
+#if !defined(XTL_REORDER_PATTERNS)
+    /// When this macro is 1, conjunction and disjunction combinators evaluate 
+    /// their sub-patterns cheapest-first according to static cost estimates
+    /// (\see #pattern_cost) instead of in the source order. Only sub-patterns 
+    /// known to be free of side effects (\see #is_pure_pattern) are reordered,
+    /// so patterns binding variables always keep their relative order.
+    /// Disabled by default as it changes the order in which user predicates
+    /// are called.
+    #define XTL_REORDER_PATTERNS 0
+#endif
+
+//------------------------------------------------------------------------------
+
+#if !defined(XTL_USE_STRING_SWITCH)
+    /// When this macro is 1, a Match statement on a single std::string 
+    /// subject learns the string literals of its leading clauses and,
+    /// once there are enough of them, dispatches through a hash table instead of
+    /// comparing the subject with each literal in turn (\see #string_switch). 
+    /// It has no effect when #XTL_MULTI_THREADING is enabled as the table is 
+    /// learned without synchronization.
+    #define XTL_USE_STRING_SWITCH 1
+#endif
+
+//------------------------------------------------------------------------------
+
+#if !defined(XTL_USE_BMI2)
+    /// Selects how vtbl maps of several subjects interleave bits of their 
+    /// vtbl-pointers into a cache index (\see #interleave_vtbls):
+    /// - 0: portable shift-and-mask or lookup table code;
+    /// - 1: PDEP instruction of BMI2, when the CPU has a fast one (checked at
+    ///      run time on first use), and portable code otherwise;
+    /// - 2: PDEP always, which is only safe when compiling for BMI2 (-mbmi2).
+    /// The default is 2 when compiling for BMI2, 1 on x86-64 with GCC or Clang
+    /// and 0 otherwise.
+    #if defined(__BMI2__)
+        #define XTL_USE_BMI2 2
+    #elif defined(__x86_64__) && (defined(__clang__) || (defined(__GNUC__) && __GNUC__ >= 5))
+        #define XTL_USE_BMI2 1
+    #else
+        #define XTL_USE_BMI2 0
+    #endif
+#endif
+
+//------------------------------------------------------------------------------
+
+#if !defined(XTL_VTBL_HASH)
+    /// Selects the hashing policy used by default by vtbl maps (\see vtblhash.hpp):
+    /// - 0: shift-and-mask of the vtbl-pointers (#shift_mask_hash);
+    /// - 1: multiplicative Fibonacci hashing (#fibonacci_hash);
+    /// - 2: simple tabulation hashing (#tabulation_hash);
+    /// - 3: whichever of the above gives the fewest collisions on the vtbl 
+    ///      pointers seen by a given map, chosen on each reconfiguration 
+    ///      (#adaptive_hash).
+    /// Shift-and-mask is the cheapest to compute and is collision-free as long
+    /// as vtbls of interest are laid out close to each other, which is usually
+    /// the case for classes coming from a single module.
+    #define XTL_VTBL_HASH 0
+#endif
+
+//------------------------------------------------------------------------------
+
 #if !defined(XTL_MIN_LOG_SIZE)
     /// Log of the smallest cache size to start from
     #define XTL_MIN_LOG_SIZE 3
 #endif
 
 #if !defined(XTL_MAX_LOG_SIZE)
-    /// Log of the largest cache size to try
-    /// \deprecated This macro is deprecated now and is only used with old vtblmap implementations
-    #define XTL_MAX_LOG_SIZE 14
+    /// Log of the largest cache size of a vtblmap. Vtbl-pointers that do not fit 
+    /// into the cache are still kept by the map, only lookups of them are slower.
+    #define XTL_MAX_LOG_SIZE 20
+#endif
+
+#if !defined(XTL_VTBL_SAMPLE_LOG_SIZE)
+    /// Log of the largest number of vtbl-pointers a vtbl map looks at when it
+    /// searches for a better layout of its cache. Larger maps are sampled, so the
+    /// cost of the search depends on the number of layouts tried, but not on the
+    /// number of classes.
+    #define XTL_VTBL_SAMPLE_LOG_SIZE 10
 #endif
 
 #if !defined(XTL_MAX_LOG_INC)
@@ -324,6 +498,14 @@
 #include "comp.gcc.hpp"     // GNU C++ workarounds
 #endif
 
+#if defined(XTL_LIKELINESS_HINTS) && !XTL_TRACE_LIKELINESS && defined(__GNUC__)
+    #include "hints.hpp"
+    #undef    XTL_LIKELY
+    #undef  XTL_UNLIKELY
+    #define   XTL_LIKELY(...) (__builtin_expect((long int)(__VA_ARGS__), mch::hinted_likeliness<mch::likeliness_hint(__FILE__,__LINE__,1)>::value))
+    #define XTL_UNLIKELY(...) (__builtin_expect((long int)(__VA_ARGS__), mch::hinted_likeliness<mch::likeliness_hint(__FILE__,__LINE__,0)>::value))
+#endif
+
 #include "comp.other.hpp"   // Default workarounds for anything not handled by specialized configs
 #include "macros.hpp"       // Tools for preprocessor meta-programming
 
@@ -501,20 +683,24 @@
 /// A macro used to infer number of bits in a given type of variable.
 #define XTL_BIT_SIZE(T) (8*sizeof(T))
 
+/// A 1 of the type of elements of bit_array, so that shifting it can reach 
+/// every bit of an element, while a plain 1 is an int and cannot.
+#define XTL_BIT_ONE(bit_array) ((bit_array)[0]*0+1)
+
 /// Sets i^th bit in bit_array
-#define XTL_BIT_SET(bit_array, i) ( (bit_array)[(i)/XTL_BIT_SIZE((bit_array)[0])] |= (1 << ((i) % XTL_BIT_SIZE((bit_array)[0]))) )
+#define XTL_BIT_SET(bit_array, i) ( (bit_array)[(i)/XTL_BIT_SIZE((bit_array)[0])] |= (XTL_BIT_ONE(bit_array) << ((i) % XTL_BIT_SIZE((bit_array)[0]))) )
 
 /// Gets i^th bit in bit_array
-#define XTL_BIT_GET(bit_array, i) ( (bit_array)[(i)/XTL_BIT_SIZE((bit_array)[0])]  & (1 << ((i) % XTL_BIT_SIZE((bit_array)[0]))) )
+#define XTL_BIT_GET(bit_array, i) ( (bit_array)[(i)/XTL_BIT_SIZE((bit_array)[0])]  & (XTL_BIT_ONE(bit_array) << ((i) % XTL_BIT_SIZE((bit_array)[0]))) )
 
 //------------------------------------------------------------------------------
 
 #if XTL_SUPPORT(vla)
     #define XTL_VLA(v,T,n,N)  T v[n]
-    #define XTL_VLAZ(v,T,n,N) T v[n]; std::memset(v,0,n*sizeof(T))
+    #define XTL_VLAZ(v,T,n,N) T v[n]; std::memset(v,0,(n)*sizeof(T))
 #elif XTL_SUPPORT(alloca)
-    #define XTL_VLA(v,T,n,N)  T* v = static_cast<T*>(alloca(n*sizeof(T)))
-    #define XTL_VLAZ(v,T,n,N) T* v = static_cast<T*>(alloca(n*sizeof(T))); std::memset(v,0,n*sizeof(T))
+    #define XTL_VLA(v,T,n,N)  T* v = static_cast<T*>(alloca((n)*sizeof(T)))
+    #define XTL_VLAZ(v,T,n,N) T* v = static_cast<T*>(alloca((n)*sizeof(T))); std::memset(v,0,(n)*sizeof(T))
 #else
     #define XTL_VLA(v,T,n,N)  T v[N]
     #define XTL_VLAZ(v,T,n,N) T v[N] = {}
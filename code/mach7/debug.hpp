@@ -45,8 +45,12 @@
 #pragma once
 
 #include <algorithm> // for std::min/std::max
-#include <ostream>
+#include <atomic>
+#include <cstring>
+#include <iostream> // for std::clog
 #include <iomanip>
+#include <mutex>
+#include <vector>
 
 namespace mch ///< Mach7 library namespace
 {
@@ -69,64 +73,240 @@ size_t call_on_last_instance<F,f>::instances = 0;
 
 //------------------------------------------------------------------------------
 
+/// Fewer samples of a hinted condition than this are not enough to call its 
+/// hint mispredicted in reports
+const size_t likeliness_min_samples = 100;
+
+//------------------------------------------------------------------------------
+
+/// Snapshot of the counts of a single condition hinted with XTL_LIKELY or 
+/// XTL_UNLIKELY taken by #likeliness_sites.
+struct likeliness_site
+{
+    const char* file;   ///< File in which the hinted condition was expanded
+    int         line;   ///< Line on which the hinted condition was expanded
+    const char* text;   ///< Text of the condition
+    bool        likely; ///< Whether the condition was hinted as likely
+    size_t      yes;    ///< Number of sampled evaluations to true
+    size_t      no;     ///< Number of sampled evaluations to false
+
+    /// Whether at least min_samples sampled evaluations were made and a strict
+    /// majority of them contradicts the hint
+    bool mispredicted(size_t min_samples = 1) const noexcept
+    {
+        return yes + no >= min_samples && (likely ? no > yes : yes > no);
+    }
+};
+
+//------------------------------------------------------------------------------
+
+/// Counts of a single hinted condition. Instances are local static variables 
+/// of #trace_likeliness, which register themselves in a global list to let
+/// #likeliness_sites take a snapshot of all of them at any time. Counters are 
+/// atomic, so tracing is safe to use from multiple threads.
 struct likliness_tracer
 {
-#ifdef _MSC_VER
-  #pragma warning( push )
-  #pragma warning( disable : 4351 ) // warning C4351: new behavior: elements of array ... will be default initialized
-#endif
+    likliness_tracer(bool l, const char* s, const char* f, int n) : text(s), file(f), line(n), likely(l), prev(nullptr), next(nullptr)
+    {
+        counts[false] = 0;
+        counts[true]  = 0;
+
+        std::lock_guard<std::mutex> lock(registry().mutex);
+        next = registry().head;
+        if (next) next->prev = this;
+        registry().head = this;
+    }
+
+   ~likliness_tracer()
+    {
+        if (snapshot().mispredicted(likeliness_min_samples))
+            std::clog << *this << std::endl;
+
+        std::lock_guard<std::mutex> lock(registry().mutex);
+        (prev ? prev->next : registry().head) = next;
+        if (next) next->prev = prev;
+    }
 
-    likliness_tracer(const char* s, const char* f, int l) : counts(), text(s), file(f), line(l) {}
+    void count(bool c) noexcept { counts[c].fetch_add(1, std::memory_order_relaxed); }
 
-#ifdef _MSC_VER
-  #pragma warning( pop )
-#endif
+    likeliness_site snapshot() const noexcept
+    {
+        likeliness_site s = { file, line, text, likely, counts[true].load(std::memory_order_relaxed), counts[false].load(std::memory_order_relaxed) };
+        return s;
+    }
 
-    size_t& operator[](bool i) { return counts[i]; }
+    /// Calls f with a snapshot of each traced condition while holding the registry lock
+    template <typename F>
+    static void for_each(F f)
+    {
+        std::lock_guard<std::mutex> lock(registry().mutex);
+
+        for (const likliness_tracer* p = registry().head; p; p = p->next)
+            f(p->snapshot());
+    }
 
     std::ostream& operator>>(std::ostream& os) const
     {
-        size_t Y = counts[true], N = counts[false];
+        likeliness_site s = snapshot();
+        size_t Y = s.yes, N = s.no;
         return os << file << '(' << line << ')' 
                   << (Y > N ? "   LIKELY " : " unlikely ") 
                   << " Yes: "        << std::setw(10) << Y
                   << " No:  "        << std::setw(10) << N
                   << " Total: "      << std::setw(10) << (Y+N)
-                  << " Percentage: " << std::setw(6)  << std::fixed << std::setprecision(2) << 100*double(std::max(Y,N))/(Y+N) << '%' 
+                  << " Percentage: " << std::setw(6)  << std::fixed << std::setprecision(2) << (Y+N ? 100*double(std::max(Y,N))/(Y+N) : 0.0) << '%' 
                   << " Condition: "  << text;
     }
 
     friend std::ostream& operator<<(std::ostream& os, const likliness_tracer& t) { return t >> os; }
 
-    size_t counts[2];
-    const char* text;
-    const char* file;
-    int         line;
-};
+    std::atomic<size_t> counts[2];
+    const char*         text;
+    const char*         file;
+    int                 line;
+    bool                likely;
 
-//------------------------------------------------------------------------------
+private:
 
-template <bool likely>
-struct likliness_tracer_of : likliness_tracer
-{
-    likliness_tracer_of(const char* s, const char* f, int l) : likliness_tracer(s,f,l) {}
-   ~likliness_tracer_of()
+    struct registry_type
     {
-        if (likely != (counts[true] >= counts[false]))
-            std::clog << *this << std::endl;
+        std::mutex        mutex;
+        likliness_tracer* head;
+    };
+
+    /// The registry is intentionally never destroyed as tracers are local 
+    /// static variables that may be destroyed after it would have been.
+    static registry_type& registry()
+    {
+        static registry_type* r = new registry_type();
+        return *r;
     }
+
+    likliness_tracer(const likliness_tracer&);            ///< No copy constructor
+    likliness_tracer& operator=(const likliness_tracer&); ///< No assignment operator
+
+    likliness_tracer* prev;
+    likliness_tracer* next;
 };
 
 //------------------------------------------------------------------------------
 
-template <bool likeliness, int line, typename T/*=void*/>
+/// Decides whether the current evaluation of a hinted condition is sampled. 
+/// Each thread keeps its own countdown to the next sample, which is reset to 
+/// a pseudo-random value in [1,2*XTL_TRACE_LIKELINESS_PERIOD) so that 
+/// conditions evaluated in a fixed rhythm are not systematically skipped.
+inline bool sample_likeliness() noexcept
+{
+    static_assert((XTL_TRACE_LIKELINESS_PERIOD & (XTL_TRACE_LIKELINESS_PERIOD-1)) == 0, "XTL_TRACE_LIKELINESS_PERIOD must be a power of 2");
+
+    if (XTL_TRACE_LIKELINESS_PERIOD == 1)
+        return true;
+
+    static thread_local unsigned int state     = 2463534242u; // Seed of Marsaglia's xorshift generator
+    static thread_local unsigned int countdown = XTL_TRACE_LIKELINESS_PERIOD;
+
+    if (--countdown)
+        return false;
+
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    countdown = 1 + (state & (2*XTL_TRACE_LIKELINESS_PERIOD-2));
+    return true;
+}
+
+//------------------------------------------------------------------------------
+
+/// Counts evaluations of a hinted condition. The counter argument, unique to 
+/// each use of XTL_LIKELY and XTL_UNLIKELY in a translation unit, keeps apart 
+/// the sites that share everything else, e.g. the same line of different files.
+template <bool likeliness, int line, int counter, typename T/*=void*/>
 static bool trace_likeliness(bool c, const char* text, const char* file)
 {
-    static likliness_tracer_of<likeliness> tracer(text,file,line);
-    ++tracer[c];
+    static likliness_tracer tracer(likeliness,text,file,line);
+
+    if (sample_likeliness())
+        tracer.count(c);
+
     return c;
 }
 
 //------------------------------------------------------------------------------
 
+/// Returns counts of all the conditions hinted with XTL_LIKELY or XTL_UNLIKELY
+/// that were evaluated at least once so far.
+inline std::vector<likeliness_site> likeliness_sites()
+{
+    std::vector<likeliness_site> result;
+    likliness_tracer::for_each([&result](const likeliness_site& s) { result.push_back(s); });
+    return result;
+}
+
+//------------------------------------------------------------------------------
+
+/// Writes mispredicted hints, or all hints when all is true, in the order of
+/// decreasing number of samples, so that the hottest mistakes come first. 
+/// Hints with fewer than min_samples samples are never called mispredicted.
+inline std::ostream& write_likeliness_report(std::ostream& os, bool all = false, size_t min_samples = likeliness_min_samples)
+{
+    std::vector<likeliness_site> sites = likeliness_sites();
+
+    std::sort(sites.begin(), sites.end(), [](const likeliness_site& a, const likeliness_site& b) { return a.yes + a.no > b.yes + b.no; });
+
+    std::ios::fmtflags fmt = os.flags(); // store flags
+
+    for (size_t i = 0; i < sites.size(); ++i)
+    {
+        const likeliness_site& s = sites[i];
+
+        const bool mispredicted = s.mispredicted(min_samples);
+
+        if (!all && !mispredicted)
+            continue;
+
+        os << s.file << '(' << s.line << ')'
+           << (mispredicted ? " MISPREDICTED " : " ok           ")
+           << (s.likely ? "XTL_LIKELY  " : "XTL_UNLIKELY")
+           << " Yes: "        << std::setw(10) << s.yes
+           << " No: "         << std::setw(10) << s.no
+           << " Percentage: " << std::setw(6)  << std::fixed << std::setprecision(2) << (s.yes + s.no ? 100*double(s.yes)/(s.yes+s.no) : 0.0) << "% true"
+           << " Condition: "  << s.text << '\n';
+    }
+
+    os.flags(fmt);
+    return os << std::flush;
+}
+
+//------------------------------------------------------------------------------
+
+/// Writes entries of the header that can be passed to the build with 
+/// -DXTL_LIKELINESS_HINTS=\"file.hpp\" to correct mispredicted hints, similar
+/// to a light-weight profile-guided optimization. Only sites with at least
+/// min_samples samples are written. \see hints.hpp
+inline std::ostream& write_likeliness_hints(std::ostream& os, size_t min_samples = likeliness_min_samples)
+{
+    std::vector<likeliness_site> sites = likeliness_sites();
+
+    os << "// Corrected XTL_LIKELY/XTL_UNLIKELY hints generated by mch::write_likeliness_hints\n";
+
+    for (size_t i = 0; i < sites.size(); ++i)
+    {
+        const likeliness_site& s = sites[i];
+
+        if (!s.mispredicted(min_samples))
+            continue;
+
+        const char* name = s.file + std::strlen(s.file);
+
+        while (name != s.file && name[-1] != '/' && name[-1] != '\\')
+            --name;
+
+        os << "{\"" << name << "\", " << s.line << ", " << (s.yes > s.no) << "}, // " << s.text << '\n';
+    }
+
+    return os << std::flush;
+}
+
+//------------------------------------------------------------------------------
+
 } // of namespace mch
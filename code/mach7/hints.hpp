@@ -0,0 +1,106 @@
+//
+//  Mach7: Pattern Matching Library for C++
+//
+//  Copyright 2011-2013, Texas A&M University.
+//  Copyright 2014 Yuriy Solodkyy.
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are met:
+//
+//      * Redistributions of source code must retain the above copyright
+//        notice, this list of conditions and the following disclaimer.
+//
+//      * Redistributions in binary form must reproduce the above copyright
+//        notice, this list of conditions and the following disclaimer in the
+//        documentation and/or other materials provided with the distribution.
+//
+//      * Neither the names of Mach7 project nor the names of its contributors
+//        may be used to endorse or promote products derived from this software
+//        without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+//  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+//  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+//  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY
+//  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+//  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+//  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///
+/// \file
+///
+/// This file substitutes hints of XTL_LIKELY and XTL_UNLIKELY with those 
+/// observed in a traced run. Build once with XTL_TRACE_LIKELINESS, run the
+/// program on representative input and save the output of 
+/// mch::write_likeliness_hints into a header, then rebuild with 
+/// -DXTL_LIKELINESS_HINTS=\"that_header.hpp\". Each entry of the header is
+/// {"file", line, likely} where file is matched against the trailing path
+/// components of __FILE__ at the site of the hint.
+///
+/// \author Yuriy Solodkyy <yuriy.solodkyy@gmail.com>
+///
+/// \see https://parasol.tamu.edu/mach7/
+/// \see https://github.com/solodon4/Mach7
+/// \see https://github.com/solodon4/SELL
+///
+
+#pragma once
+
+#include <cstddef>
+
+namespace mch ///< Mach7 library namespace
+{
+
+//------------------------------------------------------------------------------
+
+/// A hint that overrides the one written in code at a given file and line
+struct likeliness_hint_entry
+{
+    const char* file;   ///< Name of the file, possibly with some of its directories
+    int         line;   ///< Line of the hint
+    bool        likely; ///< Whether the condition should be treated as likely
+};
+
+/// Hints loaded from the header named by #XTL_LIKELINESS_HINTS
+constexpr likeliness_hint_entry likeliness_hints[] = {
+#include XTL_LIKELINESS_HINTS
+    {nullptr, 0, false} // Sentinel
+};
+
+//------------------------------------------------------------------------------
+
+constexpr std::size_t hint_strlen(const char* s) { return *s ? 1 + hint_strlen(s+1) : 0; }
+
+/// Checks whether the first n characters of file end with the first m 
+/// characters of name at the boundary of a path component.
+constexpr bool hint_file_matches(const char* file, std::size_t n, const char* name, std::size_t m)
+{
+    return m == 0 
+        ? (n == 0 || file[n-1] == '/' || file[n-1] == '\\')
+        : n != 0 && file[n-1] == name[m-1] && hint_file_matches(file, n-1, name, m-1);
+}
+
+/// Returns the hint for the condition at a given file and line, which is
+/// the corrected one when listed in #likeliness_hints and dflt otherwise.
+constexpr bool likeliness_hint(const char* file, int line, bool dflt, std::size_t i = 0)
+{
+    return !likeliness_hints[i].file
+        ? dflt
+        : likeliness_hints[i].line == line && hint_file_matches(file, hint_strlen(file), likeliness_hints[i].file, hint_strlen(likeliness_hints[i].file))
+            ? likeliness_hints[i].likely
+            : likeliness_hint(file, line, dflt, i+1);
+}
+
+/// Forces compile-time evaluation of #likeliness_hint in __builtin_expect
+template <bool likely>
+struct hinted_likeliness
+{
+    static const long value = likely;
+};
+
+//------------------------------------------------------------------------------
+
+} // of namespace mch
@@ -109,6 +109,7 @@
 //------------------------------------------------------------------------------
 
 #include "unisyn.hpp"
+#include <typeinfo>
 
 #if defined(_MSC_VER) && !defined(_CPPRTTI)
     /// Disabling RTTI in MSVC is known to enable compiler optimizations that
@@ -130,20 +131,29 @@ namespace mch ///< Mach7 library namespace
 
 //------------------------------------------------------------------------------
 
-/// FIX: This specialization doesn't actually help/work as expected as get<UID>
-///      at the time of this instantiation is not yet set<UID>.
-template <typename T, typename UID>
-struct preallocated<vtblmap<T>,UID>
+/// The vtblmap of a Match statement is presized from its number of clauses, 
+/// which only becomes known at EndMatch, so the map is constructed there by
+/// #preallocated_constructor \see #XTL_SET_TYPES_NUM_ESTIMATE
+template <typename UID>
+struct preallocated<vtblmap<type_switch_info>,UID>
 {
-    static vtblmap<T> value;
+    XTL_PREALLOCATED_STATIC preallocated_storage<vtblmap<type_switch_info>> value;
+
+    static void construct(vtbl_count_t clauses)
+    {
+        new(&value.data) vtblmap<type_switch_info>(
+            clauses ? clauses : min_expected_size,
+            typeid(UID).name(),
+            uid_file<UID>(0),
+            uid_line<UID>(0)
+        );
+    }
 };
 
-template <typename T, typename UID>
-vtblmap<T> preallocated<vtblmap<T>,UID>::value(
-    deferred_constant<vtbl_count_t>::get<UID>::value 
-        ? deferred_constant<vtbl_count_t>::get<UID>::value 
-        : min_expected_size
-);
+#if XTL_PRELOAD_LOCAL_STATIC_VARIABLES != 2
+template <typename UID>
+preallocated_storage<vtblmap<type_switch_info>> preallocated<vtblmap<type_switch_info>,UID>::value;
+#endif
 
 //------------------------------------------------------------------------------
 
@@ -282,7 +292,7 @@ template <class T> inline void ignore_unused_warning(T const&) {}
 /// - matched refers the subject by default (used for When sub-clauses)
 /// - the subject cannot be a nullptr - we assert at run-time (debug) if it is
 #define XTL_MATCH_PREAMBULA(s)                                                 \
-        struct match_uid_type {};                                              \
+        struct match_uid_type { XTL_UID_LOCATION };                            \
         auto&&     subject_ref = s;                                            \
         auto const subject_ptr = mch::addr(subject_ref);                       \
         typedef XTL_CPP0X_TYPENAME mch::underlying<decltype(*subject_ptr)>::type source_type; \
@@ -349,12 +359,27 @@ template<>                        struct target_disambiguator<int>    { typedef
 
 #if XTL_CLAUSES_NUM_ESTIMATES_TYPES_NUM
     #define XTL_GET_TYPES_NUM_ESTIMATE   (mch::deferred_constant<mch::vtbl_count_t>::get<match_uid_type>::value)
-    #define XTL_SET_TYPES_NUM_ESTIMATE(N) mch::ignore_unused_warning(mch::deferred_constant<mch::vtbl_count_t>::set<match_uid_type,(N)>::value_ptr)
 #else
     #define XTL_GET_TYPES_NUM_ESTIMATE   (min_expected_size)
+#endif
+
+#if XTL_PRELOAD_LOCAL_STATIC_VARIABLES
+    /// The preallocated map is only constructed at EndMatch, where N is known
+    #define XTL_SET_TYPES_NUM_ESTIMATE(N) mch::ignore_unused_warning(mch::preallocated_constructor<mch::vtblmap<mch::type_switch_info>,match_uid_type,XTL_CLAUSES_NUM_ESTIMATES_TYPES_NUM ? (N) : 0>::instance)
+#elif XTL_CLAUSES_NUM_ESTIMATES_TYPES_NUM
+    #define XTL_SET_TYPES_NUM_ESTIMATE(N) mch::ignore_unused_warning(mch::deferred_constant<mch::vtbl_count_t>::set<match_uid_type,(N)>::value_ptr)
+#else
     #define XTL_SET_TYPES_NUM_ESTIMATE(N)
 #endif
 
+#if XTL_PRELOAD_LOCAL_STATIC_VARIABLES
+    /// Constructs the preallocated static data of a generic Match statement at
+    /// EndMatch, presized for N clauses when the data is a vtblmap
+    #define XTL_CONSTRUCT_STATIC_DATA(N) mch::ignore_unused_warning(mch::preallocated_constructor<XTL_CPP0X_TYPENAME switch_traits::static_data_type,match_uid_type,XTL_CLAUSES_NUM_ESTIMATES_TYPES_NUM ? (N) : 0>::instance)
+#else
+    #define XTL_CONSTRUCT_STATIC_DATA(N)
+#endif
+
 //------------------------------------------------------------------------------
 /// Few general rules to understand behavior of various #Match statements below:
 /// - Each Case, Qua and When clauses should close as many braces as they open
@@ -405,8 +430,8 @@ template<>                        struct target_disambiguator<int>    { typedef
             {                                                                  \
                 if (XTL_LIKELY((__switch_info.target == 0)))                   \
                 {                                                              \
-                    __switch_info.target = target_label;                       \
                     __switch_info.offset = intptr_t(__casted_ptr)-intptr_t(subject_ptr); \
+                    __switch_info.target = target_label;                       \
                 }                                                              \
             XTL_NON_REDUNDANCY_ONLY(case target_label:)                        \
                 auto matched = mch::adjust_ptr<target_type>(subject_ptr,__switch_info.offset);\
@@ -426,8 +451,8 @@ template<>                        struct target_disambiguator<int>    { typedef
             {                                                                  \
                 if (XTL_LIKELY(__switch_info.target == 0))                     \
                 {                                                              \
-                    __switch_info.target = target_label;                       \
                     __switch_info.offset = intptr_t(__casted_ptr)-intptr_t(subject_ptr); \
+                    __switch_info.target = target_label;                       \
                 }                                                              \
             XTL_NON_REDUNDANCY_ONLY(case target_label:)                        \
                 auto matched = mch::adjust_ptr<target_type>(subject_ptr,__switch_info.offset);\
@@ -807,6 +832,7 @@ if (true) {
 #define OtherwiseQ(...) XTL_CLAUSE_OTHERWISE(CaseQ,__VA_ARGS__)
 #define EndMatchQ       XTL_SUBCLAUSE_LAST }}}                                 \
         enum { target_label = XTL_COUNTER-__base_counter };                    \
+        XTL_CONSTRUCT_STATIC_DATA(target_label-1);                             \
         if (!processed) switch_traits::on_end(subject_ptr, local_data, target_label); \
         case switch_traits::XTL_CPP0X_TEMPLATE CaseLabel<target_label>::exit: ; }}
 
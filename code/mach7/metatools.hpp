@@ -46,6 +46,7 @@
 
 #include "config.hpp"
 #include <cstddef>
+#include <new>
 #include <utility>
 #include <type_traits>
 
@@ -77,6 +78,14 @@ XTL_MSC_ONLY(template <typename R, typename A1> struct underlying<R(&)(A1)> { ty
 
 //------------------------------------------------------------------------------
 
+/// Number of types among Ts satisfying predicate P (e.g. std::is_polymorphic).
+template <template <typename> class P, typename... Ts> struct count_if;
+template <template <typename> class P>                 struct count_if<P>           { enum { value = 0 }; };
+template <template <typename> class P, typename T, typename... Ts>
+struct count_if<P,T,Ts...> { enum { value = (P<T>::value ? 1 : 0) + count_if<P,Ts...>::value }; };
+
+//------------------------------------------------------------------------------
+
 //template <typename T> inline T&& identity(T&& t) noexcept { return std::forward<T>(t); } // FIX: This breaks constructor pattern for the case of 1 argument with enable_if ...
 template <typename T> inline T& identity(T& t) noexcept { return t; }
 
@@ -120,7 +129,8 @@ template <class U, size_t L, template<class X, size_t Y> class Q> struct get_par
 /// \note This class cannot be used to pass deferred constants to objects instantiated 
 ///       through the use of preallocated<> template below. The reason is that 
 ///       initialization of such objects happens before main and thus corresponding 
-///       set<UID> may not have been initialized yet!
+///       set<UID> may not have been initialized yet! Use #preallocated_storage
+///       and #preallocated_constructor for such objects instead.
 template <typename T>
 struct deferred_constant
 {
@@ -154,15 +164,61 @@ T* deferred_constant<T>::set<UID,V>::value_ptr = &(deferred_constant<T>::get<UID
 /// Allocation Identifier - a usually local type that uniquely identifies allocation.
 /// The disadvantage of using this class might be worse locality as the static 
 /// variable inside this class, even though preallocated will most likely be 
-/// elsewhere.
+/// elsewhere. With XTL_PRELOAD_LOCAL_STATIC_VARIABLES=2 all such variables are
+/// kept together in #XTL_STATIC_DATA_SECTION to mitigate this.
 template <typename T, typename UID>
 struct preallocated
 {
-    static T value;
+    XTL_PREALLOCATED_STATIC T value;
 };
 
+#if XTL_PRELOAD_LOCAL_STATIC_VARIABLES != 2
 template <typename T, typename UID>
 T preallocated<T,UID>::value;
+#endif
+
+//------------------------------------------------------------------------------
+
+/// Storage that specializations of #preallocated can use in place of the value 
+/// when the value's constructor needs a constant that only becomes known later 
+/// in the lexical scope, e.g. the number of clauses of a Match statement that
+/// has to presize its cache. The storage has no constructor, so it is zero-
+/// initialized before any dynamic initialization takes place, while the object
+/// itself is constructed by #preallocated_constructor. Conversion to T& lets
+/// it be used in #XTL_PRELOADABLE_LOCAL_STATIC just like an object of type T.
+template <typename T>
+struct preallocated_storage
+{
+    operator T&() noexcept { return *reinterpret_cast<T*>(&data); }
+    typename std::aligned_storage<sizeof(T), std::alignment_of<T>::value>::type data;
+};
+
+/// Constructs the object preallocated for UID in #preallocated_storage with a
+/// compile-time constant V and destroys it at exit. Odr-use of #instance at the
+/// place where V becomes known instantiates a static variable, whose dynamic 
+/// initialization before main calls preallocated<T,UID>::construct(V). This is
+/// the only initializer of the object, so unlike with #deferred_constant there 
+/// is no order of initialization in which the object is built before V is set.
+/// Objects preallocated by the primary template are already constructed, so
+/// for them this is a no-op, which lets generic code use it on any type.
+/// 
+/// \note Just like any other preallocated object, it should not be used during
+///       dynamic initialization of other static variables.
+template <typename T, typename UID, size_t V>
+struct preallocated_constructor
+{
+    preallocated_constructor() { construct(preallocated<T,UID>::value); }
+   ~preallocated_constructor() { destroy(preallocated<T,UID>::value); }
+    static preallocated_constructor instance;
+private:
+    static void construct(T&) noexcept {}
+    static void construct(preallocated_storage<T>&) { preallocated<T,UID>::construct(V); }
+    static void destroy(T&) noexcept {}
+    static void destroy(preallocated_storage<T>& s) { static_cast<T&>(s).~T(); }
+};
+
+template <typename T, typename UID, size_t V>
+preallocated_constructor<T,UID,V> preallocated_constructor<T,UID,V>::instance;
 
 //------------------------------------------------------------------------------
 
@@ -0,0 +1,469 @@
+//
+//  Mach7: Pattern Matching Library for C++
+//
+//  Copyright 2011-2013, Texas A&M University.
+//  Copyright 2014 Yuriy Solodkyy.
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are met:
+//
+//      * Redistributions of source code must retain the above copyright
+//        notice, this list of conditions and the following disclaimer.
+//
+//      * Redistributions in binary form must reproduce the above copyright
+//        notice, this list of conditions and the following disclaimer in the
+//        documentation and/or other materials provided with the distribution.
+//
+//      * Neither the names of Mach7 project nor the names of its contributors
+//        may be used to endorse or promote products derived from this software
+//        without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+//  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+//  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+//  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY
+//  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+//  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+//  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///
+/// \file
+///
+/// This file defines open multimethods: functions dispatched on the dynamic 
+/// types of several arguments, whose overloads are registered at run time, e.g.
+/// by plugins, rather than listed in a single Match statement:
+///
+/// \code
+///     mch::multimethod<bool(mch::virtual_<const Shape&>, mch::virtual_<const Shape&>)> intersect;
+///
+///     intersect.add([](const Shape&,  const Shape&)  { return false; }); // Fallback
+///     intersect.add([](const Circle& a, const Circle& b) { return ...; });
+///     intersect.add([](const Circle& a, const Square& b) { return ...; });
+///     ...
+///     bool b = intersect(s1, s2);
+/// \endcode
+///
+/// Parameters marked with #virtual_ are dispatched on, while the others are 
+/// passed through to the overloads. The overload chosen for a tuple of dynamic
+/// types is the applicable one with the smallest subtype distance: for each 
+/// virtual parameter, the number of types overloads are registered for that 
+/// are between the dynamic type of the argument and the type of the parameter.
+/// Ties go to the overload registered first. The choice is made once per tuple
+/// of vtbl-pointers and memoized in a vtbl_map<N,T> along with the offsets the
+/// arguments have to be adjusted by, so that a call costs as much as an N-ary 
+/// Match statement. Registering an overload invalidates the choices made so far.
+///
+/// Relation between types of parameters of different overloads is found once 
+/// per type by throwing a pointer to one type and catching it as a pointer to 
+/// another, which only needs the types and no objects of them.
+///
+/// Like Match statements, a multimethod must not be called from several 
+/// threads at the same time.
+///
+/// \author Yuriy Solodkyy <yuriy.solodkyy@gmail.com>
+///
+/// \see https://parasol.tamu.edu/mach7/
+/// \see https://github.com/solodon4/Mach7
+/// \see https://github.com/solodon4/SELL
+///
+
+#pragma once
+
+#include "metatools.hpp" // count_if
+#include "ptrtools.hpp"  // vtbl_of
+#include "vtblmap4.hpp"  // vtbl_map<N,T> used to memoize the dispatch
+#include <exception>
+#include <memory>
+#include <typeinfo>
+#include <utility>
+#include <vector>
+
+namespace mch ///< Mach7 library namespace
+{
+
+//------------------------------------------------------------------------------
+
+/// Marks a parameter of a #multimethod, whose argument is dispatched on. 
+/// Either a reference or a pointer to a polymorphic base class.
+template <typename T> struct virtual_;
+
+//------------------------------------------------------------------------------
+
+/// Thrown when no overload of a #multimethod accepts the dynamic types of its
+/// arguments or a null pointer is passed in place of a virtual parameter.
+class bad_multimethod_call : public std::exception
+{
+public:
+    const char* what() const noexcept { return "mch::bad_multimethod_call"; }
+};
+
+//------------------------------------------------------------------------------
+
+/// Traits of a parameter P in the signature of a #multimethod
+template <typename P>
+struct multimethod_parameter
+{
+    enum { is_virtual = false };
+    typedef P type; ///< Type of the argument of the multimethod
+};
+
+template <typename B>
+struct multimethod_parameter<virtual_<B&>>
+{
+    static_assert(std::is_polymorphic<B>::value, "Only references to polymorphic classes can be virtual parameters");
+    enum { is_virtual = true };
+    typedef B& type;
+    typedef typename std::remove_const<B>::type base_type;
+    static const base_type* pointer(B& b) noexcept { return &b; }
+};
+
+template <typename B>
+struct multimethod_parameter<virtual_<B*>>
+{
+    static_assert(std::is_polymorphic<B>::value, "Only pointers to polymorphic classes can be virtual parameters");
+    enum { is_virtual = true };
+    typedef B* type;
+    typedef typename std::remove_const<B>::type base_type;
+    static const base_type* pointer(B* b) noexcept { return b; }
+};
+
+/// Whether P is a virtual parameter, for use with #count_if
+template <typename P> struct multimethod_is_virtual : std::integral_constant<bool,multimethod_parameter<P>::is_virtual> {};
+
+//------------------------------------------------------------------------------
+
+/// Number of virtual parameters among the first I parameters Ps...
+template <size_t I, typename... Ps> struct multimethod_virtuals_before { enum { value = 0 }; };
+template <size_t I, typename P, typename... Ps>
+struct multimethod_virtuals_before<I,P,Ps...>
+{
+    enum { value = I == 0 ? 0 : multimethod_virtuals_before<I-1,Ps...>::value + (multimethod_parameter<P>::is_virtual ? 1 : 0) };
+};
+template <typename P, typename... Ps>
+struct multimethod_virtuals_before<0,P,Ps...> { enum { value = 0 }; };
+
+/// Compile-time sequence of indices 0..N-1
+template <size_t... I> struct multimethod_indices {};
+template <size_t N, size_t... I> struct multimethod_make_indices : multimethod_make_indices<N-1,N-1,I...> {};
+template <size_t... I> struct multimethod_make_indices<0,I...> { typedef multimethod_indices<I...> type; };
+
+/// Parameter types Ps... of an overload along with its result R, deduced from
+/// a function pointer or the call operator of a function object
+template <typename R, typename... Ps> struct multimethod_signature {};
+template <typename F> struct multimethod_overload_traits : multimethod_overload_traits<decltype(&F::operator())> {};
+template <typename R, typename... Ps>            struct multimethod_overload_traits<R (*)(Ps...)>             { typedef multimethod_signature<R,Ps...> type; };
+template <typename R, typename... Ps>            struct multimethod_overload_traits<R (&)(Ps...)>             { typedef multimethod_signature<R,Ps...> type; };
+template <typename R, typename... Ps>            struct multimethod_overload_traits<R (Ps...)>                { typedef multimethod_signature<R,Ps...> type; };
+template <typename C, typename R, typename... Ps> struct multimethod_overload_traits<R (C::*)(Ps...)>         { typedef multimethod_signature<R,Ps...> type; };
+template <typename C, typename R, typename... Ps> struct multimethod_overload_traits<R (C::*)(Ps...) const>   { typedef multimethod_signature<R,Ps...> type; };
+
+//------------------------------------------------------------------------------
+
+///@{
+/// Argument passed to the parameter P of an overload for the parameter A of 
+/// the multimethod: arguments of virtual parameters are taken from adjusted 
+/// pointers, while the rest are forwarded.
+template <typename P, typename A, size_t K, typename T>
+inline auto multimethod_argument(void* const*, T&& arg, std::false_type) noexcept -> T&&
+{
+    return std::forward<T>(arg);
+}
+
+template <typename P, typename A, size_t K, typename T>
+inline auto multimethod_argument(void* const* adjusted, T&&, std::true_type) noexcept -> typename std::enable_if<std::is_reference<P>::value,P>::type
+{
+    return *static_cast<typename std::remove_reference<P>::type*>(adjusted[K]);
+}
+
+template <typename P, typename A, size_t K, typename T>
+inline auto multimethod_argument(void* const* adjusted, T&&, std::true_type) noexcept -> typename std::enable_if<std::is_pointer<P>::value,P>::type
+{
+    return static_cast<P>(adjusted[K]);
+}
+///@}
+
+//------------------------------------------------------------------------------
+
+/// Open multimethod with signature R(A...), where some of A... are #virtual_
+template <typename Signature> class multimethod; ///< Intentionally undefined
+
+template <typename R, typename... A>
+class multimethod<R(A...)>
+{
+public:
+
+    /// Number of virtual parameters
+    enum { arity = count_if<multimethod_is_virtual,A...>::value };
+
+    static_assert(arity > 0, "A multimethod needs at least one virtual parameter");
+
+    multimethod() : generation(1), dispatch(0, typeid(multimethod).name()) {}
+
+    /// Registers an overload: a function pointer or a function object taking 
+    /// references or pointers to classes derived from the bases of the virtual
+    /// parameters in place of those and the same types as the other parameters.
+    /// Returns the number of overloads registered so far.
+    template <typename F>
+    size_t add(F f)
+    {
+        return add_overload(std::move(f), typename multimethod_overload_traits<F>::type());
+    }
+
+    /// Calls the overload for the dynamic types of the virtual arguments
+    R operator()(typename multimethod_parameter<A>::type... args)
+    {
+        const void* objects[arity];
+        intptr_t    vtbls[arity];
+
+        store_objects(objects, vtbls, args...);
+
+        dispatch_info& info = dispatch.get(vtbls);
+
+        if (XTL_UNLIKELY(info.generation != generation))
+            resolve(info, objects);
+
+        if (XTL_UNLIKELY(!info.call))
+            throw bad_multimethod_call();
+
+        void* adjusted[arity];
+
+        for (size_t i = 0; i < arity; ++i)
+            adjusted[i] = const_cast<char*>(static_cast<const char*>(objects[i])) + info.offsets[i];
+
+        return info.call(info.function, adjusted, args...);
+    }
+
+    /// Number of registered overloads
+    size_t size() const noexcept { return overloads.size(); }
+
+private:
+
+    /// Calls an overload with the arguments of virtual parameters already adjusted
+    typedef R (*call_type)(const void* function, void* const* adjusted, typename multimethod_parameter<A>::type... args);
+
+    /// Memoized choice of the overload for a tuple of vtbl-pointers
+    struct dispatch_info
+    {
+        dispatch_info() : call(nullptr), function(nullptr), generation(0) {}
+        call_type      call;              ///< Overload to call or nullptr when none applies
+        const void*    function;          ///< Function object of the overload
+        std::ptrdiff_t offsets[arity];    ///< Adjustments of arguments to the types of parameters of the overload
+        size_t         generation;        ///< Overloads the choice was made among
+    };
+
+    /// Type of a virtual parameter of some overload
+    struct parameter_type
+    {
+        const std::type_info* type;                 ///< For telling types apart
+        const void* (*cast)(const void* base);      ///< dynamic_cast of a pointer to base to a pointer to the type
+        void        (*raise)();                     ///< Throws a pointer to the type
+        bool        (*catches)(void (*raise)());    ///< Whether a pointer thrown by raise converts to a pointer to the type
+    };
+
+    /// Registered overload
+    struct overload
+    {
+        std::shared_ptr<void> function;             ///< Function object of the overload
+        call_type             call;                 ///< Calls the function object
+        size_t                types[arity];         ///< Indices of types of its virtual parameters in #types
+    };
+
+    template <typename D, typename B>
+    struct parameter_type_of
+    {
+        static const void* cast(const void* base) { return dynamic_cast<const D*>(static_cast<const B*>(base)); }
+        static void raise() { throw static_cast<D*>(nullptr); }
+        static bool catches(void (*raise)())
+        {
+            try { raise(); }
+            catch (const D*) { return true; }
+            catch (...)      {}
+            return false;
+        }
+    };
+
+    /// Type D of the parameter P of an overload in place of the virtual parameter A
+    template <typename P, typename Param>
+    struct overload_parameter
+    {
+        typedef typename std::remove_cv<typename std::remove_pointer<typename std::remove_reference<P>::type>::type>::type type;
+        typedef typename Param::base_type base_type;
+        static_assert(std::is_base_of<base_type,type>::value, "Overloads can only take classes derived from the base of a virtual parameter in its place");
+        static_assert(std::is_reference<P>::value == std::is_reference<typename Param::type>::value, "Overloads have to take a reference or a pointer as the virtual parameter does");
+    };
+
+    template <typename F, typename... P>
+    static R call_overload(const void* function, void* const* adjusted, typename multimethod_parameter<A>::type... args)
+    {
+        return call_overload_at<F,P...>(function, adjusted, typename multimethod_make_indices<sizeof...(A)>::type(), args...);
+    }
+
+    template <typename F, typename... P, size_t... I>
+    static R call_overload_at(const void* function, void* const* adjusted, multimethod_indices<I...>, typename multimethod_parameter<A>::type... args)
+    {
+        return (*static_cast<const F*>(function))(
+            multimethod_argument<P,A,multimethod_virtuals_before<I,A...>::value>(
+                adjusted, 
+                std::forward<typename multimethod_parameter<A>::type>(args), 
+                std::integral_constant<bool,multimethod_parameter<A>::is_virtual>()
+            )...
+        );
+    }
+
+    template <typename F, typename Q, typename... P>
+    size_t add_overload(F&& f, multimethod_signature<Q,P...>)
+    {
+        static_assert(sizeof...(P) == sizeof...(A), "Overloads must have as many parameters as the multimethod");
+        typedef typename std::decay<F>::type function_type;
+
+        overload o;
+        o.function = std::shared_ptr<function_type>(new function_type(std::forward<F>(f)));
+        o.call     = &call_overload<const function_type,P...>;
+        size_t k   = 0;
+        int expand[] = { 0, (register_parameter<P,A>(o.types, k), 0)... };
+        XTL_UNUSED(expand);
+        overloads.push_back(o);
+        ++generation; // Choices made so far did not consider this overload
+        return overloads.size();
+    }
+
+    template <typename P, typename Param>
+    auto register_parameter(size_t (&indices)[arity], size_t& k) -> typename std::enable_if<multimethod_parameter<Param>::is_virtual>::type
+    {
+        typedef overload_parameter<P,multimethod_parameter<Param>> traits;
+        typedef parameter_type_of<typename traits::type,typename traits::base_type> info;
+        indices[k] = type_index(k, typeid(typename traits::type), &info::cast, &info::raise, &info::catches);
+        ++k;
+    }
+
+    template <typename P, typename Param>
+    auto register_parameter(size_t (&)[arity], size_t&) -> typename std::enable_if<!multimethod_parameter<Param>::is_virtual>::type
+    {
+        static_assert(std::is_convertible<typename multimethod_parameter<Param>::type,P>::value, "Overloads have to accept the arguments of non-virtual parameters");
+    }
+
+    /// Index of the given type among the types of the virtual parameter k, 
+    /// computing its relation to the others when it is new
+    size_t type_index(size_t k, const std::type_info& ti, const void* (*cast)(const void*), void (*raise)(), bool (*catches)(void (*)()))
+    {
+        std::vector<parameter_type>& ts = types[k];
+
+        for (size_t i = 0; i < ts.size(); ++i)
+            if (*ts[i].type == ti)
+                return i;
+
+        parameter_type t = { &ti, cast, raise, catches };
+        ts.push_back(t);
+
+        std::vector<std::vector<char>>& d = derives[k];
+        const size_t n = ts.size();
+        d.resize(n);
+
+        for (size_t i = 0; i < n; ++i)
+            d[i].resize(n, false);
+
+        for (size_t i = 0; i < n; ++i)
+        {
+            d[n-1][i] = ts[i].catches(ts[n-1].raise); // New one derives from i
+            d[i][n-1] = ts[n-1].catches(ts[i].raise); // i derives from the new one
+        }
+
+        return n-1;
+    }
+
+    template <typename... Args>
+    static void store_objects(const void**, intptr_t*, Args&&...) noexcept {}
+
+    template <typename Arg, typename... Args>
+    static void store_objects(const void** objects, intptr_t* vtbls, Arg&& arg, Args&&... args)
+    {
+        store_object<A...>(objects, vtbls, std::forward<Arg>(arg), std::forward<Args>(args)...);
+    }
+
+    template <typename P, typename... Ps, typename Arg, typename... Args>
+    static auto store_object(const void** objects, intptr_t* vtbls, Arg&& arg, Args&&... args) -> typename std::enable_if<multimethod_parameter<P>::is_virtual>::type
+    {
+        const typename multimethod_parameter<P>::base_type* p = multimethod_parameter<P>::pointer(arg);
+
+        if (XTL_UNLIKELY(!p))
+            throw bad_multimethod_call();
+
+        *objects = p;
+        *vtbls   = vtbl_of(p);
+        store_object<Ps...>(objects+1, vtbls+1, std::forward<Args>(args)...);
+    }
+
+    template <typename P, typename... Ps, typename Arg, typename... Args>
+    static auto store_object(const void** objects, intptr_t* vtbls, Arg&&, Args&&... args) -> typename std::enable_if<!multimethod_parameter<P>::is_virtual>::type
+    {
+        store_object<Ps...>(objects, vtbls, std::forward<Args>(args)...);
+    }
+
+    template <typename... Ps>
+    static auto store_object(const void**, intptr_t*) -> typename std::enable_if<sizeof...(Ps) == 0>::type {}
+
+    /// Chooses the overload for the dynamic types of objects
+    void resolve(dispatch_info& info, const void* const (&objects)[arity]) const
+    {
+        // Which types of each virtual parameter the argument converts to
+        std::vector<char> applicable[arity];
+
+        for (size_t k = 0; k < arity; ++k)
+        {
+            applicable[k].resize(types[k].size());
+
+            for (size_t i = 0; i < types[k].size(); ++i)
+                applicable[k][i] = types[k][i].cast(objects[k]) != nullptr;
+        }
+
+        const overload* best = nullptr;
+        size_t best_distance = size_t(-1);
+
+        for (size_t o = 0; o < overloads.size(); ++o)
+        {
+            const overload& ov = overloads[o];
+            size_t distance = 0;
+            bool   accepts  = true;
+
+            for (size_t k = 0; accepts && k < arity; ++k)
+            {
+                const size_t t = ov.types[k];
+                accepts = applicable[k][t] != 0;
+
+                // Types registered between the dynamic type and the parameter
+                for (size_t i = 0; accepts && i < types[k].size(); ++i)
+                    if (i != t && applicable[k][i] && derives[k][i][t])
+                        ++distance;
+            }
+
+            if (accepts && distance < best_distance)
+            {
+                best          = &ov;
+                best_distance = distance;
+            }
+        }
+
+        info.generation = generation;
+        info.call       = best ? best->call : nullptr;
+        info.function   = best ? best->function.get() : nullptr;
+
+        for (size_t k = 0; best && k < arity; ++k)
+            info.offsets[k] = static_cast<const char*>(types[k][best->types[k]].cast(objects[k])) - static_cast<const char*>(objects[k]);
+    }
+
+    multimethod(const multimethod&);            ///< No copy constructor
+    multimethod& operator=(const multimethod&); ///< No assignment operator
+
+    std::vector<overload>          overloads;        ///< Registered overloads in the order of registration
+    std::vector<parameter_type>    types[arity];     ///< Types of each virtual parameter among overloads
+    std::vector<std::vector<char>> derives[arity];   ///< derives[k][i][j] when type i of parameter k derives from its type j
+    size_t                         generation;       ///< Incremented with each registration
+    vtbl_map<arity,dispatch_info>  dispatch;         ///< Memoized choices of overloads
+};
+
+//------------------------------------------------------------------------------
+
+} // of namespace mch
@@ -56,4 +56,5 @@
 #include "predicate.hpp"      // Predicate patterns
 #include "primitive.hpp"      // Value, Variable and Wildcard patterns
 #include "quantifiers.hpp"    // Quantifiers
-#include "regex.hpp"          // Regular expression pattern
+#include "regex.hpp"          // Regular expression pattern
+#include "sequence.hpp"       // Sequence patterns
@@ -51,6 +51,21 @@ namespace mch ///< Mach7 library namespace
 
 //------------------------------------------------------------------------------
 
+/// Meta-predicate deciding whether a combinator of patterns P1 and P2 should
+/// evaluate P2 before P1. This only happens when #XTL_REORDER_PATTERNS is on,
+/// both patterns are pure and P2 is estimated to be strictly cheaper than P1,
+/// so that the relative order of patterns binding variables is preserved.
+template <typename P1, typename P2>
+struct evaluate_second_first
+{
+    static const bool value = XTL_REORDER_PATTERNS
+                           && is_pure_pattern<P1>::value 
+                           && is_pure_pattern<P2>::value 
+                           && pattern_cost<P2>::value < pattern_cost<P1>::value;
+};
+
+//------------------------------------------------------------------------------
+
 /// Conjunction pattern combinator.
 /// We have a problem with pattern combinators as they also can participate in 
 /// lazy expressions:
@@ -90,8 +105,14 @@ struct conjunction
 
     /// We parameterize over accepted type since the actually accepted type is 
     /// a function of the subject type.
+    /// \note Sub-patterns may be evaluated in reverse order \see #evaluate_second_first
     template <typename T>
-    constexpr bool operator()(const T& subject) const { return m_p1(subject) && m_p2(subject); }
+    constexpr bool operator()(const T& subject) const 
+    {
+        return evaluate_second_first<P1,P2>::value 
+                   ? m_p2(subject) && m_p1(subject) 
+                   : m_p1(subject) && m_p2(subject); 
+    }
 
     P1 m_p1; ///< The 1st pattern in conjunction
     P2 m_p2; ///< The 2nd pattern in conjunction
@@ -103,6 +124,10 @@ template <typename P1, typename P2> struct is_pattern_<conjunction<P1,P2>> { sta
 /// #is_expression_ is a helper meta-predicate that separates lazily evaluatable expressions we support
 template <typename E1, typename E2> struct is_expression_<conjunction<E1,E2>> { static const bool value = is_expression<E1>::value && is_expression<E2>::value; };
 
+/// Cost of a combinator is the cost of evaluating all of its sub-patterns
+template <typename P1, typename P2> struct pattern_cost_<conjunction<P1,P2>>    { static const unsigned int value = pattern_cost<P1>::value + pattern_cost<P2>::value; };
+template <typename P1, typename P2> struct is_pure_pattern_<conjunction<P1,P2>> { static const bool value = is_pure_pattern<P1>::value && is_pure_pattern<P2>::value; };
+
 //------------------------------------------------------------------------------
 
 /// Disjunction pattern combinator
@@ -141,8 +166,14 @@ struct disjunction
 
     /// We parameterize over accepted type since the actually accepted type is 
     /// a function of the subject type.
+    /// \note Sub-patterns may be evaluated in reverse order \see #evaluate_second_first
     template <typename T>
-    constexpr bool operator()(const T& subject) const { return m_p1(subject) || m_p2(subject); }
+    constexpr bool operator()(const T& subject) const 
+    {
+        return evaluate_second_first<P1,P2>::value 
+                   ? m_p2(subject) || m_p1(subject) 
+                   : m_p1(subject) || m_p2(subject); 
+    }
 
     P1 m_p1; ///< The 1st pattern of disjunction combinator
     P2 m_p2; ///< The 2nd pattern of disjunction combinator
@@ -154,6 +185,10 @@ template <typename P1, typename P2> struct is_pattern_<disjunction<P1,P2>> { sta
 /// #is_expression_ is a helper meta-predicate that separates lazily evaluatable expressions we support
 template <typename E1, typename E2> struct is_expression_<disjunction<E1,E2>> { static const bool value = is_expression<E1>::value && is_expression<E2>::value; };
 
+/// Cost of a combinator is the cost of evaluating all of its sub-patterns
+template <typename P1, typename P2> struct pattern_cost_<disjunction<P1,P2>>    { static const unsigned int value = pattern_cost<P1>::value + pattern_cost<P2>::value; };
+template <typename P1, typename P2> struct is_pure_pattern_<disjunction<P1,P2>> { static const bool value = is_pure_pattern<P1>::value && is_pure_pattern<P2>::value; };
+
 //------------------------------------------------------------------------------
 
 /// Negation pattern combinator
@@ -189,6 +224,10 @@ template <typename P1> struct is_pattern_<negation<P1>> { static const bool valu
 /// #is_expression_ is a helper meta-predicate that separates lazily evaluatable expressions we support
 template <typename E1> struct is_expression_<negation<E1>> { static const bool value = is_expression<E1>::value; };
 
+/// Negation costs as much as its sub-pattern
+template <typename P1> struct pattern_cost_<negation<P1>>    : pattern_cost<P1>    {};
+template <typename P1> struct is_pure_pattern_<negation<P1>> : is_pure_pattern<P1> {};
+
 //------------------------------------------------------------------------------
 
 ///@{
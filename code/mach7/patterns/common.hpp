@@ -80,6 +80,26 @@ template <typename T> struct is_expression : is_expression_<typename underlying<
 
 //------------------------------------------------------------------------------
 
+/// #pattern_cost_ is a helper meta-function estimating the relative run-time
+/// cost of matching a pattern of type T. Patterns specialize it to report
+/// their cost, while unknown patterns get a moderate default.
+/// \see #XTL_REORDER_PATTERNS
+template <typename T> struct pattern_cost_ { static const unsigned int value = 10; };
+
+/// #pattern_cost is a helper meta-function estimating the relative run-time cost of matching a pattern
+template <typename T> struct pattern_cost : pattern_cost_<typename underlying<T>::type> {};
+
+/// #is_pure_pattern_ is a helper meta-predicate distinguishing patterns that
+/// neither bind variables nor have any other side effects, and thus can be 
+/// evaluated in any order. Conservatively false unless a pattern says otherwise.
+/// \see #XTL_REORDER_PATTERNS
+template <typename T> struct is_pure_pattern_ { static const bool value = false; };
+
+/// #is_pure_pattern is a helper meta-predicate distinguishing patterns that can be evaluated in any order
+template <typename T> struct is_pure_pattern : is_pure_pattern_<typename underlying<T>::type> {};
+
+//------------------------------------------------------------------------------
+
 /// #either_is_expression is a only used to workaround a compiler stack overflow 
 /// problem in MSVC when we were overloading operator||(E1&&,E2&&) and had || in
 /// enabling condition for that overload. Now we use either_is_expression there 
@@ -234,10 +234,10 @@ struct constr2
     /// for example. Requirement of #Pattern concept.
     template <typename S> struct accepted_type_for { typedef T type; };
 
-    constexpr constr2(const P1&  p1, const P2&  p2) noexcept_when(std::is_nothrow_copy_constructible<P1>::value && std::is_nothrow_copy_constructible<P2>::value) : m_p1(          p1 ), m_p2(          p2 ) {}
-    constexpr constr2(      P1&& p1, const P2&  p2) noexcept_when(std::is_nothrow_move_constructible<P1>::value && std::is_nothrow_copy_constructible<P2>::value) : m_p1(std::move(p1)), m_p2(          p2 ) {}
-    constexpr constr2(const P1&  p1,       P2&& p2) noexcept_when(std::is_nothrow_copy_constructible<P1>::value && std::is_nothrow_move_constructible<P2>::value) : m_p1(          p1 ), m_p2(std::move(p2)) {}
-    constexpr constr2(      P1&& p1,       P2&& p2) noexcept_when(std::is_nothrow_move_constructible<P1>::value && std::is_nothrow_move_constructible<P2>::value) : m_p1(std::move(p1)), m_p2(std::move(p2)) {}
+    /// Each argument is forwarded to initialize the corresponding sub-pattern,
+    /// which is thus copied or moved without spelling out all 2^N combinations.
+    template <typename A1, typename A2>
+    constexpr constr2(A1&& p1, A2&& p2) noexcept_when(std::is_nothrow_constructible<P1,A1&&>::value && std::is_nothrow_constructible<P2,A2&&>::value) : m_p1(std::forward<A1>(p1)), m_p2(std::forward<A2>(p2)) {}
 
     constexpr constr2(const constr2&  src)          noexcept_when(std::is_nothrow_copy_constructible<P1>::value && std::is_nothrow_copy_constructible<P2>::value) : m_p1(          src.m_p1 ), m_p2(          src.m_p2 ) {} ///< Copy constructor    
     constexpr constr2(      constr2&& src)          noexcept_when(std::is_nothrow_move_constructible<P1>::value && std::is_nothrow_move_constructible<P2>::value) : m_p1(std::move(src.m_p1)), m_p2(std::move(src.m_p2)) {} ///< Move constructor
@@ -304,14 +304,8 @@ struct constr3
     /// for example. Requirement of #Pattern concept.
     template <typename S> struct accepted_type_for { typedef T type; };
 
-    constexpr constr3(const P1&  p1, const P2&  p2, const P3&  p3) noexcept_when(std::is_nothrow_copy_constructible<P1>::value && std::is_nothrow_copy_constructible<P2>::value && std::is_nothrow_copy_constructible<P3>::value) : m_p1(          p1 ), m_p2(          p2 ), m_p3(          p3 ) {}
-    constexpr constr3(      P1&& p1, const P2&  p2, const P3&  p3) noexcept_when(std::is_nothrow_move_constructible<P1>::value && std::is_nothrow_copy_constructible<P2>::value && std::is_nothrow_copy_constructible<P3>::value) : m_p1(std::move(p1)), m_p2(          p2 ), m_p3(          p3 ) {}
-    constexpr constr3(const P1&  p1,       P2&& p2, const P3&  p3) noexcept_when(std::is_nothrow_copy_constructible<P1>::value && std::is_nothrow_move_constructible<P2>::value && std::is_nothrow_copy_constructible<P3>::value) : m_p1(          p1 ), m_p2(std::move(p2)), m_p3(          p3 ) {}
-    constexpr constr3(      P1&& p1,       P2&& p2, const P3&  p3) noexcept_when(std::is_nothrow_move_constructible<P1>::value && std::is_nothrow_move_constructible<P2>::value && std::is_nothrow_copy_constructible<P3>::value) : m_p1(std::move(p1)), m_p2(std::move(p2)), m_p3(          p3 ) {}
-    constexpr constr3(const P1&  p1, const P2&  p2,       P3&& p3) noexcept_when(std::is_nothrow_copy_constructible<P1>::value && std::is_nothrow_copy_constructible<P2>::value && std::is_nothrow_move_constructible<P3>::value) : m_p1(          p1 ), m_p2(          p2 ), m_p3(std::move(p3)) {}
-    constexpr constr3(      P1&& p1, const P2&  p2,       P3&& p3) noexcept_when(std::is_nothrow_move_constructible<P1>::value && std::is_nothrow_copy_constructible<P2>::value && std::is_nothrow_move_constructible<P3>::value) : m_p1(std::move(p1)), m_p2(          p2 ), m_p3(std::move(p3)) {}
-    constexpr constr3(const P1&  p1,       P2&& p2,       P3&& p3) noexcept_when(std::is_nothrow_copy_constructible<P1>::value && std::is_nothrow_move_constructible<P2>::value && std::is_nothrow_move_constructible<P3>::value) : m_p1(          p1 ), m_p2(std::move(p2)), m_p3(std::move(p3)) {}
-    constexpr constr3(      P1&& p1,       P2&& p2,       P3&& p3) noexcept_when(std::is_nothrow_move_constructible<P1>::value && std::is_nothrow_move_constructible<P2>::value && std::is_nothrow_move_constructible<P3>::value) : m_p1(std::move(p1)), m_p2(std::move(p2)), m_p3(std::move(p3)) {}
+    template <typename A1, typename A2, typename A3>
+    constexpr constr3(A1&& p1, A2&& p2, A3&& p3) noexcept_when(std::is_nothrow_constructible<P1,A1&&>::value && std::is_nothrow_constructible<P2,A2&&>::value && std::is_nothrow_constructible<P3,A3&&>::value) : m_p1(std::forward<A1>(p1)), m_p2(std::forward<A2>(p2)), m_p3(std::forward<A3>(p3)) {}
 
     constexpr constr3(const constr3&  src)                         noexcept_when(std::is_nothrow_copy_constructible<P1>::value && std::is_nothrow_copy_constructible<P2>::value && std::is_nothrow_copy_constructible<P3>::value) : m_p1(          src.m_p1 ), m_p2(          src.m_p2 ), m_p3(          src.m_p3 ) {} ///< Copy constructor    
     constexpr constr3(      constr3&& src)                         noexcept_when(std::is_nothrow_move_constructible<P1>::value && std::is_nothrow_move_constructible<P2>::value && std::is_nothrow_move_constructible<P3>::value) : m_p1(std::move(src.m_p1)), m_p2(std::move(src.m_p2)), m_p3(std::move(src.m_p3)) {} ///< Move constructor
@@ -382,22 +376,8 @@ struct constr4
     /// for example. Requirement of #Pattern concept.
     template <typename S> struct accepted_type_for { typedef T type; };
 
-    constexpr constr4(const P1&  p1, const P2&  p2, const P3&  p3, const P4&  p4) noexcept_when(std::is_nothrow_copy_constructible<P1>::value && std::is_nothrow_copy_constructible<P2>::value && std::is_nothrow_copy_constructible<P3>::value && std::is_nothrow_copy_constructible<P4>::value) : m_p1(          p1 ), m_p2(          p2 ), m_p3(          p3 ), m_p4(          p4 ) {}
-    constexpr constr4(      P1&& p1, const P2&  p2, const P3&  p3, const P4&  p4) noexcept_when(std::is_nothrow_move_constructible<P1>::value && std::is_nothrow_copy_constructible<P2>::value && std::is_nothrow_copy_constructible<P3>::value && std::is_nothrow_copy_constructible<P4>::value) : m_p1(std::move(p1)), m_p2(          p2 ), m_p3(          p3 ), m_p4(          p4 ) {}
-    constexpr constr4(const P1&  p1,       P2&& p2, const P3&  p3, const P4&  p4) noexcept_when(std::is_nothrow_copy_constructible<P1>::value && std::is_nothrow_move_constructible<P2>::value && std::is_nothrow_copy_constructible<P3>::value && std::is_nothrow_copy_constructible<P4>::value) : m_p1(          p1 ), m_p2(std::move(p2)), m_p3(          p3 ), m_p4(          p4 ) {}
-    constexpr constr4(      P1&& p1,       P2&& p2, const P3&  p3, const P4&  p4) noexcept_when(std::is_nothrow_move_constructible<P1>::value && std::is_nothrow_move_constructible<P2>::value && std::is_nothrow_copy_constructible<P3>::value && std::is_nothrow_copy_constructible<P4>::value) : m_p1(std::move(p1)), m_p2(std::move(p2)), m_p3(          p3 ), m_p4(          p4 ) {}
-    constexpr constr4(const P1&  p1, const P2&  p2,       P3&& p3, const P4&  p4) noexcept_when(std::is_nothrow_copy_constructible<P1>::value && std::is_nothrow_copy_constructible<P2>::value && std::is_nothrow_move_constructible<P3>::value && std::is_nothrow_copy_constructible<P4>::value) : m_p1(          p1 ), m_p2(          p2 ), m_p3(std::move(p3)), m_p4(          p4 ) {}
-    constexpr constr4(      P1&& p1, const P2&  p2,       P3&& p3, const P4&  p4) noexcept_when(std::is_nothrow_move_constructible<P1>::value && std::is_nothrow_copy_constructible<P2>::value && std::is_nothrow_move_constructible<P3>::value && std::is_nothrow_copy_constructible<P4>::value) : m_p1(std::move(p1)), m_p2(          p2 ), m_p3(std::move(p3)), m_p4(          p4 ) {}
-    constexpr constr4(const P1&  p1,       P2&& p2,       P3&& p3, const P4&  p4) noexcept_when(std::is_nothrow_copy_constructible<P1>::value && std::is_nothrow_move_constructible<P2>::value && std::is_nothrow_move_constructible<P3>::value && std::is_nothrow_copy_constructible<P4>::value) : m_p1(          p1 ), m_p2(std::move(p2)), m_p3(std::move(p3)), m_p4(          p4 ) {}
-    constexpr constr4(      P1&& p1,       P2&& p2,       P3&& p3, const P4&  p4) noexcept_when(std::is_nothrow_move_constructible<P1>::value && std::is_nothrow_move_constructible<P2>::value && std::is_nothrow_move_constructible<P3>::value && std::is_nothrow_copy_constructible<P4>::value) : m_p1(std::move(p1)), m_p2(std::move(p2)), m_p3(std::move(p3)), m_p4(          p4 ) {}
-    constexpr constr4(const P1&  p1, const P2&  p2, const P3&  p3,       P4&& p4) noexcept_when(std::is_nothrow_copy_constructible<P1>::value && std::is_nothrow_copy_constructible<P2>::value && std::is_nothrow_copy_constructible<P3>::value && std::is_nothrow_move_constructible<P4>::value) : m_p1(          p1 ), m_p2(          p2 ), m_p3(          p3 ), m_p4(std::move(p4)) {}
-    constexpr constr4(      P1&& p1, const P2&  p2, const P3&  p3,       P4&& p4) noexcept_when(std::is_nothrow_move_constructible<P1>::value && std::is_nothrow_copy_constructible<P2>::value && std::is_nothrow_copy_constructible<P3>::value && std::is_nothrow_move_constructible<P4>::value) : m_p1(std::move(p1)), m_p2(          p2 ), m_p3(          p3 ), m_p4(std::move(p4)) {}
-    constexpr constr4(const P1&  p1,       P2&& p2, const P3&  p3,       P4&& p4) noexcept_when(std::is_nothrow_copy_constructible<P1>::value && std::is_nothrow_move_constructible<P2>::value && std::is_nothrow_copy_constructible<P3>::value && std::is_nothrow_move_constructible<P4>::value) : m_p1(          p1 ), m_p2(std::move(p2)), m_p3(          p3 ), m_p4(std::move(p4)) {}
-    constexpr constr4(      P1&& p1,       P2&& p2, const P3&  p3,       P4&& p4) noexcept_when(std::is_nothrow_move_constructible<P1>::value && std::is_nothrow_move_constructible<P2>::value && std::is_nothrow_copy_constructible<P3>::value && std::is_nothrow_move_constructible<P4>::value) : m_p1(std::move(p1)), m_p2(std::move(p2)), m_p3(          p3 ), m_p4(std::move(p4)) {}
-    constexpr constr4(const P1&  p1, const P2&  p2,       P3&& p3,       P4&& p4) noexcept_when(std::is_nothrow_copy_constructible<P1>::value && std::is_nothrow_copy_constructible<P2>::value && std::is_nothrow_move_constructible<P3>::value && std::is_nothrow_move_constructible<P4>::value) : m_p1(          p1 ), m_p2(          p2 ), m_p3(std::move(p3)), m_p4(std::move(p4)) {}
-    constexpr constr4(      P1&& p1, const P2&  p2,       P3&& p3,       P4&& p4) noexcept_when(std::is_nothrow_move_constructible<P1>::value && std::is_nothrow_copy_constructible<P2>::value && std::is_nothrow_move_constructible<P3>::value && std::is_nothrow_move_constructible<P4>::value) : m_p1(std::move(p1)), m_p2(          p2 ), m_p3(std::move(p3)), m_p4(std::move(p4)) {}
-    constexpr constr4(const P1&  p1,       P2&& p2,       P3&& p3,       P4&& p4) noexcept_when(std::is_nothrow_copy_constructible<P1>::value && std::is_nothrow_move_constructible<P2>::value && std::is_nothrow_move_constructible<P3>::value && std::is_nothrow_move_constructible<P4>::value) : m_p1(          p1 ), m_p2(std::move(p2)), m_p3(std::move(p3)), m_p4(std::move(p4)) {}
-    constexpr constr4(      P1&& p1,       P2&& p2,       P3&& p3,       P4&& p4) noexcept_when(std::is_nothrow_move_constructible<P1>::value && std::is_nothrow_move_constructible<P2>::value && std::is_nothrow_move_constructible<P3>::value && std::is_nothrow_move_constructible<P4>::value) : m_p1(std::move(p1)), m_p2(std::move(p2)), m_p3(std::move(p3)), m_p4(std::move(p4)) {}
+    template <typename A1, typename A2, typename A3, typename A4>
+    constexpr constr4(A1&& p1, A2&& p2, A3&& p3, A4&& p4) noexcept_when(std::is_nothrow_constructible<P1,A1&&>::value && std::is_nothrow_constructible<P2,A2&&>::value && std::is_nothrow_constructible<P3,A3&&>::value && std::is_nothrow_constructible<P4,A4&&>::value) : m_p1(std::forward<A1>(p1)), m_p2(std::forward<A2>(p2)), m_p3(std::forward<A3>(p3)), m_p4(std::forward<A4>(p4)) {}
 
     constexpr constr4(const constr4&  src)                                        noexcept_when(std::is_nothrow_copy_constructible<P1>::value && std::is_nothrow_copy_constructible<P2>::value && std::is_nothrow_copy_constructible<P3>::value && std::is_nothrow_copy_constructible<P4>::value) : m_p1(          src.m_p1 ), m_p2(          src.m_p2 ), m_p3(          src.m_p3 ), m_p4(          src.m_p4 ) {} ///< Copy constructor    
     constexpr constr4(      constr4&& src)                                        noexcept_when(std::is_nothrow_move_constructible<P1>::value && std::is_nothrow_move_constructible<P2>::value && std::is_nothrow_move_constructible<P3>::value && std::is_nothrow_move_constructible<P4>::value) : m_p1(std::move(src.m_p1)), m_p2(std::move(src.m_p2)), m_p3(std::move(src.m_p3)), m_p4(std::move(src.m_p4)) {} ///< Move constructor
@@ -456,333 +436,62 @@ struct constr4
 
 //------------------------------------------------------------------------------
 
-/// 0-argument version of a helper function to #cons that accepts arguments that
-/// have been already preprocessed with #filter to convert regular variables into
-/// #ref and constants into #value.
-/// \note This version will be called from #cons with a non-#view target type
-template <typename T, size_t layout>
-inline constr0<T,layout> cons_ex(const view<T,layout>&) noexcept
-{
-    return constr0<T,layout>();
-}
-
-/// 0-argument version of a helper function to #cons that accepts arguments that
-/// have been already preprocessed with #filter to convert regular variables into
-/// #ref and constants into #value.
-/// \note This version will be called from #cons that had its target type a #view
-template <typename T, size_t layout>
-inline constr0<T,layout> cons_ex(const view<view<T,layout>>&) noexcept
-{
-    return constr0<T,layout>();
-}
-
-/// A 0-argument version of a tree-pattern constructor. Target type is allowed
-/// to be a #view here.
-template <typename T>
-inline auto C() noexcept -> XTL_RETURN(cons_ex(view<T>()))
-
-/// A 0-argument version of a tree-pattern constructor that takes layout in
-/// addition to the target type.
-/// \note #view is not supposed to be passed as a target type to this version
-///       of the function because we will then have two potentially conflicting
-///       layouts. Any layout different from #default_layout passed here will
-///       result in a compile time error.
-template <typename T, size_t layout>
-inline auto C() noexcept -> XTL_RETURN(cons_ex(view<T,layout>()))
-
-//------------------------------------------------------------------------------
-
-/// 1-argument version of a helper function to #cons that accepts arguments that
-/// have been already preprocessed with #filter to convert regular variables into
-/// #ref and constants into #value.
-/// \note This version will be called from #cons with a non-#view target type
-template <typename T, size_t layout, typename P1>
-inline constr1<T,layout,
-            typename underlying<P1>::type
-       > 
-cons_ex(const view<T,layout>&, P1&& p1) noexcept
-{
-    return constr1<T,layout,
-            typename underlying<P1>::type
-           >(
-            std::forward<P1>(p1)
-           );
-}
-
-/// 1-argument version of a helper function to #cons that accepts arguments that
-/// have been already preprocessed with #filter to convert regular variables into
-/// #ref and constants into #value.
-/// \note This version will be called from #cons that had its target type a #view
-template <typename T, size_t layout, typename P1>
-inline constr1<T,layout,
-            typename underlying<P1>::type
-       > 
-cons_ex(const view<view<T,layout>>&, P1&& p1) noexcept
-{
-    return constr1<T,layout,
-            typename underlying<P1>::type
-           >(
-            std::forward<P1>(p1)
-           );
-}
-
-/// A 1-argument version of a tree-pattern constructor. Target type is allowed
-/// to be a #view here.
-template <typename T, typename P1>
-inline auto C(P1&& p1) noexcept -> XTL_RETURN
-(
-    cons_ex(
-        view<T>(),
-        filter(std::forward<P1>(p1))
-    )
-)
-
-/// A 1-argument version of a tree-pattern constructor that takes layout in
-/// addition to the target type.
-/// \note #view is not supposed to be passed as a target type to this version
-///       of the function because we will then have two potentially conflicting
-///       layouts. Any layout different from #default_layout passed here will
-///       result in a compile time error.
-template <typename T, size_t layout, typename P1>
-inline auto C(P1&& p1) noexcept -> XTL_RETURN
-(
-    cons_ex(
-        view<T,layout>(),
-        filter(std::forward<P1>(p1))
-    )
-)
-
-//------------------------------------------------------------------------------
-
-/// 2-argument version of a helper function to #cons that accepts arguments that
-/// have been already preprocessed with #filter to convert regular variables into
-/// #ref and constants into #value.
-/// \note This version will be called from #cons with a non-#view target type
-template <typename T, size_t layout, typename P1, typename P2>
-inline constr2<T,layout,
-            typename underlying<P1>::type,
-            typename underlying<P2>::type
-       > 
-cons_ex(const view<T,layout>&, P1&& p1, P2&& p2) noexcept
-{
-    return constr2<T,layout,
-            typename underlying<P1>::type,
-            typename underlying<P2>::type
-           >(
-            std::forward<P1>(p1),
-            std::forward<P2>(p2)
-           );
-}
-
-/// 2-argument version of a helper function to #cons that accepts arguments that
-/// have been already preprocessed with #filter to convert regular variables into
-/// #ref and constants into #value.
-/// \note This version will be called from #cons that had its target type a #view
-template <typename T, size_t layout, typename P1, typename P2>
-inline constr2<T,layout,
-            typename underlying<P1>::type,
-            typename underlying<P2>::type
-       > 
-cons_ex(const view<view<T,layout>>&, P1&& p1, P2&& p2) noexcept
-{
-    return constr2<T,layout,
-            typename underlying<P1>::type,
-            typename underlying<P2>::type
-           >(
-            std::forward<P1>(p1),
-            std::forward<P2>(p2)
-           );
-}
-
-/// A 2-argument version of a tree-pattern constructor. Target type is allowed
-/// to be a #view here.
-template <typename T, typename P1, typename P2>
-inline auto C(P1&& p1, P2&& p2) noexcept -> XTL_RETURN
-(
-    cons_ex(
-        view<T>(),
-        filter(std::forward<P1>(p1)),
-        filter(std::forward<P2>(p2))
-    )
-)
-
-/// A 2-argument version of a tree-pattern constructor that takes layout in
-/// addition to the target type.
-/// \note #view is not supposed to be passed as a target type to this version
-///       of the function because we will then have two potentially conflicting
-///       layouts. Any layout different from #default_layout passed here will
-///       result in a compile time error.
-template <typename T, size_t layout, typename P1, typename P2>
-inline auto C(P1&& p1, P2&& p2) noexcept -> XTL_RETURN
-(
-    cons_ex(
-        view<T,layout>(),
-        filter(std::forward<P1>(p1)),
-        filter(std::forward<P2>(p2))
-    )
-)
+/// Meta-function selecting the constructor pattern of the arity of Ps
+template <typename T, size_t layout, typename... Ps> struct constr_of;
+template <typename T, size_t layout>                                                     struct constr_of<T,layout>             { typedef constr0<T,layout>             type; };
+template <typename T, size_t layout, typename P1>                                        struct constr_of<T,layout,P1>          { typedef constr1<T,layout,P1>          type; };
+template <typename T, size_t layout, typename P1, typename P2>                           struct constr_of<T,layout,P1,P2>       { typedef constr2<T,layout,P1,P2>       type; };
+template <typename T, size_t layout, typename P1, typename P2, typename P3>              struct constr_of<T,layout,P1,P2,P3>    { typedef constr3<T,layout,P1,P2,P3>    type; };
+template <typename T, size_t layout, typename P1, typename P2, typename P3, typename P4> struct constr_of<T,layout,P1,P2,P3,P4> { typedef constr4<T,layout,P1,P2,P3,P4> type; };
 
 //------------------------------------------------------------------------------
 
-/// 3-argument version of a helper function to #cons that accepts arguments that
-/// have been already preprocessed with #filter to convert regular variables into
-/// #ref and constants into #value.
+/// A helper function to #cons that accepts arguments that have been already 
+/// preprocessed with #filter to convert regular variables into #ref and 
+/// constants into #value.
 /// \note This version will be called from #cons with a non-#view target type
-template <typename T, size_t layout, typename P1, typename P2, typename P3>
-inline constr3<T,layout,
-            typename underlying<P1>::type,
-            typename underlying<P2>::type,
-            typename underlying<P3>::type
-       > 
-cons_ex(const view<T,layout>&, P1&& p1, P2&& p2, P3&& p3) noexcept
+template <typename T, size_t layout, typename... Ps>
+inline typename constr_of<T,layout,typename underlying<Ps>::type...>::type
+cons_ex(const view<T,layout>&, Ps&&... ps) noexcept
 {
-    return constr3<T,layout,
-            typename underlying<P1>::type,
-            typename underlying<P2>::type,
-            typename underlying<P3>::type
-           >(
-            std::forward<P1>(p1),
-            std::forward<P2>(p2),
-            std::forward<P3>(p3)
-           );
+    return typename constr_of<T,layout,typename underlying<Ps>::type...>::type(std::forward<Ps>(ps)...);
 }
 
-/// 3-argument version of a helper function to #cons that accepts arguments that
-/// have been already preprocessed with #filter to convert regular variables into
-/// #ref and constants into #value.
+/// A helper function to #cons that accepts arguments that have been already 
+/// preprocessed with #filter to convert regular variables into #ref and 
+/// constants into #value.
 /// \note This version will be called from #cons that had its target type a #view
-template <typename T, size_t layout, typename P1, typename P2, typename P3>
-inline constr3<T,layout,
-            typename underlying<P1>::type,
-            typename underlying<P2>::type,
-            typename underlying<P3>::type
-       > 
-cons_ex(const view<view<T,layout>>&, P1&& p1, P2&& p2, P3&& p3) noexcept
+template <typename T, size_t layout, typename... Ps>
+inline typename constr_of<T,layout,typename underlying<Ps>::type...>::type
+cons_ex(const view<view<T,layout>>&, Ps&&... ps) noexcept
 {
-    return constr3<T,layout,
-            typename underlying<P1>::type,
-            typename underlying<P2>::type,
-            typename underlying<P3>::type
-           >(
-            std::forward<P1>(p1),
-            std::forward<P2>(p2),
-            std::forward<P3>(p3)
-           );
+    return typename constr_of<T,layout,typename underlying<Ps>::type...>::type(std::forward<Ps>(ps)...);
 }
 
-/// A 3-argument version of a tree-pattern constructor. Target type is allowed
-/// to be a #view here.
-template <typename T, typename P1, typename P2, typename P3>
-inline auto C(P1&& p1, P2&& p2, P3&& p3) noexcept -> XTL_RETURN
+/// A tree-pattern constructor. Target type is allowed to be a #view here.
+/// \note A single variadic version replaces what used to be a pair of 
+///       overloads of #cons_ex and #C per arity, which is noticeably cheaper 
+///       to compile in sources with many constructor patterns.
+template <typename T, typename... Ps>
+inline auto C(Ps&&... ps) noexcept -> XTL_RETURN
 (
     cons_ex(
         view<T>(),
-        filter(std::forward<P1>(p1)),
-        filter(std::forward<P2>(p2)),
-        filter(std::forward<P3>(p3))
+        filter(std::forward<Ps>(ps))...
     )
 )
 
-/// A 3-argument version of a tree-pattern constructor that takes layout in
-/// addition to the target type.
+/// A tree-pattern constructor that takes layout in addition to the target type.
 /// \note #view is not supposed to be passed as a target type to this version
 ///       of the function because we will then have two potentially conflicting
 ///       layouts. Any layout different from #default_layout passed here will
 ///       result in a compile time error.
-template <typename T, size_t layout, typename P1, typename P2, typename P3>
-inline auto C(P1&& p1, P2&& p2, P3&& p3) noexcept -> XTL_RETURN
-(
-    cons_ex(
-        view<T,layout>(),
-        filter(std::forward<P1>(p1)),
-        filter(std::forward<P2>(p2)),
-        filter(std::forward<P3>(p3))
-    )
-)
-
-//------------------------------------------------------------------------------
-
-/// 4-argument version of a helper function to #cons that accepts arguments that
-/// have been already preprocessed with #filter to convert regular variables into
-/// #ref and constants into #value.
-/// \note This version will be called from #cons with a non-#view target type
-template <typename T, size_t layout, typename P1, typename P2, typename P3, typename P4>
-inline constr4<T,layout,
-            typename underlying<P1>::type,
-            typename underlying<P2>::type,
-            typename underlying<P3>::type,
-            typename underlying<P4>::type
-       > 
-cons_ex(const view<T,layout>&, P1&& p1, P2&& p2, P3&& p3, P4&& p4) noexcept
-{
-    return constr4<T,layout,
-            typename underlying<P1>::type,
-            typename underlying<P2>::type,
-            typename underlying<P3>::type,
-            typename underlying<P4>::type
-           >(
-            std::forward<P1>(p1),
-            std::forward<P2>(p2),
-            std::forward<P3>(p3),
-            std::forward<P4>(p4)
-           );
-}
-
-/// 4-argument version of a helper function to #cons that accepts arguments that
-/// have been already preprocessed with #filter to convert regular variables into
-/// #ref and constants into #value.
-/// \note This version will be called from #cons that had its target type a #view
-template <typename T, size_t layout, typename P1, typename P2, typename P3, typename P4>
-inline constr4<T,layout,
-            typename underlying<P1>::type,
-            typename underlying<P2>::type,
-            typename underlying<P3>::type,
-            typename underlying<P4>::type
-       > 
-cons_ex(const view<view<T,layout>>&, P1&& p1, P2&& p2, P3&& p3, P4&& p4) noexcept
-{
-    return constr4<T,layout,
-            typename underlying<P1>::type,
-            typename underlying<P2>::type,
-            typename underlying<P3>::type,
-            typename underlying<P4>::type
-           >(
-            std::forward<P1>(p1),
-            std::forward<P2>(p2),
-            std::forward<P3>(p3),
-            std::forward<P4>(p4)
-           );
-}
-
-/// A 4-argument version of a tree-pattern constructor. Target type is allowed
-/// to be a #view here.
-template <typename T, typename P1, typename P2, typename P3, typename P4>
-inline auto C(P1&& p1, P2&& p2, P3&& p3, P4&& p4) noexcept -> XTL_RETURN
-(
-    cons_ex(
-        view<T>(),
-        filter(std::forward<P1>(p1)),
-        filter(std::forward<P2>(p2)),
-        filter(std::forward<P3>(p3)),
-        filter(std::forward<P4>(p4))
-    )
-)
-
-/// A 4-argument version of a tree-pattern constructor that takes layout in
-/// addition to the target type.
-/// \note #view is not supposed to be passed as a target type to this version
-///       of the function because we will then have two potentially conflicting
-///       layouts. Any layout different from #default_layout passed here will
-///       result in a compile time error.
-template <typename T, size_t layout, typename P1, typename P2, typename P3, typename P4>
-inline auto C(P1&& p1, P2&& p2, P3&& p3, P4&& p4) noexcept -> XTL_RETURN
+template <typename T, size_t layout, typename... Ps>
+inline auto C(Ps&&... ps) noexcept -> XTL_RETURN
 (
     cons_ex(
         view<T,layout>(),
-        filter(std::forward<P1>(p1)),
-        filter(std::forward<P2>(p2)),
-        filter(std::forward<P3>(p3)),
-        filter(std::forward<P4>(p4))
+        filter(std::forward<Ps>(ps))...
     )
 )
 
@@ -87,6 +87,10 @@ template <typename E1> struct is_pattern_<equivalence<E1>>    { static const boo
 /// #is_expression_ is a helper meta-predicate that separates lazily evaluatable expressions we support
 template <typename E1> struct is_expression_<equivalence<E1>> { static const bool value = true; };
 
+/// Equivalence pattern evaluates an expression and compares the result with the subject
+template <typename E1> struct pattern_cost_<equivalence<E1>>    { static const unsigned int value = 2; };
+template <typename E1> struct is_pure_pattern_<equivalence<E1>> { static const bool value = true; };
+
 //------------------------------------------------------------------------------
 
 template <typename E1>              
@@ -51,27 +51,16 @@ namespace mch ///< Mach7 library namespace
 
 //------------------------------------------------------------------------------
 
-template <typename C>
-struct iterator_increment_suffix
-{
-    iterator_increment_suffix(const iterator_increment_suffix& i) noexcept : m_begin(i.m_begin) {} ///< Copy constructor
-    iterator_increment_suffix& operator=(const iterator_increment_suffix&); ///< Assignment is not allowed for this class
-
-    /// Type function returning a type that will be accepted by the pattern for
-    /// a given subject type S. We use type function instead of an associated 
-    /// type, because there is no a single accepted type for a #wildcard pattern
-    /// for example. Requirement of #Pattern concept.
-    template <typename S> struct accepted_type_for { typedef C type; };
-
-    typename C::const_iterator m_begin;
-    typename C::const_iterator m_end;
-};
-
+/// Iterator pattern binds the range [begin,end) of a container of type C, 
+/// which can later be accessed through #m_begin and #m_end.
+/// \note For contiguous containers consider #sequence pattern from sequence.hpp
+///       instead, which is able to destructure the container in place.
 template <typename C>
 struct iterator
 {
-    iterator(const iterator& i) noexcept : m_begin(i.m_begin) {} ///< Copy constructor
-    iterator& operator=(const iterator&); ///< Assignment is not allowed for this class
+    iterator() noexcept_when(std::is_nothrow_default_constructible<typename C::const_iterator>::value) : m_begin(), m_end() {}
+    iterator(const iterator& i) noexcept_when(std::is_nothrow_copy_constructible<typename C::const_iterator>::value) : m_begin(i.m_begin), m_end(i.m_end) {} ///< Copy constructor
+    iterator& operator=(const iterator&) XTL_DELETED; ///< Assignment is not allowed for this class
 
     /// Type function returning a type that will be accepted by the pattern for
     /// a given subject type S. We use type function instead of an associated 
@@ -86,10 +75,8 @@ struct iterator
         return true;
     }
 
-    R T::operator++(int);
-
-    typename C::const_iterator m_begin;
-    typename C::const_iterator m_end;
+    mutable typename C::const_iterator m_begin;
+    mutable typename C::const_iterator m_end;
 };
 
 //------------------------------------------------------------------------------
@@ -76,6 +76,11 @@ struct predicate
 /// #is_pattern_ is a helper meta-predicate capable of distinguishing all our patterns
 template <typename A> struct is_pattern_<predicate<A>>    { static const bool value = true; };
 
+/// Predicate pattern calls an opaque user function, which we assume to be 
+/// relatively expensive, but free of side effects.
+template <typename A> struct pattern_cost_<predicate<A>>    { static const unsigned int value = 20; };
+template <typename A> struct is_pure_pattern_<predicate<A>> { static const bool value = true; };
+
 //------------------------------------------------------------------------------
 
 template <typename A> inline predicate<A> filter(bool (&f)(A)) noexcept { return predicate<A>(f); }
@@ -44,6 +44,7 @@
 
 #pragma once
 
+#include <cstring>
 #include <type_traits>
 #include "common.hpp"
 
@@ -89,6 +90,10 @@ static wildcard _;
 /// #is_pattern_ is a helper meta-predicate capable of distinguishing all our patterns
 template <> struct is_pattern_<wildcard> { static const bool value = true; };
 
+/// Wildcard pattern does nothing and thus is the cheapest one
+template <> struct pattern_cost_<wildcard>    { static const unsigned int value = 0; };
+template <> struct is_pure_pattern_<wildcard> { static const bool value = true; };
+
 //------------------------------------------------------------------------------
 
 /// This is the specialization that makes the member not to be invoked when we
@@ -129,6 +134,32 @@ struct value
 
 //------------------------------------------------------------------------------
 
+/// Specialization of the value pattern for string literals (and other arrays of
+/// characters), which are compared by content rather than by address. C-string 
+/// subjects are compared with strcmp, other string-like subjects (e.g. std::string) 
+/// with their own operator== against a C-string.
+template <size_t N>
+struct value<char[N]>
+{
+    /// Type function returning a type that will be accepted by the pattern for
+    /// a given subject type S. We use type function instead of an associated 
+    /// type, because there is no a single accepted type for a #wildcard pattern
+    /// for example. Requirement of #Pattern concept.
+    template <typename S> struct accepted_type_for { typedef S type; };
+
+    typedef const char* result_type;   ///< Type of result when used in expression. Requirement of #LazyExpression concept
+    constexpr explicit value(const char (&s)[N]) noexcept : m_value(s) {}
+    constexpr          value(const value&     v) noexcept : m_value(v.m_value) {} ///< Copy constructor
+    bool operator()(const char* s) const noexcept { return s && std::strcmp(s, m_value) == 0; }
+    template <typename S>
+    typename std::enable_if<!std::is_pointer<S>::value, bool>::type
+         operator()(const S& s)    const { return s == m_value; }
+    constexpr operator result_type() const noexcept { return m_value; }// FIX: avoid implicit conversion in lazy expressions
+    const char* m_value;
+};
+
+//------------------------------------------------------------------------------
+
 // Many compilers will live without this specialization to enable syntactic sugar
 #if XTL_SUPPORT(nullptr)
 
@@ -160,6 +191,10 @@ template <typename T> struct is_pattern_<value<T>>    { static const bool value
 /// #is_expression_ is a helper meta-predicate that separates lazily evaluatable expressions we support
 template <typename T> struct is_expression_<value<T>> { static const bool value = true; };
 
+/// Value pattern only performs a comparison
+template <typename T> struct pattern_cost_<value<T>>    { static const unsigned int value = 1; };
+template <typename T> struct is_pure_pattern_<value<T>> { static const bool value = true; };
+
 //------------------------------------------------------------------------------
 
 /// Convenience function for creating value patterns
@@ -394,6 +429,9 @@ template <typename T> struct is_pattern_<var<T>>    { static const bool value =
 /// #is_expression_ is a helper meta-predicate that separates lazily evaluatable expressions we support
 template <typename T> struct is_expression_<var<T>> { static const bool value = true; };
 
+/// Variable pattern only performs an assignment, which is a side effect
+template <typename T> struct pattern_cost_<var<T>> { static const unsigned int value = 1; };
+
 //------------------------------------------------------------------------------
 
 /// #is_var is a helper meta-predicate that is true only when P=var<T>
@@ -505,6 +543,14 @@ template <typename T> struct is_pattern_<ref2<T>>    { static const bool value =
 template <typename T> struct is_expression_<ref0<T>> { static const bool value = true; };
 template <typename T> struct is_expression_<ref2<T>> { static const bool value = true; };
 
+/// References to user variables bind them, while references to patterns 
+/// cost as much as the patterns themselves.
+template <typename T> struct pattern_cost_<ref0<T>>    { static const unsigned int value = 1; };
+template <typename P> struct pattern_cost_<ref1<P>>    : pattern_cost<P>    {};
+template <typename E> struct pattern_cost_<ref2<E>>    : pattern_cost<E>    {};
+template <typename P> struct is_pure_pattern_<ref1<P>> : is_pure_pattern<P> {};
+template <typename E> struct is_pure_pattern_<ref2<E>> : is_pure_pattern<E> {};
+
 //------------------------------------------------------------------------------
 
 /// Convenience function for creating variable patterns out of existing variables
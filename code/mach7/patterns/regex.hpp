@@ -273,6 +273,14 @@ template <typename P1>                           struct is_pattern_<regex1<P1>>
 template <typename P1, typename P2>              struct is_pattern_<regex2<P1,P2>>    { static const bool value = true; };
 template <typename P1, typename P2, typename P3> struct is_pattern_<regex3<P1,P2,P3>> { static const bool value = true; };
 
+/// Regular expression matching is the most expensive of our primitive patterns.
+/// Only regex0 is pure as the rest match their sub-patterns against sub-matches.
+template <>                                      struct pattern_cost_<regex0>           { static const unsigned int value = 100; };
+template <typename P1>                           struct pattern_cost_<regex1<P1>>       { static const unsigned int value = 100; };
+template <typename P1, typename P2>              struct pattern_cost_<regex2<P1,P2>>    { static const unsigned int value = 100; };
+template <typename P1, typename P2, typename P3> struct pattern_cost_<regex3<P1,P2,P3>> { static const unsigned int value = 100; };
+template <>                                      struct is_pure_pattern_<regex0>        { static const bool value = true; };
+
 //------------------------------------------------------------------------------
 
 } // of namespace mch
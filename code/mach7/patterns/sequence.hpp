@@ -44,54 +44,339 @@
 
 #pragma once
 
-#include "common.hpp"
-#include <vector>
+#include "primitive.hpp" // FIX: Ideally this should be common.hpp, but GCC seem to disagree: http://gcc.gnu.org/bugzilla/show_bug.cgi?id=55460
+#include <algorithm>     // for std::equal
+#include <cstddef>
+#include <tuple>
+#include <vector>        // for the diagnostic of the removed seq(const std::vector<T,A>&)
 
 namespace mch ///< Mach7 library namespace
 {
 
 //------------------------------------------------------------------------------
 
-template <typename I>
+/// Non-owning view of a contiguous sequence of elements of type T.
+/// Sequence patterns bind sub-sequences of the subject to var<array_view<T>>,
+/// which lets one destructure a buffer in place without copying or allocating.
+/// \note This class plays the role of C++20 std::span, which we cannot require.
+///       It can be constructed from anything providing contiguous data() and
+///       size(): std::vector, std::array, std::basic_string, std::span etc.
+template <typename T>
+class array_view
+{
+public:
+
+    typedef T           value_type;
+    typedef const T*    iterator;
+    typedef const T*    const_iterator;
+    typedef std::size_t size_type;
+
+    constexpr array_view()                              noexcept : m_data(nullptr), m_size(0) {}
+    constexpr array_view(const T* data, size_type size) noexcept : m_data(data),    m_size(size) {}
+    template <size_type N>
+    constexpr array_view(const T (&arr)[N])             noexcept : m_data(arr),     m_size(N) {}
+
+    /// Conversion from any contiguous container of T
+    template <typename C>
+    array_view(const C& c, typename std::enable_if<std::is_convertible<decltype(std::declval<const C&>().data()),const T*>::value>::type* = 0) noexcept
+        : m_data(c.data()), m_size(c.size()) {}
+
+    constexpr const T*  data()  const noexcept { return m_data; }
+    constexpr size_type size()  const noexcept { return m_size; }
+    constexpr bool      empty() const noexcept { return m_size == 0; }
+    constexpr const T*  begin() const noexcept { return m_data; }
+    constexpr const T*  end()   const noexcept { return m_data + m_size; }
+    constexpr const T&  front() const noexcept { return m_data[0]; }
+    constexpr const T&  back()  const noexcept { return m_data[m_size-1]; }
+    constexpr const T&  operator[](size_type i) const noexcept { return m_data[i]; }
+
+    /// Sub-view of count elements starting at offset. The caller is responsible
+    /// for making sure that [offset,offset+count) is within the view.
+    constexpr array_view subview(size_type offset, size_type count) const noexcept { return array_view(m_data + offset, count); }
+    constexpr array_view subview(size_type offset)                  const noexcept { return array_view(m_data + offset, m_size - offset); }
+    constexpr array_view first(size_type count)                     const noexcept { return array_view(m_data, count); }
+    constexpr array_view last(size_type count)                      const noexcept { return array_view(m_data + m_size - count, count); }
+
+    friend bool operator==(const array_view& a, const array_view& b) { return a.m_size == b.m_size && std::equal(a.begin(), a.end(), b.begin()); }
+    friend bool operator!=(const array_view& a, const array_view& b) { return !(a == b); }
+
+private:
+
+    const T*  m_data; ///< Pointer to the first element of the viewed sequence
+    size_type m_size; ///< Number of elements in the viewed sequence
+};
+
+//------------------------------------------------------------------------------
+
+/// Type function returning the type of elements of a contiguous container C
+template <typename C>           struct element_type_of       { typedef typename std::remove_const<typename std::remove_pointer<decltype(std::declval<const C&>().data())>::type>::type type; };
+template <typename T, size_t N> struct element_type_of<T[N]> { typedef T type; };
+
+/// Makes a view of the entire contiguous container c
+template <typename C>
+inline array_view<typename element_type_of<C>::type> make_view(const C& c) noexcept
+{
+    return array_view<typename element_type_of<C>::type>(c);
+}
+
+//------------------------------------------------------------------------------
+
+/// Rest pattern is a marker used inside #sequence pattern to match the part
+/// of the sequence that is not covered by element patterns with a nested
+/// pattern P1. The nested pattern is applied to an array_view<T> of that part.
+/// At most one rest pattern is allowed within a sequence pattern, e.g.:
+/// - seq(x, y, rest(r)) - [x, y, r...]
+/// - seq(rest(r), y)    - [r..., y]
+/// - seq(x, rest(r), y) - [x, r..., y]
+template <typename P1>
+struct rest_pattern
+{
+    static_assert(is_pattern<P1>::value, "Argument P1 of a rest-pattern must be a pattern");
+    static_assert(!is_var<P1>::value,    "Attempting to host var<> directly. Use filter() to wrap it into ref2<>");
+
+    constexpr explicit rest_pattern(const P1&  p1)          noexcept_when(std::is_nothrow_copy_constructible<P1>::value) : m_p1(          p1 ) {}
+    constexpr explicit rest_pattern(      P1&& p1)          noexcept_when(std::is_nothrow_move_constructible<P1>::value) : m_p1(std::move(p1)) {}
+    constexpr          rest_pattern(const rest_pattern&  r) noexcept_when(std::is_nothrow_copy_constructible<P1>::value) : m_p1(          r.m_p1 ) {} ///< Copy constructor
+    constexpr          rest_pattern(      rest_pattern&& r) noexcept_when(std::is_nothrow_move_constructible<P1>::value) : m_p1(std::move(r.m_p1)) {} ///< Move constructor
+    rest_pattern& operator=(const rest_pattern&) XTL_DELETED; ///< Assignment is not allowed for this class
+
+    /// Type function returning a type that will be accepted by the pattern for
+    /// a given subject type S. We use type function instead of an associated 
+    /// type, because there is no a single accepted type for a #wildcard pattern
+    /// for example. Requirement of #Pattern concept.
+    template <typename S> struct accepted_type_for { typedef S type; };
+
+    template <typename T>
+    bool operator()(const array_view<T>& v) const { return m_p1(v); }
+
+    P1 m_p1; ///< Pattern to be applied to the rest of the sequence
+};
+
+//------------------------------------------------------------------------------
+
+/// #is_pattern_ is a helper meta-predicate capable of distinguishing all our patterns
+template <typename P1> struct is_pattern_<rest_pattern<P1>> { static const bool value = true; };
+
+/// Helper meta-predicate to distinguish #rest_pattern among other patterns
+template <typename P>  struct is_rest_pattern                  { static const bool value = false; };
+template <typename P1> struct is_rest_pattern<rest_pattern<P1>> { static const bool value = true; };
+
+//------------------------------------------------------------------------------
+
+/// Index of the first #rest_pattern in the list of patterns or the length of 
+/// the list when there is none.
+template <typename... P>             struct rest_position;
+template <>                          struct rest_position<>        { static const size_t value = 0; static const size_t count = 0; };
+template <typename P, typename... Q> struct rest_position<P,Q...>
+{
+    static const size_t value = is_rest_pattern<P>::value ? 0 : 1 + rest_position<Q...>::value;
+    static const size_t count = is_rest_pattern<P>::value + rest_position<Q...>::count; ///< Number of rest patterns in the list
+};
+
+//------------------------------------------------------------------------------
+
+/// Helper class that applies I-th element pattern of a #sequence to the 
+/// corresponding element of a view. Patterns before the rest pattern at 
+/// position R are matched from the front of the view, while patterns after it
+/// are matched from the back of it.
+template <size_t I, size_t R, size_t N>
+struct sequence_element
+{
+    template <typename Tuple, typename T>
+    static bool match(const Tuple& ps, const array_view<T>& v)
+    {
+        return std::get<I>(ps)(v[I < R ? I : I + v.size() - N]) 
+            && sequence_element<I+1,R,N>::match(ps,v);
+    }
+};
+
+template <size_t R, size_t N>
+struct sequence_element<R,R,N>
+{
+    template <typename Tuple, typename T>
+    static bool match(const Tuple& ps, const array_view<T>& v)
+    {
+        return std::get<R>(ps)(v.subview(R, v.size() + 1 - N)) 
+            && sequence_element<R+1,R,N>::match(ps,v);
+    }
+};
+
+template <size_t R, size_t N>
+struct sequence_element<N,R,N>
+{
+    template <typename Tuple, typename T>
+    static bool match(const Tuple&, const array_view<T>&) noexcept { return true; }
+};
+
+/// Disambiguates the case of no rest pattern (R == N), where we are done.
+template <size_t N>
+struct sequence_element<N,N,N>
+{
+    template <typename Tuple, typename T>
+    static bool match(const Tuple&, const array_view<T>&) noexcept { return true; }
+};
+
+//------------------------------------------------------------------------------
+
+/// Sequence pattern matches contiguous sequences (std::vector, std::array, 
+/// std::basic_string, built-in arrays, #array_view etc.) element-wise.
+/// Without a #rest_pattern among P... the subject must have exactly 
+/// sizeof...(P) elements. With a #rest_pattern, the subject must have at least
+/// sizeof...(P)-1 elements and the rest pattern gets a view of whatever was
+/// not matched by the element patterns. No elements are ever copied.
+template <typename... P>
 struct sequence
 {
-    constexpr sequence(const I&  b, const I&  e) noexcept_when(std::is_nothrow_copy_constructible<I>::value) : m_begin(          b ), m_end(          e ) {}
-    constexpr sequence(      I&& b,       I&& e) noexcept_when(std::is_nothrow_move_constructible<I>::value) : m_begin(std::move(b)), m_end(std::move(e)) {}
+    static_assert(rest_position<P...>::count <= 1, "At most one rest pattern is allowed within a sequence pattern");
 
-    constexpr sequence(const sequence&  src) noexcept_when(std::is_nothrow_copy_constructible<I>::value) : m_begin(          src.m_begin ), m_end(          src.m_end ) {} ///< Copy constructor
-    constexpr sequence(      sequence&& src) noexcept_when(std::is_nothrow_move_constructible<I>::value) : m_begin(std::move(src.m_begin)), m_end(std::move(src.m_end)) {} ///< Move constructor
+    static const size_t N = sizeof...(P);                  ///< Total number of patterns in the sequence
+    static const size_t R = rest_position<P...>::value;    ///< Position of the rest pattern or N if there is none
+    static const size_t K = N - rest_position<P...>::count; ///< Minimum number of elements in the subject
 
+    constexpr explicit sequence(const std::tuple<P...>&  ps) noexcept_when(std::is_nothrow_copy_constructible<std::tuple<P...>>::value) : m_ps(          ps ) {}
+    constexpr explicit sequence(      std::tuple<P...>&& ps) noexcept_when(std::is_nothrow_move_constructible<std::tuple<P...>>::value) : m_ps(std::move(ps)) {}
+    constexpr          sequence(const sequence&  s)          noexcept_when(std::is_nothrow_copy_constructible<std::tuple<P...>>::value) : m_ps(          s.m_ps ) {} ///< Copy constructor
+    constexpr          sequence(      sequence&& s)          noexcept_when(std::is_nothrow_move_constructible<std::tuple<P...>>::value) : m_ps(std::move(s.m_ps)) {} ///< Move constructor
     sequence& operator=(const sequence&) XTL_DELETED; ///< Assignment is not allowed for this class
 
     /// Type function returning a type that will be accepted by the pattern for
     /// a given subject type S. We use type function instead of an associated 
     /// type, because there is no a single accepted type for a #wildcard pattern
     /// for example. Requirement of #Pattern concept.
-    template <typename S> struct accepted_type_for; // Intentionally no definition
+    template <typename S> struct accepted_type_for { typedef S type; };
+
+    template <typename T>
+    bool operator()(const array_view<T>& v) const
+    {
+        return (R == N ? v.size() == K : v.size() >= K) 
+            && sequence_element<0,R,N>::match(m_ps, v);
+    }
 
     template <typename C>
-    bool operator()(const C& c) const 
+    bool operator()(const C& c) const { return operator()(make_view(c)); }
+
+    std::tuple<P...> m_ps; ///< Patterns to be applied to the elements of the sequence
+};
+
+//------------------------------------------------------------------------------
+
+/// #is_pattern_ is a helper meta-predicate capable of distinguishing all our patterns
+template <typename... P> struct is_pattern_<sequence<P...>> { static const bool value = true; };
+
+//------------------------------------------------------------------------------
+
+/// Slice pattern applies pattern P1 to a view of count elements of the subject
+/// starting at offset. It fails when the subject has less than offset+count
+/// elements.
+template <typename P1>
+struct slice_pattern
+{
+    static_assert(is_pattern<P1>::value, "Argument P1 of a slice-pattern must be a pattern");
+    static_assert(!is_var<P1>::value,    "Attempting to host var<> directly. Use filter() to wrap it into ref2<>");
+
+    constexpr slice_pattern(size_t offset, size_t count, const P1&  p1) noexcept_when(std::is_nothrow_copy_constructible<P1>::value) : m_offset(offset), m_count(count), m_p1(          p1 ) {}
+    constexpr slice_pattern(size_t offset, size_t count,       P1&& p1) noexcept_when(std::is_nothrow_move_constructible<P1>::value) : m_offset(offset), m_count(count), m_p1(std::move(p1)) {}
+    constexpr slice_pattern(const slice_pattern&  s) noexcept_when(std::is_nothrow_copy_constructible<P1>::value) : m_offset(s.m_offset), m_count(s.m_count), m_p1(          s.m_p1 ) {} ///< Copy constructor
+    constexpr slice_pattern(      slice_pattern&& s) noexcept_when(std::is_nothrow_move_constructible<P1>::value) : m_offset(s.m_offset), m_count(s.m_count), m_p1(std::move(s.m_p1)) {} ///< Move constructor
+    slice_pattern& operator=(const slice_pattern&) XTL_DELETED; ///< Assignment is not allowed for this class
+
+    /// Type function returning a type that will be accepted by the pattern for
+    /// a given subject type S. We use type function instead of an associated 
+    /// type, because there is no a single accepted type for a #wildcard pattern
+    /// for example. Requirement of #Pattern concept.
+    template <typename S> struct accepted_type_for { typedef S type; };
+
+    template <typename T>
+    bool operator()(const array_view<T>& v) const
     {
-        m_begin = c.begin();
-        m_end   = c.end();
-        return true; 
+        return m_offset <= v.size() && m_count <= v.size() - m_offset 
+            && m_p1(v.subview(m_offset, m_count));
     }
 
-    I m_begin;
-    I m_end;
+    template <typename C>
+    bool operator()(const C& c) const { return operator()(make_view(c)); }
+
+    const size_t m_offset; ///< Offset of the first element of the slice
+    const size_t m_count;  ///< Number of elements in the slice
+    P1           m_p1;     ///< Pattern to be applied to the slice
 };
 
 //------------------------------------------------------------------------------
 
 /// #is_pattern_ is a helper meta-predicate capable of distinguishing all our patterns
-template <typename I> struct is_pattern_<sequence<I>> { static const bool value = true; };
+template <typename P1> struct is_pattern_<slice_pattern<P1>> { static const bool value = true; };
+
+//------------------------------------------------------------------------------
+
+template <typename P1>
+inline auto rest(P1&& p1) noexcept 
+        -> rest_pattern<
+                typename underlying<decltype(filter(std::forward<P1>(p1)))>::type
+           >
+{
+    return rest_pattern<
+                typename underlying<decltype(filter(std::forward<P1>(p1)))>::type
+           >(
+                filter(std::forward<P1>(p1))
+            );
+}
+
+/// Rest pattern that accepts any remainder of the sequence
+inline rest_pattern<wildcard> rest() noexcept { return rest_pattern<wildcard>(wildcard()); }
+
+//------------------------------------------------------------------------------
+
+/// Meta-predicate telling whether the arguments of #seq are those of its former 
+/// overload seq(const std::vector<T,A>&), which made a pattern out of the 
+/// iterators of a vector. We reject such calls instead of silently treating 
+/// the vector as the pattern of the only element of a sequence.
+template <typename... P>          struct is_removed_seq_call                   : std::false_type {};
+template <typename T, typename A> struct is_removed_seq_call<std::vector<T,A>> : std::true_type  {};
+
+template <typename... P>
+inline auto seq(P&&... ps) noexcept 
+        -> sequence<
+                typename underlying<decltype(filter(std::forward<P>(ps)))>::type...
+           >
+{
+    static_assert(!is_removed_seq_call<typename std::decay<P>::type...>::value, 
+                  "seq(v) no longer matches the elements of vector v: use seq(val(v)) for a one-element sequence equal to [v]");
+    return sequence<
+                typename underlying<decltype(filter(std::forward<P>(ps)))>::type...
+           >(
+                std::tuple<typename underlying<decltype(filter(std::forward<P>(ps)))>::type...>(
+                    filter(std::forward<P>(ps))...
+                )
+            );
+}
+
+/// Matches sequences that start with elements matching ps...: [ps..., _...]
+template <typename... P>
+inline auto prefix(P&&... ps) noexcept -> decltype(seq(std::forward<P>(ps)..., rest()))
+{
+    return seq(std::forward<P>(ps)..., rest());
+}
+
+/// Matches sequences that end with elements matching ps...: [_..., ps...]
+template <typename... P>
+inline auto suffix(P&&... ps) noexcept -> decltype(seq(rest(), std::forward<P>(ps)...))
+{
+    return seq(rest(), std::forward<P>(ps)...);
+}
 
 //------------------------------------------------------------------------------
 
-template <typename T, typename A>
-sequence<typename std::vector<T,A>::const_iterator> seq(const std::vector<T,A>& v)
+template <typename P1>
+inline auto slice(size_t offset, size_t count, P1&& p1) noexcept 
+        -> slice_pattern<
+                typename underlying<decltype(filter(std::forward<P1>(p1)))>::type
+           >
 {
-    return sequence<typename std::vector<T,A>::const_iterator>(v.begin(),v.end());
+    return slice_pattern<
+                typename underlying<decltype(filter(std::forward<P1>(p1)))>::type
+           >(
+                offset, count, filter(std::forward<P1>(p1))
+            );
 }
 
 //------------------------------------------------------------------------------
@@ -106,39 +106,223 @@ inline bool solve(const expr<bool_complement,E1>& e, const S& r)
 
 //------------------------------------------------------------------------------
 
-// Solver for the first argument of addition: a+b == r => a == r-b
-template <typename E1, typename T, typename S>
-inline bool solve(const expr<addition,E1,value<T>>& e, const S& r)
+/// Number of trailing zero bits in a non-zero unsigned value v
+template <typename U>
+constexpr unsigned int trailing_zero_bits(U v) noexcept
+{
+    return v & 1 ? 0 : 1 + trailing_zero_bits(U(v >> 1));
+}
+
+/// A step of Newton's iteration x = x*(2-a*x) for computing an inverse of a 
+/// modulo 2^N. Each step doubles the number of correct low bits in x.
+template <typename U>
+constexpr U modular_inverse_step(U a, U x) noexcept
+{
+    return U(x*(U(2)-U(a*x)));
+}
+
+/// Multiplicative inverse of an odd value a modulo 2^N, where N is the number
+/// of bits in U. We start from x = a that already has 3 correct bits because 
+/// a*a == 1 (mod 8) for any odd a, so 5 steps give us 96 >= 64 correct bits.
+template <typename U>
+constexpr U modular_inverse(U a) noexcept
+{
+    static_assert(sizeof(U)*8 <= 96, "modular_inverse needs more Newton's steps for such a wide type");
+    return modular_inverse_step(a,modular_inverse_step(a,modular_inverse_step(a,modular_inverse_step(a,modular_inverse_step(a,a)))));
+}
+
+//------------------------------------------------------------------------------
+
+/// Meta-predicate telling whether equations over type T can be solved by
+/// #solve_linear. We exclude types narrower than int to avoid dealing with
+/// integral promotions in modular arithmetic.
+template <typename T>
+struct is_linearly_solvable
+{
+    static const bool value = std::is_integral<T>::value 
+                           && !std::is_same<T,bool>::value 
+                           && sizeof(T) >= sizeof(int);
+};
+
+//------------------------------------------------------------------------------
+
+/// Branch-free solver of a linear equation a*x+b == r over integral type T.
+/// Instead of dividing, we multiply r-b by the modular inverse of the odd part
+/// of a after shifting out its power of 2, and then check with a single 
+/// comparison whether the product is within the range of possible quotients.
+/// This is exact: the product is in that range iff a divides r-b, in which case
+/// the product is the quotient. When a and b are known at compile time, as is
+/// the case for patterns like 2*m+1, the compiler folds all the computations
+/// involving them, leaving a subtraction, a shift, a multiplication and a 
+/// couple of comparisons.
+/// The range check guarantees that a*x does not overflow. We also make sure 
+/// a*x+b does not: for unsigned T by accepting x only when b <= r, and for 
+/// signed T by rejecting r of a sign different from that of both a*x == r-b 
+/// and b. Thus x is a root over integers and not just modulo 2^N, e.g. 
+/// 2*x-1 == INT_MAX has no roots instead of a wrapped root -2^30.
+/// \note Variable x gets bound even when the equation has no solution, just
+///       like with other solvers, which bind before they check.
+template <typename E, typename T, typename S>
+inline bool solve_linear(const E& x, const T& a, const T& b, const S& r)
+{
+    static_assert(is_linearly_solvable<T>::value, "solve_linear can only be used on integral types no narrower than int");
+    typedef typename std::make_unsigned<T>::type U;
+    const unsigned int W = sizeof(U)*8;
+
+    XTL_ASSERT(a != T(0));
+
+    const bool         negative = std::is_signed<T>::value && U(a) >> (W-1); // a < 0 without the warnings for unsigned T
+    const U            c = negative ? U(0)-U(a) : U(a);                      // |a|
+    const U            n = U(U(r)-U(b));                                     // r-b
+    const unsigned int k = trailing_zero_bits(c);
+    const U            d = U(c >> k);                                        // Odd part of |a|
+    const U            q = U(U(T(n) >> k) * modular_inverse(d));             // (r-b)/|a| if exact. Arithmetic shift for signed T
+    const bool     exact = (n & U((U(1) << k) - 1)) == 0;                    // 2^k divides r-b
+    const U           k1 = std::is_signed<T>::value ? U(U(1) << (W-1-k)) / d      : U(0);            // Quotient range is [-k1,k2]
+    const U           k2 = std::is_signed<T>::value ? U(U(U(1) << (W-1-k)) - 1) / d : U(~U(0) >> k) / d;
+    const bool   inrange = U(q + k1) <= U(k1 + k2);                          // d divides (r-b)/2^k
+    const bool   nonwrap = std::is_signed<T>::value ? ((n ^ U(r)) & (U(b) ^ U(r))) >> (W-1) == 0 // a*x+b does not overflow, as a*x == r-b when exact and in range
+                                                    : U(b) <= U(r);
+
+    return solve(x, T(negative ? U(0)-q : q)) & exact & inrange & nonwrap;
+}
+
+/// Solver of x+b == r over integral type T: the case of #solve_linear with 
+/// a == 1, which needs neither the inverse nor the range check. Roots that 
+/// would make x+b overflow are rejected the same way.
+template <typename E, typename T, typename S>
+inline bool solve_unit(const E& x, const T& b, const S& r)
+{
+    static_assert(is_linearly_solvable<T>::value, "solve_unit can only be used on integral types no narrower than int");
+    typedef typename std::make_unsigned<T>::type U;
+
+    // NOTE: We subtract only after the check to let the compiler lay out the 
+    //       unsigned case as a compare and branch followed by the subtraction.
+    XTL_STATIC_IF(std::is_signed<T>::value) 
+        return ((U(U(r)-U(b)) ^ U(r)) & (U(b) ^ U(r))) >> (sizeof(U)*8-1) == 0 && solve(x, T(U(r)-U(b)));
+    else
+        return U(b) <= U(r) && solve(x, T(U(r)-U(b)));
+}
+
+//------------------------------------------------------------------------------
+
+/// Decomposition of an expression into a coefficient and a sub-expression: 
+/// a*x, x*a and (trivially) x itself. Used to recognize linear forms a*x+b.
+template <typename E>
+struct linear_term
+{
+    typedef E variable_type;
+    static const bool unit = true; ///< The coefficient is always 1
+    static const E& variable(const E& e) noexcept { return e; }
+    template <typename T> static T coefficient(const E&) noexcept { return T(1); }
+};
+
+template <typename E1, typename T>
+struct linear_term<expr<multiplication,E1,value<T>>>
+{
+    typedef E1 variable_type;
+    static const bool unit = false;
+    static const E1& variable(const expr<multiplication,E1,value<T>>& e) noexcept { return e.m_e1; }
+    template <typename U> static U coefficient(const expr<multiplication,E1,value<T>>& e) noexcept { return U(e.m_e2.m_value); }
+};
+
+template <typename E1, typename T>
+struct linear_term<expr<multiplication,value<T>,E1>>
 {
-    //typedef S source_type;               // The type a subject
-    typedef typename E1::result_type target_type; // The type of a target expression
+    typedef E1 variable_type;
+    static const bool unit = false;
+    static const E1& variable(const expr<multiplication,value<T>,E1>& e) noexcept { return e.m_e2; }
+    template <typename U> static U coefficient(const expr<multiplication,value<T>,E1>& e) noexcept { return U(e.m_e1.m_value); }
+};
+
+//------------------------------------------------------------------------------
+
+///@{
+/// Solver for e+v == r, where v is a known value. Linear forms e = a*x over
+/// integral types are solved for x directly with #solve_linear, or with 
+/// #solve_unit when there is no coefficient.
+template <typename E, typename V, typename S>
+inline bool solve_offset(const E& e, const V& v, const S& r, std::true_type /*linear*/)
+{
+    typedef typename E::result_type target_type; // The type of a target expression
+
+    XTL_STATIC_IF(linear_term<E>::unit) 
+        return solve_unit(linear_term<E>::variable(e), target_type(v), r);
+    else
+        return solve_linear(
+                   linear_term<E>::variable(e), 
+                   linear_term<E>::template coefficient<target_type>(e), 
+                   target_type(v), 
+                   r
+               );
+}
 
+template <typename E, typename V, typename S>
+inline bool solve_offset(const E& e, const V& v, const S& r, std::false_type /*linear*/)
+{
     // NOTE: The following conditions are known at compile time and we rely here
     //       on compiler eliminating dead branches. The reason we do this as 
     //       opposed making enable_if-ed overloads is to avoid the exponensial
     //       explosion of cases we'll have to add to make overloading unambiguous!
-    // FIX:  Move first condition of && into if and make both solve calls in else 
-    // FIX:  Why is condition strict v < r? Shouldn't it be v <= r?
-    XTL_STATIC_IF(std::is_unsigned<target_type>::value) 
-        return e.m_e2.m_value < r && solve(e.m_e1,r-e.m_e2.m_value);
+    XTL_STATIC_IF(std::is_unsigned<typename E::result_type>::value) 
+        return v <= r && solve(e,r-v);
     else
-        return solve(e.m_e1,r-e.m_e2.m_value);
+        return solve(e,r-v);
 }
 
-// Solver for the second argument of addition: a+b == r => b == r-a
-template <typename E1, typename T, typename S>
-inline bool solve(const expr<addition,value<T>,E1>& e, const S& r)
+template <typename E, typename V, typename S>
+inline bool solve_offset(const E& e, const V& v, const S& r)
+{
+    return solve_offset(e, v, r, std::integral_constant<bool, is_linearly_solvable<typename E::result_type>::value>());
+}
+///@}
+
+//------------------------------------------------------------------------------
+
+///@{
+/// Solver for e*v == r, where v is a known value. Integral types are handled
+/// by #solve_linear without any division.
+template <typename E, typename V, typename S>
+inline bool solve_scaled(const E& e, const V& v, const S& r, std::true_type /*linear*/)
+{
+    typedef typename E::result_type target_type; // The type of a target expression
+    return solve_linear(e, target_type(v), target_type(0), r);
+}
+
+template <typename E, typename V, typename S>
+inline bool solve_scaled(const E& e, const V& v, const S& r, std::false_type /*linear*/)
 {
     // NOTE: The following conditions are known at compile time and we rely here
     //       on compiler eliminating dead branches. The reason we do this as 
     //       opposed making enable_if-ed overloads is to avoid the exponensial
     //       explosion of cases we'll have to add to make overloading unambiguous!
-    // FIX:  Move first condition of && into if and make both solve calls in else 
-    // FIX:  Why is condition strict v < r? Shouldn't it be v <= r?
-    XTL_STATIC_IF(std::is_unsigned<typename E1::result_type>::value) 
-        return e.m_e1.m_value < r && solve(e.m_e2,r-e.m_e1.m_value);
+    XTL_STATIC_IF(std::is_integral<typename E::result_type>::value) 
+        return solve(e,r/v) && eval(e)*v == r;
     else
-        return solve(e.m_e2,r-e.m_e1.m_value);
+        return solve(e,r/v);
+}
+
+template <typename E, typename V, typename S>
+inline bool solve_scaled(const E& e, const V& v, const S& r)
+{
+    return solve_scaled(e, v, r, std::integral_constant<bool, is_linearly_solvable<typename E::result_type>::value>());
+}
+///@}
+
+//------------------------------------------------------------------------------
+
+// Solver for the first argument of addition: a+b == r => a == r-b
+template <typename E1, typename T, typename S>
+inline bool solve(const expr<addition,E1,value<T>>& e, const S& r)
+{
+    return solve_offset(e.m_e1,e.m_e2.m_value,r);
+}
+
+// Solver for the second argument of addition: a+b == r => b == r-a
+template <typename E1, typename T, typename S>
+inline bool solve(const expr<addition,value<T>,E1>& e, const S& r)
+{
+    return solve_offset(e.m_e2,e.m_e1.m_value,r);
 }
 
 //------------------------------------------------------------------------------
@@ -147,37 +331,14 @@ inline bool solve(const expr<addition,value<T>,E1>& e, const S& r)
 template <typename E1, typename E2, typename S>
 inline bool solve(const expr<addition,E1,equivalence<E2>>& e, const S& r)
 {
-    //typedef S source_type;               // The type a subject
-    typedef typename E1::result_type target_type; // The type of a target expression
-
-    // NOTE: The following conditions are known at compile time and we rely here
-    //       on compiler eliminating dead branches. The reason we do this as 
-    //       opposed making enable_if-ed overloads is to avoid the exponensial
-    //       explosion of cases we'll have to add to make overloading unambiguous!
-    // FIX:  Move first condition of && into if and make both solve calls in else 
-    // FIX:  Why is condition strict v < r? Shouldn't it be v <= r?
-    auto v = eval(e.m_e2);
-    XTL_STATIC_IF(std::is_unsigned<target_type>::value) 
-        return v < r && solve(e.m_e1,r-v);
-    else
-        return solve(e.m_e1,r-v);
+    return solve_offset(e.m_e1,eval(e.m_e2),r);
 }
 
 // Solver for the second argument of addition: a+b == r => b == r-a
 template <typename E1, typename E2, typename S>
 inline bool solve(const expr<addition,equivalence<E1>,E2>& e, const S& r)
 {
-    // NOTE: The following conditions are known at compile time and we rely here
-    //       on compiler eliminating dead branches. The reason we do this as 
-    //       opposed making enable_if-ed overloads is to avoid the exponensial
-    //       explosion of cases we'll have to add to make overloading unambiguous!
-    // FIX:  Move first condition of && into if and make both solve calls in else 
-    // FIX:  Why is condition strict v < r? Shouldn't it be v <= r?
-    auto v = eval(e.m_e1);
-    XTL_STATIC_IF(std::is_unsigned<typename E2::result_type>::value) 
-        return v < r && solve(e.m_e2,r-v);
-    else
-        return solve(e.m_e2,r-v);
+    return solve_offset(e.m_e2,eval(e.m_e1),r);
 }
 
 //------------------------------------------------------------------------------
@@ -187,7 +348,10 @@ template <typename E1, typename T, typename S>
 inline bool solve(const expr<subtraction,E1,value<T>>& e, const S& r)
 {
     // FIX:  Shouldn't there be a similar is_unsigned check?
-    return solve(e.m_e1,r+e.m_e2.m_value) && eval(e) == r;
+    XTL_STATIC_IF(std::is_signed<typename E1::result_type>::value) 
+        return solve_offset(e.m_e1,-e.m_e2.m_value,r);
+    else
+        return solve(e.m_e1,r+e.m_e2.m_value) && eval(e) == r;
 }
 
 // Solver for the second argument of subtraction: a-b == r => b == a-r
@@ -222,30 +386,14 @@ inline bool solve(const expr<subtraction,equivalence<E1>,E2>& e, const S& r)
 template <typename E1, typename T, typename S>
 inline bool solve(const expr<multiplication,E1,value<T>>& e, const S& r)
 {
-    // NOTE: The following conditions are known at compile time and we rely here
-    //       on compiler eliminating dead branches. The reason we do this as 
-    //       opposed making enable_if-ed overloads is to avoid the exponensial
-    //       explosion of cases we'll have to add to make overloading unambiguous!
-    XTL_STATIC_IF(std::is_integral<typename E1::result_type>::value) 
-        //return r % e.m_e2.m_value == 0 ? solve(e.m_e1,r/e.m_e2.m_value) : false;
-        return solve(e.m_e1,r/e.m_e2.m_value) && eval(e) == r; // NOTE: Somehow this one is faster than the above commented out one
-    else
-        return solve(e.m_e1,r/e.m_e2.m_value);
+    return solve_scaled(e.m_e1,e.m_e2.m_value,r);
 }
 
 // Solver for the second argument of multiplication: a*b == r => b == r/a
 template <typename E1, typename T, typename S>
 inline bool solve(const expr<multiplication,value<T>,E1>& e, const S& r)
 {
-    // NOTE: The following conditions are known at compile time and we rely here
-    //       on compiler eliminating dead branches. The reason we do this as 
-    //       opposed making enable_if-ed overloads is to avoid the exponensial
-    //       explosion of cases we'll have to add to make overloading unambiguous!
-    XTL_STATIC_IF(std::is_integral<typename E1::result_type>::value) 
-        //return r % e.m_e1.m_value == 0 ? solve(e.m_e2,r/e.m_e1.m_value) : false;
-        return solve(e.m_e2,r/e.m_e1.m_value) && eval(e) == r; // NOTE: Somehow this one is faster than the above commented out one
-    else
-        return solve(e.m_e2,r/e.m_e1.m_value);
+    return solve_scaled(e.m_e2,e.m_e1.m_value,r);
 }
 
 //------------------------------------------------------------------------------
@@ -53,6 +53,11 @@
 
 #if defined(_MSC_VER)
     #include <excpt.h>
+    #include <intrin.h>
+#endif
+#if XTL_USE_BMI2
+    #include <atomic>
+    #include <immintrin.h>
 #endif
 #if !defined(_MSC_VER) || _MSC_VER >= 1600 
     #include <cstdint>
@@ -166,10 +171,17 @@ template <>         struct requires_bits<0>  { static const size_t value = 1; };
 //------------------------------------------------------------------------------
 
 /// Finds the number of trailing zeros in v.
+/// \note Like the portable version, returns -127 (cast to uint32_t) for 0.
 /// The following code to count trailing zeros was taken from:
 /// http://graphics.stanford.edu/~seander/bithacks.html#ZerosOnRightFloatCast
 inline uint32_t trailing_zeros(uint32_t v) noexcept
 {
+#if defined(__GNUC__)
+    return v ? uint32_t(__builtin_ctz(v)) : uint32_t(-127);
+#elif defined(_MSC_VER) && _MSC_VER >= 1400
+    unsigned long i;
+    return _BitScanForward(&i, v) ? uint32_t(i) : uint32_t(-127);
+#else
     static_assert(sizeof(v) == sizeof(float), "trailing_zeros function assumes float to be of same size as uint32_t");
 #ifdef _MSC_VER
   #pragma warning( push )
@@ -183,6 +195,7 @@ inline uint32_t trailing_zeros(uint32_t v) noexcept
 #ifdef _MSC_VER
   #pragma warning( pop )
 #endif
+#endif
 }
 
 //------------------------------------------------------------------------------
@@ -192,26 +205,33 @@ inline uint32_t trailing_zeros(uint32_t v) noexcept
 /// http://graphics.stanford.edu/~seander/bithacks.html#CountBitsSetKernighan
 inline unsigned int bits_set(std::intptr_t v) noexcept
 {
+#if defined(__GNUC__)
+    return unsigned(__builtin_popcountll(static_cast<unsigned long long>(v)));
+#else
     unsigned int c = 0; // c accumulates the total bits set in v
 
     for (; v; c++)
         v &= v - 1; // clear the least significant bit set
 
     return c;
+#endif
 }
 
 //------------------------------------------------------------------------------
 
 /// Returns the amount of bits required to represent a given number.
-/// FIX: Optimize this draft function
 inline size_t req_bits(size_t v) noexcept
 {
+#if defined(__GNUC__)
+    return v ? sizeof(unsigned long long)*8 - __builtin_clzll(v) : 1;
+#else
     size_t r = 1;   // r-1 will be lg(v)
 
     while (v >>= 1) // unroll for more speed...
         r++;
 
     return r;
+#endif
 }
 
 //------------------------------------------------------------------------------
@@ -492,19 +512,60 @@ inline uint32_t interleave(
 
 //------------------------------------------------------------------------------
 
-/// Interleaves bits of N numbers (aka Morton numbers).
-/// FIX: Replace condition on j to better handle odd numbers.
-template <typename T, size_t N>
-inline T interleave(const T (&vtbl)[N]) noexcept
+/// Mask of a T with groups of S bits set at positions that are multiples of S*N
+/// starting from bit p, e.g. 0x0F000F000F for S=4, N=3 in 40 bits.
+/// Used by #spread_bits to move bit i of the number into position i*N.
+template <typename T>
+constexpr T stride_mask(size_t S, size_t N, size_t p = 0) noexcept
 {
-    T result = 0;
-    T bit    = 1;
+    return p >= sizeof(T)*8 ? T(0) : T((p % (S*N) < S ? T(1) << p : T(0)) | stride_mask<T>(S, N, p+1));
+}
 
-    for (size_t i = 0, j = 0; i < sizeof(T)*8/N; ++i, bit <<= 1)
-        for (size_t n = 0; n < N; ++n)
-            result |= ((vtbl[n] & bit) >> i) << j++;
+/// Spreads the lowest bits of x apart, so that bit i goes into bit i*N. The 
+/// generalization of the magic number method from the bit twiddling hacks:
+/// at step S the bits of x, whose index has bit S set, move S*(N-1) bits up.
+template <size_t N, size_t S>
+struct spread_bits
+{
+    template <typename T>
+    static inline T apply(T x) noexcept
+    {
+        x = (x | (x << (S*(N-1)))) & std::integral_constant<T,stride_mask<T>(S,N)>::value;
+        return spread_bits<N,S/2>::apply(x);
+    }
+};
 
-    return result;
+template <size_t N> struct spread_bits<N,0> { template <typename T> static inline T apply(T x) noexcept { return x; } };
+
+/// The largest power of 2 not exceeding n
+constexpr size_t floor_pow2(size_t n, size_t p = 1) noexcept { return 2*p > n ? p : floor_pow2(n, 2*p); }
+
+/// Spreads the lowest 32/N bits of vtbl[n],...,vtbl[N-1] and combines them into
+/// a Morton number. Recursion (instead of a loop) makes sure it is unrolled.
+template <size_t N, size_t n = 0>
+struct interleave_from
+{
+    enum { bits = 32/N }; // Number of bits taken from each number
+
+    template <typename T>
+    static inline uint32_t apply(const T (&vtbl)[N]) noexcept
+    {
+        return spread_bits<N,floor_pow2(bits-1)>::apply(uint32_t(vtbl[n]) & (~uint32_t(0) >> (32-bits))) << n
+             | interleave_from<N,n+1>::apply(vtbl);
+    }
+};
+
+template <size_t N> struct interleave_from<N,N> { template <typename T> static inline uint32_t apply(const T (&)[N]) noexcept { return 0; } };
+
+/// Interleaves bits of N numbers (aka Morton numbers): bit i of vtbl[n] goes 
+/// into bit i*N+n of the result for the lowest 32/N bits of each number. Like
+/// the hand-written versions for 2-4 numbers above, it only computes 32 bits, 
+/// which is more than enough for a cache index of #vtbl_map.
+/// \see unit/morton.cpp for tests and timings against the other versions.
+template <typename T, size_t N>
+inline T interleave(const T (&vtbl)[N]) noexcept
+{
+    return T(interleave_from<N>::apply(vtbl));
 }
 
 //------------------------------------------------------------------------------
@@ -533,4 +594,96 @@ inline intptr_t interleave(const intptr_t (&vtbl)[4]) noexcept { return interlea
 
 //------------------------------------------------------------------------------
 
+#if XTL_USE_BMI2
+
+#if XTL_USE_BMI2 == 1
+    /// Lets code use BMI2 instructions without compiling everything for BMI2
+    #define XTL_TARGET_BMI2 __attribute__((target("bmi2")))
+#else
+    #define XTL_TARGET_BMI2
+#endif
+
+/// Deposits the lowest 32/N bits of vtbl[n],...,vtbl[N-1] into every N-th bit
+/// with PDEP, which does the job of all the shifts and masks of #spread_bits
+/// in a single instruction.
+template <size_t N, size_t n = 0>
+struct deposit_from
+{
+    enum { bits = 32/N }; // Number of bits taken from each number, the same as in #interleave_from
+
+    template <typename T>
+    XTL_TARGET_BMI2 static inline uint32_t apply(const T (&vtbl)[N]) noexcept
+    {
+        return _pdep_u32(uint32_t(vtbl[n]), std::integral_constant<uint32_t,(stride_mask<uint32_t>(1,N) & (~uint32_t(0) >> (32-bits*N))) << n>::value)
+             | deposit_from<N,n+1>::apply(vtbl);
+    }
+};
+
+template <size_t N> struct deposit_from<N,N> { template <typename T> XTL_TARGET_BMI2 static inline uint32_t apply(const T (&)[N]) noexcept { return 0; } };
+
+/// BMI2 version of #interleave computing exactly the same 32-bit Morton number
+template <size_t N>
+XTL_TARGET_BMI2 inline intptr_t interleave_bmi2(const intptr_t (&vtbl)[N]) noexcept
+{
+    return intptr_t(deposit_from<N>::apply(vtbl));
+}
+
+#endif
+
+#if XTL_USE_BMI2 == 1
+
+/// Whether the CPU we run on has BMI2 with PDEP that is faster than the portable
+/// code. AMD processors before Zen 3 (family 17h) implement it in microcode 
+/// with a latency of hundreds of cycles.
+inline bool has_fast_pdep() noexcept
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("bmi2") && !__builtin_cpu_is("amdfam17h");
+}
+
+/// Runtime dispatch between #interleave_bmi2 and the portable #interleave. The
+/// pointer is constant-initialized with a resolver, which replaces it on the 
+/// first call, so it can be used from constructors of static objects too.
+template <size_t N>
+struct interleave_dispatch
+{
+    typedef intptr_t (*function)(const intptr_t (&)[N]);
+
+    static intptr_t portable(const intptr_t (&vtbl)[N]) noexcept { return interleave(vtbl); }
+    static XTL_TARGET_BMI2 intptr_t bmi2(const intptr_t (&vtbl)[N]) noexcept { return interleave_bmi2(vtbl); }
+
+    static intptr_t resolve(const intptr_t (&vtbl)[N]) noexcept
+    {
+        function f = has_fast_pdep() ? &bmi2 : &portable;
+        chosen.store(f, std::memory_order_relaxed); // All threads store the same value
+        return f(vtbl);
+    }
+
+    static std::atomic<function> chosen;
+};
+
+template <size_t N>
+std::atomic<typename interleave_dispatch<N>::function> interleave_dispatch<N>::chosen(&interleave_dispatch<N>::resolve);
+
+#endif
+
+/// Interleaves N vtbl-pointers into a cache index of #vtbl_map in the way 
+/// selected by #XTL_USE_BMI2. Lookup tables of the portable version are as 
+/// fast as PDEP for 2 numbers. Runtime dispatch costs a load and an indirect
+/// call, which only pays off against the generic version for 5 and more.
+/// \see unit/morton.cpp for timings
+template <size_t N>
+inline intptr_t interleave_vtbls(const intptr_t (&vtbl)[N]) noexcept
+{
+#if XTL_USE_BMI2 == 2
+    return N < 2 ? interleave(vtbl) : interleave_bmi2(vtbl);
+#elif XTL_USE_BMI2 == 1
+    return N < 5 ? interleave(vtbl) : interleave_dispatch<N>::chosen.load(std::memory_order_relaxed)(vtbl);
+#else
+    return interleave(vtbl);
+#endif
+}
+
+//------------------------------------------------------------------------------
+
 } // of namespace mch
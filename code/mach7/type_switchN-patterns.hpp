@@ -51,22 +51,31 @@
 
 #include "vtblmap4.hpp"
 #include "metatools.hpp"
+#include "patterns/primitive.hpp"
+#include <cstring>
+#include <string>
+#include <typeinfo>
+#include <vector>
 
 namespace mch ///< Mach7 library namespace
 {
 
 //------------------------------------------------------------------------------
 
-/// FIX: This specialization doesn't actually help/work as expected as get<UID>
-///      at the time of this instantiation is not yet set<UID>.
-template <size_t N, typename T, typename UID>
-struct preallocated<vtbl_map<N,T>,UID>
+/// The vtbl_map of a Match statement is presized from its number of clauses, 
+/// which only becomes known at EndMatch, so the map is constructed there by
+/// #preallocated_constructor \see #XTL_SET_TYPES_NUM_ESTIMATE
+template <size_t N, typename T, typename H, typename UID>
+struct preallocated<vtbl_map<N,T,H>,UID>
 {
-    static vtbl_map<N,T> value;
+    XTL_PREALLOCATED_STATIC preallocated_storage<vtbl_map<N,T,H>> value;
+    static void construct(vtbl_count_t clauses) { new(&value.data) vtbl_map<N,T,H>(clauses, typeid(UID).name(), uid_file<UID>(0), uid_line<UID>(0)); }
 };
 
-template <size_t N, typename T, typename UID>
-vtbl_map<N,T> preallocated<vtbl_map<N,T>,UID>::value(deferred_constant<vtbl_count_t>::get<UID>::value);
+#if XTL_PRELOAD_LOCAL_STATIC_VARIABLES != 2
+template <size_t N, typename T, typename H, typename UID>
+preallocated_storage<vtbl_map<N,T,H>> preallocated<vtbl_map<N,T,H>,UID>::value;
+#endif
 
 template <typename S, typename C = void>
 struct dynamic_cast_when_polymorphic_helper
@@ -129,10 +138,195 @@ struct type_switch_info_offset_helper<false, SwitchInfo>
     static inline ptrdiff_t get_offset(SwitchInfo&, size_t) { return 0; }; // Result is unused, so return anything
 };
 
+//------------------------------------------------------------------------------
+
+/// Traits of the subject types that can be dispatched with #string_switch.
+/// \note C-strings are not among them as #Match treats pointer subjects as
+///       the objects they point to.
+template <typename S> struct string_subject { static const bool value = false; };
+
+template <> struct string_subject<std::string>
+{
+    static const bool value = true;
+    static inline const char* data(const std::string& s) noexcept { return s.data(); }
+    static inline size_t      size(const std::string& s) noexcept { return s.size(); }
+};
+
+//------------------------------------------------------------------------------
+
+/// Tells whether the spelling of a pattern is a narrow string literal, possibly
+/// with a u8 or raw prefix. Only literals are learned by #string_switch: other 
+/// arrays of characters may change their content or go out of scope.
+constexpr bool is_string_literal_spelling(const char* s) noexcept
+{
+    return *s == '"' || ((*s == 'u' || *s == '8' || *s == 'R') && is_string_literal_spelling(s+1));
+}
+
+//------------------------------------------------------------------------------
+
+/// Hash table for the leading clauses of a #Match statement on a single std::string
+/// subject that are string literals, e.g. Case("add") ... Case("sub"). The 
+/// literals are learned as the clauses are tried sequentially, each of them 
+/// only once: subjects not found among the literals learned so far resume the
+/// sequential search at the last learned clause. The first clause that is not
+/// a string literal (or the end of the statement) closes the table, after which
+/// subjects not found in it jump straight to that clause.
+/// \note Clauses are still re-tried after the jump, so a jump never changes 
+///       the result, it merely skips the literal clauses that cannot match.
+template <typename S, bool = XTL_USE_STRING_SWITCH && !XTL_MULTI_THREADING && string_subject<S>::value>
+class string_switch
+{
+public:
+
+    /// Fewer literal clauses than this are cheaper to try sequentially
+    static const size_t min_literals = 8;
+
+    string_switch() : m_closed(false), m_last(0), m_fallback(0), m_count(0), m_mask(0) {}
+
+    /// Returns the case label to jump to for a given subject or 0 when the
+    /// clauses have to be tried sequentially.
+    size_t target(const S& s) const noexcept
+    {
+        if (XTL_LIKELY(m_count < min_literals))
+            return 0;
+
+        const char*  p = string_subject<S>::data(s);
+        const size_t n = string_subject<S>::size(s);
+        const size_t h = hash(p, n);
+
+        for (size_t i = h & m_mask; m_slots[i].label; i = (i + 1) & m_mask)
+            if (m_slots[i].hash == h && m_slots[i].size == n && std::memcmp(m_slots[i].data, p, n) == 0)
+                return m_slots[i].label;
+
+        return m_fallback;
+    }
+
+    /// Whether clauses still have to report themselves with #learn
+    bool learns() const noexcept { return !m_closed; }
+
+    /// Clause with the given label, consisting of a single array of characters,
+    /// was tried sequentially. literal tells whether it was a string literal.
+    template <size_t N>
+    void learn(size_t label, bool literal, const value<char[N]>& p)
+    {
+        if (!literal)
+            return close(label);
+
+        if (label <= m_last)
+            return; // Already learned
+
+        m_last = m_fallback = label;
+
+        const size_t n = std::strlen(p.m_value);
+        const size_t h = hash(p.m_value, n);
+
+        if (m_count && find(h, p.m_value, n))
+            return; // An earlier clause with the same literal always wins
+
+        if (2*(m_count+1) > m_slots.size())
+            grow();
+
+        const entry e = { h, n, p.m_value, label };
+        insert(m_slots, m_mask, e);
+        ++m_count;
+    }
+
+    /// Any other clause with the given label was tried sequentially
+    template <typename... P>
+    void learn(size_t label, bool, const P&...) { close(label); }
+
+    /// Stops learning and makes the subjects not found in the table jump to label
+    void close(size_t label) noexcept
+    {
+        m_fallback = label;
+        m_closed   = true;
+    }
+
+private:
+
+    /// FNV-1a hash of n characters pointed to by p
+    static size_t hash(const char* p, size_t n) noexcept
+    {
+        size_t h = size_t(2166136261u);
+
+        for (size_t i = 0; i < n; ++i)
+            h = (h ^ static_cast<unsigned char>(p[i])) * size_t(16777619u);
+
+        return h;
+    }
+
+    struct entry
+    {
+        size_t      hash;  ///< Hash of the literal
+        size_t      size;  ///< Length of the literal
+        const char* data;  ///< The literal itself
+        size_t      label; ///< Label of its clause. 0 marks an empty slot.
+    };
+
+    bool find(size_t h, const char* p, size_t n) const noexcept
+    {
+        for (size_t i = h & m_mask; m_slots[i].label; i = (i + 1) & m_mask)
+            if (m_slots[i].hash == h && m_slots[i].size == n && std::memcmp(m_slots[i].data, p, n) == 0)
+                return true;
+
+        return false;
+    }
+
+    static void insert(std::vector<entry>& slots, size_t mask, const entry& e) noexcept
+    {
+        size_t i = e.hash & mask;
+
+        while (slots[i].label)
+            i = (i + 1) & mask;
+
+        slots[i] = e;
+    }
+
+    /// Doubles the table, keeping the load factor at or below 1/2 so that 
+    /// probe sequences stay short
+    void grow()
+    {
+        const size_t size = m_slots.empty() ? 2*min_literals : 2*m_slots.size();
+        std::vector<entry> slots(size, entry());
+
+        for (size_t i = 0; i < m_slots.size(); ++i)
+            if (m_slots[i].label)
+                insert(slots, size-1, m_slots[i]);
+
+        m_slots.swap(slots);
+        m_mask = size-1;
+    }
+
+    bool               m_closed;   ///< Whether all the leading literal clauses have been learned
+    size_t             m_last;     ///< Label of the last learned clause
+    size_t             m_fallback; ///< Where subjects not in the table jump: #m_last while learning, the first non-literal clause once closed
+    size_t             m_count;    ///< Number of different literals in the table
+    size_t             m_mask;     ///< Size of the hash table minus 1
+    std::vector<entry> m_slots;    ///< Open-addressing hash table of the literals
+};
+
+/// Specialization used when the fast path is not applicable: clauses are tried
+/// sequentially as usual.
+template <typename S>
+class string_switch<S,false>
+{
+public:
+    template <typename T>    constexpr size_t target(const T&)                 const noexcept { return 0; }
+                             constexpr bool   learns()                         const noexcept { return false; }
+    template <typename... P> void             learn(size_t, bool, const P&...)       noexcept {}
+                             void             close(size_t)                          noexcept {}
+};
+
 } // of namespace mch
 
 #define XTL_GET_TYPES_NUM_ESTIMATE   (mch::deferred_constant<mch::vtbl_count_t>::get<match_uid_type>::value)
-#define XTL_SET_TYPES_NUM_ESTIMATE(N) mch::deferred_constant<mch::vtbl_count_t>::set<match_uid_type,(N)>::value_ptr
+#if XTL_PRELOAD_LOCAL_STATIC_VARIABLES
+/// Constructs the preallocated map of the Match statement presized for N clauses
+#define XTL_SET_TYPES_NUM_ESTIMATE(N) (void)&mch::preallocated_constructor<vtbl_map_type,match_uid_type,(N)>::instance
+#else
+/// Lets the function-local map of the Match statement be presized for N clauses on first entry
+#define XTL_SET_TYPES_NUM_ESTIMATE(N) (void)mch::deferred_constant<mch::vtbl_count_t>::set<match_uid_type,(N)>::value_ptr
+#endif
 
 //------------------------------------------------------------------------------
 
@@ -179,7 +373,7 @@ struct type_switch_info_offset_helper<false, SwitchInfo>
 
 /// Helper macro for #Match
 #define MatchN(N, ...) {                                                       \
-        struct match_uid_type {};                                              \
+        struct match_uid_type { XTL_UID_LOCATION };                            \
         enum {                                                                 \
             is_inside_case_clause = 0,                                         \
             number_of_subjects = N,                                            \
@@ -192,7 +386,9 @@ struct type_switch_info_offset_helper<false, SwitchInfo>
         typedef mch::vtbl_map<number_of_polymorphic_subjects,mch::type_switch_info<number_of_polymorphic_subjects>> vtbl_map_type; \
         XTL_PRELOADABLE_LOCAL_STATIC(vtbl_map_type,__vtbl2case_map,match_uid_type,XTL_DUMP_PERFORMANCE_ONLY(__FILE__,__LINE__,XTL_FUNCTION,)XTL_GET_TYPES_NUM_ESTIMATE);\
         mch::type_switch_info<number_of_polymorphic_subjects>& __switch_info = __vtbl2case_map.get(XTL_ENUM(N,XTL_PREFIX,subject_ptr)); \
-        switch (number_of_polymorphic_subjects ? __switch_info.target : 0) {                                        \
+        typedef mch::string_switch<XTL_CPP0X_TYPENAME std::conditional<N == 1, source_type0, void>::type> string_switch_type; \
+        XTL_PRELOADABLE_LOCAL_STATIC(string_switch_type,__string_switch,match_uid_type,XTL_EMPTY()); \
+        switch (number_of_polymorphic_subjects ? __switch_info.target : __string_switch.target(*subject_ptr0)) { \
         default: {{{
 
 #if defined(_MSC_VER)
@@ -215,11 +411,19 @@ struct type_switch_info_offset_helper<false, SwitchInfo>
 //#define XTL_ADJUST_PTR_FROM(i,...) auto& match##i = *mch::adjust_ptr_if_polymorphic<target_type##i>(subject_ptr##i,__switch_info.offset[polymorphic_index##i]);
 #define XTL_ADJUST_PTR_FROM(i,...) auto& match##i = *mch::adjust_ptr_if_polymorphic<target_type##i>(subject_ptr##i,mch::type_switch_info_offset_helper<is_polymorphic##i,decltype(__switch_info)>::get_offset(__switch_info, polymorphic_index##i));
 #define XTL_MATCH_PATTERN_TO_TARGET(i,...) mch::filter(XTL_SELECT_ARG(i,__VA_ARGS__))(match##i)
+#define XTL_FILTER_PATTERN(i,...) mch::filter(XTL_SELECT_ARG(i,__VA_ARGS__))
 
 /// Helper macro for #Case
 /// NOTE: It is possible to have if conditions sequenced instead of &&, but that
 ///       doesn't seem to help compiler figuring out it got same dynamic_cast calls.
 /// FIX: Neither mentioning only type nor omitting variable name works.
+/// NOTE: Clauses with value patterns on integral subjects (e.g. Case(1) ... Case(42))
+///       deliberately remain plain equality tests in the default branch of the
+///       switch: once value<T>::operator() is inlined, optimizing compilers turn
+///       such a chain into a jump table or a binary search just like they do for
+///       a native switch. Mapping subjects to case labels with a table learned
+///       at run time was measured to be several times slower than that.
+///       \see time-pat-switch.cpp
 #define CaseN(N, ...)                                                          \
         }}}                                                                    \
         {                                                                      \
@@ -234,6 +438,8 @@ struct type_switch_info_offset_helper<false, SwitchInfo>
                 __switch_info.target = target_label;                           \
                 XTL_REPEAT(N, XTL_ASSIGN_OFFSET, XTL_EMPTY())                  \
             }                                                                  \
+            if (XTL_UNLIKELY(__string_switch.learns()))                        \
+                __string_switch.learn(target_label, mch::is_string_literal_spelling(#__VA_ARGS__), XTL_ENUM(N, XTL_FILTER_PATTERN, __VA_ARGS__)); \
         case target_label:                                                     \
             XTL_REPEAT(N, XTL_ADJUST_PTR_FROM, __VA_ARGS__)                    \
             if (XTL_REPEAT_WITH(&&, N, XTL_MATCH_PATTERN_TO_TARGET, __VA_ARGS__)) {
@@ -256,19 +462,25 @@ struct type_switch_info_offset_helper<false, SwitchInfo>
             enum { target_label = XTL_COUNTER-__base_counter, is_inside_case_clause = 1 }; \
             if (XTL_LIKELY(__switch_info.target == 0))                         \
                 __switch_info.target = target_label;                           \
+            if (XTL_UNLIKELY(__string_switch.learns()))                        \
+                __string_switch.close(target_label);                           \
         case target_label:
 
 /// General EndMatch statement
 #define EndMatch                                                               \
         }}}                                                                    \
+        {                                                                      \
+        enum { target_label = XTL_COUNTER-__base_counter };                    \
+        if (XTL_UNLIKELY(__string_switch.learns()))                            \
+            __string_switch.close(target_label);                               \
         XTL_STATIC_IF(number_of_polymorphic_subjects)                          \
         if (XTL_UNLIKELY((__switch_info.target == 0)))                         \
         {                                                                      \
-            enum { target_label = XTL_COUNTER-__base_counter };                \
             XTL_SET_TYPES_NUM_ESTIMATE(target_label-1);                        \
             __switch_info.target = target_label;                               \
             case target_label: ;                                               \
         }                                                                      \
+        }                                                                      \
         }}
 
 //------------------------------------------------------------------------------
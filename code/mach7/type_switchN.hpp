@@ -51,27 +51,38 @@
 
 #include "vtblmap4.hpp"
 #include "metatools.hpp"
+#include <typeinfo>
 
 namespace mch ///< Mach7 library namespace
 {
 
 //------------------------------------------------------------------------------
 
-/// FIX: This specialization doesn't actually help/work as expected as get<UID>
-///      at the time of this instantiation is not yet set<UID>.
-template <size_t N, typename T, typename UID>
-struct preallocated<vtbl_map<N,T>,UID>
+/// The vtbl_map of a Match statement is presized from its number of clauses, 
+/// which only becomes known at EndMatch, so the map is constructed there by
+/// #preallocated_constructor \see #XTL_SET_TYPES_NUM_ESTIMATE
+template <size_t N, typename T, typename H, typename UID>
+struct preallocated<vtbl_map<N,T,H>,UID>
 {
-    static vtbl_map<N,T> value;
+    XTL_PREALLOCATED_STATIC preallocated_storage<vtbl_map<N,T,H>> value;
+    static void construct(vtbl_count_t clauses) { new(&value.data) vtbl_map<N,T,H>(clauses, typeid(UID).name(), uid_file<UID>(0), uid_line<UID>(0)); }
 };
 
-template <size_t N, typename T, typename UID>
-vtbl_map<N,T> preallocated<vtbl_map<N,T>,UID>::value(deferred_constant<vtbl_count_t>::get<UID>::value);
+#if XTL_PRELOAD_LOCAL_STATIC_VARIABLES != 2
+template <size_t N, typename T, typename H, typename UID>
+preallocated_storage<vtbl_map<N,T,H>> preallocated<vtbl_map<N,T,H>,UID>::value;
+#endif
 
 } // of namespace mch
 
 #define XTL_GET_TYPES_NUM_ESTIMATE   (mch::deferred_constant<mch::vtbl_count_t>::get<match_uid_type>::value)
-#define XTL_SET_TYPES_NUM_ESTIMATE(N) mch::deferred_constant<mch::vtbl_count_t>::set<match_uid_type,(N)>::value_ptr
+#if XTL_PRELOAD_LOCAL_STATIC_VARIABLES
+/// Constructs the preallocated map of the Match statement presized for N clauses
+#define XTL_SET_TYPES_NUM_ESTIMATE(N) (void)&mch::preallocated_constructor<vtbl_map_type,match_uid_type,(N)>::instance
+#else
+/// Lets the function-local map of the Match statement be presized for N clauses on first entry
+#define XTL_SET_TYPES_NUM_ESTIMATE(N) (void)mch::deferred_constant<mch::vtbl_count_t>::set<match_uid_type,(N)>::value_ptr
+#endif
 
 //------------------------------------------------------------------------------
 
@@ -116,7 +127,7 @@ enum { default_layout = size_t(~0) };
 
 /// Helper macro for #Match
 #define MatchN(N, ...) {                                                       \
-        struct match_uid_type {};                                              \
+        struct match_uid_type { XTL_UID_LOCATION };                            \
         enum { is_inside_case_clause = 0, number_of_subjects = N };            \
         enum { __base_counter = XTL_COUNTER };                                 \
         XTL_REPEAT(N,XTL_MATCH_SUBJECT_POLYMORPHIC_FROM,__VA_ARGS__)           \
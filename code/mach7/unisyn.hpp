@@ -342,8 +342,9 @@ public:
     {
         if (XTL_LIKELY(local_data.switch_info_ptr->target == 0)) 
         {
-            local_data.switch_info_ptr->target = line; 
+            // The offset goes first as other threads may use it once they see the target
             local_data.switch_info_ptr->offset = intptr_t(local_data.casted_ptr)-intptr_t(subject_ptr);
+            local_data.switch_info_ptr->target = line; 
         } 
     }
     
@@ -0,0 +1,228 @@
+//
+//  Mach7: Pattern Matching Library for C++
+//
+//  Copyright 2011-2013, Texas A&M University.
+//  Copyright 2014 Yuriy Solodkyy.
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are met:
+//
+//      * Redistributions of source code must retain the above copyright
+//        notice, this list of conditions and the following disclaimer.
+//
+//      * Redistributions in binary form must reproduce the above copyright
+//        notice, this list of conditions and the following disclaimer in the
+//        documentation and/or other materials provided with the distribution.
+//
+//      * Neither the names of Mach7 project nor the names of its contributors
+//        may be used to endorse or promote products derived from this software
+//        without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+//  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+//  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+//  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY
+//  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+//  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+//  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///
+/// \file
+///
+/// This file defines machine-readable JSON and CSV writers for the statistics 
+/// and layout of vtbl-maps, so that changes in cache behavior across builds can
+/// be diffed and graphed by tools instead of read off the text dump.
+///
+/// \author Yuriy Solodkyy <yuriy.solodkyy@gmail.com>
+///
+/// \see https://parasol.tamu.edu/mach7/
+/// \see https://github.com/solodon4/Mach7
+/// \see https://github.com/solodon4/SELL
+///
+
+#pragma once
+
+#include "vtblstats.hpp" // Run-time statistics of vtbl maps
+#include <cstdlib>
+#include <cstring>
+#include <ostream>
+#include <string>
+#include <typeinfo>
+#include <vector>
+
+#if defined(__GNUC__)
+#include <cxxabi.h>
+#endif
+
+namespace mch ///< Mach7 library namespace
+{
+
+//------------------------------------------------------------------------------
+
+/// Returns human-readable name of a class. Names are demangled on compilers
+/// with Itanium ABI, while Visual C++ already returns readable names. Names 
+/// that are not mangled are returned as is.
+inline std::string demangle(const char* name)
+{
+#if defined(__GNUC__)
+    int   status = 0;
+    char* result = abi::__cxa_demangle(name, 0, 0, &status);
+
+    // Names of local classes returned by typeid lack the _ of the _Z prefix
+    if (!result && name[0] == 'Z')
+        result = abi::__cxa_demangle((std::string("_") + name).c_str(), 0, 0, &status);
+
+    if (result)
+    {
+        std::string str(result);
+        std::free(result);
+        return str;
+    }
+#endif
+    return name;
+}
+
+inline std::string demangle(const std::type_info& ti) { return demangle(ti.name()); }
+
+//------------------------------------------------------------------------------
+
+/// Writes str as a JSON string literal, escaping quotes and control characters
+inline std::ostream& write_json_string(std::ostream& os, const char* str)
+{
+    static const char hex[] = "0123456789abcdef";
+
+    os << '"';
+
+    for (; *str; ++str)
+        switch (*str)
+        {
+        case '"':  os << "\\\""; break;
+        case '\\': os << "\\\\"; break;
+        case '\n': os << "\\n";  break;
+        case '\t': os << "\\t";  break;
+        default:
+            if (static_cast<unsigned char>(*str) < 0x20)
+                os << "\\u00" << hex[(*str >> 4) & 0xF] << hex[*str & 0xF];
+            else
+                os << *str;
+        }
+
+    return os << '"';
+}
+
+/// Writes str as a CSV field, quoting it when it contains separators or quotes
+inline std::ostream& write_csv_string(std::ostream& os, const char* str)
+{
+    if (!str[std::strcspn(str, ",\"\r\n")])
+        return os << str;
+
+    os << '"';
+
+    for (; *str; ++str)
+        os << (*str == '"' ? "\"\"" : std::string(1,*str));
+
+    return os << '"';
+}
+
+//------------------------------------------------------------------------------
+
+/// Writes the members of s as "key":value pairs without the enclosing braces,
+/// so that writers of a map layout can append their own members.
+inline std::ostream& write_json_members(std::ostream& os, const vtbl_map_stats& s)
+{
+    os << "\"file\":";       write_json_string(os, s.file);
+    os << ",\"line\":"       << s.line;
+    os << ",\"func\":";      write_json_string(os, demangle(s.func).c_str());
+    return os
+       << ",\"arity\":"      << s.arity
+       << ",\"vtbls\":"      << s.vtbls
+       << ",\"log_size\":"   << s.log_size
+       << ",\"memory\":"     << s.memory
+       << ",\"updates\":"    << s.updates
+       << ",\"hits\":"       << s.hits
+       << ",\"misses\":"     << s.misses
+       << ",\"collisions\":" << s.collisions;
+}
+
+/// Writes s as a single-line JSON object
+inline std::ostream& write_json(std::ostream& os, const vtbl_map_stats& s)
+{
+    os << '{';
+    return write_json_members(os, s) << '}';
+}
+
+/// Header of the CSV columns written by #write_csv_fields
+inline const char* csv_header() 
+{
+    return "file,line,func,arity,vtbls,log_size,memory,updates,hits,misses,collisions";
+}
+
+/// Writes the fields of s as a comma-separated list without the end of line
+inline std::ostream& write_csv_fields(std::ostream& os, const vtbl_map_stats& s)
+{
+    write_csv_string(os, s.file) << ',' << s.line << ',';
+    write_csv_string(os, demangle(s.func).c_str());
+    return os
+       << ',' << s.arity
+       << ',' << s.vtbls
+       << ',' << s.log_size
+       << ',' << s.memory
+       << ',' << s.updates
+       << ',' << s.hits
+       << ',' << s.misses
+       << ',' << s.collisions;
+}
+
+/// Tells whether this is the first call in the program. Used by vtbl-maps that
+/// all dump CSV into the same std::clog upon destruction to write the header 
+/// only once, regardless of how many different vtbl_map types there are.
+inline bool first_csv_dump() noexcept
+{
+    static bool dumped = false;
+    const  bool first  = !dumped;
+    dumped = true;
+    return first;
+}
+
+//------------------------------------------------------------------------------
+
+/// Writes statistics of all the vtbl-maps alive at the moment as a JSON array
+/// with one map per line.
+inline std::ostream& write_vtbl_maps_json(std::ostream& os)
+{
+    std::vector<vtbl_map_stats> stats = snapshot_vtbl_maps();
+
+    os << '[';
+
+    for (size_t i = 0; i < stats.size(); ++i)
+        write_json(os << (i ? ",\n " : "\n "), stats[i]);
+
+    return os << "\n]" << std::endl;
+}
+
+/// Writes statistics of all the vtbl-maps alive at the moment as CSV with header
+inline std::ostream& write_vtbl_maps_csv(std::ostream& os)
+{
+    std::vector<vtbl_map_stats> stats = snapshot_vtbl_maps();
+
+    os << csv_header() << '\n';
+
+    for (size_t i = 0; i < stats.size(); ++i)
+        write_csv_fields(os, stats[i]) << '\n';
+
+    return os << std::flush;
+}
+
+//------------------------------------------------------------------------------
+
+/// Case label associated with a value stored in a vtbl-map, when there is one.
+/// Overloaded for type_switch_info next to its definition.
+template <typename T>
+inline long long case_target(const T&) noexcept { return -1; }
+
+//------------------------------------------------------------------------------
+
+} // of namespace mch
@@ -0,0 +1,231 @@
+//
+//  Mach7: Pattern Matching Library for C++
+//
+//  Copyright 2011-2013, Texas A&M University.
+//  Copyright 2014 Yuriy Solodkyy.
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are met:
+//
+//      * Redistributions of source code must retain the above copyright
+//        notice, this list of conditions and the following disclaimer.
+//
+//      * Redistributions in binary form must reproduce the above copyright
+//        notice, this list of conditions and the following disclaimer in the
+//        documentation and/or other materials provided with the distribution.
+//
+//      * Neither the names of Mach7 project nor the names of its contributors
+//        may be used to endorse or promote products derived from this software
+//        without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+//  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+//  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+//  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY
+//  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+//  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+//  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///
+/// \file
+///
+/// This file defines hashing policies of vtbl_map that turn a tuple of 
+/// vtbl-pointers into a cache index.
+///
+/// Every policy is given vtbl-pointers already shifted by the optimal shifts 
+/// vtbl_map has computed and returns a value, low bits of which vtbl_map then
+/// uses as the index. Besides the call operator a policy provides:
+/// - variants:  the number of different hash functions it can be switched 
+///              between, as well as a constructor taking the number of one;
+/// - prepare(): called before the first use of a policy by any map;
+/// - name():    the name of the hash function currently in use;
+/// - operator==: whether two objects of the policy compute the same function.
+///
+/// \author Yuriy Solodkyy <yuriy.solodkyy@gmail.com>
+///
+/// \see https://parasol.tamu.edu/mach7/
+/// \see https://github.com/solodon4/Mach7
+/// \see https://github.com/solodon4/SELL
+///
+
+#pragma once
+
+#include "config.hpp"
+#include "ptrtools.hpp"  // Helper functions to work with pointers
+#include <cstddef>
+#include <cstdint>
+
+namespace mch ///< Mach7 library namespace
+{
+
+//------------------------------------------------------------------------------
+
+/// Folds shifted vtbl-pointers of a key into a single 64-bit word keeping all
+/// their bits, unlike #interleave_vtbls that only keeps the low ones. Rotation
+/// makes the result depend on the order of vtbl-pointers.
+template <size_t N>
+inline uint64_t fold_vtbls(const intptr_t (&vtbl)[N]) noexcept
+{
+    uint64_t k = uint64_t(vtbl[0]);
+
+    for (size_t i = 1; i < N; ++i)
+        k = (k << 21 | k >> 43) ^ uint64_t(vtbl[i]);
+
+    return k;
+}
+
+//------------------------------------------------------------------------------
+
+/// Interleaves low bits of shifted vtbl-pointers. This is the original hash 
+/// function of vtbl_map: it is the cheapest one and does not have collisions
+/// as long as the vtbl-pointers differ in bits that the optimal shifts keep,
+/// but high bits of vtbl-pointers are ignored.
+struct shift_mask_hash
+{
+    static const int variants = 1;
+    explicit shift_mask_hash(int = 0) noexcept {}
+    template <size_t N>
+    size_t operator()(const intptr_t (&vtbl)[N]) const noexcept { return size_t(interleave_vtbls(vtbl)); }
+    static void prepare() noexcept {}
+    const char* name() const noexcept { return "shift-mask"; }
+    bool operator==(const shift_mask_hash&) const noexcept { return true; }
+};
+
+//------------------------------------------------------------------------------
+
+/// Multiplicative hashing with the golden ratio constant, which spreads 
+/// vtbl-pointers that are far apart (e.g. coming from different modules or
+/// randomized with ASLR) over the whole cache at the price of a multiplication.
+/// \see Knuth, The Art of Computer Programming, Vol. 3, Section 6.4
+struct fibonacci_hash
+{
+    static const int variants = 1;
+    explicit fibonacci_hash(int = 0) noexcept {}
+
+    template <size_t N>
+    size_t operator()(const intptr_t (&vtbl)[N]) const noexcept
+    {
+        const uint64_t k = fold_vtbls(vtbl);
+        // Bits above 32 of the product depend on all the bits of the folded key
+        return size_t(((k ^ k >> 32) * UINT64_C(0x9E3779B97F4A7C15)) >> 32);
+    }
+
+    static void prepare() noexcept {}
+    const char* name() const noexcept { return "fibonacci"; }
+    bool operator==(const fibonacci_hash&) const noexcept { return true; }
+};
+
+//------------------------------------------------------------------------------
+
+/// Random table of simple tabulation hashing, which is a template only to be 
+/// able to define its data in a header.
+template <typename D = void>
+struct tabulation_table
+{
+    static uint32_t data[4][256];
+
+    /// Fills the table with the output of splitmix64 on the first call
+    static void fill() noexcept
+    {
+        static const bool filled = generate(); // Thread-safe initialization
+        XTL_UNUSED(filled);
+    }
+
+private:
+
+    static bool generate() noexcept
+    {
+        uint64_t x = UINT64_C(0x4D616368375F7674); // Fixed seed for reproducible layouts
+
+        for (size_t i = 0; i < 4; ++i)
+            for (size_t j = 0; j < 256; ++j)
+            {
+                uint64_t z = (x += UINT64_C(0x9E3779B97F4A7C15));
+                z = (z ^ (z >> 30)) * UINT64_C(0xBF58476D1CE4E5B9);
+                z = (z ^ (z >> 27)) * UINT64_C(0x94D049BB133111EB);
+                data[i][j] = uint32_t(z ^ (z >> 31));
+            }
+
+        return true;
+    }
+};
+
+template <typename D> uint32_t tabulation_table<D>::data[4][256];
+
+/// Simple tabulation hashing of the folded key: a xor of random words looked
+/// up by each of its bytes. It is 3-independent and thus does not depend on 
+/// the layout of vtbl-pointers at all, at the price of 4 loads from a 4KB table.
+/// \see Patrascu and Thorup, The Power of Simple Tabulation Hashing, 2011
+struct tabulation_hash
+{
+    static const int variants = 1;
+    explicit tabulation_hash(int = 0) noexcept {}
+
+    template <size_t N>
+    size_t operator()(const intptr_t (&vtbl)[N]) const noexcept
+    {
+        const uint64_t k = fold_vtbls(vtbl);
+        const uint32_t w = uint32_t(k ^ k >> 32);
+        const uint32_t (&t)[4][256] = tabulation_table<>::data;
+        return t[0][w & 0xFF] ^ t[1][w >> 8 & 0xFF] ^ t[2][w >> 16 & 0xFF] ^ t[3][w >> 24];
+    }
+
+    static void prepare() noexcept { tabulation_table<>::fill(); }
+    const char* name() const noexcept { return "tabulation"; }
+    bool operator==(const tabulation_hash&) const noexcept { return true; }
+};
+
+//------------------------------------------------------------------------------
+
+/// Switches between the hash functions above. vtbl_map tries all of them when
+/// it reconfigures and keeps the one that gives the fewest collisions on the 
+/// vtbl-pointers it has seen, so maps on classes from a single module keep the
+/// cheap shift-and-mask, while those on scattered classes move to hashes that 
+/// look at all the bits.
+struct adaptive_hash
+{
+    static const int variants = 3;
+    explicit adaptive_hash(int v = 0) noexcept : kind(v) {}
+
+    template <size_t N>
+    size_t operator()(const intptr_t (&vtbl)[N]) const noexcept
+    {
+        switch (kind)
+        {
+        case 1:  return fibonacci_hash()(vtbl);
+        case 2:  return tabulation_hash()(vtbl);
+        default: return shift_mask_hash()(vtbl);
+        }
+    }
+
+    static void prepare() noexcept { tabulation_hash::prepare(); }
+
+    const char* name() const noexcept
+    {
+        return kind == 1 ? fibonacci_hash().name() : kind == 2 ? tabulation_hash().name() : shift_mask_hash().name();
+    }
+
+    bool operator==(const adaptive_hash& h) const noexcept { return kind == h.kind; }
+
+    int kind; ///< 0 - shift-mask, 1 - Fibonacci, 2 - tabulation
+};
+
+//------------------------------------------------------------------------------
+
+/// Hashing policy vtbl maps use when not given one explicitly \see #XTL_VTBL_HASH
+#if   XTL_VTBL_HASH == 1
+typedef fibonacci_hash  default_vtbl_hash;
+#elif XTL_VTBL_HASH == 2
+typedef tabulation_hash default_vtbl_hash;
+#elif XTL_VTBL_HASH == 3
+typedef adaptive_hash   default_vtbl_hash;
+#else
+typedef shift_mask_hash default_vtbl_hash;
+#endif
+
+//------------------------------------------------------------------------------
+
+} // of namespace mch
@@ -0,0 +1,227 @@
+//
+//  Mach7: Pattern Matching Library for C++
+//
+//  Copyright 2011-2013, Texas A&M University.
+//  Copyright 2014 Yuriy Solodkyy.
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are met:
+//
+//      * Redistributions of source code must retain the above copyright
+//        notice, this list of conditions and the following disclaimer.
+//
+//      * Redistributions in binary form must reproduce the above copyright
+//        notice, this list of conditions and the following disclaimer in the
+//        documentation and/or other materials provided with the distribution.
+//
+//      * Neither the names of Mach7 project nor the names of its contributors
+//        may be used to endorse or promote products derived from this software
+//        without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+//  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+//  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+//  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY
+//  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+//  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+//  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///
+/// \file
+///
+/// This file defines the queue of deferred searches for better layouts of 
+/// vtbl-maps (\see #XTL_DEFERRED_VTBL_UPDATE) along with the means of running
+/// them: explicitly with #maintain_caches or on a background thread owned by
+/// #cache_maintainer.
+///
+/// \author Yuriy Solodkyy <yuriy.solodkyy@gmail.com>
+///
+/// \see https://parasol.tamu.edu/mach7/
+/// \see https://github.com/solodon4/Mach7
+/// \see https://github.com/solodon4/SELL
+///
+
+#pragma once
+
+#include "config.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+
+namespace mch ///< Mach7 library namespace
+{
+
+//------------------------------------------------------------------------------
+
+/// A request of a vtbl-map to search for a better layout of its cache. The 
+/// owner of the map fills it in and queues it with #request, maintenance runs
+/// it, after which the owner takes the result once #ready says so. Only the 
+/// owner makes requests and takes results, so they need no synchronization 
+/// beyond the state of the request. Maintenance runs requests while holding 
+/// the lock of the queue, which the owner only tries to take: a busy queue 
+/// makes the owner retry later rather than wait.
+class vtbl_map_maintenance
+{
+public:
+
+    vtbl_map_maintenance() noexcept : m_state(idle_state), m_next(nullptr) {}
+
+    /// Whether a new request can be made
+    bool idle()  const noexcept { return m_state.load(std::memory_order_relaxed) == idle_state; }
+
+    /// Whether the result of the request is available to the owner
+    bool ready() const noexcept { return m_state.load(std::memory_order_acquire) == ready_state; }
+
+    /// Acknowledges that the owner has taken the result
+    void done() noexcept { m_state.store(idle_state, std::memory_order_relaxed); }
+
+    /// Calls prepare to fill in the request and queues it. Returns false 
+    /// without calling prepare when maintenance is busy with the queue.
+    template <typename F>
+    bool request(F prepare)
+    {
+        std::unique_lock<std::mutex> lock(queue().mutex, std::try_to_lock);
+
+        if (!lock)
+            return false;
+
+        prepare();
+        m_next = queue().head;
+        queue().head = this;
+        m_state.store(queued_state, std::memory_order_relaxed);
+        queue().wakeup.notify_all();
+        return true;
+    }
+
+    /// Withdraws the request, waiting for maintenance if it is being run. 
+    /// Must be called before anything used by #run gets destroyed.
+    void cancel()
+    {
+        std::lock_guard<std::mutex> lock(queue().mutex);
+
+        for (vtbl_map_maintenance** p = &queue().head; *p; p = &(*p)->m_next)
+            if (*p == this)
+            {
+                *p = m_next;
+                break;
+            }
+
+        m_next = nullptr;
+        m_state.store(idle_state, std::memory_order_relaxed);
+    }
+
+    /// Runs all queued requests and returns their number
+    static size_t run_queued()
+    {
+        std::lock_guard<std::mutex> lock(queue().mutex);
+        return run_queued_locked();
+    }
+
+protected:
+
+   ~vtbl_map_maintenance() {}
+
+    /// Searches for the better layout, called by maintenance with the queue locked
+    virtual void run() = 0;
+
+private:
+
+    friend class cache_maintainer;
+
+    enum { idle_state, queued_state, ready_state };
+
+    struct queue_type
+    {
+        queue_type() : head(nullptr) {}
+        std::mutex              mutex;
+        std::condition_variable wakeup; ///< Notified when requests are queued
+        vtbl_map_maintenance*   head;
+    };
+
+    /// The queue is intentionally never destroyed as vtbl-maps living in 
+    /// static storage may withdraw their requests after it would have been.
+    static queue_type& queue()
+    {
+        static queue_type* q = new queue_type();
+        return *q;
+    }
+
+    static size_t run_queued_locked()
+    {
+        size_t n = 0;
+
+        for (; vtbl_map_maintenance* p = queue().head; ++n)
+        {
+            queue().head = p->m_next;
+            p->m_next    = nullptr;
+            p->run();
+            p->m_state.store(ready_state, std::memory_order_release);
+        }
+
+        return n;
+    }
+
+    vtbl_map_maintenance(const vtbl_map_maintenance&);            ///< No copy constructor
+    vtbl_map_maintenance& operator=(const vtbl_map_maintenance&); ///< No assignment operator
+
+    std::atomic<int>      m_state;
+    vtbl_map_maintenance* m_next;
+};
+
+//------------------------------------------------------------------------------
+
+/// Searches for better layouts of all the vtbl-maps that requested one since
+/// the last call and returns their number. The maps adopt the layouts found 
+/// on their next cache miss. Meant to be called when a program can afford the
+/// time, e.g. when idle between requests, or by #cache_maintainer.
+inline size_t maintain_caches() { return vtbl_map_maintenance::run_queued(); }
+
+//------------------------------------------------------------------------------
+
+/// Runs #maintain_caches on a background thread as soon as there are requests
+/// for it, for the lifetime of the object.
+class cache_maintainer
+{
+public:
+
+    cache_maintainer() : m_stop(false), m_thread(&cache_maintainer::loop, this) {}
+
+   ~cache_maintainer()
+    {
+        {
+            std::lock_guard<std::mutex> lock(vtbl_map_maintenance::queue().mutex);
+            m_stop = true;
+        }
+
+        vtbl_map_maintenance::queue().wakeup.notify_all();
+        m_thread.join();
+    }
+
+private:
+
+    void loop()
+    {
+        std::unique_lock<std::mutex> lock(vtbl_map_maintenance::queue().mutex);
+
+        while (!m_stop)
+        {
+            vtbl_map_maintenance::run_queued_locked();
+            vtbl_map_maintenance::queue().wakeup.wait(lock);
+        }
+    }
+
+    cache_maintainer(const cache_maintainer&);            ///< No copy constructor
+    cache_maintainer& operator=(const cache_maintainer&); ///< No assignment operator
+
+    bool        m_stop;   ///< Guarded by the lock of the queue
+    std::thread m_thread;
+};
+
+//------------------------------------------------------------------------------
+
+} // of namespace mch
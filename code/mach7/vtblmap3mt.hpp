@@ -79,9 +79,14 @@
 #include <algorithm>
 #include <atomic>
 #include <cmath>
+#include <cstdint>
 #include <cstring>
 #include "ptrtools.hpp"  // Helper functions to work with pointers
 #include "config.hpp"    // Various compiler/platform dependent macros
+#include "vtblstats.hpp" // Run-time statistics of vtbl maps
+#if XTL_VTBL_INVALIDATION
+#include "vtblmodules.hpp"// Invalidation of vtbls of unloaded modules
+#endif
 
 #if XTL_DUMP_PERFORMANCE
 // For print out purposes only
@@ -105,8 +110,7 @@ typedef unsigned char  bit_offset_t;
 /// vtbl pointers in the program. Roughly N should be equal to some constant c
 /// multiplied by the amount of different classes polymorphic classes in the 
 /// program. Constant c accounts for potential multiple inheritance.
-typedef unsigned short vtbl_count_t;
-//typedef size_t vtbl_count_t;
+typedef std::uint32_t vtbl_count_t;
 
 //------------------------------------------------------------------------------
 
@@ -131,6 +135,8 @@ const double ln2 = 0.69314718055994528622676398299518041312694549560546875;
 /// reallocate the contained data. The reason is that all the applications that
 /// use the vtblmap so far rely on the reference to an element associated with 
 /// given vtbl-pointer to not change throughout the lifetime of application. 
+/// The only exception is #purge, which vacates entries of vtbl-pointers of 
+/// classes that are no longer loaded for reuse by other vtbl-pointers.
 template <typename T>
 class vtblmap
 {
@@ -209,10 +215,10 @@ private:
         #endif
 
         /// We need to declare this placement delete operator since we overload new.
-        void operator delete(void* p, size_t, size_t) { ::delete(static_cast<char*>(p)); }
+        void operator delete(void* p, size_t, size_t) { ::delete[](static_cast<char*>(p)); }
 
         /// We also provide non-placement delete operator since it doesn't really depend on extra arguments.
-        void operator delete(void* p)                 { ::delete(static_cast<char*>(p)); }
+        void operator delete(void* p)                 { ::delete[](static_cast<char*>(p)); }
 
         /// Creates new cache_descriptor based on parameters k and l of the hashing function
         cache_descriptor(
@@ -244,13 +250,12 @@ private:
         ) :
             cache_mask( (1<<log_size) - 1 ),
             optimal_shift(shift),
-            used(old.size()),
+            used(old.used.load()),
             predecessor(&old),
             own_entries_begin(reinterpret_cast<stored_type*>(&cache[0]+(1<<log_size))),
             own_entries_end(own_entries_begin + (cache_mask - old.cache_mask))
         {
             XTL_ASSERT(cache_mask > old.cache_mask);   // Since we are going to inherit all its existing elements
-            XTL_ASSERT(old.used.load() == old.size()); // Since we replace descriptors only when they are full
 
             // Initialize remaining pointers from cache to newly allocated cache entries
             for (size_t j = 0, i = old.size(); i <= cache_mask; ++i, ++j)
@@ -286,6 +291,14 @@ private:
         bool is_full() const { return used > cache_mask; } ///< Checks whether cache is full
         size_t  size() const { return cache_mask+1; }      ///< Number of entries in cache
 
+        /// Amount of memory used by the cache
+        size_t memory_used() const 
+        {
+            return sizeof(cache_descriptor)                                   // Descriptor itself
+                + (cache_mask+1-XTL_VARIABLE_SIZE_ARRAY)*sizeof(cache[0])     // Pointers in cache
+                + (cache_mask+1)*sizeof(stored_type);                         // Actual cached values pointers in cache point to
+        }
+
         const stored_type* operator[](intptr_t vtbl) const { return cache[(vtbl>>optimal_shift) & cache_mask]; }
               stored_type* operator[](intptr_t vtbl)       { return cache[(vtbl>>optimal_shift) & cache_mask]; }
 
@@ -465,18 +478,15 @@ public:
         #undef new
     #endif
     vtblmap(const char* fl, size_t ln, const char* fn, const vtbl_count_t expected_size = min_expected_size) : 
-        descriptor(new(1<<req_bits(expected_size-1),1<<req_bits(expected_size-1)) cache_descriptor(req_bits(expected_size-1))),
+        descriptor(new(size_t(1)<<initial_log_size(expected_size),size_t(1)<<initial_log_size(expected_size)) cache_descriptor(initial_log_size(expected_size))),
         last_table_size(0),
         collisions_before_update(initial_collisions_before_update),
-        file(fl), 
-        line(ln),
-        func(fn),
-        updates(0), 
         clauses(expected_size),
-        hits(0),
-        misses(0),
-        collisions(0)
-    {}
+        statistics(1, fl, ln, fn)
+        XTL_VTBL_INVALIDATION_ONLY(, invalidation(*this))
+    {
+        statistics.layout(0, initial_log_size(expected_size), memory_used(), false);
+    }
     #if defined(DBG_NEW)
         #define new DBG_NEW
     #endif
@@ -485,11 +495,18 @@ public:
     #if defined(DBG_NEW)
         #undef new
     #endif
-    vtblmap(const vtbl_count_t expected_size = min_expected_size) :
-        descriptor(new(1<<req_bits(expected_size-1),1<<req_bits(expected_size-1)) cache_descriptor(req_bits(expected_size-1))),
+    /// \param uid  Name identifying the Match statement in run-time statistics
+    /// \param file File of the Match statement, when known
+    /// \param line Line of the Match statement, when known
+    vtblmap(const vtbl_count_t expected_size = min_expected_size, const char* uid = nullptr, const char* file = nullptr, size_t line = 0) :
+        descriptor(new(size_t(1)<<initial_log_size(expected_size),size_t(1)<<initial_log_size(expected_size)) cache_descriptor(initial_log_size(expected_size))),
         collisions_before_update(initial_collisions_before_update)
-        XTL_DUMP_PERFORMANCE_ONLY(,file("unspecified"), line(0), func("unspecified"), updates(0), clauses(expected_size), hits(0), misses(0), collisions(0))
-    {}
+        XTL_DUMP_PERFORMANCE_ONLY(,clauses(expected_size)),
+        statistics(1, file, line, uid)
+        XTL_VTBL_INVALIDATION_ONLY(, invalidation(*this))
+    {
+        statistics.layout(0, initial_log_size(expected_size), memory_used(), false);
+    }
     #if defined(DBG_NEW)
         #define new DBG_NEW
     #endif
@@ -500,6 +517,12 @@ public:
         delete descriptor.load(); // FIX: in lock free?
     }
 
+    /// Log of the cache size to start with for a given number of expected vtbls
+    static size_t initial_log_size(vtbl_count_t expected_size) noexcept
+    {
+        return req_bits(std::max(expected_size, vtbl_count_t(1))-1);
+    }
+
     /// This is the main function to get the value of type T associated with
     /// the vtbl of a given pointer.
     ///
@@ -522,8 +545,7 @@ public:
 
         if (XTL_UNLIKELY(cur_vtbl != vtbl))
         {
-            XTL_DUMP_PERFORMANCE_ONLY(++misses);
-            XTL_DUMP_PERFORMANCE_ONLY(if (cur_vtbl) ++collisions);
+            statistics.miss(cur_vtbl != 0);
 
             if (dsc->is_full()                            // No entries left for possibly new vtbl in the cache
                 || (cur_vtbl                              // Collision - the entry for vtbl is already occupied
@@ -533,20 +555,61 @@ public:
 
             // Find entry with our vtbl and update cache if needed
             if (stored_type* st = dsc->get(vtbl))
+            {
+                statistics.known(dsc->used); // Including vtbl if it was just added
                 return st->value;
+            }
             else
                 return update(vtbl); // call to get will fail only when the cache is full
         }
         else
         {
-            XTL_DUMP_PERFORMANCE_ONLY(++hits);
+            statistics.hit();
             return st->value;
         }
     }
 
+    /// Amount of memory used by the map
+    size_t memory_used() const 
+    {
+        const cache_descriptor* dsc = descriptor; // Load atomic value for this thread since it may change
+        XTL_ASSERT(dsc);
+        return sizeof(vtblmap) + dsc->memory_used();
+    }
+
     /// A function that gets called when the cache is either too inefficient or full.
     T& update(intptr_t vtbl);
 
+    /// Vacates the entries of vtbl-pointers in [lo,hi) and returns their 
+    /// number \see vtblmodules.hpp. Other threads may keep looking up other
+    /// vtbl-pointers meanwhile.
+    size_t purge(intptr_t lo, intptr_t hi)
+    {
+        cache_descriptor* dsc = descriptor; // Load atomic value for this thread since it may change
+        size_t removed = 0;
+
+        // Entries are owned by the current descriptor and its predecessors
+        for (cache_descriptor* d = dsc; d; d = d->predecessor)
+            for (typename cache_descriptor::stored_type* p = d->own_entries_begin; p != d->own_entries_end; ++p)
+            {
+                intptr_t vtbl = p->vtbl;
+
+                if (lo <= vtbl && vtbl < hi)
+                {
+                    p->value.~T();                                // Reset the value before others may take the entry
+                    new(&p->value) T();
+                    if (p->vtbl.compare_exchange_strong(vtbl, 0)) // essentially: p->vtbl = 0;
+                    {
+                        --dsc->used;
+                        ++removed;
+                    }
+                }
+            }
+
+        statistics.known(dsc->used);
+        return removed;
+    }
+
 #if XTL_DUMP_PERFORMANCE
     std::ostream& operator>>(std::ostream& os) const;
     friend std::ostream& operator<<(std::ostream& os, const vtblmap& m) { return m >> os; }
@@ -564,14 +627,23 @@ private:
     std::atomic<int> collisions_before_update;
 
 #if XTL_DUMP_PERFORMANCE
-    const char* file;      ///< File in which this vtblmap_of is instantiated
-    size_t      line;      ///< Line in the file where it is instantiated
-    const char* func;      ///< Function in which this vtblmap_of is instantiated
-    size_t      updates;   ///< Amount of reconfigurations performed at run time
     size_t      clauses;   ///< Size of the table expected from the number of clauses
-    size_t      hits;      ///< The amount of cache hits
-    size_t      misses;    ///< The amount of cache misses
-    size_t      collisions;///< Out of all the misses, how many were actual collisions
+#endif
+
+    /// Hits, misses, collisions and updates of this map along with its location
+    vtbl_map_statistics statistics;
+
+#if XTL_VTBL_INVALIDATION
+    /// Registration of this map for purging vtbls of unloaded modules
+    struct invalidation_hook : vtbl_map_invalidation
+    {
+        explicit invalidation_hook(vtblmap& m) : map(m) {}
+        size_t purge(intptr_t lo, intptr_t hi) { return map.purge(lo,hi); }
+        vtblmap& map;
+    };
+
+    /// Declared last to be unregistered before the rest of the map is destroyed
+    invalidation_hook invalidation;
 #endif
 
 };
@@ -587,7 +659,6 @@ T& vtblmap<T>::update(intptr_t vtbl)
     *this >> std::clog;       
 #endif
 
-    XTL_DUMP_PERFORMANCE_ONLY(++updates); // Record update
     collisions_before_update = renewed_collisions_before_update;      // Reset collisions counter
 
 ReStart:
@@ -627,7 +698,7 @@ ReStart:
 
             // Iterate over vtbl in old cache and see where they are mapped with log size i and offset j
             for (cache_descriptor* d = dsc; d; d = d->predecessor)
-                for (cache_descriptor::stored_type* p = d->own_entries_begin; p != d->own_entries_end; ++p)
+                for (typename cache_descriptor::stored_type* p = d->own_entries_begin; p != d->own_entries_end; ++p)
                     if (intptr_t vtbl = p->vtbl)
                         XTL_BIT_SET(cache_histogram, (vtbl >> j) & cache_mask); // Mark the entry for each vtbl
 
@@ -688,6 +759,7 @@ ReStart:
     {
         XTL_ASSERT(res && res->vtbl == vtbl); // We have ensured enough space, so no need to check this explicitly
         last_table_size = dsc->used.load();   // Update memoized value
+        statistics.layout(dsc->used, req_bits(dsc->cache_mask), memory_used()); // Record update
 #if XTL_DUMP_PERFORMANCE
         std::clog << "After" << std::endl;
         *this >> std::clog;       
@@ -721,7 +793,9 @@ std::ostream& vtblmap<T>::operator>>(std::ostream& os) const
 {
     std::ios::fmtflags fmt = os.flags(); // store flags
 
-    os << file << '[' << line << ']' << ' ' << func << std::endl;
+    const vtbl_map_stats stats = statistics.snapshot();
+
+    os << stats.file << '[' << stats.line << ']' << ' ' << stats.func << std::endl;
 
     cache_descriptor* dsc = descriptor; // Load atomic value for this thread since it may change
 
@@ -805,14 +879,14 @@ std::ostream& vtblmap<T>::operator>>(std::ostream& os) const
         << " log_size="   << std::setw(2) << log_size     // log2 size required
         << " shift="      << std::setw(2) << dsc->optimal_shift// optimal shift used
         << " width="      << std::setw(2) << str.find_last_of("X")-str.find_first_of("X")+1 // total spread of different bits
-        << " updates="    << std::setw(2) << updates      // how many updates have been performed on the cache
-        << " hits="       << std::setw(8) << hits         // how many hits have we had
-        << " misses="     << std::setw(8) << misses       // how many misses have we had
-        << " collisions=" << std::setw(8) << collisions   // how many misses were actual collisions
+        << " updates="    << std::setw(2) << stats.updates   // how many updates have been performed on the cache
+        << " hits="       << std::setw(8) << stats.hits      // how many hits have we had
+        << " misses="     << std::setw(8) << stats.misses    // how many misses have we had
+        << " collisions=" << std::setw(8) << stats.collisions// how many misses were actual collisions
 //        << " entries: "   << std::setw(5) << entries      // how many entires in the cache are used
 //        << " Entropy: "   << std::setw(9) << std::fixed << std::setprecision(7) << entropy  // Entropy
 //        << " Conflict: "  << std::setw(9) << std::fixed << std::setprecision(7) << conflict // Probability of conflict
-        << " Stmt: "      << file << '[' << line << ']' << ' ' << func
+        << " Stmt: "      << stats.file << '[' << stats.line << ']' << ' ' << stats.func
         << ";\n";
     os.flags(fmt);
 #if 0
@@ -858,7 +932,7 @@ std::ostream& vtblmap<T>::operator>>(std::ostream& os) const
         << " perfect="     << std::setw(3) << (vtbl_count ? d1*100/vtbl_count : 0) << '%'
         //<< " sizeof(ent)=" << std::setw(2) << sizeof(cache_entry)
         << " conflict="    << std::setw(9) << std::fixed << std::setprecision(7) << cache_conflict // Probability of conflict in cache
-        << " Stmt: "       << file << '[' << line << ']' << ' ' << func
+        << " Stmt: "       << stats.file << '[' << stats.line << ']' << ' ' << stats.func
         << "; ";
 
     size_t cache_last_non_zero_count = last_non_zero_count(cache_histogram,cache_size,vtbl_count);
@@ -868,7 +942,7 @@ std::ostream& vtblmap<T>::operator>>(std::ostream& os) const
     {
         size_t d = std::count(cache_histogram,cache_histogram+cache_size,i);
 
-        if (!i) os << std::setw(3) << d*100/cache_size << "% unused " << '[' << line << ']';
+        if (!i) os << std::setw(3) << d*100/cache_size << "% unused " << '[' << stats.line << ']';
         os << std::setw(2) << i << "->" << d << "; ";
     }
 
@@ -908,10 +982,14 @@ std::ostream& vtblmap<T>::operator>>(std::ostream& os) const
 
 /// Data structure used by our Match statements to associate jump target and the 
 /// required offset with the vtbl-pointer.
+/// \note Threads seeing the same class for the first time store these at the 
+///       same time, while others may already be jumping to the target. The 
+///       offset is thus stored before the target, and both are atomic so that
+///       a thread seeing the target is guaranteed to see the offset as well.
 struct type_switch_info
 {
-    std::ptrdiff_t offset; ///< Required this-pointer offset to the source sub-object
-    std::size_t    target; ///< Case label of the jump target of Match statement
+    std::atomic<std::ptrdiff_t> offset; ///< Required this-pointer offset to the source sub-object
+    std::atomic<std::size_t>    target; ///< Case label of the jump target of Match statement
 };
 
 //------------------------------------------------------------------------------
@@ -78,9 +78,15 @@
 
 #include <algorithm>
 #include <cmath>
+#include <cstdint>
 #include <cstring>
+#include <vector>
 #include "ptrtools.hpp"  // Helper functions to work with pointers
 #include "config.hpp"    // Various compiler/platform dependent macros
+#include "vtblstats.hpp" // Run-time statistics of vtbl maps
+#if XTL_VTBL_INVALIDATION
+#include "vtblmodules.hpp"// Invalidation of vtbls of unloaded modules
+#endif
 
 #if XTL_DUMP_PERFORMANCE
 // For print out purposes only
@@ -88,7 +94,6 @@
 #include <iostream>
 #include <iomanip>
 #include <string>
-#include <vector>
 #endif
 
 namespace mch ///< Mach7 library namespace
@@ -104,14 +109,14 @@ typedef unsigned char  bit_offset_t;
 /// vtbl pointers in the program. Roughly N should be equal to some constant c
 /// multiplied by the amount of different classes polymorphic classes in the 
 /// program. Constant c accounts for potential multiple inheritance.
-typedef unsigned short vtbl_count_t;
-//typedef size_t vtbl_count_t;
+typedef std::uint32_t vtbl_count_t;
 
 //------------------------------------------------------------------------------
 
 const bit_offset_t min_log_size      = XTL_MIN_LOG_SIZE; ///< Log of the smallest cache size to start from
 const bit_offset_t max_log_size      = XTL_MAX_LOG_SIZE; ///< Log of the largest cache size to try
 const bit_offset_t max_log_inc       = XTL_MAX_LOG_INC;  ///< Log of the maximum allowed increased from the minimum requred log size (1 means twice from the min required size)
+const bit_offset_t sample_log_size   = XTL_VTBL_SAMPLE_LOG_SIZE; ///< Log of the largest number of vtbls looked at to find a better cache layout
 const vtbl_count_t min_expected_size = 1 << min_log_size;
 const bit_offset_t irrelevant_bits   = XTL_IRRELEVANT_VTBL_BITS;
 const int initial_collisions_before_update = 1;
@@ -126,36 +131,209 @@ const double ln2 = 0.69314718055994528622676398299518041312694549560546875;
 /// This version of the class is for use in the single-threaded environment. 
 /// The data structure is implemented in a lock-free manner.
 ///
-/// The map can only grow in size - it does not provide any means to shrink or 
-/// reallocate the contained data. The reason is that all the applications that
-/// use the vtblmap so far rely on the reference to an element associated with 
-/// given vtbl-pointer to not change throughout the lifetime of application. 
+/// The map has two levels: a table of all the vtbl-pointers it has seen along
+/// with their values, and a direct-mapped cache of pointers into that table 
+/// indexed by a few bits of the vtbl-pointer. Lookups that hit the cache never
+/// touch the table, while those that miss it find their entry in the table in 
+/// expected constant time and take over the cache entry. Rearranging the cache
+/// only looks at a sample of the vtbl-pointers, so neither misses nor updates
+/// get slower as the number of classes grows into hundreds of thousands.
+///
+/// The map does not reallocate the contained data. The reason is that all the
+/// applications that use the vtblmap so far rely on the reference to an element
+/// associated with given vtbl-pointer to not change throughout the lifetime of 
+/// application. The only exception is #purge, which forgets vtbl-pointers of 
+/// classes that are no longer loaded and reuses their entries.
 template <typename T>
 class vtblmap
 {
 private:
 
-    /// A helper data structure that is swapped during updates to 
-    /// cache parameters k and l.
-    struct cache_descriptor
+    /// Type of the stored values, which is a pair of vtbl-pointer and T value.
+    struct stored_type
+    {
+        stored_type(intptr_t v = 0) : vtbl(v), value() XTL_USE_VTBL_FREQUENCY_ONLY(,hits(0)) {}
+
+        intptr_t vtbl;  ///< v-table pointer of the value
+        T        value; ///< value associated with the v-table pointer vtbl
+        XTL_USE_VTBL_FREQUENCY_ONLY(size_t hits;) ///< Sampled number of lookups that found this entry
+    };
+
+    /// All the vtbl-pointers seen by the map along with their values. Entries 
+    /// are allocated in chunks and never move, while an open-addressing index
+    /// with linear probing over them finds the entry of a vtbl-pointer.
+    class entry_table
     {
-        /// Type of the stored values, which is a pair of vtbl-pointer and T value.
-        struct stored_type
+    public:
+
+        entry_table() : index(0), index_mask(size_t(-1)), used(0), allocated(0), chunk(0), chunk_left(0), first(0), diff(0) {}
+
+       ~entry_table()
+        {
+            delete[] index;
+
+            for (size_t i = 0; i < chunks.size(); ++i)
+                delete[] chunks[i];
+        }
+
+        size_t size() const { return used; }
+
+        /// Bits in which the vtbl-pointers in the table differ
+        intptr_t differing_bits() const { return diff; }
+
+        /// Amount of memory used by the table
+        size_t memory_used() const 
+        {
+            return (index_mask+1)*sizeof(stored_type*) + chunks.capacity()*sizeof(stored_type*) + allocated*sizeof(stored_type);
+        }
+
+        /// Finds the entry of vtbl, adding one when there is none yet
+        stored_type* get(intptr_t vtbl)
         {
-            stored_type(intptr_t v = 0) : vtbl(v), value() {}
+            for (size_t i = slot(vtbl); index && index[i]; i = (i+1) & index_mask)
+                if (index[i]->vtbl == vtbl)
+                    return index[i];
 
-            intptr_t vtbl;  ///< v-table pointer of the value
-            T        value; ///< value associated with the v-table pointer vtbl
+            if (2*(used+1) > index_mask+1) // Keep load factor of the index below 1/2
+                grow();
 
-            /// Helper function to in-place construct stored_type inside uninitialized memory
-            void construct()    { new(this) stored_type(); }
-            /// Helper function to manually destroy stored_type
-            void destroy()      { this->~stored_type(); }
-        };
+            stored_type* st;
 
+            if (!purged.empty())
+            {
+                st = purged.back(); // Reuse an entry of a forgotten vtbl
+                purged.pop_back();
+            }
+            else
+            {
+                if (!chunk_left)
+                {
+                    chunk_left = std::max(size_t(1) << min_log_size, used); // Chunks double the number of entries
+                    chunk      = new stored_type[chunk_left];
+                    allocated += chunk_left;
+                    chunks.push_back(chunk);
+                }
+
+                st = chunk++;
+                --chunk_left;
+            }
+
+            st->vtbl = vtbl;
+
+            size_t i = slot(vtbl);
+            while (index[i]) i = (i+1) & index_mask;
+            index[i] = st;
+
+            if (!used++) first = vtbl;
+            diff |= first ^ vtbl;
+            return st;
+        }
+
+        /// Calls f with at most about 2^log_size entries spread evenly over the index
+        template <typename F>
+        void for_sample(size_t log_size, F f) const
+        {
+            const size_t step = index ? std::max(size_t(1), (index_mask+1) >> (log_size+1)) : 1; // index is at least twice larger than the number of entries
+
+            for (size_t i = 0; index && i <= index_mask; i += step)
+                if (index[i])
+                    f(*index[i]);
+        }
+
+        /// Calls f with every entry
+        template <typename F>
+        void for_each(F f) const
+        {
+            for (size_t i = 0; index && i <= index_mask; ++i)
+                if (index[i])
+                    f(*index[i]);
+        }
+
+        /// Forgets the entries of vtbl-pointers in [lo,hi), keeping them for
+        /// reuse, and returns their number.
+        size_t purge(intptr_t lo, intptr_t hi)
+        {
+            const size_t before = purged.size();
+            std::vector<stored_type*> kept;
+            kept.reserve(used);
+
+            for (size_t i = 0; index && i <= index_mask; ++i)
+                if (stored_type* st = index[i])
+                {
+                    index[i] = 0;
+
+                    if (lo <= st->vtbl && st->vtbl < hi)
+                    {
+                        *st = stored_type();
+                        purged.push_back(st);
+                    }
+                    else
+                        kept.push_back(st);
+                }
+
+            // Entries are placed again since removal would break linear probing
+            used = kept.size();
+            diff = 0;
+
+            for (size_t k = 0; k < kept.size(); ++k)
+            {
+                size_t i = slot(kept[k]->vtbl);
+                while (index[i]) i = (i+1) & index_mask;
+                index[i] = kept[k];
+                if (!k) first = kept[k]->vtbl;
+                diff |= first ^ kept[k]->vtbl;
+            }
+
+            return purged.size() - before;
+        }
+
+    private:
+
+        /// Fibonacci hashing of vtbl into a slot of the index
+        size_t slot(intptr_t vtbl) const
+        {
+            return size_t((static_cast<unsigned long long>(vtbl) * 0x9E3779B97F4A7C15ULL) >> 32) & index_mask;
+        }
+
+        void grow()
+        {
+            stored_type** old      = index;
+            const size_t  old_mask = index_mask;
+
+            index_mask = index ? 2*index_mask+1 : (size_t(2) << min_log_size) - 1;
+            index      = new stored_type*[index_mask+1]();
+
+            for (size_t i = 0; old && i <= old_mask; ++i)
+                if (old[i])
+                {
+                    size_t j = slot(old[i]->vtbl);
+                    while (index[j]) j = (j+1) & index_mask;
+                    index[j] = old[i];
+                }
+
+            delete[] old;
+        }
+
+        entry_table(const entry_table&);            ///< No copy constructor
+        entry_table& operator=(const entry_table&); ///< No assignment operator
+
+        stored_type**             index;      ///< Open-addressing index of entries, 0 marks an empty slot
+        size_t                    index_mask; ///< Size of the index minus 1
+        size_t                    used;       ///< Number of entries
+        size_t                    allocated;  ///< Number of entries allocated in chunks
+        stored_type*              chunk;      ///< Next free entry in the last chunk
+        size_t                    chunk_left; ///< Number of free entries in the last chunk
+        std::vector<stored_type*> chunks;     ///< Chunks of entries for deallocation
+        std::vector<stored_type*> purged;     ///< Entries of forgotten vtbls to reuse
+        intptr_t                  first;      ///< The first vtbl-pointer added
+        intptr_t                  diff;       ///< Bits in which vtbl-pointers differ from the first one
+    };
+
+    /// A helper data structure that is swapped during updates to 
+    /// cache parameters k and l.
+    struct cache_descriptor
+    {
         /// Cache mask to access entries. Always cache_size-1 since cache_size is a power of 2
-        /// \note We currently rely in constructors on this member be first in 
-        ///       declaration order so that it is initialized first!
         const size_t cache_mask;
         
         /// Optimal shift computed based on the vtbl pointers already in the map.
@@ -165,10 +343,8 @@ private:
         /// effectively also minimizes probability of not finding something in cache)
         const size_t optimal_shift;
 
-        /// Total number of vtbl-pointers in the cache
-        size_t used;
-
-        /// Variable-sized array with actual pointers to stored_type
+        /// Variable-sized array with pointers to entries of the table, or to
+        /// the vacant entry of the map when no vtbl took the cache entry yet
         stored_type* cache[XTL_VARIABLE_SIZE_ARRAY];
 
         #if defined(DBG_NEW)
@@ -178,7 +354,7 @@ private:
         void* operator new(size_t s, size_t log_size)
         {
             // FIX: Ensure proper alignment requirements
-            return ::new char[s + ((1<<log_size)-XTL_VARIABLE_SIZE_ARRAY)*sizeof(stored_type*)];
+            return ::new char[s + ((size_t(1)<<log_size)-XTL_VARIABLE_SIZE_ARRAY)*sizeof(stored_type*)];
         }
 
         #if defined(DBG_NEW)
@@ -186,138 +362,62 @@ private:
         #endif
 
         /// We need to declare this placement delete operator since we overload new.
-        void operator delete(void* p, size_t) { ::delete(static_cast<char*>(p)); } // We cast to char* to avoid warning on deleting void*, which is undefined
+        void operator delete(void* p, size_t) { ::delete[](static_cast<char*>(p)); } // We cast to char* to avoid warning on deleting void*, which is undefined
 
         /// We also provide non-placement delete operator since it doesn't really depend on extra arguments.
-        void operator delete(void* p)         { ::delete(static_cast<char*>(p)); } // We cast to char* to avoid warning on deleting void*, which is undefined
+        void operator delete(void* p)         { ::delete[](static_cast<char*>(p)); } // We cast to char* to avoid warning on deleting void*, which is undefined
 
         /// Creates new cache_descriptor based on parameters k and l of the hashing function
         cache_descriptor(
             const size_t log_size,               ///< Parameter k of the cache - the log of the size of the cache
-            const size_t shift = irrelevant_bits ///< Parameter l of the cache - number of irrelevant bits on the right to remove
+            const size_t shift,                  ///< Parameter l of the cache - number of irrelevant bits on the right to remove
+            stored_type* vacant                  ///< Entry with 0 vtbl-pointer in place of missing ones
         ) :
-            cache_mask( (1<<log_size) - 1 ),
-            optimal_shift(shift),
-            used(0)
+            cache_mask( (size_t(1)<<log_size) - 1 ),
+            optimal_shift(shift)
         {
-            // Allocate all cache entries in one chunk for better cache performance.
-            // Only allocate the difference from need and already present in old ones
-            stored_type* cache_entries = new stored_type[1<<log_size];
-
-            // Initialize pointers from cache to newly allocated cache entries
-            for (size_t i = 0; i <= cache_mask; ++i)
-                cache[i] = &cache_entries[i];
+            std::fill(&cache[0], &cache[cache_mask+1], vacant);
         }
 
         /// Creates new cache_descriptor based on parameters k and l of the 
         /// hashing function as well as a reference to the cache_descriptor it
-        /// is going to replace.
+        /// is going to replace. Entries cached by the old one keep being cached
+        /// unless they now collide, in which case the table still has them.
         cache_descriptor(
-            const size_t       log_size, ///< Parameter k of the cache - the log of the size of the cache                
-            const size_t       shift,    ///< Parameter l of the cache - number of irrelevant bits on the right to remove
-            cache_descriptor&& old       ///< cache_descriptor we will supposedly replace
+            const size_t            log_size, ///< Parameter k of the cache - the log of the size of the cache                
+            const size_t            shift,    ///< Parameter l of the cache - number of irrelevant bits on the right to remove
+            const cache_descriptor& old,      ///< cache_descriptor we will supposedly replace
+            stored_type*            vacant    ///< Entry with 0 vtbl-pointer in place of missing ones
         ) :
-            cache_mask( (1<<log_size) - 1 ),
-            optimal_shift(shift),
-            used(old.used)
+            cache_mask( (size_t(1)<<log_size) - 1 ),
+            optimal_shift(shift)
         {
-            XTL_ASSERT(cache_mask >= old.cache_mask); // Since we are going to inherit all its existing elements
-
-            size_t i = 0;
-
-            // Initialize first cache pointers to cache entries from old cache
-            for (; i <= old.cache_mask; ++i)
-            {
-                cache[i] = 0;
-                std::swap(cache[i],old.cache[i]);
-            }
-
-            if (cache_mask - old.cache_mask)
-            {
-                // Allocate all cache entries in one chunk for better cache performance.
-                // Only allocate the difference from need and already present in old ones
-                stored_type* cache_entries = new stored_type[cache_mask - old.cache_mask];
-
-                // Initialize remaining pointers from cache to newly allocated cache entries
-                for (size_t j = 0; i <= cache_mask; ++i, ++j)
-                    cache[i] = &cache_entries[j];
-            }
-        }
+            std::fill(&cache[0], &cache[cache_mask+1], vacant);
 
-        /// Deallocates memory used for elements.
-        ~cache_descriptor()
-        {
-            // The elements will be pointing into separate arrays, we want to
-            // find all the beginnings of arrays to deallocate them
-            std::sort(&cache[0], &cache[cache_mask+1]);
-
-            for (size_t i = 0; i <= cache_mask;)
-            {
-                if (cache[i])
+            for (size_t i = 0; i <= old.cache_mask; ++i)
+                if (old.cache[i]->vtbl)
                 {
-                    size_t j = i+1;
-                    for (; j <= cache_mask && intptr_t(cache[j])-intptr_t(cache[j-1]) == sizeof(stored_type); ++j);
-                    delete[] cache[i];
-                    i = j;
+                    stored_type*& ce = (*this)[old.cache[i]->vtbl];
+                #if XTL_USE_VTBL_FREQUENCY
+                    if (ce->vtbl && ce->hits >= old.cache[i]->hits) continue; // Keep the hotter one
+                #endif
+                    ce = old.cache[i];
                 }
-                else
-                    ++i;
-            }
         }
 
         cache_descriptor& operator=(const cache_descriptor&); ///< No assignment
 
-        bool is_full() const { return used > cache_mask; } ///< Checks whether cache is full
         size_t  size() const { return cache_mask+1; }      ///< Number of entries in cache
 
-        const stored_type*& operator[](intptr_t vtbl) const { return cache[(vtbl>>optimal_shift) & cache_mask]; }
-              stored_type*& operator[](intptr_t vtbl)       { return cache[(vtbl>>optimal_shift) & cache_mask]; }
-
-        /// Main function that will be used to get a reference to the stored element. 
-        inline stored_type*& get(const intptr_t vtbl) noexcept
+        /// Amount of memory used by the cache
+        size_t memory_used() const 
         {
-            XTL_ASSERT(vtbl); // Must be a valid vtbl pointer
-
-            stored_type*& ce = cache[(vtbl>>optimal_shift) & cache_mask]; // Location where it should be
-
-            XTL_ASSERT(ce);   // Since we pre-allocate all entries
-
-            if (XTL_UNLIKELY(ce->vtbl != vtbl))
-            {
-                // NOTE: We don't check if the entry is occupied as even when 
-                //       it is not, the vtbl may be elsewhere in the cache due 
-                //       to changes to k and l after update.
-                stored_type** cv;
-
-                // See if vtbl is elsewhere in the cache
-                for (size_t i = 0; i <= cache_mask; ++i)
-                    if (cache[i]->vtbl == vtbl) // if so ...
-                    {
-                        cv = &cache[i]; // swap it with the right position
-                        goto Swap;
-                    }
-
-                // vtbl is not in the cache
-                if (used <= cache_mask) // there are empty slots in cache
-                    for (size_t i = 0; i <= cache_mask; ++i)
-                        if (cache[i]->vtbl == 0) // find the first empty slot
-                        {
-                            cache[i]->vtbl = vtbl; // assign vtbl to it
-                            ++used;
-                            cv = &cache[i]; // swap it with the right position
-                            goto Swap;
-                        }
-
-                // There are no empty slots, we return the slot in which it
-                // is supposed to be, the caller should check vtbl of the 
-                // returned entry to ensure it has vtbl he was looking for.
-                return ce;
-Swap:
-                std::swap(ce,*cv);
-            }
-
-            return ce;
+            return sizeof(cache_descriptor)                                   // Descriptor itself
+                + (cache_mask+1-XTL_VARIABLE_SIZE_ARRAY)*sizeof(stored_type*);// Pointers in cache
         }
+
+        const stored_type*& operator[](intptr_t vtbl) const { return cache[(vtbl>>optimal_shift) & cache_mask]; }
+              stored_type*& operator[](intptr_t vtbl)       { return cache[(vtbl>>optimal_shift) & cache_mask]; }
     };
 
 public:
@@ -327,18 +427,15 @@ public:
         #undef new
     #endif
     vtblmap(const char* fl, size_t ln, const char* fn, const vtbl_count_t expected_size = min_expected_size) : 
-        descriptor(new(req_bits(expected_size-1)) cache_descriptor(req_bits(expected_size-1))),
+        descriptor(new(initial_log_size(expected_size)) cache_descriptor(initial_log_size(expected_size),irrelevant_bits,&vacant)),
         last_table_size(0),
         collisions_before_update(initial_collisions_before_update),
-        file(fl), 
-        line(ln),
-        func(fn),
-        updates(0), 
         clauses(expected_size),
-        hits(0),
-        misses(0),
-        collisions(0)
-    {}
+        statistics(1, fl, ln, fn)
+        XTL_VTBL_INVALIDATION_ONLY(, invalidation(*this))
+    {
+        statistics.layout(0, initial_log_size(expected_size), memory_used(), false);
+    }
     #if defined(DBG_NEW)
         #define new DBG_NEW
     #endif
@@ -347,11 +444,19 @@ public:
     #if defined(DBG_NEW)
         #undef new
     #endif
-    vtblmap(const vtbl_count_t expected_size = min_expected_size) :
-        descriptor(new(req_bits(expected_size-1)) cache_descriptor(req_bits(expected_size-1))),
+    /// \param uid  Name identifying the Match statement in run-time statistics
+    /// \param file File of the Match statement, when known
+    /// \param line Line of the Match statement, when known
+    vtblmap(const vtbl_count_t expected_size = min_expected_size, const char* uid = nullptr, const char* file = nullptr, size_t line = 0) :
+        descriptor(new(initial_log_size(expected_size)) cache_descriptor(initial_log_size(expected_size),irrelevant_bits,&vacant)),
+        last_table_size(0),
         collisions_before_update(initial_collisions_before_update)
-        XTL_DUMP_PERFORMANCE_ONLY(,file("unspecified"), line(0), func("unspecified"), updates(0), clauses(expected_size), hits(0), misses(0), collisions(0))
-    {}
+        XTL_DUMP_PERFORMANCE_ONLY(,clauses(expected_size)),
+        statistics(1, file, line, uid)
+        XTL_VTBL_INVALIDATION_ONLY(, invalidation(*this))
+    {
+        statistics.layout(0, initial_log_size(expected_size), memory_used(), false);
+    }
     #if defined(DBG_NEW)
         #define new DBG_NEW
     #endif
@@ -362,6 +467,12 @@ public:
         delete descriptor;
     }
 
+    /// Log of the cache size to start with for a given number of expected vtbls
+    static size_t initial_log_size(vtbl_count_t expected_size) noexcept
+    {
+        return std::min(size_t(max_log_size), req_bits(std::max(expected_size, vtbl_count_t(1))-1));
+    }
+
     /// This is the main function to get the value of type T associated with
     /// the vtbl of a given pointer.
     ///
@@ -372,34 +483,64 @@ public:
         XTL_ASSERT(descriptor); // Allocated in constructor, deallocated in destructor
 
         const intptr_t vtbl = *reinterpret_cast<const intptr_t*>(p);
-        typename cache_descriptor::stored_type*& ce = (*descriptor)[vtbl];
+        stored_type*& ce = (*descriptor)[vtbl];
 
         XTL_ASSERT(vtbl); // Since this represents VTBL pointer it cannot be null
         XTL_ASSERT(ce);   // Since we use stub entry with vtbl==0 to indicate an empty one
 
         if (XTL_UNLIKELY(ce->vtbl != vtbl))
         {
-            XTL_DUMP_PERFORMANCE_ONLY(++misses);
-            XTL_DUMP_PERFORMANCE_ONLY(if (ce->vtbl) ++collisions);
+            statistics.miss(ce->vtbl != 0);
 
-            if (descriptor->is_full()                     // No entries left for possibly new vtbl in the cache
-                || (ce->vtbl                              // Collision - the entry for vtbl is already occupied
+            if (ce->vtbl                                  // Collision - the entry for vtbl is already occupied
                 && --collisions_before_update <= 0        // We had sufficiently many collisions to justify call
-                && descriptor->used != last_table_size))  // There was at least one vtbl added since last update
+                && table.size() != last_table_size)       // There was at least one vtbl added since last update
                 return update(vtbl); // try to rearrange cache
 
-            // Try to find entry with our vtbl and swap it with where it is expected to be
-            descriptor->get(vtbl); // This will bring correct pointer into ce
-            XTL_ASSERT(ce->vtbl == vtbl);
+            // Find or add the entry of vtbl in the table and cache it
+            stored_type* st = table.get(vtbl);
+        #if XTL_USE_VTBL_FREQUENCY
+            // A hotter vtbl stays in the cache, so that two colliding vtbls 
+            // do not keep replacing each other
+            if (!ce->vtbl || ce->hits <= st->hits)
+        #endif
+            ce = st;
+            statistics.known(table.size()); // Including vtbl if it was just added
+            XTL_USE_VTBL_FREQUENCY_ONLY(if (XTL_UNLIKELY(sampler())) ++st->hits;)
+            return st->value;
         }
-        XTL_DUMP_PERFORMANCE_ONLY(else ++hits);
 
+        statistics.hit();
+        XTL_USE_VTBL_FREQUENCY_ONLY(if (XTL_UNLIKELY(sampler())) ++ce->hits;)
         return ce->value;
     }
 
-    /// A function that gets called when the cache is either too inefficient or full.
+    /// Amount of memory used by the map
+    size_t memory_used() const 
+    {
+        XTL_ASSERT(descriptor);
+        return sizeof(vtblmap) + descriptor->memory_used() + table.memory_used();
+    }
+
+    /// A function that gets called when the cache is too inefficient.
     T& update(intptr_t vtbl);
 
+    /// Removes the entries of vtbl-pointers in [lo,hi) and returns their 
+    /// number \see vtblmodules.hpp
+    size_t purge(intptr_t lo, intptr_t hi)
+    {
+        XTL_ASSERT(descriptor); // Allocated in constructor, deallocated in destructor
+
+        // The cache may only point to entries that are still in the table
+        for (size_t i = 0; i <= descriptor->cache_mask; ++i)
+            if (lo <= descriptor->cache[i]->vtbl && descriptor->cache[i]->vtbl < hi)
+                descriptor->cache[i] = &vacant;
+
+        const size_t removed = table.purge(lo, hi);
+        statistics.known(table.size());
+        return removed;
+    }
+
 #if XTL_DUMP_PERFORMANCE
     std::ostream& operator>>(std::ostream& os) const;
     friend std::ostream& operator<<(std::ostream& os, const vtblmap& m) { return m >> os; }
@@ -407,9 +548,18 @@ public:
 
 private:
 
+    vtblmap(const vtblmap&);            ///< No copy constructor
+    vtblmap& operator=(const vtblmap&); ///< No assignment operator
+
     /// Cached mappings of vtbl to some indecies
     cache_descriptor* descriptor;
 
+    /// All vtbl-pointers seen so far along with their values
+    entry_table table;
+
+    /// Entry all vacant cache entries point to
+    stored_type vacant;
+
     /// Memoized table.size() during last cache rearranging
     size_t last_table_size;
 
@@ -417,14 +567,28 @@ private:
     int collisions_before_update;
 
 #if XTL_DUMP_PERFORMANCE
-    const char* file;      ///< File in which this vtblmap_of is instantiated
-    size_t      line;      ///< Line in the file where it is instantiated
-    const char* func;      ///< Function in which this vtblmap_of is instantiated
-    size_t      updates;   ///< Amount of reconfigurations performed at run time
     size_t      clauses;   ///< Size of the table expected from the number of clauses
-    size_t      hits;      ///< The amount of cache hits
-    size_t      misses;    ///< The amount of cache misses
-    size_t      collisions;///< Out of all the misses, how many were actual collisions
+#endif
+
+    /// Hits, misses, collisions and updates of this map along with its location
+    vtbl_map_statistics statistics;
+
+#if XTL_USE_VTBL_FREQUENCY
+    /// Picks the lookups that count towards frequency of entries
+    vtbl_frequency_sampler sampler;
+#endif
+
+#if XTL_VTBL_INVALIDATION
+    /// Registration of this map for purging vtbls of unloaded modules
+    struct invalidation_hook : vtbl_map_invalidation
+    {
+        explicit invalidation_hook(vtblmap& m) : map(m) {}
+        size_t purge(intptr_t lo, intptr_t hi) { return map.purge(lo,hi); }
+        vtblmap& map;
+    };
+
+    /// Declared last to be unregistered before the rest of the map is destroyed
+    invalidation_hook invalidation;
 #endif
 
 };
@@ -435,74 +599,89 @@ template <typename T>
 T& vtblmap<T>::update(intptr_t vtbl)
 {
     XTL_ASSERT(descriptor); // Allocated in constructor, deallocated in destructor
-    XTL_ASSERT(last_table_size < descriptor->used || descriptor->is_full()); // We will only call this if size changed
+    XTL_ASSERT(last_table_size != table.size()); // We will only call this if size changed
 
-    // FIX: vtbl might already exist in old descriptor and if it happens to be the first one, it won't be taken into consideration
-    intptr_t diff = 0;
-    intptr_t prev = vtbl;
+    stored_type* const st = table.get(vtbl); // Add vtbl to the table so that it is accounted for
 
-    // Compute bits in which existing vtbl, including the newly added one, differ
-    for (size_t i = 0; i <= descriptor->cache_mask; ++i)
-    {
-        XTL_ASSERT(descriptor->cache[i]);
-
-        if (intptr_t vtbl = descriptor->cache[i]->vtbl)
-        {
-            diff |= prev ^ vtbl;
-            prev = vtbl;
-        }
-    }
+    // Updates look at a sample of the table, so their cost is proportional to
+    // the number of layouts tried rather than the number of vtbls. Tolerating
+    // a number of collisions proportional to the table before the next one 
+    // makes their cost amortized constant as the table grows.
+    collisions_before_update = std::max(renewed_collisions_before_update, int(std::min(table.size(), size_t(1) << 30) >> 2));
 
-//#if XTL_DUMP_PERFORMANCE
-//        std::clog << "\nVtbl:New" << std::bitset<8*sizeof(intptr_t)>((unsigned long long)vtbl) << " -> " << ((vtbl >> optimal_shift) & cache_mask) << '\t' << vtbl_typeid(vtbl).name() << std::endl;
-//        *this >> std::clog;       
-//#endif
-
-    XTL_DUMP_PERFORMANCE_ONLY(++updates); // Record update
-    collisions_before_update = renewed_collisions_before_update;      // Reset collisions counter
+    const intptr_t diff = table.differing_bits();
 
     bit_offset_t k  = bit_offset_t(req_bits(descriptor->cache_mask)); // current log_size
-    bit_offset_t n  = bit_offset_t(req_bits(descriptor->used));       // needed  log_size
+    bit_offset_t n  = bit_offset_t(req_bits(table.size()-1));         // needed  log_size
     bit_offset_t m  = bit_offset_t(req_bits(diff));                   // highest bit in which vtbls differ
     bit_offset_t z  = bit_offset_t(trailing_zeros(static_cast<unsigned int>(diff))); // amount of lowest bits in which vtbls do not differ
     bit_offset_t l1 = std::min(max_log_size,std::max(k,n));                          // lower bound for log_size iteration
     bit_offset_t l2 = std::min(max_log_size,std::max(k,bit_offset_t(n+max_log_inc)));// upper bound for log_size iteration
-    bit_offset_t no = l1;                                             // current estimate of the best log_size
-    bit_offset_t zo = z;                                              // current estimate of the best offset
+    bit_offset_t no = k;                                              // current estimate of the best log_size
+    bit_offset_t zo = bit_offset_t(descriptor->optimal_shift);        // current estimate of the best offset
 
-    // We do this to not resort to vectors and heap and keep counting on stack
-    const size_t cache_histogram_size = 1 + ((1<<l2) - 1)/XTL_BIT_SIZE(intptr_t);
-    XTL_VLA(cache_histogram, intptr_t, cache_histogram_size, 1 + ((1<<max_log_size) - 1)/XTL_BIT_SIZE(intptr_t)); // intptr_t cache_histogram[cache_histogram_size];
+    // Sample of vtbls the layouts are tried on
+    std::vector<const stored_type*> sample;
+    sample.reserve(size_t(2) << sample_log_size);
+    table.for_sample(sample_log_size, [&sample](const stored_type& e) { sample.push_back(&e); });
 
+    // We do this to not resort to vectors and heap and keep counting on stack
+    const size_t cache_histogram_size = 1 + ((size_t(1)<<l2) - 1)/XTL_BIT_SIZE(intptr_t);
+    XTL_VLA(cache_histogram, intptr_t, cache_histogram_size, 1 + ((size_t(1)<<max_log_size) - 1)/XTL_BIT_SIZE(intptr_t)); // intptr_t cache_histogram[cache_histogram_size];
+
+#if XTL_USE_VTBL_FREQUENCY
+    // Weight of the hottest vtbl mapped into each entry. The layout maximizing 
+    // their sum gives the hottest vtbls entries of their own. Weights are the
+    // sampled hits plus one, so without samples this is the number of entries.
+    std::vector<size_t> cache_weights(size_t(1)<<l2);
+    size_t max_cache_weight = 0;
+#else
     size_t max_cache_entries = 0;
+#endif
 
     // Iterate over allowed log sizes
     for (bit_offset_t i = l1; i <= l2; ++i)
     {
-        const size_t   cache_size = 1<<i;
+        const size_t   cache_size = size_t(1)<<i;
         const intptr_t cache_mask = cache_size-1;
 
         // Iterate over possible offsets
-        for (bit_offset_t j = z; j <= m-i; ++j)
+        for (bit_offset_t j = z; j + i <= m || j == z; ++j)
         {
-            std::memset(cache_histogram,0,cache_histogram_size*sizeof(intptr_t)); // Reset bit histogram to zeros
-            XTL_BIT_SET(cache_histogram, (vtbl >> j) & cache_mask);               // Mark the entry for new vtbl
+            std::memset(cache_histogram,0,(1 + (cache_size-1)/XTL_BIT_SIZE(intptr_t))*sizeof(intptr_t)); // Reset bit histogram to zeros
 
-            // Iterate over vtbl in old cache and see where they are mapped with log size i and offset j
-            for (size_t c = 0; c <= descriptor->cache_mask; ++c)
-            {
-                XTL_ASSERT(descriptor->cache[c]);
-
-                if (intptr_t vtbl = descriptor->cache[c]->vtbl)
-                    XTL_BIT_SET(cache_histogram, (vtbl >> j) & cache_mask); // Mark the entry for each vtbl
-            }
+            // Iterate over sampled vtbls and see where they are mapped with log size i and offset j
+            for (size_t c = 0; c < sample.size(); ++c)
+                XTL_BIT_SET(cache_histogram, (sample[c]->vtbl >> j) & cache_mask); // Mark the entry for each vtbl
 
             size_t entries = 0;
 
             // Count the number of used entries
-            for (size_t h = 0; h < cache_histogram_size; ++h)
+            for (size_t h = 0; h <= (cache_size-1)/XTL_BIT_SIZE(intptr_t); ++h)
                 entries += bits_set(cache_histogram[h]);
 
+        #if XTL_USE_VTBL_FREQUENCY
+            std::fill(cache_weights.begin(), cache_weights.begin() + cache_size, size_t(0));
+
+            for (size_t c = 0; c < sample.size(); ++c)
+            {
+                size_t& w = cache_weights[(sample[c]->vtbl >> j) & cache_mask];
+                w = std::max(w, sample[c]->hits + 1);
+            }
+
+            size_t weight = 0;
+
+            for (size_t h = 0; h < cache_size; ++h)
+                weight += cache_weights[h];
+
+            // Update best estimates
+            if (weight > max_cache_weight)
+            {
+                max_cache_weight = weight;
+                no = i;
+                zo = j;
+            }
+        #else
             // Update best estimates
             if (entries > max_cache_entries)
             {
@@ -510,8 +689,9 @@ T& vtblmap<T>::update(intptr_t vtbl)
                 no = i;
                 zo = j;
             }
+        #endif
 
-            if (entries == descriptor->used+1)
+            if (entries == sample.size())
             {
                 // We found size and offset without conflicts, exit both loops
                 i = l2+1; // to exit both for loops
@@ -521,30 +701,36 @@ T& vtblmap<T>::update(intptr_t vtbl)
         }
     }
 
+    if (no < k)
+        no = k; // We never shrink, while we preallocate based on number of case clauses or the minimum
+
     if (descriptor->optimal_shift != zo || no != k)
     {
-        if (no < k)
-            no = k; // We never shrink, while we preallocate based on number of case clauses or the minimum
-
         cache_descriptor* old = descriptor;
         #if defined(DBG_NEW)
             #undef new
         #endif
-        descriptor = new(no) cache_descriptor(no,zo,std::move(*old));
+        descriptor = new(no) cache_descriptor(no,zo,*old,&vacant);
         #if defined(DBG_NEW)
             #define new DBG_NEW
         #endif
         delete old;
     }
 
-//#if XTL_DUMP_PERFORMANCE
-//        std::clog << "After" << std::endl;
-//        *this >> std::clog;       
-//#endif
-    typename cache_descriptor::stored_type* res = descriptor->get(vtbl);
-    XTL_ASSERT(res && res->vtbl == vtbl); // We have ensured enough space, so no need to check this explicitly
-    last_table_size = descriptor->used;   // Update memoized value
-    return res->value;
+#if XTL_USE_VTBL_FREQUENCY
+    // Age the frequencies, so that the next update favors recently hot vtbls
+    table.for_each([](stored_type& e) { e.hits /= 2; });
+#endif
+
+    stored_type*& ce = (*descriptor)[vtbl];
+#if XTL_USE_VTBL_FREQUENCY
+    if (!ce->vtbl || ce->hits <= st->hits)
+#endif
+    ce = st;
+    last_table_size = table.size();       // Update memoized value
+    statistics.known(table.size());
+    statistics.layout(table.size(), req_bits(descriptor->cache_mask), memory_used()); // Record update
+    return st->value;
 }
 
 //------------------------------------------------------------------------------
@@ -570,35 +756,29 @@ std::ostream& vtblmap<T>::operator>>(std::ostream& os) const
 {
     std::ios::fmtflags fmt = os.flags(); // store flags
 
-    os << file << '[' << line << ']' << ' ' << func << std::endl;
+    const vtbl_map_stats stats = statistics.snapshot();
+
+    os << stats.file << '[' << stats.line << ']' << ' ' << stats.func << std::endl;
 
-    size_t vtbl_count = descriptor->used;
+    size_t vtbl_count = table.size();
     size_t log_size   = req_bits(descriptor->cache_mask);
-    size_t cache_size = (1<<log_size);
+    size_t cache_size = (size_t(1)<<log_size);
 
-    // We do this to not resort to vectors and heap and keep counting on stack
-    XTL_VLAZ(cache_histogram, vtbl_count_t, cache_size, 1<<max_log_size); // vtbl_count_t cache_histogram[cache_size];
+    std::vector<vtbl_count_t> cache_histogram(cache_size);
+    std::vector<intptr_t> vtbls;
+    std::vector<intptr_t>::iterator q;
 
-    std::vector<intptr_t> vtbls(vtbl_count);
-    std::vector<intptr_t>::iterator q = vtbls.begin();
+    vtbls.reserve(vtbl_count);
 
-    intptr_t diff = 0;
-    intptr_t prev = 0;
+    const intptr_t diff = table.differing_bits();
+    intptr_t       prev = 0;
 
-    // Compute bits in which existing vtbl, including the newly added one, differ
-    for (size_t i = 0; i <= descriptor->cache_mask; ++i)
+    // Collect all the vtbls and see how many of them map into each cache entry
+    table.for_each([&](const stored_type& e)
     {
-        XTL_ASSERT(descriptor->cache[i]);
-
-        if (intptr_t vtbl = descriptor->cache[i]->vtbl)
-        {
-            XTL_ASSERT(size_t(q-vtbls.begin()) < vtbl_count); // Since we preallocated only that much
-            *q++ = vtbl;
-            if (prev) diff |= prev ^ vtbl; // Update diff with information about which bits in all vtbls differ
-            prev = vtbl;
-            cache_histogram[(vtbl >> descriptor->optimal_shift) & descriptor->cache_mask]++;
-        }
-    }
+        vtbls.push_back(e.vtbl);
+        cache_histogram[(e.vtbl >> descriptor->optimal_shift) & descriptor->cache_mask]++;
+    });
 
     // Sort vtables to output them in address order
     std::sort(vtbls.begin(),vtbls.end());
@@ -650,14 +830,14 @@ std::ostream& vtblmap<T>::operator>>(std::ostream& os) const
         << " log_size="   << std::setw(2) << log_size     // log2 size required
         << " shift="      << std::setw(2) << descriptor->optimal_shift// optimal shift used
         << " width="      << std::setw(2) << str.find_last_of("X")-str.find_first_of("X")+1 // total spread of different bits
-        << " updates="    << std::setw(2) << updates      // how many updates have been performed on the cache
-        << " hits="       << std::setw(8) << hits         // how many hits have we had
-        << " misses="     << std::setw(8) << misses       // how many misses have we had
-        << " collisions=" << std::setw(8) << collisions   // how many misses were actual collisions
+        << " updates="    << std::setw(2) << stats.updates   // how many updates have been performed on the cache
+        << " hits="       << std::setw(8) << stats.hits      // how many hits have we had
+        << " misses="     << std::setw(8) << stats.misses    // how many misses have we had
+        << " collisions=" << std::setw(8) << stats.collisions// how many misses were actual collisions
 //        << " entries: "   << std::setw(5) << entries      // how many entires in the cache are used
 //        << " Entropy: "   << std::setw(9) << std::fixed << std::setprecision(7) << entropy  // Entropy
 //        << " Conflict: "  << std::setw(9) << std::fixed << std::setprecision(7) << conflict // Probability of conflict
-        << " Stmt: "      << file << '[' << line << ']' << ' ' << func
+        << " Stmt: "      << stats.file << '[' << stats.line << ']' << ' ' << stats.func
         << ";\n";
     os.flags(fmt);
 #if 0
@@ -703,17 +883,17 @@ std::ostream& vtblmap<T>::operator>>(std::ostream& os) const
         << " perfect="     << std::setw(3) << (vtbl_count ? d1*100/vtbl_count : 0) << '%'
         //<< " sizeof(ent)=" << std::setw(2) << sizeof(cache_entry)
         << " conflict="    << std::setw(9) << std::fixed << std::setprecision(7) << cache_conflict // Probability of conflict in cache
-        << " Stmt: "       << file << '[' << line << ']' << ' ' << func
+        << " Stmt: "       << stats.file << '[' << stats.line << ']' << ' ' << stats.func
         << "; ";
 
-    size_t cache_last_non_zero_count = last_non_zero_count(cache_histogram,cache_size,vtbl_count);
+    size_t cache_last_non_zero_count = last_non_zero_count(&cache_histogram[0],cache_size,vtbl_count);
 
     // Print cache histogram
     for (size_t i = 0; i <= cache_last_non_zero_count; ++i)
     {
-        size_t d = std::count(cache_histogram,cache_histogram+cache_size,i);
+        size_t d = std::count(cache_histogram.begin(),cache_histogram.end(),i);
 
-        if (!i) os << std::setw(3) << d*100/cache_size << "% unused " << '[' << line << ']';
+        if (!i) os << std::setw(3) << d*100/cache_size << "% unused " << '[' << stats.line << ']';
         os << std::setw(2) << i << "->" << d << "; ";
     }
 
@@ -78,9 +78,20 @@
 
 #include <algorithm>
 #include <cmath>
+#include <cstdint>
 #include <cstring>
 #include <cstdarg>
+#include "metatools.hpp" // Meta-functions like count_if
 #include "ptrtools.hpp"  // Helper functions to work with pointers
+#include "vtblhash.hpp"  // Hashing policies of vtbl maps
+#include "vtblstats.hpp" // Run-time statistics of vtbl maps
+#if XTL_DEFERRED_VTBL_UPDATE
+#include "vtblmaint.hpp" // Deferred updates of vtbl maps
+#endif
+#if XTL_VTBL_INVALIDATION
+#include "vtblmodules.hpp"// Invalidation of vtbls of unloaded modules
+#endif
+#include "vtblexport.hpp"// JSON and CSV writers of vtbl map statistics
 #include <xtl/xtl.hpp>   // XTL subtyping definitions
 
 #if XTL_DUMP_PERFORMANCE
@@ -116,14 +127,14 @@ typedef size_t  bit_offset_t;
 /// vtbl pointers in the program. Roughly N should be equal to some constant c
 /// multiplied by the number of different classes polymorphic classes in the 
 /// program. Constant c accounts for potential multiple inheritance.
-typedef unsigned short vtbl_count_t;
-//typedef size_t vtbl_count_t;
+typedef std::uint32_t vtbl_count_t;
 
 //------------------------------------------------------------------------------
 
 const bit_offset_t min_log_size      = XTL_MIN_LOG_SIZE; ///< Log of the smallest cache size to start from
 const bit_offset_t max_stack_log_size= XTL_MAX_STACK_LOG_SIZE; ///< Log of the maximum stack size we can reserve to do some histogram computations.
 const bit_offset_t max_log_inc       = XTL_MAX_LOG_INC;  ///< Log of the maximum allowed increased from the minimum requred log size (1 means twice from the min required size)
+const bit_offset_t sample_log_size   = XTL_VTBL_SAMPLE_LOG_SIZE; ///< Log of the largest number of cache entries looked at to find a better layout
 //const vtbl_count_t min_expected_size = 1 << min_log_size;
 const bit_offset_t irrelevant_bits   = 0; // XTL_IRRELEVANT_VTBL_BITS; // FIX: temporarily set to 0 for experiments with XTL subtyping where we don't work with vtbl-pointers
 const int initial_collisions_before_update = 16;
@@ -250,11 +261,12 @@ inline void array_fill(const T (&a)[N], const T& v)
 template <size_t N, typename T>
 struct stored_type_for
 {
-    stored_type_for() : XTL_VTBL_HASHING(hash(0),) vtbl(), value() {}
+    stored_type_for() : XTL_VTBL_HASHING(hash(0),) vtbl(), value() XTL_USE_VTBL_FREQUENCY_ONLY(,hits(0)) {}
 
     XTL_VTBL_HASHING(intptr_t hash;)     ///< hash of vtbl[i] for comparing vtbl for large N (> 2)
     intptr_t vtbl[N];  ///< v-table pointers of the value
     T        value;    ///< value associated with the v-table pointers vtbl[]
+    XTL_USE_VTBL_FREQUENCY_ONLY(size_t hits;) ///< Sampled number of lookups that found this entry
 
     /// Helper function to in-place construct stored_type inside uninitialized memory
     void construct()    { new(this) stored_type_for(); }
@@ -279,10 +291,11 @@ struct stored_type_for
 template <typename T>
 struct stored_type_for<1,T>
 {
-    stored_type_for() : vtbl(), value() {}
+    stored_type_for() : vtbl(), value() XTL_USE_VTBL_FREQUENCY_ONLY(,hits(0)) {}
 
     intptr_t vtbl[1];  ///< v-table pointers of the value
     T        value;    ///< value associated with the v-table pointers vtbl[]
+    XTL_USE_VTBL_FREQUENCY_ONLY(size_t hits;) ///< Sampled number of lookups that found this entry
 
     /// Helper function to in-place construct stored_type inside uninitialized memory
     void construct()    { new(this) stored_type_for(); }
@@ -302,7 +315,31 @@ struct stored_type_for<1,T>
 
 //------------------------------------------------------------------------------
 
-template <size_t N, typename T>
+///@{
+/// Stores vtbl-pointers of those subjects, whose types satisfy predicate P (e.g.
+/// std::is_polymorphic), into consecutive elements of vtbl skipping the rest.
+/// \note vtbl_of is called with the static type of each subject, so that 
+///       overloads of it for non-polymorphic types like boost::variant apply.
+template <typename S> inline void store_vtbl(intptr_t* vtbl, const S* s, std::true_type ) noexcept { *vtbl = vtbl_of(s); }
+template <typename S> inline void store_vtbl(intptr_t*     , const S*  , std::false_type) noexcept {}
+
+template <template <typename> class P>
+inline void store_vtbls(intptr_t*) noexcept {}
+
+template <template <typename> class P, typename S, typename... Ss>
+inline void store_vtbls(intptr_t* vtbl, const S* s, const Ss*... ss) noexcept
+{
+    store_vtbl(vtbl, s, std::integral_constant<bool,P<S>::value>());
+    store_vtbls<P>(vtbl + (P<S>::value ? 1 : 0), ss...);
+}
+///@}
+
+//------------------------------------------------------------------------------
+
+/// \tparam N Number of vtbl-pointers in the key
+/// \tparam T Type of values associated with the keys
+/// \tparam H Hashing policy turning the key into a cache index \see vtblhash.hpp
+template <size_t N, typename T, typename H = default_vtbl_hash>
 class vtbl_map
 {
 private:
@@ -329,6 +366,9 @@ private:
         /// Total number of vtbl-pointers in the cache
         size_t used;
 
+        /// Hash function applied to shifted vtbl-pointers
+        H hash;
+
         /// Variable-sized array with actual pointers to stored_type
         stored_type* cache[XTL_VARIABLE_SIZE_ARRAY];
 
@@ -347,15 +387,16 @@ private:
         #endif
 
         /// We need to declare this placement delete operator since we overload new.
-        void operator delete(void* p, size_t) { ::delete(static_cast<char*>(p)); } // We cast to char* to avoid warning on deleting void*, which is undefined
+        void operator delete(void* p, size_t) { ::delete[](static_cast<char*>(p)); } // We cast to char* to avoid warning on deleting void*, which is undefined
 
         /// We also provide non-placement delete operator since it doesn't really depend on extra arguments.
-        void operator delete(void* p)         { ::delete(static_cast<char*>(p)); } // We cast to char* to avoid warning on deleting void*, which is undefined
+        void operator delete(void* p)         { ::delete[](static_cast<char*>(p)); } // We cast to char* to avoid warning on deleting void*, which is undefined
 
         /// Creates new cache_descriptor based on parameters k and l of the hashing function
         cache_descriptor(
             const size_t       log_size,               ///< Parameter k of the cache - the log of the size of the cache
-            const bit_offset_t shift = irrelevant_bits ///< Parameter l of the cache - number of irrelevant bits on the right to remove
+            const bit_offset_t shift = irrelevant_bits,///< Parameter l of the cache - number of irrelevant bits on the right to remove
+            const H&           h = H()                 ///< Hash function to use
         );
 
         /// Creates new cache_descriptor based on parameters k and l of the 
@@ -364,6 +405,7 @@ private:
         cache_descriptor(
             const size_t       log_size,    ///< Parameter k of the cache - the log of the size of the cache                
             const bit_offset_t (&shifts)[N],///< Parameter l of the cache - number of irrelevant bits on the right to remove
+            const H&           h,           ///< Hash function to use
         #if defined(XTL_NO_RVALREF)
             cache_descriptor&  old          ///< cache_descriptor we will supposedly replace
         #else
@@ -385,19 +427,19 @@ private:
                 + (cache_mask+1)*sizeof(stored_type);                         // Actual cached values pointers in cache point to
         }
 
-        /// Global function computing cache index for a given vtbl pointers, offsets and cache mask
-        static inline size_t cache_index(const intptr_t vtbl[N], const bit_offset_t shifts[N], size_t cache_mask)
+        /// Global function computing cache index for a given vtbl pointers, offsets, cache mask and hash function
+        static inline size_t cache_index(const intptr_t vtbl[N], const bit_offset_t shifts[N], size_t cache_mask, const H& h)
         {
             intptr_t vtbl_shifted[N];
 
             for (size_t i = 0; i < N; ++i)
                 vtbl_shifted[i] = vtbl[i] >> shifts[i];
 
-            return interleave(vtbl_shifted) & cache_mask;
+            return h(vtbl_shifted) & cache_mask;
         }
 
-        /// Computes cache index for current optimal offsets and cache mask.
-        size_t cache_index(const intptr_t vtbl[N]) const { return cache_index(vtbl,optimal_shift,cache_mask); }
+        /// Computes cache index for current optimal offsets, cache mask and hash function.
+        size_t cache_index(const intptr_t vtbl[N]) const { return cache_index(vtbl,optimal_shift,cache_mask,hash); }
 
         /// Re-establishes invariant that vtbls can only be in the cache 
         /// entry that correspond to their cache index, unless that entry
@@ -410,10 +452,45 @@ private:
         /// Optimization for when the cache index has already been computed
         stored_type* get(const intptr_t (&vtbl)[N], size_t j) noexcept;
 
+        /// Swaps entry cv into location ce, where it is expected to be, and returns it
+        stored_type* promote(stored_type*& ce, stored_type*& cv) noexcept
+        {
+        #if XTL_USE_VTBL_FREQUENCY
+            // A hotter entry that belongs to ce stays there, so that two 
+            // colliding entries do not keep swapping each other out
+            if (ce->occupied() && ce->hits > cv->hits && &cache[cache_index(ce->vtbl)] == &ce)
+                return cv;
+        #endif
+            std::swap(ce,cv);
+            return ce;
+        }
+
+        /// Distance between cache entries looked at by #entries_for. Caches larger
+        /// than 2^#sample_log_size entries are sampled, so that the cost of trying
+        /// a layout does not grow with the number of classes.
+        size_t sample_stride() const { return std::max(size_t(1), size_t(cache_mask+1) >> sample_log_size); }
+
+        /// Number of occupied entries among those looked at by #entries_for
+        size_t sampled_used() const
+        {
+            if (cache_mask < (size_t(1) << sample_log_size))
+                return used;
+
+            size_t result = 0;
+
+            for (size_t c = 0, stride = sample_stride(); c <= cache_mask; c += stride)
+                result += cache[c]->occupied();
+
+            return result;
+        }
+
         /// Computes the number of entries an existing set of vtbl-pointer tuples 
         /// extended with the new one will occupy in cache of a given #log_size 
-        /// with given #offsets
-        size_t entries_for(const intptr_t (&vtbl)[N], size_t log_size, const bit_offset_t (&offsets)[N]) const;
+        /// with given #offsets and hash function #h. With #XTL_USE_VTBL_FREQUENCY
+        /// it also sets #weight to the sum of frequencies (plus one) of the 
+        /// hottest tuples mapped into each entry. Only every #sample_stride()
+        /// entry of the current cache is taken into account.
+        size_t entries_for(const intptr_t (&vtbl)[N], size_t log_size, const bit_offset_t (&offsets)[N], const H& h XTL_USE_VTBL_FREQUENCY_ONLY(, size_t& weight)) const;
 
     private:
 
@@ -433,20 +510,18 @@ public:
     #if defined(DBG_NEW)
         #undef new
     #endif
-    vtbl_map(const char* fl, size_t ln, const char* fn, const vtbl_count_t& num_clauses) : 
-        descriptor(new(min_log_size) cache_descriptor(min_log_size)),
+    vtbl_map(const char* fl, size_t ln, const char* fn, const vtbl_count_t num_clauses) : 
+        descriptor(new(initial_log_size(num_clauses)) cache_descriptor(initial_log_size(num_clauses))),
         case_clauses(num_clauses),
         last_table_size(0),
         collisions_before_update(initial_collisions_before_update),
         prev_collisions_before_update(initial_collisions_before_update),
-        file(fl), 
-        line(ln),
-        func(fn),
-        updates(0), 
-        hits(0),
-        misses(0),
-        collisions(0)
-    {}
+        statistics(N, fl, ln, fn)
+        XTL_DEFERRED_VTBL_UPDATE_ONLY(, maintenance(*this))
+        XTL_VTBL_INVALIDATION_ONLY(, invalidation(*this))
+    {
+        statistics.layout(0, req_bits(descriptor->cache_mask), memory_used(), false);
+    }
     #if defined(DBG_NEW)
         #define new DBG_NEW
     #endif
@@ -455,30 +530,53 @@ public:
     #if defined(DBG_NEW)
         #undef new
     #endif
-    vtbl_map(const vtbl_count_t& num_clauses) : 
-        descriptor(new(min_log_size) cache_descriptor(min_log_size)),
+    /// \param num_clauses Number of case clauses of the Match statement, which
+    ///                    presizes the cache when known and is 0 otherwise
+    /// \param uid  Name identifying the Match statement in run-time statistics
+    /// \param file File of the Match statement, when known
+    /// \param line Line of the Match statement, when known
+    vtbl_map(const vtbl_count_t num_clauses, const char* uid = nullptr, const char* file = nullptr, size_t line = 0) : 
+        descriptor(new(initial_log_size(num_clauses)) cache_descriptor(initial_log_size(num_clauses))),
         case_clauses(num_clauses),
         last_table_size(0),
         collisions_before_update(initial_collisions_before_update),
-        prev_collisions_before_update(initial_collisions_before_update)
-        XTL_DUMP_PERFORMANCE_ONLY(,file("unspecified"), line(0), func("unspecified"), updates(0), hits(0), misses(0), collisions(0))
-    {}
+        prev_collisions_before_update(initial_collisions_before_update),
+        statistics(N, file, line, uid)
+        XTL_DEFERRED_VTBL_UPDATE_ONLY(, maintenance(*this))
+        XTL_VTBL_INVALIDATION_ONLY(, invalidation(*this))
+    {
+        statistics.layout(0, req_bits(descriptor->cache_mask), memory_used(), false);
+    }
     #if defined(DBG_NEW)
         #define new DBG_NEW
     #endif
 
    ~vtbl_map()
     {
-        XTL_DUMP_PERFORMANCE_ONLY(std::clog << *this << std::endl);
+        XTL_DUMP_PERFORMANCE_ONLY(dump(std::clog));
+    #if XTL_DEFERRED_VTBL_UPDATE
+        maintenance.cancel();
+        delete maintenance.snapshot;
+    #endif
         delete descriptor;
     }
 
+    /// Log of the cache size to start with for a given number of case clauses:
+    /// each clause will likely be taken by at least one combination of vtbls.
+    static bit_offset_t initial_log_size(size_t clauses) noexcept
+    {
+        return std::max(min_log_size, bit_offset_t(req_bits(clauses)));
+    }
+
     size_t memory_used() const 
     {
         XTL_ASSERT(descriptor);
         return sizeof(vtbl_map) + descriptor->memory_used();
     }
 
+    /// Name of the hash function the map currently uses \see vtblhash.hpp
+    const char* hash_name() const noexcept { return descriptor->hash.name(); }
+
     /// This is the main function to get the value of type T associated with
     /// the (vtbl0,...,vtblN) of given pointers.
     ///
@@ -514,118 +612,188 @@ public:
 
         if (XTL_LIKELY(ce->is_for(vtbl)))
         {
-            XTL_DUMP_PERFORMANCE_ONLY(++hits);
+            statistics.hit();
+            XTL_USE_VTBL_FREQUENCY_ONLY(if (XTL_UNLIKELY(sampler())) ++ce->hits;)
             return ce->value;
         }
         else
         {
-            XTL_DUMP_PERFORMANCE_ONLY(++misses);
-            XTL_DUMP_PERFORMANCE_ONLY(if (ce->occupied()) ++collisions);
+            statistics.miss(ce->occupied());
+
+        #if XTL_DEFERRED_VTBL_UPDATE
+            // The search for a better layout is left to maintenance, while we 
+            // only adopt the layouts it found and grow the cache when it is full
+            if (XTL_UNLIKELY(maintenance.ready()))        // Maintenance found a layout for us
+                return adopt_layout(vtbl);
+
+            if (XTL_UNLIKELY(descriptor->is_full()))      // No entries left for possibly new vtbl in the cache
+            {
+                request_update(vtbl);
+                return relayout(current_layout(), vtbl);  // grow the cache keeping its layout
+            }
 
+            if (XTL_UNLIKELY(
+                ce->occupied()                            // Collision - the entry for vtbl is already occupied
+                && --collisions_before_update <= 0        // We had sufficiently many collisions to justify call
+                && descriptor->used != last_table_size))  // There was at least one vtbl added since last update
+                request_update(vtbl);                     // ask maintenance to rearrange cache
+        #else
             if (XTL_UNLIKELY(
                 descriptor->is_full()                     // No entries left for possibly new vtbl in the cache
                 || (ce->occupied()                        // Collision - the entry for vtbl is already occupied
                 && --collisions_before_update <= 0        // We had sufficiently many collisions to justify call
                 && descriptor->used != last_table_size))) // There was at least one vtbl added since last update
                 return update(vtbl);                      // try to rearrange cache
+        #endif
 
             // Try to find entry with our vtbl and swap it with where it is expected to be
-            descriptor->get(vtbl,j); // This will bring correct pointer into ce
-            XTL_ASSERT(ce->is_for(vtbl));
-            return ce->value;
+            typename cache_descriptor::stored_type* st = descriptor->get(vtbl,j); // This will bring correct pointer into ce unless ce is hotter
+            XTL_ASSERT(st && st->is_for(vtbl));
+            statistics.known(descriptor->used); // Including vtbl if it was just added
+            XTL_USE_VTBL_FREQUENCY_ONLY(if (XTL_UNLIKELY(sampler())) ++st->hits;)
+            return st->value;
         }
     }
 
 //------------------------------------------------------------------------------
 
-    // FIX: temporary copypaste of get overloads below into xtl_get. Make get more generic to work with both cases
-
-    //template <typename S1> inline auto xtl_get(const S1* s1) -> typename std::enable_if<!xtl::is_poly_morphic<S1>::value,T&>::type { static T dummy; return dummy; }
-    template <typename S1> inline auto xtl_get(const S1* s1) -> typename std::enable_if< xtl::is_poly_morphic<S1>::value,T&>::type { intptr_t vtbl[1] = {vtbl_of(s1)}; return get(vtbl); }
-
-    //template <typename S1, typename S2> inline auto xtl_get(const S1* s1, const S2* s2) -> typename std::enable_if<!xtl::is_poly_morphic<S1>::value && !xtl::is_poly_morphic<S2>::value,T&>::type { static T dummy; return dummy; }
-    template <typename S1, typename S2> inline auto xtl_get(const S1*   , const S2* s2) -> typename std::enable_if<!xtl::is_poly_morphic<S1>::value &&  xtl::is_poly_morphic<S2>::value,T&>::type { intptr_t vtbl[1] = {            vtbl_of(s2)}; return get(vtbl); }
-    template <typename S1, typename S2> inline auto xtl_get(const S1* s1, const S2*   ) -> typename std::enable_if< xtl::is_poly_morphic<S1>::value && !xtl::is_poly_morphic<S2>::value,T&>::type { intptr_t vtbl[1] = {vtbl_of(s1)            }; return get(vtbl); }
-    template <typename S1, typename S2> inline auto xtl_get(const S1* s1, const S2* s2) -> typename std::enable_if< xtl::is_poly_morphic<S1>::value &&  xtl::is_poly_morphic<S2>::value,T&>::type { intptr_t vtbl[2] = {vtbl_of(s1),vtbl_of(s2)}; return get(vtbl); }
-
-    //template <typename S1, typename S2, typename S3> inline auto xtl_get(const S1*   , const S2*   , const S3*   ) -> typename std::enable_if<!xtl::is_poly_morphic<S1>::value && !xtl::is_poly_morphic<S2>::value && !xtl::is_poly_morphic<S3>::value,T&>::type { static T dummy; return dummy; }
-    template <typename S1, typename S2, typename S3> inline auto xtl_get(const S1*   , const S2*   , const S3* s3) -> typename std::enable_if<!xtl::is_poly_morphic<S1>::value && !xtl::is_poly_morphic<S2>::value &&  xtl::is_poly_morphic<S3>::value,T&>::type { intptr_t vtbl[1] = {                        vtbl_of(s3)}; return get(vtbl); }
-    template <typename S1, typename S2, typename S3> inline auto xtl_get(const S1*   , const S2* s2, const S3*   ) -> typename std::enable_if<!xtl::is_poly_morphic<S1>::value &&  xtl::is_poly_morphic<S2>::value && !xtl::is_poly_morphic<S3>::value,T&>::type { intptr_t vtbl[1] = {            vtbl_of(s2)            }; return get(vtbl); }
-    template <typename S1, typename S2, typename S3> inline auto xtl_get(const S1*   , const S2* s2, const S3* s3) -> typename std::enable_if<!xtl::is_poly_morphic<S1>::value &&  xtl::is_poly_morphic<S2>::value &&  xtl::is_poly_morphic<S3>::value,T&>::type { intptr_t vtbl[2] = {            vtbl_of(s2),vtbl_of(s3)}; return get(vtbl); }
-    template <typename S1, typename S2, typename S3> inline auto xtl_get(const S1* s1, const S2*   , const S3*   ) -> typename std::enable_if< xtl::is_poly_morphic<S1>::value && !xtl::is_poly_morphic<S2>::value && !xtl::is_poly_morphic<S3>::value,T&>::type { intptr_t vtbl[1] = {vtbl_of(s1)                        }; return get(vtbl); }
-    template <typename S1, typename S2, typename S3> inline auto xtl_get(const S1* s1, const S2*   , const S3* s3) -> typename std::enable_if< xtl::is_poly_morphic<S1>::value && !xtl::is_poly_morphic<S2>::value &&  xtl::is_poly_morphic<S3>::value,T&>::type { intptr_t vtbl[2] = {vtbl_of(s1),            vtbl_of(s3)}; return get(vtbl); }
-    template <typename S1, typename S2, typename S3> inline auto xtl_get(const S1* s1, const S2* s2, const S3*   ) -> typename std::enable_if< xtl::is_poly_morphic<S1>::value &&  xtl::is_poly_morphic<S2>::value && !xtl::is_poly_morphic<S3>::value,T&>::type { intptr_t vtbl[2] = {vtbl_of(s1),vtbl_of(s2)            }; return get(vtbl); }
-    template <typename S1, typename S2, typename S3> inline auto xtl_get(const S1* s1, const S2* s2, const S3* s3) -> typename std::enable_if< xtl::is_poly_morphic<S1>::value &&  xtl::is_poly_morphic<S2>::value &&  xtl::is_poly_morphic<S3>::value,T&>::type { intptr_t vtbl[3] = {vtbl_of(s1),vtbl_of(s2),vtbl_of(s3)}; return get(vtbl); }
-
-    //template <typename S1, typename S2, typename S3, typename S4> inline auto xtl_get(const S1* s1, const S2* s2, const S3* s3, const S4* s4) -> typename std::enable_if<!xtl::is_poly_morphic<S1>::value && !xtl::is_poly_morphic<S2>::value && !xtl::is_poly_morphic<S3>::value && !xtl::is_poly_morphic<S4>::value,T&>::type { static T dummy; return dummy; }
-    template <typename S1, typename S2, typename S3, typename S4> inline auto xtl_get(const S1*   , const S2*   , const S3*   , const S4* s4) -> typename std::enable_if<!xtl::is_poly_morphic<S1>::value && !xtl::is_poly_morphic<S2>::value && !xtl::is_poly_morphic<S3>::value &&  xtl::is_poly_morphic<S4>::value,T&>::type { intptr_t vtbl[1] = {                                    vtbl_of(s4)}; return get(vtbl); }
-    template <typename S1, typename S2, typename S3, typename S4> inline auto xtl_get(const S1*   , const S2*   , const S3* s3, const S4*   ) -> typename std::enable_if<!xtl::is_poly_morphic<S1>::value && !xtl::is_poly_morphic<S2>::value &&  xtl::is_poly_morphic<S3>::value && !xtl::is_poly_morphic<S4>::value,T&>::type { intptr_t vtbl[1] = {                        vtbl_of(s3)            }; return get(vtbl); }
-    template <typename S1, typename S2, typename S3, typename S4> inline auto xtl_get(const S1*   , const S2*   , const S3* s3, const S4* s4) -> typename std::enable_if<!xtl::is_poly_morphic<S1>::value && !xtl::is_poly_morphic<S2>::value &&  xtl::is_poly_morphic<S3>::value &&  xtl::is_poly_morphic<S4>::value,T&>::type { intptr_t vtbl[2] = {                        vtbl_of(s3),vtbl_of(s4)}; return get(vtbl); }
-    template <typename S1, typename S2, typename S3, typename S4> inline auto xtl_get(const S1*   , const S2* s2, const S3*   , const S4*   ) -> typename std::enable_if<!xtl::is_poly_morphic<S1>::value &&  xtl::is_poly_morphic<S2>::value && !xtl::is_poly_morphic<S3>::value && !xtl::is_poly_morphic<S4>::value,T&>::type { intptr_t vtbl[1] = {            vtbl_of(s2)                        }; return get(vtbl); }
-    template <typename S1, typename S2, typename S3, typename S4> inline auto xtl_get(const S1*   , const S2* s2, const S3*   , const S4* s4) -> typename std::enable_if<!xtl::is_poly_morphic<S1>::value &&  xtl::is_poly_morphic<S2>::value && !xtl::is_poly_morphic<S3>::value &&  xtl::is_poly_morphic<S4>::value,T&>::type { intptr_t vtbl[2] = {            vtbl_of(s2),            vtbl_of(s4)}; return get(vtbl); }
-    template <typename S1, typename S2, typename S3, typename S4> inline auto xtl_get(const S1*   , const S2* s2, const S3* s3, const S4*   ) -> typename std::enable_if<!xtl::is_poly_morphic<S1>::value &&  xtl::is_poly_morphic<S2>::value &&  xtl::is_poly_morphic<S3>::value && !xtl::is_poly_morphic<S4>::value,T&>::type { intptr_t vtbl[2] = {            vtbl_of(s2),vtbl_of(s3)            }; return get(vtbl); }
-    template <typename S1, typename S2, typename S3, typename S4> inline auto xtl_get(const S1*   , const S2* s2, const S3* s3, const S4* s4) -> typename std::enable_if<!xtl::is_poly_morphic<S1>::value &&  xtl::is_poly_morphic<S2>::value &&  xtl::is_poly_morphic<S3>::value &&  xtl::is_poly_morphic<S4>::value,T&>::type { intptr_t vtbl[3] = {            vtbl_of(s2),vtbl_of(s3),vtbl_of(s4)}; return get(vtbl); }
-    template <typename S1, typename S2, typename S3, typename S4> inline auto xtl_get(const S1* s1, const S2*   , const S3*   , const S4*   ) -> typename std::enable_if< xtl::is_poly_morphic<S1>::value && !xtl::is_poly_morphic<S2>::value && !xtl::is_poly_morphic<S3>::value && !xtl::is_poly_morphic<S4>::value,T&>::type { intptr_t vtbl[1] = {vtbl_of(s1)                                    }; return get(vtbl); }
-    template <typename S1, typename S2, typename S3, typename S4> inline auto xtl_get(const S1* s1, const S2*   , const S3*   , const S4* s4) -> typename std::enable_if< xtl::is_poly_morphic<S1>::value && !xtl::is_poly_morphic<S2>::value && !xtl::is_poly_morphic<S3>::value &&  xtl::is_poly_morphic<S4>::value,T&>::type { intptr_t vtbl[2] = {vtbl_of(s1),                        vtbl_of(s4)}; return get(vtbl); }
-    template <typename S1, typename S2, typename S3, typename S4> inline auto xtl_get(const S1* s1, const S2*   , const S3* s3, const S4*   ) -> typename std::enable_if< xtl::is_poly_morphic<S1>::value && !xtl::is_poly_morphic<S2>::value &&  xtl::is_poly_morphic<S3>::value && !xtl::is_poly_morphic<S4>::value,T&>::type { intptr_t vtbl[2] = {vtbl_of(s1),            vtbl_of(s3)            }; return get(vtbl); }
-    template <typename S1, typename S2, typename S3, typename S4> inline auto xtl_get(const S1* s1, const S2*   , const S3* s3, const S4* s4) -> typename std::enable_if< xtl::is_poly_morphic<S1>::value && !xtl::is_poly_morphic<S2>::value &&  xtl::is_poly_morphic<S3>::value &&  xtl::is_poly_morphic<S4>::value,T&>::type { intptr_t vtbl[3] = {vtbl_of(s1),            vtbl_of(s3),vtbl_of(s4)}; return get(vtbl); }
-    template <typename S1, typename S2, typename S3, typename S4> inline auto xtl_get(const S1* s1, const S2* s2, const S3*   , const S4*   ) -> typename std::enable_if< xtl::is_poly_morphic<S1>::value &&  xtl::is_poly_morphic<S2>::value && !xtl::is_poly_morphic<S3>::value && !xtl::is_poly_morphic<S4>::value,T&>::type { intptr_t vtbl[2] = {vtbl_of(s1),vtbl_of(s2)                        }; return get(vtbl); }
-    template <typename S1, typename S2, typename S3, typename S4> inline auto xtl_get(const S1* s1, const S2* s2, const S3*   , const S4* s4) -> typename std::enable_if< xtl::is_poly_morphic<S1>::value &&  xtl::is_poly_morphic<S2>::value && !xtl::is_poly_morphic<S3>::value &&  xtl::is_poly_morphic<S4>::value,T&>::type { intptr_t vtbl[3] = {vtbl_of(s1),vtbl_of(s2),            vtbl_of(s4)}; return get(vtbl); }
-    template <typename S1, typename S2, typename S3, typename S4> inline auto xtl_get(const S1* s1, const S2* s2, const S3* s3, const S4*   ) -> typename std::enable_if< xtl::is_poly_morphic<S1>::value &&  xtl::is_poly_morphic<S2>::value &&  xtl::is_poly_morphic<S3>::value && !xtl::is_poly_morphic<S4>::value,T&>::type { intptr_t vtbl[3] = {vtbl_of(s1),vtbl_of(s2),vtbl_of(s3)            }; return get(vtbl); }
-    template <typename S1, typename S2, typename S3, typename S4> inline auto xtl_get(const S1* s1, const S2* s2, const S3* s3, const S4* s4) -> typename std::enable_if< xtl::is_poly_morphic<S1>::value &&  xtl::is_poly_morphic<S2>::value &&  xtl::is_poly_morphic<S3>::value &&  xtl::is_poly_morphic<S4>::value,T&>::type { intptr_t vtbl[4] = {vtbl_of(s1),vtbl_of(s2),vtbl_of(s3),vtbl_of(s4)}; return get(vtbl); }
-
-//------------------------------------------------------------------------------
+    ///@{
+    /// Gets the value associated with the vtbl-pointers of the polymorphic 
+    /// subjects among s..., while the non-polymorphic ones are skipped. There
+    /// has to be exactly N polymorphic subjects. The two versions only differ
+    /// in the trait deciding what is polymorphic: std::is_polymorphic is used
+    /// by Match, while XTL subtyping relies on xtl::is_poly_morphic.
+    template <typename... S>
+    inline auto get(const S*... s) noexcept -> typename std::enable_if<count_if<std::is_polymorphic,S...>::value == N, T&>::type
+    {
+        intptr_t vtbl[N];
+        store_vtbls<std::is_polymorphic>(vtbl, s...);
+        return get(vtbl);
+    }
 
-  //template <typename S1> inline auto get(const S1* s1) -> typename std::enable_if<!std::is_polymorphic<S1>::value,T&>::type { static T dummy; return dummy; }
-    template <typename S1> inline auto get(const S1* s1) -> typename std::enable_if< std::is_polymorphic<S1>::value,T&>::type { intptr_t vtbl[1] = {vtbl_of(s1)}; return get(vtbl); }
-
-  //template <typename S1, typename S2> inline auto get(const S1* s1, const S2* s2) -> typename std::enable_if<!std::is_polymorphic<S1>::value && !std::is_polymorphic<S2>::value,T&>::type { static T dummy; return dummy; }
-    template <typename S1, typename S2> inline auto get(const S1*   , const S2* s2) -> typename std::enable_if<!std::is_polymorphic<S1>::value &&  std::is_polymorphic<S2>::value,T&>::type { intptr_t vtbl[1] = {            vtbl_of(s2)}; return get(vtbl); }
-    template <typename S1, typename S2> inline auto get(const S1* s1, const S2*   ) -> typename std::enable_if< std::is_polymorphic<S1>::value && !std::is_polymorphic<S2>::value,T&>::type { intptr_t vtbl[1] = {vtbl_of(s1)            }; return get(vtbl); }
-    template <typename S1, typename S2> inline auto get(const S1* s1, const S2* s2) -> typename std::enable_if< std::is_polymorphic<S1>::value &&  std::is_polymorphic<S2>::value,T&>::type { intptr_t vtbl[2] = {vtbl_of(s1),vtbl_of(s2)}; return get(vtbl); }
-
-  //template <typename S1, typename S2, typename S3> inline auto get(const S1*   , const S2*   , const S3*   ) -> typename std::enable_if<!std::is_polymorphic<S1>::value && !std::is_polymorphic<S2>::value && !std::is_polymorphic<S3>::value,T&>::type { static T dummy; return dummy; }
-    template <typename S1, typename S2, typename S3> inline auto get(const S1*   , const S2*   , const S3* s3) -> typename std::enable_if<!std::is_polymorphic<S1>::value && !std::is_polymorphic<S2>::value &&  std::is_polymorphic<S3>::value,T&>::type { intptr_t vtbl[1] = {                        vtbl_of(s3)}; return get(vtbl); }
-    template <typename S1, typename S2, typename S3> inline auto get(const S1*   , const S2* s2, const S3*   ) -> typename std::enable_if<!std::is_polymorphic<S1>::value &&  std::is_polymorphic<S2>::value && !std::is_polymorphic<S3>::value,T&>::type { intptr_t vtbl[1] = {            vtbl_of(s2)            }; return get(vtbl); }
-    template <typename S1, typename S2, typename S3> inline auto get(const S1*   , const S2* s2, const S3* s3) -> typename std::enable_if<!std::is_polymorphic<S1>::value &&  std::is_polymorphic<S2>::value &&  std::is_polymorphic<S3>::value,T&>::type { intptr_t vtbl[2] = {            vtbl_of(s2),vtbl_of(s3)}; return get(vtbl); }
-    template <typename S1, typename S2, typename S3> inline auto get(const S1* s1, const S2*   , const S3*   ) -> typename std::enable_if< std::is_polymorphic<S1>::value && !std::is_polymorphic<S2>::value && !std::is_polymorphic<S3>::value,T&>::type { intptr_t vtbl[1] = {vtbl_of(s1)                        }; return get(vtbl); }
-    template <typename S1, typename S2, typename S3> inline auto get(const S1* s1, const S2*   , const S3* s3) -> typename std::enable_if< std::is_polymorphic<S1>::value && !std::is_polymorphic<S2>::value &&  std::is_polymorphic<S3>::value,T&>::type { intptr_t vtbl[2] = {vtbl_of(s1),            vtbl_of(s3)}; return get(vtbl); }
-    template <typename S1, typename S2, typename S3> inline auto get(const S1* s1, const S2* s2, const S3*   ) -> typename std::enable_if< std::is_polymorphic<S1>::value &&  std::is_polymorphic<S2>::value && !std::is_polymorphic<S3>::value,T&>::type { intptr_t vtbl[2] = {vtbl_of(s1),vtbl_of(s2)            }; return get(vtbl); }
-    template <typename S1, typename S2, typename S3> inline auto get(const S1* s1, const S2* s2, const S3* s3) -> typename std::enable_if< std::is_polymorphic<S1>::value &&  std::is_polymorphic<S2>::value &&  std::is_polymorphic<S3>::value,T&>::type { intptr_t vtbl[3] = {vtbl_of(s1),vtbl_of(s2),vtbl_of(s3)}; return get(vtbl); }
-
-  //template <typename S1, typename S2, typename S3, typename S4> inline auto get(const S1* s1, const S2* s2, const S3* s3, const S4* s4) -> typename std::enable_if<!std::is_polymorphic<S1>::value && !std::is_polymorphic<S2>::value && !std::is_polymorphic<S3>::value && !std::is_polymorphic<S4>::value,T&>::type { static T dummy; return dummy; }
-    template <typename S1, typename S2, typename S3, typename S4> inline auto get(const S1*   , const S2*   , const S3*   , const S4* s4) -> typename std::enable_if<!std::is_polymorphic<S1>::value && !std::is_polymorphic<S2>::value && !std::is_polymorphic<S3>::value &&  std::is_polymorphic<S4>::value,T&>::type { intptr_t vtbl[1] = {                                    vtbl_of(s4)}; return get(vtbl); }
-    template <typename S1, typename S2, typename S3, typename S4> inline auto get(const S1*   , const S2*   , const S3* s3, const S4*   ) -> typename std::enable_if<!std::is_polymorphic<S1>::value && !std::is_polymorphic<S2>::value &&  std::is_polymorphic<S3>::value && !std::is_polymorphic<S4>::value,T&>::type { intptr_t vtbl[1] = {                        vtbl_of(s3)            }; return get(vtbl); }
-    template <typename S1, typename S2, typename S3, typename S4> inline auto get(const S1*   , const S2*   , const S3* s3, const S4* s4) -> typename std::enable_if<!std::is_polymorphic<S1>::value && !std::is_polymorphic<S2>::value &&  std::is_polymorphic<S3>::value &&  std::is_polymorphic<S4>::value,T&>::type { intptr_t vtbl[2] = {                        vtbl_of(s3),vtbl_of(s4)}; return get(vtbl); }
-    template <typename S1, typename S2, typename S3, typename S4> inline auto get(const S1*   , const S2* s2, const S3*   , const S4*   ) -> typename std::enable_if<!std::is_polymorphic<S1>::value &&  std::is_polymorphic<S2>::value && !std::is_polymorphic<S3>::value && !std::is_polymorphic<S4>::value,T&>::type { intptr_t vtbl[1] = {            vtbl_of(s2)                        }; return get(vtbl); }
-    template <typename S1, typename S2, typename S3, typename S4> inline auto get(const S1*   , const S2* s2, const S3*   , const S4* s4) -> typename std::enable_if<!std::is_polymorphic<S1>::value &&  std::is_polymorphic<S2>::value && !std::is_polymorphic<S3>::value &&  std::is_polymorphic<S4>::value,T&>::type { intptr_t vtbl[2] = {            vtbl_of(s2),            vtbl_of(s4)}; return get(vtbl); }
-    template <typename S1, typename S2, typename S3, typename S4> inline auto get(const S1*   , const S2* s2, const S3* s3, const S4*   ) -> typename std::enable_if<!std::is_polymorphic<S1>::value &&  std::is_polymorphic<S2>::value &&  std::is_polymorphic<S3>::value && !std::is_polymorphic<S4>::value,T&>::type { intptr_t vtbl[2] = {            vtbl_of(s2),vtbl_of(s3)            }; return get(vtbl); }
-    template <typename S1, typename S2, typename S3, typename S4> inline auto get(const S1*   , const S2* s2, const S3* s3, const S4* s4) -> typename std::enable_if<!std::is_polymorphic<S1>::value &&  std::is_polymorphic<S2>::value &&  std::is_polymorphic<S3>::value &&  std::is_polymorphic<S4>::value,T&>::type { intptr_t vtbl[3] = {            vtbl_of(s2),vtbl_of(s3),vtbl_of(s4)}; return get(vtbl); }
-    template <typename S1, typename S2, typename S3, typename S4> inline auto get(const S1* s1, const S2*   , const S3*   , const S4*   ) -> typename std::enable_if< std::is_polymorphic<S1>::value && !std::is_polymorphic<S2>::value && !std::is_polymorphic<S3>::value && !std::is_polymorphic<S4>::value,T&>::type { intptr_t vtbl[1] = {vtbl_of(s1)                                    }; return get(vtbl); }
-    template <typename S1, typename S2, typename S3, typename S4> inline auto get(const S1* s1, const S2*   , const S3*   , const S4* s4) -> typename std::enable_if< std::is_polymorphic<S1>::value && !std::is_polymorphic<S2>::value && !std::is_polymorphic<S3>::value &&  std::is_polymorphic<S4>::value,T&>::type { intptr_t vtbl[2] = {vtbl_of(s1),                        vtbl_of(s4)}; return get(vtbl); }
-    template <typename S1, typename S2, typename S3, typename S4> inline auto get(const S1* s1, const S2*   , const S3* s3, const S4*   ) -> typename std::enable_if< std::is_polymorphic<S1>::value && !std::is_polymorphic<S2>::value &&  std::is_polymorphic<S3>::value && !std::is_polymorphic<S4>::value,T&>::type { intptr_t vtbl[2] = {vtbl_of(s1),            vtbl_of(s3)            }; return get(vtbl); }
-    template <typename S1, typename S2, typename S3, typename S4> inline auto get(const S1* s1, const S2*   , const S3* s3, const S4* s4) -> typename std::enable_if< std::is_polymorphic<S1>::value && !std::is_polymorphic<S2>::value &&  std::is_polymorphic<S3>::value &&  std::is_polymorphic<S4>::value,T&>::type { intptr_t vtbl[3] = {vtbl_of(s1),            vtbl_of(s3),vtbl_of(s4)}; return get(vtbl); }
-    template <typename S1, typename S2, typename S3, typename S4> inline auto get(const S1* s1, const S2* s2, const S3*   , const S4*   ) -> typename std::enable_if< std::is_polymorphic<S1>::value &&  std::is_polymorphic<S2>::value && !std::is_polymorphic<S3>::value && !std::is_polymorphic<S4>::value,T&>::type { intptr_t vtbl[2] = {vtbl_of(s1),vtbl_of(s2)                        }; return get(vtbl); }
-    template <typename S1, typename S2, typename S3, typename S4> inline auto get(const S1* s1, const S2* s2, const S3*   , const S4* s4) -> typename std::enable_if< std::is_polymorphic<S1>::value &&  std::is_polymorphic<S2>::value && !std::is_polymorphic<S3>::value &&  std::is_polymorphic<S4>::value,T&>::type { intptr_t vtbl[3] = {vtbl_of(s1),vtbl_of(s2),            vtbl_of(s4)}; return get(vtbl); }
-    template <typename S1, typename S2, typename S3, typename S4> inline auto get(const S1* s1, const S2* s2, const S3* s3, const S4*   ) -> typename std::enable_if< std::is_polymorphic<S1>::value &&  std::is_polymorphic<S2>::value &&  std::is_polymorphic<S3>::value && !std::is_polymorphic<S4>::value,T&>::type { intptr_t vtbl[3] = {vtbl_of(s1),vtbl_of(s2),vtbl_of(s3)            }; return get(vtbl); }
-    template <typename S1, typename S2, typename S3, typename S4> inline auto get(const S1* s1, const S2* s2, const S3* s3, const S4* s4) -> typename std::enable_if< std::is_polymorphic<S1>::value &&  std::is_polymorphic<S2>::value &&  std::is_polymorphic<S3>::value &&  std::is_polymorphic<S4>::value,T&>::type { intptr_t vtbl[4] = {vtbl_of(s1),vtbl_of(s2),vtbl_of(s3),vtbl_of(s4)}; return get(vtbl); }
+    template <typename... S>
+    inline auto xtl_get(const S*... s) noexcept -> typename std::enable_if<count_if<xtl::is_poly_morphic,S...>::value == N, T&>::type
+    {
+        intptr_t vtbl[N];
+        store_vtbls<xtl::is_poly_morphic>(vtbl, s...);
+        return get(vtbl);
+    }
+    ///@}
 
     /// A function that gets called when the cache is either too inefficient or full.
     T& update(const intptr_t (&vtbl)[N]);
 
+    /// Removes the entries of tuples with any vtbl-pointer in [lo,hi) and 
+    /// returns their number \see vtblmodules.hpp
+    size_t purge(intptr_t lo, intptr_t hi);
+
 #if XTL_DUMP_PERFORMANCE
     std::ostream& operator>>(std::ostream& os) const;
     friend std::ostream& operator<<(std::ostream& os, const vtbl_map& m) { return m >> os; }
+
+    /// Writes statistics and layout of the map as a single-line JSON object
+    std::ostream& write_json(std::ostream& os) const;
+
+    /// Writes statistics and layout of the map as CSV rows, one per key
+    std::ostream& write_csv(std::ostream& os) const;
+
+    /// Dumps the map in the format selected by #XTL_DUMP_PERFORMANCE_FORMAT
+    std::ostream& dump(std::ostream& os) const;
 #endif
 
 private:
 
+    /// Parameters of the cache that define where each tuple of vtbls goes
+    struct layout
+    {
+        bit_offset_t log_size;  ///< Log of the size of the cache
+        bit_offset_t shifts[N]; ///< Irrelevant bits removed from each vtbl
+        H            hash;      ///< Hash function applied to shifted vtbls
+    };
+
+    /// Searches for the layout mapping vtbl and the tuples in d onto the most
+    /// entries. Only reads d and the constant members, so maintenance can run
+    /// it on a snapshot of the cache while the map is in use.
+    layout best_layout(const cache_descriptor& d, const intptr_t (&vtbl)[N]) const;
+
+    /// Switches the cache to layout l, unless it is the current one, making 
+    /// sure there is room for vtbl, whose value it returns.
+    T& relayout(const layout& l, const intptr_t (&vtbl)[N]);
+
+#if XTL_DEFERRED_VTBL_UPDATE
+    layout current_layout() const
+    {
+        layout l;
+        l.log_size = bit_offset_t(req_bits(descriptor->cache_mask));
+        l.hash     = descriptor->hash;
+        array_copy(descriptor->optimal_shift,l.shifts);
+        return l;
+    }
+
+    /// Copy of vtbls and frequencies of the tuples in d, without their values
+    static cache_descriptor* keys_of(const cache_descriptor& d)
+    {
+        const size_t log_size = req_bits(d.cache_mask);
+        #if defined(DBG_NEW)
+            #undef new
+        #endif
+        cache_descriptor* copy = new(log_size) cache_descriptor(log_size, irrelevant_bits, d.hash);
+        #if defined(DBG_NEW)
+            #define new DBG_NEW
+        #endif
+        array_copy(d.optimal_shift,copy->optimal_shift);
+        copy->used = d.used;
+
+        for (size_t i = 0; i <= d.cache_mask; ++i)
+        {
+            *copy->cache[i] = d.cache[i]->vtbl;
+            XTL_USE_VTBL_FREQUENCY_ONLY(copy->cache[i]->hits = d.cache[i]->hits;)
+        }
+
+        return copy;
+    }
+
+    /// Queues a search for a better layout unless one is already under way
+    void request_update(const intptr_t (&vtbl)[N])
+    {
+        if (!maintenance.idle() || maintenance.request([this,&vtbl]() { maintenance.snapshot = keys_of(*descriptor); array_copy(vtbl,maintenance.vtbl); }))
+            collisions_before_update = prev_collisions_before_update;
+        else
+            collisions_before_update = 1; // Maintenance was busy, try again on next collision
+    }
+
+    /// Switches to the layout found by maintenance
+    T& adopt_layout(const intptr_t (&vtbl)[N])
+    {
+        const layout l = maintenance.result;
+        maintenance.done();
+        return relayout(l,vtbl);
+    }
+
+    /// Search for a better layout of this map run by maintenance
+    struct deferred_update : vtbl_map_maintenance
+    {
+        explicit deferred_update(const vtbl_map& m) : map(m), snapshot(nullptr) {}
+
+        void run()
+        {
+            result = map.best_layout(*snapshot,vtbl);
+            delete snapshot;
+            snapshot = nullptr;
+        }
+
+        const vtbl_map&   map;
+        cache_descriptor* snapshot; ///< Tuples in the cache when the update was requested
+        intptr_t          vtbl[N];  ///< Tuple whose lookup requested the update
+        layout            result;   ///< Layout found by maintenance
+    };
+#endif
+
     /// Cached mappings of vtbl to some indecies
     cache_descriptor* descriptor;
 
-    /// A reference to a global variable that will be initialized with the 
-    /// number of case clauses of a given match statement
-    const vtbl_count_t& case_clauses;
+    /// Number of case clauses of a given match statement or 0 when not known
+    const vtbl_count_t case_clauses;
 
     /// Memoized table.size() during last cache rearranging
     size_t last_table_size;
@@ -636,14 +804,30 @@ private:
     /// Previous number of colisions that we will still tolerate before next update
     int prev_collisions_before_update;
 
-#if XTL_DUMP_PERFORMANCE
-    const char* file;      ///< File in which this vtblmap_of is instantiated
-    size_t      line;      ///< Line in the file where it is instantiated
-    const char* func;      ///< Function in which this vtblmap_of is instantiated
-    size_t      updates;   ///< Amount of reconfigurations performed at run time
-    size_t      hits;      ///< The number of cache hits
-    size_t      misses;    ///< The number of cache misses
-    size_t      collisions;///< Out of all the misses, how many were actual collisions
+    /// Hits, misses, collisions and updates of this map along with its location
+    vtbl_map_statistics statistics;
+
+#if XTL_USE_VTBL_FREQUENCY
+    /// Picks the lookups that count towards frequency of entries
+    vtbl_frequency_sampler sampler;
+#endif
+
+#if XTL_DEFERRED_VTBL_UPDATE
+    /// Our request for a better layout
+    deferred_update maintenance;
+#endif
+
+#if XTL_VTBL_INVALIDATION
+    /// Registration of this map for purging vtbls of unloaded modules
+    struct invalidation_hook : vtbl_map_invalidation
+    {
+        explicit invalidation_hook(vtbl_map& m) : map(m) {}
+        size_t purge(intptr_t lo, intptr_t hi) { return map.purge(lo,hi); }
+        vtbl_map& map;
+    };
+
+    /// Declared last to be unregistered before the rest of the map is destroyed
+    invalidation_hook invalidation;
 #endif
 
 };
@@ -651,28 +835,32 @@ private:
 //------------------------------------------------------------------------------
 
 /// This specialization is used when none of the arguments of Match-statement is polymorphic.
-template <typename T>
-class vtbl_map<0,T>
+template <typename T, typename H>
+class vtbl_map<0,T,H>
 {
 public:
-    vtbl_map(XTL_DUMP_PERFORMANCE_ONLY(const char*, size_t, const char*,) const vtbl_count_t&) {}
+    template <typename... A> explicit vtbl_map(const A&...) noexcept {} ///< Accepts arguments of any constructor of the general case
     inline T& get(...) noexcept { return dummy; }
     static T dummy; 
 };
 
-template <typename T> T vtbl_map<0,T>::dummy;
+template <typename T, typename H> T vtbl_map<0,T,H>::dummy;
 
 //------------------------------------------------------------------------------
 
-template <size_t N, typename T>
-vtbl_map<N,T>::cache_descriptor::cache_descriptor(
+template <size_t N, typename T, typename H>
+vtbl_map<N,T,H>::cache_descriptor::cache_descriptor(
     const size_t       log_size, ///< Parameter k of the cache - the log of the size of the cache
-    const bit_offset_t shift     ///< Parameter l of the cache - number of irrelevant bits on the right to remove
+    const bit_offset_t shift,    ///< Parameter l of the cache - number of irrelevant bits on the right to remove
+    const H&           h         ///< Hash function to use
 ) :
     cache_mask( (1<<log_size) - 1 ),
     //optimal_shift(shift),
-    used(0)
+    used(0),
+    hash(h)
 {
+    H::prepare(); // Hash function has to be ready before we compute any cache index
+
     // Initialize all optimal_shift values with the same value
     std::fill(&optimal_shift[0],&optimal_shift[N],shift);
 
@@ -692,10 +880,11 @@ vtbl_map<N,T>::cache_descriptor::cache_descriptor(
 
 //------------------------------------------------------------------------------
 
-template <size_t N, typename T>
-vtbl_map<N,T>::cache_descriptor::cache_descriptor(
+template <size_t N, typename T, typename H>
+vtbl_map<N,T,H>::cache_descriptor::cache_descriptor(
     const size_t       log_size,    ///< Parameter k of the cache - the log of the size of the cache                
     const bit_offset_t (&shifts)[N],///< Parameter l of the cache - number of irrelevant bits on the right to remove
+    const H&           h,           ///< Hash function to use
 #if defined(XTL_NO_RVALREF)
     cache_descriptor&  old          ///< cache_descriptor we will supposedly replace
 #else
@@ -703,12 +892,19 @@ vtbl_map<N,T>::cache_descriptor::cache_descriptor(
 #endif
 ) :
     cache_mask( (1<<log_size) - 1 ),
-    used(old.used)
+    used(old.used),
+    hash(h)
 {
     XTL_ASSERT(cache_mask >= old.cache_mask); // Since we are going to inherit all its existing elements
 
     array_copy(shifts,optimal_shift);         // Initialize optimal shifts
 
+#if XTL_USE_VTBL_FREQUENCY
+    // Hotter entries are placed first to take the entries they map to, while 
+    // colder ones colliding with them will have to look for other places
+    std::stable_sort(&old.cache[0], &old.cache[old.cache_mask+1], [](const stored_type* a, const stored_type* b) { return a->hits > b->hits; });
+#endif
+
     // We'll be initializing cache pointers out of order for performance reasons
     // so zero them out first to see which ones we have alredy initialized
     for (size_t i = 0; i <= cache_mask; ++i) cache[i] = 0;
@@ -771,8 +967,8 @@ vtbl_map<N,T>::cache_descriptor::cache_descriptor(
 
 //------------------------------------------------------------------------------
 
-template <size_t N, typename T>
-vtbl_map<N,T>::cache_descriptor::~cache_descriptor()
+template <size_t N, typename T, typename H>
+vtbl_map<N,T,H>::cache_descriptor::~cache_descriptor()
 {
     // The elements will be pointing into separate arrays, we want to
     // find all the beginnings of arrays to deallocate them
@@ -794,8 +990,8 @@ vtbl_map<N,T>::cache_descriptor::~cache_descriptor()
 
 //------------------------------------------------------------------------------
 
-template <size_t N, typename T>
-void vtbl_map<N,T>::cache_descriptor::put_entries_in_right_place()
+template <size_t N, typename T, typename H>
+void vtbl_map<N,T,H>::cache_descriptor::put_entries_in_right_place()
 {
     for (size_t i = 0; i <= cache_mask; ++i)
     {
@@ -853,8 +1049,8 @@ next:   ;
 
 //------------------------------------------------------------------------------
 
-template <size_t N, typename T>
-auto vtbl_map<N,T>::cache_descriptor::get(const intptr_t (&vtbl)[N], size_t j) noexcept -> stored_type*
+template <size_t N, typename T, typename H>
+auto vtbl_map<N,T,H>::cache_descriptor::get(const intptr_t (&vtbl)[N], size_t j) noexcept -> stored_type*
 {
     XTL_ASSERT(j == cache_index(vtbl)); // j must be index of location where vtbl should be
     stored_type*& ce = cache[j]; // Location where it should be
@@ -884,14 +1080,12 @@ auto vtbl_map<N,T>::cache_descriptor::get(const intptr_t (&vtbl)[N], size_t j) n
                 XTL_ASSERT(cache[j]->vtbl[N-1] == 0); // Either all 0 or all non 0
                 *cache[j] = vtbl; //array_copy(vtbl,cache[i]->vtbl);
                 ++used;
-                std::swap(ce,cache[j]); // swap it with the right position
-                return ce;
+                return promote(ce,cache[j]); // swap it with the right position
             }
             else
             if (XTL_UNLIKELY(cache[j]->is_for(vtbl XTL_VTBL_HASHING(,vtbl_hash)))) // if so ...
             {
-                std::swap(ce,cache[j]); // swap it with the right position
-                return ce;
+                return promote(ce,cache[j]); // swap it with the right position
             }
 
             j = lcg_next(j);
@@ -902,15 +1096,13 @@ auto vtbl_map<N,T>::cache_descriptor::get(const intptr_t (&vtbl)[N], size_t j) n
         for (size_t i = j; i <= cache_mask; ++i)
             if (XTL_UNLIKELY(cache[i]->is_for(vtbl XTL_VTBL_HASHING(,vtbl_hash)))) // if so ...
             {
-                std::swap(ce,cache[i]); // swap it with the right position
-                return ce;
+                return promote(ce,cache[i]); // swap it with the right position
             }
         // If not found, continue from the beginning until j
         for (size_t i = 0; i < j; ++i)
             if (XTL_UNLIKELY(cache[i]->is_for(vtbl XTL_VTBL_HASHING(,vtbl_hash)))) // if so ...
             {
-                std::swap(ce,cache[i]); // swap it with the right position
-                return ce;
+                return promote(ce,cache[i]); // swap it with the right position
             }
 #endif
     }
@@ -928,8 +1120,7 @@ auto vtbl_map<N,T>::cache_descriptor::get(const intptr_t (&vtbl)[N], size_t j) n
                 XTL_ASSERT(cache[i]->vtbl[N-1] == 0); // Either all 0 or all non 0
                 *cache[i] = vtbl; //array_copy(vtbl,cache[i]->vtbl);
                 ++used;
-                std::swap(ce,cache[i]); // swap it with the right position
-                return ce;
+                return promote(ce,cache[i]); // swap it with the right position
             }
         // If not found, continue from the beginning until j
         for (size_t i = 0; i < j; ++i)
@@ -938,8 +1129,7 @@ auto vtbl_map<N,T>::cache_descriptor::get(const intptr_t (&vtbl)[N], size_t j) n
                 XTL_ASSERT(cache[i]->vtbl[N-1] == 0); // Either all 0 or all non 0
                 *cache[i] = vtbl; //array_copy(vtbl,cache[i]->vtbl);
                 ++used;
-                std::swap(ce,cache[i]); // swap it with the right position
-                return ce;
+                return promote(ce,cache[i]); // swap it with the right position
             }
 #endif
     }
@@ -950,8 +1140,8 @@ auto vtbl_map<N,T>::cache_descriptor::get(const intptr_t (&vtbl)[N], size_t j) n
 
 //------------------------------------------------------------------------------
 
-template <size_t N, typename T>
-size_t vtbl_map<N,T>::cache_descriptor::entries_for(const intptr_t (&vtbl)[N], size_t log_size, const bit_offset_t (&offsets)[N]) const
+template <size_t N, typename T, typename H>
+size_t vtbl_map<N,T,H>::cache_descriptor::entries_for(const intptr_t (&vtbl)[N], size_t log_size, const bit_offset_t (&offsets)[N], const H& h XTL_USE_VTBL_FREQUENCY_ONLY(, size_t& weight)) const
 {
     // NOTE: This function should not be inlined because of the use of VLA or 
     //       alloca. Some compilers have been reported to have errors inlining 
@@ -966,17 +1156,19 @@ size_t vtbl_map<N,T>::cache_descriptor::entries_for(const intptr_t (&vtbl)[N], s
     const intptr_t max_stack_mask       = (1<<(max_stack_log_size+3))-1; // Mask for the largest number of bits we are allowed to allocate on stack: +3 is *8 for the number of bits in the allowed stack size
     const size_t   cache_histogram_size = 1 + std::min(new_cache_mask,max_stack_mask)/XTL_BIT_SIZE(intptr_t); // Number of elements in intptr_t array allocated on the stack
     XTL_VLAZ(cache_histogram, intptr_t, cache_histogram_size, 1 + max_stack_mask/XTL_BIT_SIZE(intptr_t)); // Declares intptr_t cache_histogram[cache_histogram_size] = {0};
-    XTL_BIT_SET(cache_histogram, cache_index(vtbl,offsets,new_cache_mask) & max_stack_mask); // Mark the entry for new vtbl
+    XTL_BIT_SET(cache_histogram, cache_index(vtbl,offsets,new_cache_mask,h) & max_stack_mask); // Mark the entry for new vtbl
+
+    const size_t stride = sample_stride();
 
     // Iterate over vtbl in old cache and see where they are mapped with log size i and offset j
-    for (size_t c = 0; c <= this->cache_mask; ++c)
+    for (size_t c = 0; c <= this->cache_mask; c += stride)
     {
         stored_type* const st = cache[c];
 
         XTL_ASSERT(st);
 
         if (st->occupied())
-            XTL_BIT_SET(cache_histogram, cache_index(st->vtbl,offsets,new_cache_mask) & max_stack_mask); // Mark the entry for each vtbl
+            XTL_BIT_SET(cache_histogram, cache_index(st->vtbl,offsets,new_cache_mask,h) & max_stack_mask); // Mark the entry for each vtbl
     }
 
     size_t entries = 0;
@@ -985,17 +1177,96 @@ size_t vtbl_map<N,T>::cache_descriptor::entries_for(const intptr_t (&vtbl)[N], s
     for (size_t h = 0; h < cache_histogram_size; ++h)
         entries += bits_set(cache_histogram[h]);
 
+#if XTL_USE_VTBL_FREQUENCY
+    // Weight of the hottest tuple mapped into each entry, wrapping over just 
+    // like the histogram above but on fewer entries since each takes a word.
+    const intptr_t max_weight_mask = std::min(new_cache_mask,intptr_t((1<<max_stack_log_size)/sizeof(size_t))-1);
+    const size_t   cache_weights_size = size_t(max_weight_mask)+1;
+    XTL_VLAZ(cache_weights, size_t, cache_weights_size, (1<<max_stack_log_size)/sizeof(size_t)); // Declares size_t cache_weights[cache_weights_size] = {0};
+    cache_weights[cache_index(vtbl,offsets,new_cache_mask,h) & max_weight_mask] = 1; // The new tuple has not been seen yet
+
+    for (size_t c = 0; c <= this->cache_mask; c += stride)
+        if (cache[c]->occupied())
+        {
+            size_t& w = cache_weights[cache_index(cache[c]->vtbl,offsets,new_cache_mask,h) & max_weight_mask];
+            w = std::max(w, cache[c]->hits + 1);
+        }
+
+    weight = 0;
+
+    for (intptr_t e = 0; e <= max_weight_mask; ++e)
+        weight += cache_weights[e];
+#endif
+
     return entries;
 }
 
 //------------------------------------------------------------------------------
 
-template <size_t N, typename T>
-T& vtbl_map<N,T>::update(const intptr_t (&vtbl)[N])
+template <size_t N, typename T, typename H>
+T& vtbl_map<N,T,H>::update(const intptr_t (&vtbl)[N])
 {
     XTL_ASSERT(descriptor); // Allocated in constructor, deallocated in destructor
     XTL_ASSERT(last_table_size < descriptor->used || descriptor->is_full()); // We will only call this if size changed
 
+    return relayout(best_layout(*descriptor,vtbl),vtbl);
+}
+
+//------------------------------------------------------------------------------
+
+template <size_t N, typename T, typename H>
+size_t vtbl_map<N,T,H>::purge(intptr_t lo, intptr_t hi)
+{
+    XTL_ASSERT(descriptor); // Allocated in constructor, deallocated in destructor
+
+    size_t removed = 0;
+
+    for (size_t i = 0; i <= descriptor->cache_mask; ++i)
+    {
+        typename cache_descriptor::stored_type* const st = descriptor->cache[i];
+
+        if (st->occupied())
+            for (size_t s = 0; s < N; ++s)
+                if (lo <= st->vtbl[s] && st->vtbl[s] < hi)
+                {
+                    st->destroy();
+                    st->construct();
+                    ++removed;
+                    break;
+                }
+    }
+
+    if (removed)
+    {
+        // Vacated entries may have been on the LCG walk of other tuples, so we
+        // place the remaining ones again with the same layout
+        const size_t log_size = req_bits(descriptor->cache_mask);
+        descriptor->used -= removed;
+        #if defined(DBG_NEW)
+            #undef new
+        #endif
+        cache_descriptor* const old = descriptor;
+        #if defined(XTL_NO_RVALREF)
+            descriptor = new(log_size) cache_descriptor(log_size, old->optimal_shift, old->hash, *old);
+        #else
+            descriptor = new(log_size) cache_descriptor(log_size, old->optimal_shift, old->hash, std::move(*old));
+        #endif
+        #if defined(DBG_NEW)
+            #define new DBG_NEW
+        #endif
+        delete old;
+        last_table_size = descriptor->used;
+        statistics.known(descriptor->used);
+    }
+
+    return removed;
+}
+
+//------------------------------------------------------------------------------
+
+template <size_t N, typename T, typename H>
+auto vtbl_map<N,T,H>::best_layout(const cache_descriptor& d, const intptr_t (&vtbl)[N]) const -> layout
+{
     // FIX: vtbl might already exist in old descriptor and if it happens to be the first one, it won't be taken into consideration
     intptr_t prev[N];
     intptr_t diff[N] = {};
@@ -1003,9 +1274,9 @@ T& vtbl_map<N,T>::update(const intptr_t (&vtbl)[N])
     array_copy(vtbl,prev);
 
     // Compute bits in which existing vtbl, including the newly added one, differ
-    for (size_t i = 0; i <= descriptor->cache_mask; ++i)
+    for (size_t i = 0; i <= d.cache_mask; ++i)
     {
-        typename cache_descriptor::stored_type* const st = descriptor->cache[i];
+        typename cache_descriptor::stored_type* const st = d.cache[i];
 
         XTL_ASSERT(st);
 
@@ -1020,17 +1291,15 @@ T& vtbl_map<N,T>::update(const intptr_t (&vtbl)[N])
 //#if XTL_DUMP_PERFORMANCE
 //        std::clog << "\nVtbl:New";
 //        vtbl_bin_print(vtbl,std::clog); // Show binary value of vtbl pointer
-//        std::clog << " -> " << descriptor->cache_index(vtbl) << '\t';
+//        std::clog << " -> " << d.cache_index(vtbl) << '\t';
 //        vtbl_class_print(vtbl,std::clog); // Show name of the class of this vtbl
 //        std::clog << std::endl;
 //        *this >> std::clog;       
 //#endif
 
-    XTL_DUMP_PERFORMANCE_ONLY(++updates); // Record update
-
-    bit_offset_t k  = bit_offset_t(req_bits(descriptor->cache_mask));     // current log_size
-    bit_offset_t n  = bit_offset_t(req_bits(descriptor->used));           // needed  log_size
-    bit_offset_t c  = bit_offset_t(req_bits(case_clauses));               // log_size estimate. NOTE: case_clauses will be initialized by now
+    bit_offset_t k  = bit_offset_t(req_bits(d.cache_mask));     // current log_size
+    bit_offset_t n  = bit_offset_t(req_bits(d.used));           // needed  log_size
+    bit_offset_t c  = bit_offset_t(req_bits(case_clauses));               // log_size estimate
     bit_offset_t l1 = std::max(std::max(k,c),n);                          // lower bound for log_size iteration
     bit_offset_t l2 = std::max(std::max(k,c),bit_offset_t(n+max_log_inc));// upper bound for log_size iteration
     bit_offset_t no = l1; // current estimate of the best log_size
@@ -1046,7 +1315,7 @@ T& vtbl_map<N,T>::update(const intptr_t (&vtbl)[N])
             z[i] = bit_offset_t(trailing_zeros(static_cast<unsigned int>(diff[i]))); // lowest bits in which vtbls do not differ. 
         }
         else
-            m[i] = z[i] = descriptor->optimal_shift[i];
+            m[i] = z[i] = d.optimal_shift[i];
 
         zo[i] = z[i]; // current estimate of the best offset
     }
@@ -1057,6 +1326,9 @@ T& vtbl_map<N,T>::update(const intptr_t (&vtbl)[N])
     //std::copy(&m[0],&m[N],std::ostream_iterator<bit_offset_t>(std::clog,","));
     //std::clog << std::endl;
 
+    H hash = d.hash; // Hash function to use from now on
+    const size_t perfect = d.sampled_used()+1; // Number of entries when sampled vtbls do not collide
+
 #if 0
     size_t max_cache_entries = 0;
 
@@ -1080,7 +1352,7 @@ T& vtbl_map<N,T>::update(const intptr_t (&vtbl)[N])
         // Iterate over possible offsets
         do
         {
-            size_t entries = descriptor->entries_for(vtbl, i, j); // Count the number of used entries
+            size_t entries = d.entries_for(vtbl, i, j, hash); // Count the number of used entries
 
             //std::clog << "Trying size: " << i << " offset ";
             //std::copy(&x[0],&x[N],std::ostream_iterator<bit_offset_t>(std::clog,","));
@@ -1093,7 +1365,7 @@ T& vtbl_map<N,T>::update(const intptr_t (&vtbl)[N])
                 no = i;
                 array_copy(j,zo);
 
-                if (entries == descriptor->used+1)
+                if (entries == perfect)
                 {
                     // We found size and offset without conflicts, exit both loops
                     i = l2+1; // to exit both for loops
@@ -1115,69 +1387,121 @@ T& vtbl_map<N,T>::update(const intptr_t (&vtbl)[N])
 
 #else
 
-    size_t max_cache_entries = descriptor->entries_for(vtbl, l1, descriptor->optimal_shift);
-    array_copy(descriptor->optimal_shift,zo); // Copy current solution as current optimal
-    no = l1;
-
-    // Iterate over allowed log sizes
-    for (bit_offset_t i = l1; i <= l2; ++i)
+    size_t max_cache_entries = 0;
+    size_t max_cache_score   = 0;
+
+    // Layouts are compared by score: the number of different entries vtbls are
+    // mapped to or, with XTL_USE_VTBL_FREQUENCY, the weight of those entries,
+    // which favors layouts where the hottest vtbls do not collide.
+    XTL_USE_VTBL_FREQUENCY_ONLY(size_t weight = 0;)
+
+    // When the hashing policy can switch between several hash functions, we 
+    // repeat the search for each of them and keep the one that maps the vtbls
+    // seen so far onto the largest number of different entries, i.e. has the
+    // fewest collisions on them. Ties go to the earlier, cheaper one.
+    for (int v = 0; v < H::variants; ++v)
     {
-//        size_t saved_max_cache_entries = 0;
-
-        // We iterate until we can make improvements to the number of used cache entries
-//        while (max_cache_entries > saved_max_cache_entries)
+        const H      h = H::variants > 1 ? H(v) : d.hash;
+        bit_offset_t nv = l1; // current estimate of the best log_size for h
+        bit_offset_t zv[N];   // current estimate of the best offset for h
+        size_t max_entries_v = d.entries_for(vtbl, l1, d.optimal_shift, h XTL_USE_VTBL_FREQUENCY_ONLY(, weight));
+        size_t max_score_v   = XTL_IF(XTL_USE_VTBL_FREQUENCY, weight, max_entries_v);
+        array_copy(d.optimal_shift,zv); // Copy current solution as current optimal
+
+        // Iterate over allowed log sizes
+        for (bit_offset_t i = l1; i <= l2; ++i)
         {
-//            saved_max_cache_entries = max_cache_entries;
+//            size_t saved_max_entries_v = 0;
 
-            // Try to improve independently each argument position
-            for (size_t s = 0; s < N; ++s) 
+            // We iterate until we can make improvements to the number of used cache entries
+//            while (max_entries_v > saved_max_entries_v)
             {
-                bit_offset_t bits_in_arg_mask = (i+N-1-s)/N;
-                bit_offset_t mm = m[s] > bits_in_arg_mask && m[s] - bits_in_arg_mask >= z[s] ? m[s] - bits_in_arg_mask : m[s];
-                bit_offset_t cur = zo[s];
-
-                //XTL_ASSERT(z[s] <= cur && cur <= mm);
+//                saved_max_entries_v = max_entries_v;
 
-                for (bit_offset_t t = z[s]; t <= mm; ++t)
+                // Try to improve independently each argument position
+                for (size_t s = 0; s < N; ++s) 
                 {
-                    if (t != cur)
-                    {
-                        zo[s] = t;
+                    bit_offset_t bits_in_arg_mask = (i+N-1-s)/N;
+                    bit_offset_t mm = m[s] > bits_in_arg_mask && m[s] - bits_in_arg_mask >= z[s] ? m[s] - bits_in_arg_mask : m[s];
+                    bit_offset_t cur = zv[s];
 
-                        size_t entries = descriptor->entries_for(vtbl, i, zo); // Count the number of used entries
+                    //XTL_ASSERT(z[s] <= cur && cur <= mm);
 
-                        // Update best estimates
-                        if (entries > max_cache_entries)
+                    for (bit_offset_t t = z[s]; t <= mm; ++t)
+                    {
+                        if (t != cur)
                         {
-                            max_cache_entries = entries;
-                            no  = i;
-                            cur = t;
+                            zv[s] = t;
 
-                            if (entries == descriptor->used+1)
+                            size_t entries = d.entries_for(vtbl, i, zv, h XTL_USE_VTBL_FREQUENCY_ONLY(, weight)); // Count the number of used entries
+                            size_t score   = XTL_IF(XTL_USE_VTBL_FREQUENCY, weight, entries);
+
+                            // Update best estimates
+                            if (score > max_score_v)
                             {
-                                // We found size and offset without conflicts, exit both loops
-                                i = l2+1; // to exit both for loops
-                                zo[s] = cur;
-                                goto break_of_both_loops;
+                                max_entries_v = entries;
+                                max_score_v   = score;
+                                nv  = i;
+                                cur = t;
+
+                                if (entries == perfect)
+                                {
+                                    // We found size and offset without conflicts, exit both loops
+                                    i = l2+1; // to exit both for loops
+                                    zv[s] = cur;
+                                    goto break_of_both_loops;
+                                }
                             }
                         }
                     }
-                }
 
-                zo[s] = cur;
-            } // of loop over argument positions
+                    zv[s] = cur;
+                } // of loop over argument positions
 
 break_of_both_loops: ;
 
-        } // of while there are improvements
-    } // of loop over possible log sizes
+            } // of while there are improvements
+        } // of loop over possible log sizes
+
+        if (max_score_v > max_cache_score)
+        {
+            max_cache_entries = max_entries_v;
+            max_cache_score   = max_score_v;
+            no   = nv;
+            hash = h;
+            array_copy(zv,zo);
+
+            if (max_cache_entries == perfect)
+                break; // No collisions, while the remaining hash functions are costlier
+        }
+    } // of loop over hash functions
 #endif
+    layout result;
+    result.log_size = no;
+    result.hash     = hash;
+    array_copy(zo,result.shifts);
+    return result;
+}
+
+//------------------------------------------------------------------------------
+
+template <size_t N, typename T, typename H>
+T& vtbl_map<N,T,H>::relayout(const layout& l, const intptr_t (&vtbl)[N])
+{
+    XTL_ASSERT(descriptor); // Allocated in constructor, deallocated in destructor
+
+    bit_offset_t k  = bit_offset_t(req_bits(descriptor->cache_mask)); // current log_size
+    bit_offset_t no = l.log_size;
+
     if (no < k)
         no = k; // We never shrink, while we preallocate based on number of case clauses or the minimum
 
-    if (no != k || !array_equal(descriptor->optimal_shift,zo))
+    if (no == k && descriptor->is_full())
+        no = k+1; // The layout was found for fewer vtbls than there are now, while we need room for vtbl
+
+    if (no != k || !array_equal(descriptor->optimal_shift,l.shifts) || !(l.hash == descriptor->hash))
     {
-        // OK, either log size or optimal shifts changed. Reset collisions counter to default one
+        // OK, either log size, optimal shifts or hash function changed. Reset collisions counter to default one
         // Having fixed initial collision count may be counterproductive for small type switches.
         // We thus make this number proportional to the number of case clauses to somewhat estimate
         // after how many collisions an update may be useful.
@@ -1188,9 +1512,9 @@ break_of_both_loops: ;
             #undef new
         #endif
         #if defined(XTL_NO_RVALREF)
-            descriptor = new(no) cache_descriptor(no,zo,*old);
+            descriptor = new(no) cache_descriptor(no,l.shifts,l.hash,*old);
         #else
-            descriptor = new(no) cache_descriptor(no,zo,std::move(*old));
+            descriptor = new(no) cache_descriptor(no,l.shifts,l.hash,std::move(*old));
         #endif
         #if defined(DBG_NEW)
             #define new DBG_NEW
@@ -1203,6 +1527,12 @@ break_of_both_loops: ;
         prev_collisions_before_update = collisions_before_update = prev_collisions_before_update*2;
     }
 
+#if XTL_USE_VTBL_FREQUENCY
+    // Age the frequencies, so that the next update favors recently hot vtbls
+    for (size_t i = 0; i <= descriptor->cache_mask; ++i)
+        descriptor->cache[i]->hits /= 2;
+#endif
+
 //#if XTL_DUMP_PERFORMANCE
 //        std::clog << "After" << std::endl;
 //        *this >> std::clog;       
@@ -1213,18 +1543,21 @@ break_of_both_loops: ;
     typename cache_descriptor::stored_type* res = descriptor->get(vtbl);
     XTL_ASSERT(res && res->is_for(vtbl)); // We have ensured enough space, so no need to check this explicitly
     last_table_size = descriptor->used;   // Update memoized value
+    statistics.layout(descriptor->used, req_bits(descriptor->cache_mask), memory_used()); // Record update
     return res->value;
 }
 
 //------------------------------------------------------------------------------
 
 #if XTL_DUMP_PERFORMANCE
-template <size_t N, typename T>
-std::ostream& vtbl_map<N,T>::operator>>(std::ostream& os) const
+template <size_t N, typename T, typename H>
+std::ostream& vtbl_map<N,T,H>::operator>>(std::ostream& os) const
 {
     std::ios::fmtflags fmt = os.flags(); // store flags
 
-    os << file << '[' << line << ']' << ' ' << func << std::endl;
+    const vtbl_map_stats stats = statistics.snapshot();
+
+    os << stats.file << '[' << stats.line << ']' << ' ' << stats.func << std::endl;
 
     size_t vtbl_count = descriptor->used;
     size_t log_size   = req_bits(descriptor->cache_mask);
@@ -1258,7 +1591,7 @@ std::ostream& vtbl_map<N,T>::operator>>(std::ostream& os) const
                 prev[s] = vtbl;
             }
 
-            cache_histogram[cache_descriptor::cache_index(to_array(a),descriptor->optimal_shift,descriptor->cache_mask)]++;
+            cache_histogram[cache_descriptor::cache_index(to_array(a),descriptor->optimal_shift,descriptor->cache_mask,descriptor->hash)]++;
             XTL_ASSERT(size_t(q-vtbls.begin()) < vtbl_count); // Since we preallocated only that much
             *q++ = a;
         }
@@ -1315,12 +1648,12 @@ std::ostream& vtbl_map<N,T>::operator>>(std::ostream& os) const
         << " clauses="    << std::setw(4) << case_clauses // Number of case clauses in the match statement
         << " total="      << std::setw(5) << vtbl_count   // Total number of vtbl pointers seen
         << " log_size="   << std::setw(2) << log_size     // log2 size required
-        << " updates="    << std::setw(2) << updates      // how many updates have been performed on the cache
-        << " hits="       << std::setw(8) << hits         // how many hits have we had
-        << " misses="     << std::setw(8) << misses       // how many misses have we had
-        << " collisions=" << std::setw(8) << collisions   // how many misses were actual collisions
-        << " memory="     << std::setw(8) << memory_used()// number of bytes used
-        << " Stmt: "      << file << '[' << line << ']' << ' ' << func
+        << " updates="    << std::setw(2) << stats.updates   // how many updates have been performed on the cache
+        << " hits="       << std::setw(8) << stats.hits      // how many hits have we had
+        << " misses="     << std::setw(8) << stats.misses    // how many misses have we had
+        << " collisions=" << std::setw(8) << stats.collisions// how many misses were actual collisions
+        << " memory="     << std::setw(8) << memory_used()   // number of bytes used
+        << " Stmt: "      << stats.file << '[' << stats.line << ']' << ' ' << stats.func
         << ";\n";
     os.flags(fmt);
 #if 0
@@ -1365,7 +1698,7 @@ std::ostream& vtbl_map<N,T>::operator>>(std::ostream& os) const
         << " load_factor=" << std::setw(4) << std::fixed << std::setprecision(2) << double(cache_size-d0)/cache_size
         << " perfect="     << std::setw(3) << (vtbl_count ? d1*100/vtbl_count : 0) << '%'
         << " conflict="    << std::setw(9) << std::fixed << std::setprecision(7) << cache_conflict // Probability of conflict in cache
-        << " Stmt: "       << file << '[' << line << ']' << ' ' << func
+        << " Stmt: "       << stats.file << '[' << stats.line << ']' << ' ' << stats.func
         << "; ";
 
     size_t cache_last_non_zero_count = last_non_zero_count(&cache_histogram[0],cache_size,vtbl_count);
@@ -1375,7 +1708,7 @@ std::ostream& vtbl_map<N,T>::operator>>(std::ostream& os) const
     {
         size_t d = std::count(cache_histogram.begin(),cache_histogram.end(),i);
 
-        if (!i) os << std::setw(3) << d*100/cache_size << "% unused " << '[' << line << ']';
+        if (!i) os << std::setw(3) << d*100/cache_size << "% unused " << '[' << stats.line << ']';
         os << std::setw(2) << i << "->" << d << "; ";
     }
 
@@ -1410,6 +1743,123 @@ std::ostream& vtbl_map<N,T>::operator>>(std::ostream& os) const
     os.flags(fmt);
     return os << std::endl;
 }
+
+//------------------------------------------------------------------------------
+
+/// The JSON object has all the members of #vtbl_map_stats followed by:
+/// - "shifts":  array of N optimal shifts of the hash function
+/// - "entries": array of occupied cache entries with "slot" it occupies, 
+///              "index" it hashes to (they differ after a collision), "target"
+///              case label, as well as vtbl-pointers of the "key" and their
+///              demangled "classes"
+template <size_t N, typename T, typename H>
+std::ostream& vtbl_map<N,T,H>::write_json(std::ostream& os) const
+{
+    std::ios::fmtflags fmt = os.flags(); // store flags
+
+    os << '{';
+    write_json_members(os, statistics.snapshot()) << ",\"shifts\":[";
+
+    for (size_t s = 0; s < N; s++)
+        os << (s ? "," : "") << size_t(descriptor->optimal_shift[s]);
+
+    os << "],\"entries\":[";
+
+    for (size_t i = 0, n = 0; i <= descriptor->cache_mask; ++i)
+    {
+        const typename cache_descriptor::stored_type* st = descriptor->cache[i];
+
+        if (!st->occupied())
+            continue;
+
+        os << (n++ ? ",{" : "{")
+           << "\"slot\":"    << i
+           << ",\"index\":"  << descriptor->cache_index(st->vtbl)
+           << ",\"target\":" << case_target(st->value)
+           << ",\"key\":[";
+
+        for (size_t s = 0; s < N; s++)
+            os << (s ? ",\"0x" : "\"0x") << std::hex << st->vtbl[s] << std::dec << '"';
+
+        os << "],\"classes\":[";
+
+        for (size_t s = 0; s < N; s++)
+            write_json_string(os << (s ? "," : ""), demangle(vtbl_typeid(st->vtbl[s])).c_str());
+
+        os << "]}";
+    }
+
+    os.flags(fmt);
+    return os << "]}";
+}
+
+//------------------------------------------------------------------------------
+
+/// Each row has the columns of #csv_header followed by shifts, slot, index, 
+/// target, key and classes of one occupied cache entry, where values of 
+/// different arguments in the last three are separated with |. A map without
+/// entries is written as a single row with the last five columns empty.
+template <size_t N, typename T, typename H>
+std::ostream& vtbl_map<N,T,H>::write_csv(std::ostream& os) const
+{
+    std::ios::fmtflags fmt = os.flags(); // store flags
+
+    const vtbl_map_stats stats = statistics.snapshot();
+    std::string shifts;
+
+    for (size_t s = 0; s < N; s++)
+        shifts += (s ? "|" : "") + std::to_string(size_t(descriptor->optimal_shift[s]));
+
+    bool empty = true;
+
+    for (size_t i = 0; i <= descriptor->cache_mask; ++i)
+    {
+        const typename cache_descriptor::stored_type* st = descriptor->cache[i];
+
+        if (!st->occupied())
+            continue;
+
+        write_csv_fields(os, stats) 
+            << ',' << shifts
+            << ',' << i
+            << ',' << descriptor->cache_index(st->vtbl)
+            << ',' << case_target(st->value) << ',';
+
+        for (size_t s = 0; s < N; s++)
+            os << (s ? "|0x" : "0x") << std::hex << st->vtbl[s] << std::dec;
+
+        std::string classes;
+
+        for (size_t s = 0; s < N; s++)
+            classes += (s ? "|" : "") + demangle(vtbl_typeid(st->vtbl[s]));
+
+        write_csv_string(os << ',', classes.c_str()) << '\n';
+        empty = false;
+    }
+
+    if (empty)
+        write_csv_fields(os, stats) << ',' << shifts << ",,,,,\n";
+
+    os.flags(fmt);
+    return os << std::flush;
+}
+
+//------------------------------------------------------------------------------
+
+template <size_t N, typename T, typename H>
+std::ostream& vtbl_map<N,T,H>::dump(std::ostream& os) const
+{
+#if XTL_DUMP_PERFORMANCE_FORMAT == 1
+    return write_json(os) << std::endl;
+#elif XTL_DUMP_PERFORMANCE_FORMAT == 2
+    if (first_csv_dump())
+        os << csv_header() << ",shifts,slot,index,target,key,classes\n";
+
+    return write_csv(os);
+#else
+    return os << *this << std::endl;
+#endif
+}
 #endif
 
 //------------------------------------------------------------------------------
@@ -1430,6 +1880,10 @@ struct type_switch_info<0>
     std::ptrdiff_t offset[XTL_VARIABLE_SIZE_ARRAY]; ///< Dummy array, not used. Ideally should be 0 size
 };
 
+/// Case label associated with the vtbl-pointers in machine-readable dumps
+template <size_t N>
+inline long long case_target(const type_switch_info<N>& si) noexcept { return si.target; }
+
 //------------------------------------------------------------------------------
 
 } // of namespace mch
@@ -0,0 +1,314 @@
+//
+//  Mach7: Pattern Matching Library for C++
+//
+//  Copyright 2011-2013, Texas A&M University.
+//  Copyright 2014 Yuriy Solodkyy.
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are met:
+//
+//      * Redistributions of source code must retain the above copyright
+//        notice, this list of conditions and the following disclaimer.
+//
+//      * Redistributions in binary form must reproduce the above copyright
+//        notice, this list of conditions and the following disclaimer in the
+//        documentation and/or other materials provided with the distribution.
+//
+//      * Neither the names of Mach7 project nor the names of its contributors
+//        may be used to endorse or promote products derived from this software
+//        without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+//  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+//  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+//  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY
+//  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+//  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+//  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///
+/// \file
+///
+/// This file defines means of forgetting classes of a module (a shared library
+/// or a plugin) that is about to be unloaded. Vtbl-maps are keyed by addresses
+/// of vtbls, so once a module is unloaded and another one gets loaded at the 
+/// same address, entries learned for classes of the former would be used for
+/// unrelated classes of the latter. Modules are registered with the range of 
+/// addresses their vtbls occupy by #register_module or #register_module_of,
+/// while #unregister_module purges entries of their vtbls from every live 
+/// vtbl_map, vtblmap and thus memoized_cast (\see #XTL_VTBL_INVALIDATION).
+/// Entries of other classes stay, so nothing else has to be learned again:
+///
+/// \code
+///     void* handle = dlopen("plugin.so", RTLD_NOW);
+///     mch::vtbl_module_id plugin = mch::register_module_of(dlsym(handle, "make_shape"), "plugin.so");
+///     ...                             // Match statements learn classes of the plugin
+///     mch::unregister_module(plugin); // No objects of plugin classes are left
+///     dlclose(handle);
+/// \endcode
+///
+/// Purging a single-threaded map must not overlap with lookups in it, just like
+/// the unloading of a module must not overlap with uses of its classes.
+///
+/// \author Yuriy Solodkyy <yuriy.solodkyy@gmail.com>
+///
+/// \see https://parasol.tamu.edu/mach7/
+/// \see https://github.com/solodon4/Mach7
+/// \see https://github.com/solodon4/SELL
+///
+
+#pragma once
+
+#include "config.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#if defined(__unix__) && !defined(__APPLE__)
+#include <link.h>        // dl_iterate_phdr to find the image of a module
+#define XTL_HAS_DL_ITERATE_PHDR 1
+#else
+#define XTL_HAS_DL_ITERATE_PHDR 0
+#endif
+
+namespace mch ///< Mach7 library namespace
+{
+
+//------------------------------------------------------------------------------
+
+/// A vtbl-map that can forget some of its entries. Each instance registers 
+/// itself in a global list during its lifetime, so that #purge_all reaches 
+/// every live map. Maps derive a member from it that forwards #purge to them.
+class vtbl_map_invalidation
+{
+public:
+
+    /// Removes entries of vtbl-pointers in [lo,hi) from all live vtbl-maps and
+    /// returns the number of removed entries.
+    static size_t purge_all(intptr_t lo, intptr_t hi)
+    {
+        std::lock_guard<std::mutex> lock(registry().mutex);
+        size_t n = 0;
+
+        for (vtbl_map_invalidation* p = registry().head; p; p = p->m_next)
+            n += p->purge(lo, hi);
+
+        return n;
+    }
+
+protected:
+
+    vtbl_map_invalidation() : m_prev(nullptr), m_next(nullptr)
+    {
+        std::lock_guard<std::mutex> lock(registry().mutex);
+        m_next = registry().head;
+        if (m_next) m_next->m_prev = this;
+        registry().head = this;
+    }
+
+   ~vtbl_map_invalidation()
+    {
+        std::lock_guard<std::mutex> lock(registry().mutex);
+        (m_prev ? m_prev->m_next : registry().head) = m_next;
+        if (m_next) m_next->m_prev = m_prev;
+    }
+
+    /// Removes entries of vtbl-pointers in [lo,hi) and returns their number
+    virtual size_t purge(intptr_t lo, intptr_t hi) = 0;
+
+private:
+
+    struct registry_type
+    {
+        registry_type() : head(nullptr) {}
+        std::mutex             mutex;
+        vtbl_map_invalidation* head;
+    };
+
+    /// The registry is intentionally never destroyed as vtbl-maps living in 
+    /// static storage may unregister themselves after it would have been.
+    static registry_type& registry()
+    {
+        static registry_type* r = new registry_type();
+        return *r;
+    }
+
+    vtbl_map_invalidation(const vtbl_map_invalidation&);            ///< No copy constructor
+    vtbl_map_invalidation& operator=(const vtbl_map_invalidation&); ///< No assignment operator
+
+    vtbl_map_invalidation* m_prev;
+    vtbl_map_invalidation* m_next;
+};
+
+//------------------------------------------------------------------------------
+
+/// Identifies a registered module, 0 is never one
+typedef size_t vtbl_module_id;
+
+/// A registered module along with the range of addresses of its vtbls
+struct vtbl_module
+{
+    vtbl_module_id id;    ///< Identifier returned on registration
+    std::string    name;  ///< Name given on registration
+    intptr_t       begin; ///< First address of the module
+    intptr_t       end;   ///< One past the last address of the module
+};
+
+/// Modules registered so far. Like the other registries, it is intentionally
+/// never destroyed.
+struct vtbl_module_registry
+{
+    vtbl_module_registry() : last_id(0) {}
+
+    static vtbl_module_registry& instance()
+    {
+        static vtbl_module_registry* r = new vtbl_module_registry();
+        return *r;
+    }
+
+    std::mutex               mutex;
+    std::vector<vtbl_module> modules;
+    vtbl_module_id           last_id;
+};
+
+//------------------------------------------------------------------------------
+
+/// Removes entries of vtbl-pointers in [begin,end) from all live vtbl-maps and
+/// returns the number of removed entries. Returns 0 without #XTL_VTBL_INVALIDATION.
+inline size_t invalidate_vtbls(const void* begin, const void* end)
+{
+#if XTL_VTBL_INVALIDATION
+    return vtbl_map_invalidation::purge_all(reinterpret_cast<intptr_t>(begin), reinterpret_cast<intptr_t>(end));
+#else
+    XTL_UNUSED(begin);
+    XTL_UNUSED(end);
+    return 0;
+#endif
+}
+
+//------------------------------------------------------------------------------
+
+/// Registers a module whose vtbls are within [begin,end)
+inline vtbl_module_id register_module(const void* begin, const void* end, const char* name = nullptr)
+{
+    vtbl_module_registry& r = vtbl_module_registry::instance();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    vtbl_module m = { ++r.last_id, name ? name : "", reinterpret_cast<intptr_t>(begin), reinterpret_cast<intptr_t>(end) };
+    r.modules.push_back(m);
+    return m.id;
+}
+
+//------------------------------------------------------------------------------
+
+/// Registers the loaded module containing the given address, e.g. of a function
+/// obtained from it with dlsym, with the range spanning all its segments. 
+/// Returns 0 when the module is not found or the platform provides no means to
+/// find it, in which case #register_module has to be used instead.
+inline vtbl_module_id register_module_of(const void* address, const char* name = nullptr)
+{
+#if XTL_HAS_DL_ITERATE_PHDR
+    struct search
+    {
+        intptr_t    address;
+        intptr_t    begin;
+        intptr_t    end;
+        std::string name;
+
+        static int callback(dl_phdr_info* info, size_t, void* data)
+        {
+            search&  s     = *static_cast<search*>(data);
+            intptr_t begin = INTPTR_MAX;
+            intptr_t end   = 0;
+
+            for (int i = 0; i < info->dlpi_phnum; ++i)
+                if (info->dlpi_phdr[i].p_type == PT_LOAD)
+                {
+                    const intptr_t b = intptr_t(info->dlpi_addr + info->dlpi_phdr[i].p_vaddr);
+                    begin = std::min(begin, b);
+                    end   = std::max(end,   intptr_t(b + info->dlpi_phdr[i].p_memsz));
+                }
+
+            if (begin <= s.address && s.address < end)
+            {
+                s.begin = begin;
+                s.end   = end;
+                s.name  = info->dlpi_name ? info->dlpi_name : "";
+                return 1; // Stop iteration
+            }
+
+            return 0;
+        }
+    };
+
+    search s = { reinterpret_cast<intptr_t>(address), 0, 0, std::string() };
+
+    if (dl_iterate_phdr(&search::callback, &s))
+        return register_module(reinterpret_cast<const void*>(s.begin), reinterpret_cast<const void*>(s.end), name ? name : s.name.c_str());
+#else
+    XTL_UNUSED(address);
+    XTL_UNUSED(name);
+#endif
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+
+/// Removes entries of vtbls of a registered module from all live vtbl-maps 
+/// while keeping the module registered, and returns the number of removed 
+/// entries. 
+inline size_t invalidate_module(vtbl_module_id id)
+{
+    vtbl_module_registry& r = vtbl_module_registry::instance();
+    std::unique_lock<std::mutex> lock(r.mutex);
+
+    for (size_t i = 0; i < r.modules.size(); ++i)
+        if (r.modules[i].id == id)
+        {
+            const vtbl_module m = r.modules[i];
+            lock.unlock();
+            return invalidate_vtbls(reinterpret_cast<const void*>(m.begin), reinterpret_cast<const void*>(m.end));
+        }
+
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+
+/// Removes entries of vtbls of a registered module from all live vtbl-maps and
+/// forgets the module. Meant to be called right before the module is unloaded,
+/// when no objects of its classes are left. Returns the number of removed entries.
+inline size_t unregister_module(vtbl_module_id id)
+{
+    const size_t n = invalidate_module(id);
+    vtbl_module_registry& r = vtbl_module_registry::instance();
+    std::lock_guard<std::mutex> lock(r.mutex);
+
+    for (size_t i = 0; i < r.modules.size(); ++i)
+        if (r.modules[i].id == id)
+        {
+            r.modules.erase(r.modules.begin() + i);
+            break;
+        }
+
+    return n;
+}
+
+//------------------------------------------------------------------------------
+
+/// Returns the modules registered at the moment of the call
+inline std::vector<vtbl_module> registered_modules()
+{
+    vtbl_module_registry& r = vtbl_module_registry::instance();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    return r.modules;
+}
+
+//------------------------------------------------------------------------------
+
+} // of namespace mch
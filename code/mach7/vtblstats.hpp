@@ -0,0 +1,304 @@
+//
+//  Mach7: Pattern Matching Library for C++
+//
+//  Copyright 2011-2013, Texas A&M University.
+//  Copyright 2014 Yuriy Solodkyy.
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are met:
+//
+//      * Redistributions of source code must retain the above copyright
+//        notice, this list of conditions and the following disclaimer.
+//
+//      * Redistributions in binary form must reproduce the above copyright
+//        notice, this list of conditions and the following disclaimer in the
+//        documentation and/or other materials provided with the distribution.
+//
+//      * Neither the names of Mach7 project nor the names of its contributors
+//        may be used to endorse or promote products derived from this software
+//        without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+//  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+//  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+//  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY
+//  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+//  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+//  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///
+/// \file
+///
+/// This file defines run-time statistics kept by every vtbl_map and vtblmap in
+/// the program and a registry that lets one take a snapshot of all of them.
+///
+/// \author Yuriy Solodkyy <yuriy.solodkyy@gmail.com>
+///
+/// \see https://parasol.tamu.edu/mach7/
+/// \see https://github.com/solodon4/Mach7
+/// \see https://github.com/solodon4/SELL
+///
+
+#pragma once
+
+#include "config.hpp"
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+namespace mch ///< Mach7 library namespace
+{
+
+//------------------------------------------------------------------------------
+
+/// Snapshot of the statistics of a single vtbl-map taken by #snapshot_vtbl_maps.
+struct vtbl_map_stats
+{
+    const char* file;       ///< File of the Match statement or "unspecified" when not known
+    size_t      line;       ///< Line of the Match statement or 0 when not known
+    const char* func;       ///< Function of the Match statement (mangled name of its local UID type when file and line are not known)
+    size_t      arity;      ///< Number of vtbl pointers in the key of the map
+    size_t      vtbls;      ///< Number of different keys seen so far
+    size_t      log_size;   ///< Log of the cache size
+    size_t      memory;     ///< Bytes used by the map as of the last reconfiguration
+    size_t      updates;    ///< Number of reconfigurations performed at run time
+    size_t      hits;       ///< Number of cache hits
+    size_t      misses;     ///< Number of cache misses
+    size_t      collisions; ///< Out of all the misses, how many were actual collisions
+
+    /// Fraction of lookups served directly from the cache
+    double hit_rate() const noexcept { return hits + misses ? double(hits) / double(hits + misses) : 1.0; }
+};
+
+//------------------------------------------------------------------------------
+
+/// Members of the local UID type of a Match statement that let the vtbl-maps 
+/// preallocated for it report where the statement is. __FILE__ and __LINE__ 
+/// expand at the Match statement since this is only used inside its macro.
+#define XTL_UID_LOCATION                                                       \
+        static const char* uid_file() noexcept { return __FILE__; }            \
+        static size_t      uid_line() noexcept { return __LINE__; }
+
+/// File of the Match statement identified by UID or nullptr when UID does not know it
+template <typename UID> inline auto uid_file(int) noexcept -> decltype(UID::uid_file()) { return UID::uid_file(); }
+template <typename UID> inline const char* uid_file(...) noexcept { return nullptr; }
+
+/// Line of the Match statement identified by UID or 0 when UID does not know it
+template <typename UID> inline auto uid_line(int) noexcept -> decltype(UID::uid_line()) { return UID::uid_line(); }
+template <typename UID> inline size_t uid_line(...) noexcept { return 0; }
+
+//------------------------------------------------------------------------------
+
+/// Decides which lookups of a vtbl-map count towards the frequency of the entry
+/// they found \see #XTL_USE_VTBL_FREQUENCY. About one in 2^#XTL_VTBL_FREQUENCY_SAMPLING
+/// lookups is picked by the top bits of an LCG rather than by a counter, so that 
+/// periodic sequences of types do not alias with the sampling period.
+class vtbl_frequency_sampler
+{
+public:
+    vtbl_frequency_sampler() noexcept : m_state(0) {}
+    bool operator()() noexcept
+    {
+        m_state = m_state * 6364136223846793005ULL + 1442695040888963407ULL;
+        return (m_state >> (64 - XTL_VTBL_FREQUENCY_SAMPLING)) == 0;
+    }
+private:
+    unsigned long long m_state;
+};
+
+//------------------------------------------------------------------------------
+
+#if XTL_VTBL_MAP_STATISTICS || XTL_DUMP_PERFORMANCE
+
+/// Statistics kept by each vtbl-map. Counters are relaxed atomics incremented 
+/// with a separate load and store rather than a read-modify-write instruction:
+/// this keeps the cost of a cache hit to a plain increment of memory at the 
+/// price of occasionally losing a count when several threads use the same map.
+/// With #XTL_MULTI_THREADING the hit, miss and collision counters are split 
+/// into cache-line sized shards picked by thread, so that threads hitting the 
+/// same map do not keep stealing the line with its counters from each other.
+/// Each instance registers itself in a global list for #snapshot_vtbl_maps 
+/// during its lifetime.
+class vtbl_map_statistics
+{
+public:
+
+    vtbl_map_statistics(size_t arity, const char* file, size_t line, const char* func) :
+        m_file(file ? file : "unspecified"),
+        m_line(line),
+        m_func(func ? func : "unspecified"),
+        m_arity(arity),
+        m_vtbls(0), m_log_size(0), m_memory(0), m_updates(0),
+        m_prev(nullptr), m_next(nullptr)
+    {
+        std::lock_guard<std::mutex> lock(registry().mutex);
+        m_next = registry().head;
+        if (m_next) m_next->m_prev = this;
+        registry().head = this;
+    }
+
+   ~vtbl_map_statistics()
+    {
+        std::lock_guard<std::mutex> lock(registry().mutex);
+        (m_prev ? m_prev->m_next : registry().head) = m_next;
+        if (m_next) m_next->m_prev = m_prev;
+    }
+
+    void hit() noexcept { increment(m_shards[shard_index()].hits); }
+
+    /// Records a miss, which is a collision when the entry was taken by another key
+    void miss(bool collision) noexcept
+    {
+        shard& s = m_shards[shard_index()];
+        increment(s.misses);
+        if (collision) increment(s.collisions);
+    }
+
+    /// Records the number of different keys known after a miss was resolved
+    void known(size_t vtbls) noexcept { m_vtbls.store(vtbls, std::memory_order_relaxed); }
+
+    /// Records a new layout of the map after reconfiguration or construction
+    void layout(size_t vtbls, size_t log_size, size_t memory, bool update = true) noexcept
+    {
+        if (update) increment(m_updates);
+        m_vtbls.store(vtbls, std::memory_order_relaxed);
+        m_log_size.store(log_size, std::memory_order_relaxed);
+        m_memory.store(memory, std::memory_order_relaxed);
+    }
+
+    const char* file() const noexcept { return m_file; }
+    size_t      line() const noexcept { return m_line; }
+    const char* func() const noexcept { return m_func; }
+
+    vtbl_map_stats snapshot() const noexcept
+    {
+        vtbl_map_stats s = {
+            m_file, m_line, m_func, m_arity,
+            m_vtbls.load(std::memory_order_relaxed),
+            m_log_size.load(std::memory_order_relaxed),
+            m_memory.load(std::memory_order_relaxed),
+            m_updates.load(std::memory_order_relaxed),
+            0, 0, 0
+        };
+
+        for (size_t i = 0; i < shards; ++i)
+        {
+            s.hits       += m_shards[i].hits.load(std::memory_order_relaxed);
+            s.misses     += m_shards[i].misses.load(std::memory_order_relaxed);
+            s.collisions += m_shards[i].collisions.load(std::memory_order_relaxed);
+        }
+
+        return s;
+    }
+
+    /// Calls f with a snapshot of each live vtbl-map while holding the registry lock
+    template <typename F>
+    static void for_each(F f)
+    {
+        std::lock_guard<std::mutex> lock(registry().mutex);
+
+        for (const vtbl_map_statistics* p = registry().head; p; p = p->m_next)
+            f(p->snapshot());
+    }
+
+private:
+
+    typedef std::atomic<size_t> counter;
+
+    static void increment(counter& c) noexcept { c.store(c.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed); }
+
+    /// Number of shards of the counters updated on every lookup
+    enum { shards = XTL_MULTI_THREADING ? 16 : 1, cache_line = 64 };
+
+    /// Counters updated on every lookup, padded to occupy a cache line of their own
+    struct shard
+    {
+        shard() : hits(0), misses(0), collisions(0) {}
+        counter hits;
+        counter misses;
+        counter collisions;
+        char    padding[cache_line > 3*sizeof(counter) ? cache_line - 3*sizeof(counter) : 1];
+    };
+
+    /// Shard used by the calling thread: threads get them round-robin on first use.
+    /// The thread-local is constant-initialized so that its use needs no guard.
+    static size_t shard_index() noexcept
+    {
+    #if XTL_MULTI_THREADING
+        static std::atomic<size_t> next(0);
+        static thread_local size_t index = 0; // 0 means not assigned yet
+        if (XTL_UNLIKELY(!index))
+            index = next.fetch_add(1, std::memory_order_relaxed) % shards + 1;
+        return index - 1;
+    #else
+        return 0;
+    #endif
+    }
+
+    struct registry_type
+    {
+        std::mutex           mutex;
+        vtbl_map_statistics* head;
+    };
+
+    /// The registry is intentionally never destroyed as vtbl-maps living in 
+    /// static storage may unregister themselves after it would have been.
+    static registry_type& registry()
+    {
+        static registry_type* r = new registry_type();
+        return *r;
+    }
+
+    vtbl_map_statistics(const vtbl_map_statistics&);            ///< No copy constructor
+    vtbl_map_statistics& operator=(const vtbl_map_statistics&); ///< No assignment operator
+
+    const char*          m_file;
+    size_t               m_line;
+    const char*          m_func;
+    size_t               m_arity;
+    counter              m_vtbls;
+    counter              m_log_size;
+    counter              m_memory;
+    counter              m_updates;
+    shard                m_shards[shards];
+    vtbl_map_statistics* m_prev;
+    vtbl_map_statistics* m_next;
+};
+
+#else
+
+/// Statistics are disabled: vtbl-maps do not count anything and do not register
+class vtbl_map_statistics
+{
+public:
+    vtbl_map_statistics(size_t, const char*, size_t, const char*) noexcept {}
+    void hit() noexcept {}
+    void miss(bool) noexcept {}
+    void known(size_t) noexcept {}
+    void layout(size_t, size_t, size_t, bool = true) noexcept {}
+    const char* file() const noexcept { return "unspecified"; }
+    size_t      line() const noexcept { return 0; }
+    const char* func() const noexcept { return "unspecified"; }
+    template <typename F> static void for_each(F) {}
+};
+
+#endif
+
+//------------------------------------------------------------------------------
+
+/// Returns statistics of all the vtbl-maps alive at the moment of the call. 
+/// The result is empty when #XTL_VTBL_MAP_STATISTICS is disabled.
+inline std::vector<vtbl_map_stats> snapshot_vtbl_maps()
+{
+    std::vector<vtbl_map_stats> result;
+    vtbl_map_statistics::for_each([&result](const vtbl_map_stats& s) { result.push_back(s); });
+    return result;
+}
+
+//------------------------------------------------------------------------------
+
+} // of namespace mch
@@ -0,0 +1,356 @@
+//
+//  Mach7: Pattern Matching Library for C++
+//
+//  Copyright 2011-2013, Texas A&M University.
+//  Copyright 2014 Yuriy Solodkyy.
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are met:
+//
+//      * Redistributions of source code must retain the above copyright
+//        notice, this list of conditions and the following disclaimer.
+//
+//      * Redistributions in binary form must reproduce the above copyright
+//        notice, this list of conditions and the following disclaimer in the
+//        documentation and/or other materials provided with the distribution.
+//
+//      * Neither the names of Mach7 project nor the names of its contributors
+//        may be used to endorse or promote products derived from this software
+//        without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+//  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+//  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+//  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY
+//  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+//  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+//  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+///
+/// \file
+///
+/// This file defines a tool that measures the cost of compiling translation
+/// units: wall and CPU time of the compiler as well as its peak memory. Each
+/// source is compiled several times and the median of each is reported. The
+/// CPU time and memory are those of the compiler driver together with all the
+/// processes it spawned (cc1plus, as etc.).
+///
+/// When the compiler is Clang, it is also asked for -ftime-trace, which leaves
+/// a Chrome trace of the frontend (parsing, template instantiation etc.) next
+/// to each object file in the output directory.
+///
+/// Pairs of sources named X-a.cpp and X-b.cpp (as in this folder: a solution
+/// without and with Mach7) also get a verdict: the ratio of the median time
+/// of X-b to that of X-a with the range of ratios of individual compilations.
+/// Verdicts are written in the same JSON format as that of the benchmark
+/// harness (see ../time/benchmark.hpp), so compare-benchmarks can check them
+/// against a baseline as well.
+///
+/// \note The file has .cxx extension so that Makefile and build.bat in this 
+///       folder, which build every .cpp file, skip it: it relies on POSIX.
+///
+/// Usage: measure-compile [--runs R] [--json file] [--output-dir dir]
+///                        [--program name] compiler [flags...] -- sources...
+///
+/// \author Yuriy Solodkyy <yuriy.solodkyy@gmail.com>
+///
+/// \see https://parasol.tamu.edu/mach7/
+/// \see https://github.com/solodon4/Mach7
+/// \see https://github.com/solodon4/SELL
+///
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <sys/resource.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+//------------------------------------------------------------------------------
+
+/// Cost of a single compilation
+struct cost
+{
+    double wall_ms; ///< Wall-clock time of the compiler
+    double cpu_ms;  ///< User and system time of the compiler and its children
+    long   rss_kb;  ///< Peak resident set size of the largest of those processes
+};
+
+/// Costs of all compilations of a source together with their medians
+struct measurement
+{
+    std::string       source;
+    std::string       name;  ///< Source file name without folder and extension
+    std::vector<cost> runs;
+    cost              median;
+};
+
+//------------------------------------------------------------------------------
+
+static std::string base_name(const std::string& path)
+{
+    std::string::size_type slash = path.find_last_of("/\\");
+    std::string name = slash == std::string::npos ? path : path.substr(slash+1);
+    std::string::size_type dot = name.find_last_of('.');
+    return dot == std::string::npos ? name : name.substr(0,dot);
+}
+
+//------------------------------------------------------------------------------
+
+template <typename T>
+static T median_of(std::vector<T> v)
+{
+    std::sort(v.begin(), v.end());
+    return v.empty() ? T() : v[v.size()/2];
+}
+
+//------------------------------------------------------------------------------
+
+/// Runs the given command line and measures its cost.
+/// \returns false when the command could not be run or did not succeed.
+static bool run(const std::vector<std::string>& command, cost& c)
+{
+    std::vector<char*> argv;
+
+    for (size_t i = 0; i < command.size(); ++i)
+        argv.push_back(const_cast<char*>(command[i].c_str()));
+
+    argv.push_back(0);
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    pid_t pid = fork();
+
+    if (pid < 0)
+        return false;
+
+    if (pid == 0)
+    {
+        execvp(argv[0], &argv[0]);
+        _exit(127);
+    }
+
+    int status = 0;
+    struct rusage usage;
+
+    // Unlike getrusage(RUSAGE_CHILDREN), which accumulates all the children
+    // of this process, wait4 reports the usage of this child only. On Linux
+    // it includes the descendants it waited for, e.g. cc1plus of g++ driver.
+    if (wait4(pid, &status, 0, &usage) != pid)
+        return false;
+
+    c.wall_ms = std::chrono::duration<double,std::milli>(std::chrono::steady_clock::now() - start).count();
+    c.cpu_ms  = (usage.ru_utime.tv_sec  + usage.ru_stime.tv_sec ) * 1000.0
+              + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1000.0;
+#if defined(__APPLE__)
+    c.rss_kb  = usage.ru_maxrss / 1024; // Reported in bytes on OS X
+#else
+    c.rss_kb  = usage.ru_maxrss;        // Reported in kilobytes on Linux
+#endif
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+//------------------------------------------------------------------------------
+
+static void write_json(
+    std::ostream&                   os,
+    const std::string&              program,
+    const std::string&              compiler,
+    const std::vector<measurement>& results)
+{
+    os << "{\n  \"program\": \""  << program  << '"'
+       << ",\n  \"compiler\": \"" << compiler << '"'
+       << ",\n  \"series\": [";
+
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        const measurement& m = results[i];
+        os << (i ? ",\n    " : "\n    ")
+           << "{\"name\": \""   << m.name << '"'
+           << ", \"runs\": "    << m.runs.size()
+           << ", \"wall_ms\": " << m.median.wall_ms
+           << ", \"cpu_ms\": "  << m.median.cpu_ms
+           << ", \"rss_kb\": "  << m.median.rss_kb << '}';
+    }
+
+    os << "\n  ],\n  \"verdicts\": [";
+
+    size_t k = 0;
+
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        const measurement& a = results[i];
+
+        if (a.name.size() < 2 || a.name.compare(a.name.size()-2, 2, "-a") != 0)
+            continue;
+
+        const std::string pair = a.name.substr(0, a.name.size()-2) + "-b";
+
+        for (size_t j = 0; j < results.size(); ++j)
+        {
+            const measurement& b = results[j];
+
+            if (b.name != pair)
+                continue;
+
+            // Ratios of compilations with the same index, all of which were
+            // made at roughly the same time and thus under similar load.
+            std::vector<double> ratios;
+
+            for (size_t r = 0; r < a.runs.size() && r < b.runs.size(); ++r)
+                ratios.push_back(b.runs[r].wall_ms / a.runs[r].wall_ms);
+
+            std::sort(ratios.begin(), ratios.end());
+
+            os << (k++ ? ",\n    " : "\n    ")
+               << "{\"first\": \""    << a.name << '"'
+               << ", \"second\": \""  << b.name << '"'
+               << ", \"iterations\": " << ratios.size()
+               << ", \"cycles1\": "    << a.median.wall_ms
+               << ", \"cycles2\": "    << b.median.wall_ms
+               << ", \"ratio\": "      << b.median.wall_ms / a.median.wall_ms
+               << ", \"ratio_low\": "  << ratios.front()
+               << ", \"ratio_high\": " << ratios.back() << '}';
+        }
+    }
+
+    os << "\n  ]\n}" << std::endl;
+}
+
+//------------------------------------------------------------------------------
+
+static int usage()
+{
+    std::cerr << "Usage: measure-compile [--runs R] [--json file] [--output-dir dir] [--program name] compiler [flags...] -- sources..." << std::endl;
+    return 2;
+}
+
+//------------------------------------------------------------------------------
+
+int main(int argc, char* argv[])
+{
+    size_t      runs    = 5;
+    std::string json;
+    std::string outdir  = ".";
+    std::string program = "compile-time";
+    int i = 1;
+
+    for (; i < argc && std::strncmp(argv[i], "--", 2) == 0 && argv[i][2]; i += 2)
+    {
+        if (i+1 >= argc)
+            return usage();
+
+        if      (std::strcmp(argv[i], "--runs")       == 0) runs    = std::strtoul(argv[i+1], 0, 10);
+        else if (std::strcmp(argv[i], "--json")       == 0) json    = argv[i+1];
+        else if (std::strcmp(argv[i], "--output-dir") == 0) outdir  = argv[i+1];
+        else if (std::strcmp(argv[i], "--program")    == 0) program = argv[i+1];
+        else
+            return usage();
+    }
+
+    std::vector<std::string> compiler;
+
+    for (; i < argc && std::strcmp(argv[i], "--") != 0; ++i)
+        compiler.push_back(argv[i]);
+
+    if (compiler.empty() || i == argc || runs == 0)
+        return usage();
+
+    const bool clang = compiler[0].find("clang") != std::string::npos;
+
+    if (clang)
+        compiler.push_back("-ftime-trace"); // Writes <object>.json next to the object file
+
+    std::vector<measurement> results;
+
+    for (++i; i < argc; ++i)
+    {
+        measurement m;
+        m.source = argv[i];
+        m.name   = base_name(m.source);
+        results.push_back(m);
+    }
+
+    // Compilations of different sources are interleaved, so that a change of
+    // load of the machine affects all of them rather than just a few.
+    for (size_t r = 0; r < runs; ++r)
+    {
+        for (size_t j = 0; j < results.size(); ++j)
+        {
+            std::vector<std::string> command = compiler;
+            command.push_back("-c");
+            command.push_back(results[j].source);
+            command.push_back("-o");
+            command.push_back(outdir + '/' + results[j].name + ".o");
+
+            cost c;
+
+            if (!run(command, c))
+            {
+                std::cerr << "ERROR: Compilation of " << results[j].source << " failed" << std::endl;
+                return 1;
+            }
+
+            results[j].runs.push_back(c);
+        }
+    }
+
+    std::cout << std::setw(40) << std::left << "Source" << std::right
+              << std::setw(12) << "Wall [ms]"
+              << std::setw(12) << "CPU [ms]"
+              << std::setw(12) << "Peak [MB]" << std::endl;
+
+    for (size_t j = 0; j < results.size(); ++j)
+    {
+        measurement& m = results[j];
+        std::vector<double> wall, cpu;
+        std::vector<long>   rss;
+
+        for (size_t r = 0; r < m.runs.size(); ++r)
+        {
+            wall.push_back(m.runs[r].wall_ms);
+            cpu.push_back(m.runs[r].cpu_ms);
+            rss.push_back(m.runs[r].rss_kb);
+        }
+
+        m.median.wall_ms = median_of(wall);
+        m.median.cpu_ms  = median_of(cpu);
+        m.median.rss_kb  = median_of(rss);
+
+        std::cout << std::setw(40) << std::left << m.name << std::right << std::fixed << std::setprecision(1)
+                  << std::setw(12) << m.median.wall_ms
+                  << std::setw(12) << m.median.cpu_ms
+                  << std::setw(12) << m.median.rss_kb / 1024.0 << std::endl;
+    }
+
+    if (clang)
+        std::cout << "Time traces of Clang frontend are in " << outdir << "/*.json" << std::endl;
+
+    if (!json.empty())
+    {
+        std::ofstream out(json.c_str());
+
+        if (!out)
+        {
+            std::cerr << "ERROR: Cannot write results to " << json << std::endl;
+            return 1;
+        }
+
+        write_json(out, program, compiler[0], results);
+        std::cout << "Wrote results of " << results.size() << " sources to " << json << std::endl;
+    }
+
+    return 0;
+}
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,499 @@
+//
+//  Mach7: Pattern Matching Library for C++
+//
+//  Copyright 2011-2013, Texas A&M University.
+//  Copyright 2014 Yuriy Solodkyy.
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are met:
+//
+//      * Redistributions of source code must retain the above copyright
+//        notice, this list of conditions and the following disclaimer.
+//
+//      * Redistributions in binary form must reproduce the above copyright
+//        notice, this list of conditions and the following disclaimer in the
+//        documentation and/or other materials provided with the distribution.
+//
+//      * Neither the names of Mach7 project nor the names of its contributors
+//        may be used to endorse or promote products derived from this software
+//        without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+//  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+//  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+//  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY
+//  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+//  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+//  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+///
+/// \file
+///
+/// This file defines the benchmark harness shared by all the timing tests. It
+/// takes care of warm-up, optional pinning to a CPU, hardware counters, 
+/// confidence intervals of medians and machine-readable output, so that 
+/// results of different runs and builds can be compared mechanically.
+///
+/// The harness is configured at run time with the following environment 
+/// variables, so that the same binaries can be used interactively and in CI:
+/// - MACH7_BENCH_JSON         - file to write JSON with all the results to (<program>.json),
+///                              "-" for standard output or empty to disable it
+/// - MACH7_BENCH_CPU          - index of the CPU to pin the process to
+/// - MACH7_BENCH_WARMUP_MS    - milliseconds to spin before the first measurement (250)
+/// - MACH7_BENCH_REPETITIONS  - number of experiments K (100)
+/// - MACH7_BENCH_MEASUREMENTS - number of measurements M per experiment (101)
+/// - MACH7_BENCH_NO_PERF      - disables hardware counters when set
+///
+/// \author Yuriy Solodkyy <yuriy.solodkyy@gmail.com>
+///
+/// \see https://parasol.tamu.edu/mach7/
+/// \see https://github.com/solodon4/Mach7
+/// \see https://github.com/solodon4/SELL
+///
+
+#pragma once
+
+#include "timing.hpp"                      // Support of get_time_stamp and get_frequency
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#if defined(__linux__)
+    #include <linux/perf_event.h>
+    #include <sched.h>
+    #include <sys/ioctl.h>
+    #include <sys/syscall.h>
+    #include <unistd.h>
+#endif
+
+namespace mch ///< Mach7 library namespace
+{
+
+//------------------------------------------------------------------------------
+
+/// Returns the value of a numeric environment variable or dflt when it is not set
+inline long long benchmark_option(const char* name, long long dflt)
+{
+    const char* value = std::getenv(name);
+    return value && *value ? std::atoll(value) : dflt;
+}
+
+//------------------------------------------------------------------------------
+
+/// Name of the timing program the harness is compiled into, which names its 
+/// JSON output. Build scripts may define MACH7_BENCH_PROGRAM, otherwise it is
+/// derived from the name of the main source file when the compiler provides it.
+inline std::string benchmark_program()
+{
+#if defined(MACH7_BENCH_PROGRAM)
+    std::string name = MACH7_BENCH_PROGRAM;
+#elif defined(__BASE_FILE__)
+    std::string name = __BASE_FILE__;
+#else
+    std::string name = "benchmark";
+#endif
+    std::string::size_type p = name.find_last_of("/\\");
+
+    if (p != std::string::npos)
+        name.erase(0, p+1);
+
+    p = name.rfind('.');
+
+    if (p != std::string::npos && p > 0)
+        name.erase(p);
+
+    return name;
+}
+
+//------------------------------------------------------------------------------
+
+/// Hardware events counted around every measurement
+enum perf_event_kind
+{
+    perf_cycles,
+    perf_branch_misses,
+    perf_cache_misses,
+    perf_event_kinds
+};
+
+/// Names of #perf_event_kind values as they appear in the output
+inline const char* perf_event_name(size_t k)
+{
+    static const char* names[perf_event_kinds] = {"cycles", "branch_misses", "cache_misses"};
+    return names[k];
+}
+
+//------------------------------------------------------------------------------
+
+/// User-space hardware counters of the calling thread read through 
+/// perf_event_open on Linux. Counters that cannot be opened, e.g. because of
+/// perf_event_paranoid settings or virtualization, are reported as missing.
+class perf_counters
+{
+public:
+
+    perf_counters()
+    {
+        std::fill(&fd[0], &fd[perf_event_kinds], -1);
+#if defined(__linux__)
+        if (std::getenv("MACH7_BENCH_NO_PERF"))
+            return;
+
+        static const unsigned long long configs[perf_event_kinds] = {
+            PERF_COUNT_HW_CPU_CYCLES, 
+            PERF_COUNT_HW_BRANCH_MISSES, 
+            PERF_COUNT_HW_CACHE_MISSES
+        };
+
+        for (size_t k = 0; k < perf_event_kinds; ++k)
+        {
+            perf_event_attr attr;
+            std::memset(&attr, 0, sizeof(attr));
+            attr.type           = PERF_TYPE_HARDWARE;
+            attr.size           = sizeof(attr);
+            attr.config         = configs[k];
+            attr.exclude_kernel = 1;
+            attr.exclude_hv     = 1;
+            attr.inherit        = 1; // Include threads spawned by parallel tests
+            fd[k] = int(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+        }
+#endif
+    }
+
+   ~perf_counters()
+    {
+#if defined(__linux__)
+        for (size_t k = 0; k < perf_event_kinds; ++k)
+            if (fd[k] >= 0)
+                close(fd[k]);
+#endif
+    }
+
+    bool available(size_t k) const { return fd[k] >= 0; }
+
+    /// Reads current values of all the counters, leaving missing ones intact
+    void read(long long (&values)[perf_event_kinds]) const
+    {
+#if defined(__linux__)
+        for (size_t k = 0; k < perf_event_kinds; ++k)
+            if (fd[k] >= 0 && ::read(fd[k], &values[k], sizeof(values[k])) != sizeof(values[k]))
+                values[k] = 0;
+#else
+        XTL_UNUSED(values);
+#endif
+    }
+
+private:
+
+    perf_counters(const perf_counters&);            ///< No copy constructor
+    perf_counters& operator=(const perf_counters&); ///< No assignment operator
+
+    int fd[perf_event_kinds];
+};
+
+//------------------------------------------------------------------------------
+
+/// Summary of a series of measurements with 95% confidence interval of the
+/// median computed from order statistics, which needs no assumptions about 
+/// the distribution of measurements.
+struct benchmark_summary
+{
+    long long min, max, median, ci_low, ci_high;
+    double    mean, dev;
+};
+
+template <typename T>
+inline benchmark_summary summarize(std::vector<T> v) // by value since we sort
+{
+    benchmark_summary s = {};
+
+    if (v.empty())
+        return s;
+
+    std::sort(v.begin(), v.end());
+
+    const size_t n = v.size();
+    const double h = 0.98*std::sqrt(double(n)); // 1.96*sqrt(n)/2 ranks around the median
+    const size_t l = size_t(std::max(0.0, std::floor(n/2.0 - h)));
+    const size_t u = size_t(std::min(double(n-1), std::ceil(n/2.0 + h)));
+
+    double sum = 0.0, sum2 = 0.0;
+
+    for (size_t i = 0; i < n; ++i)
+    {
+        sum  += double(v[i]);
+        sum2 += double(v[i])*double(v[i]);
+    }
+
+    s.min     = (long long)(v.front());
+    s.max     = (long long)(v.back());
+    s.median  = (long long)(v[n/2]);
+    s.ci_low  = (long long)(v[l]);
+    s.ci_high = (long long)(v[u]);
+    s.mean    = sum/n;
+    s.dev     = std::sqrt(std::max(0.0, sum2/n - s.mean*s.mean));
+    return s;
+}
+
+//------------------------------------------------------------------------------
+
+/// The harness itself. It is created on first use, at which point it pins the
+/// process if requested and warms the CPU up. Results recorded through it are 
+/// written as JSON at exit when MACH7_BENCH_JSON is set.
+class benchmark
+{
+public:
+
+    /// Measurements may be attributed to one of the two compared techniques
+    enum { sides = 2 };
+
+    static benchmark& instance()
+    {
+        static benchmark b;
+        return b;
+    }
+
+    /// Number of experiments to perform
+    size_t repetitions()  const { return m_repetitions; }
+    /// Number of measurements per experiment
+    size_t measurements() const { return m_measurements; }
+
+    /// Runs body once and returns its duration in time stamps. Hardware counters
+    /// are accumulated for the given side (0 or 1) until the next #record of it.
+    template <typename F>
+    long long measure(size_t side, F body)
+    {
+        long long before[perf_event_kinds] = {};
+        long long after [perf_event_kinds] = {};
+
+        m_counters.read(before);
+        time_stamp start  = get_time_stamp();
+        body();
+        time_stamp finish = get_time_stamp();
+        m_counters.read(after);
+
+        for (size_t k = 0; k < perf_event_kinds; ++k)
+            m_pending[side][k] += after[k] - before[k];
+
+        m_pending_runs[side]++;
+        return finish - start;
+    }
+
+    /// Records a series of timings of N iterations each, returning their summary 
+    /// in cycles per N iterations. Counters accumulated by #measure for side are
+    /// attributed to this series, unless side is not 0 or 1.
+    benchmark_summary record(const char* name, const std::vector<long long>& timings, size_t N, size_t side)
+    {
+        series s;
+        s.name       = name;
+        s.iterations = N;
+        s.samples    = timings.size();
+
+        std::vector<long long> c(timings.size());
+
+        for (size_t i = 0; i < timings.size(); ++i)
+            c[i] = cycles(timings[i]);
+
+        s.cycles = summarize(c);
+
+        for (size_t k = 0; k < perf_event_kinds; ++k)
+            s.counters[k] = -1.0;
+
+        if (side < sides)
+        {
+            for (size_t k = 0; k < perf_event_kinds; ++k)
+            {
+                if (m_counters.available(k) && m_pending_runs[side] && N)
+                    s.counters[k] = double(m_pending[side][k])/(double(m_pending_runs[side])*N);
+
+                m_pending[side][k] = 0;
+            }
+
+            m_pending_runs[side] = 0;
+        }
+
+        m_series.push_back(s);
+        return s.cycles;
+    }
+
+    /// Records the final comparison of two techniques from the medians of 
+    /// each of their experiments. The ratio is of the second to the first, so 
+    /// values below 1 mean the second technique is faster.
+    void verdict(const char* first, const char* second, size_t N, const std::vector<long long>& medians1, const std::vector<long long>& medians2)
+    {
+        comparison c;
+        c.first      = first;
+        c.second     = second;
+        c.iterations = N;
+        c.cycles1    = summarize(medians1).median;
+        c.cycles2    = summarize(medians2).median;
+
+        std::vector<double> ratios;
+
+        for (size_t i = 0; i < medians1.size() && i < medians2.size(); ++i)
+            if (medians1[i] > 0)
+                ratios.push_back(double(medians2[i])/medians1[i]);
+
+        std::sort(ratios.begin(), ratios.end());
+
+        if (ratios.empty())
+            c.ratio = c.ratio_low = c.ratio_high = 0.0;
+        else
+        {
+            const size_t n = ratios.size();
+            const double h = 0.98*std::sqrt(double(n));
+            c.ratio      = ratios[n/2];
+            c.ratio_low  = ratios[size_t(std::max(0.0, std::floor(n/2.0 - h)))];
+            c.ratio_high = ratios[size_t(std::min(double(n-1), std::ceil(n/2.0 + h)))];
+        }
+
+        m_comparisons.push_back(c);
+    }
+
+    /// Writes all the results recorded so far as JSON
+    std::ostream& write_json(std::ostream& os) const
+    {
+        os << "{\n  \"program\": \""  << m_program << '"'
+           << ",\n  \"frequency\": " << time_stamp_frequency
+           << ",\n  \"cpu\": "       << m_cpu
+           << ",\n  \"warmup_ms\": " << m_warmup_ms
+           << ",\n  \"series\": [";
+
+        for (size_t i = 0; i < m_series.size(); ++i)
+        {
+            const series& s = m_series[i];
+            os << (i ? ",\n    " : "\n    ")
+               << "{\"name\": \""    << s.name << '"'
+               << ", \"iterations\": " << s.iterations
+               << ", \"samples\": "    << s.samples
+               << ", \"cycles\": {\"min\": " << s.cycles.min
+               << ", \"median\": "   << s.cycles.median
+               << ", \"ci_low\": "   << s.cycles.ci_low
+               << ", \"ci_high\": "  << s.cycles.ci_high
+               << ", \"max\": "      << s.cycles.max
+               << ", \"mean\": "     << s.cycles.mean
+               << ", \"dev\": "      << s.cycles.dev << '}';
+
+            for (size_t k = 0; k < perf_event_kinds; ++k)
+                if (s.counters[k] >= 0.0)
+                    os << ", \"" << perf_event_name(k) << "_per_iteration\": " << s.counters[k];
+
+            os << '}';
+        }
+
+        os << "\n  ],\n  \"verdicts\": [";
+
+        for (size_t i = 0; i < m_comparisons.size(); ++i)
+        {
+            const comparison& c = m_comparisons[i];
+            os << (i ? ",\n    " : "\n    ")
+               << "{\"first\": \""    << c.first  << '"'
+               << ", \"second\": \""  << c.second << '"'
+               << ", \"iterations\": " << c.iterations
+               << ", \"cycles1\": "    << c.cycles1
+               << ", \"cycles2\": "    << c.cycles2
+               << ", \"ratio\": "      << c.ratio
+               << ", \"ratio_low\": "  << c.ratio_low
+               << ", \"ratio_high\": " << c.ratio_high << '}';
+        }
+
+        return os << "\n  ]\n}" << std::endl;
+    }
+
+private:
+
+    struct series
+    {
+        std::string       name;
+        size_t            iterations;
+        size_t            samples;
+        benchmark_summary cycles;
+        double            counters[perf_event_kinds]; ///< Per iteration or negative when not available
+    };
+
+    struct comparison
+    {
+        std::string first, second;
+        size_t      iterations;
+        long long   cycles1, cycles2;
+        double      ratio, ratio_low, ratio_high;
+    };
+
+    benchmark() :
+        m_program     (benchmark_program()),
+        m_repetitions (size_t(benchmark_option("MACH7_BENCH_REPETITIONS",  100))),
+        m_measurements(size_t(benchmark_option("MACH7_BENCH_MEASUREMENTS", 101))),
+        m_warmup_ms   (benchmark_option("MACH7_BENCH_WARMUP_MS", 250)),
+        m_cpu         (benchmark_option("MACH7_BENCH_CPU", -1))
+    {
+        std::memset(m_pending, 0, sizeof(m_pending));
+        std::memset(m_pending_runs, 0, sizeof(m_pending_runs));
+
+#if defined(__linux__)
+        if (m_cpu >= 0)
+        {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(int(m_cpu), &set);
+
+            if (sched_setaffinity(0, sizeof(set), &set) != 0)
+                m_cpu = -1;
+        }
+#else
+        m_cpu = -1; // Pinning is only supported on Linux
+#endif
+
+        // Spin to let the CPU leave its power-saving states before measuring
+        const time_stamp until = get_time_stamp() + time_stamp(m_warmup_ms*time_stamp_frequency/1000);
+        volatile size_t spin = 0;
+
+        while (get_time_stamp() < until)
+            spin = spin + 1;
+    }
+
+   ~benchmark()
+    {
+        const char* env  = std::getenv("MACH7_BENCH_JSON");
+        std::string path = env ? env : m_program + ".json";
+
+        if (path.empty() || m_series.empty())
+            return;
+
+        if (path == "-")
+        {
+            write_json(std::cout);
+            return;
+        }
+
+        std::ofstream file(path.c_str());
+
+        if (file)
+            write_json(file);
+        else
+            std::cerr << "ERROR: Cannot write benchmark results to " << path << std::endl;
+    }
+
+    std::string             m_program;
+    size_t                  m_repetitions;
+    size_t                  m_measurements;
+    long long               m_warmup_ms;
+    long long               m_cpu;
+    perf_counters           m_counters;
+    long long               m_pending[sides][perf_event_kinds];
+    size_t                  m_pending_runs[sides];
+    std::vector<series>     m_series;
+    std::vector<comparison> m_comparisons;
+};
+
+//------------------------------------------------------------------------------
+
+} // of namespace mch
@@ -0,0 +1,486 @@
+//
+//  Mach7: Pattern Matching Library for C++
+//
+//  Copyright 2011-2013, Texas A&M University.
+//  Copyright 2014 Yuriy Solodkyy.
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are met:
+//
+//      * Redistributions of source code must retain the above copyright
+//        notice, this list of conditions and the following disclaimer.
+//
+//      * Redistributions in binary form must reproduce the above copyright
+//        notice, this list of conditions and the following disclaimer in the
+//        documentation and/or other materials provided with the distribution.
+//
+//      * Neither the names of Mach7 project nor the names of its contributors
+//        may be used to endorse or promote products derived from this software
+//        without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+//  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+//  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+//  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY
+//  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+//  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+//  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+///
+/// \file
+///
+/// This file defines a tool that compares verdicts written by the benchmark
+/// harness (see benchmark.hpp) against a checked-in baseline and fails when 
+/// any of them regressed significantly. It is used by the check-benchmarks
+/// target, while update-benchmark-baseline uses it to rewrite the baseline.
+///
+/// Verdicts are ratios of the median time of the second technique (matching)
+/// to that of the first (visitors) together with a 95% confidence interval of
+/// that ratio over all the experiments. The interval only accounts for noise
+/// within a single process though: code and data placement differ between 
+/// runs of the same binary and move some ratios by 20-40%. Each program is
+/// thus run several times and results of the same verdict are combined into
+/// the median of their ratios with the range of those ratios as its interval.
+/// With 5 runs that range contains the true median with probability 94%.
+/// A verdict regressed when both:
+/// - its interval lies entirely above that of the baseline, and
+/// - its ratio exceeds the baseline ratio by more than the tolerance (5%).
+/// The first condition rules out noise, while the second one ignores changes
+/// too small to matter. Improvements are reported but never fail the check.
+///
+/// Usage: compare-benchmarks [--tolerance T] [--update] baseline.json results.json...
+///
+/// \author Yuriy Solodkyy <yuriy.solodkyy@gmail.com>
+///
+/// \see https://parasol.tamu.edu/mach7/
+/// \see https://github.com/solodon4/Mach7
+/// \see https://github.com/solodon4/SELL
+///
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+//------------------------------------------------------------------------------
+
+/// A JSON value: just enough to read what the benchmark harness writes
+struct json
+{
+    enum kind_type { null, boolean, number, string, array, object };
+
+    json() : kind(null), num(0.0) {}
+
+    kind_type                   kind;
+    double                      num;
+    std::string                 str;
+    std::vector<json>           items;   ///< Elements of an array
+    std::map<std::string, json> members; ///< Members of an object
+
+    /// Member of an object or null value when there is no such member
+    const json& operator[](const std::string& name) const
+    {
+        static const json none;
+        std::map<std::string, json>::const_iterator p = members.find(name);
+        return p == members.end() ? none : p->second;
+    }
+};
+
+//------------------------------------------------------------------------------
+
+/// Recursive-descent reader of JSON that throws std::runtime_error on errors
+class json_reader
+{
+public:
+
+    json_reader(const std::string& text) : m_text(text), m_pos(0) {}
+
+    json read()
+    {
+        json result = value();
+        skip();
+
+        if (m_pos != m_text.size())
+            fail("trailing characters");
+
+        return result;
+    }
+
+private:
+
+    void fail(const char* what) const
+    {
+        std::ostringstream os;
+        os << what << " at offset " << m_pos;
+        throw std::runtime_error(os.str());
+    }
+
+    void skip() { while (m_pos < m_text.size() && std::isspace((unsigned char)m_text[m_pos])) ++m_pos; }
+
+    bool accept(char c)
+    {
+        skip();
+
+        if (m_pos < m_text.size() && m_text[m_pos] == c)
+        {
+            ++m_pos;
+            return true;
+        }
+
+        return false;
+    }
+
+    void expect(char c) { if (!accept(c)) fail("unexpected character"); }
+
+    bool keyword(const char* word)
+    {
+        const std::string w(word);
+
+        if (m_text.compare(m_pos, w.size(), w) != 0)
+            return false;
+
+        m_pos += w.size();
+        return true;
+    }
+
+    std::string text()
+    {
+        std::string result;
+        expect('"');
+
+        while (m_pos < m_text.size() && m_text[m_pos] != '"')
+        {
+            if (m_text[m_pos] == '\\' && m_pos+1 < m_text.size())
+                ++m_pos; // Take the escaped character as is: the harness writes no \u escapes
+
+            result += m_text[m_pos++];
+        }
+
+        expect('"');
+        return result;
+    }
+
+    json value()
+    {
+        json result;
+        skip();
+
+        if (m_pos == m_text.size())
+            fail("unexpected end");
+
+        const char c = m_text[m_pos];
+
+        if (c == '{')
+        {
+            result.kind = json::object;
+            ++m_pos;
+
+            if (!accept('}'))
+            {
+                do
+                {
+                    skip();
+                    std::string name = text();
+                    expect(':');
+                    result.members[name] = value();
+                }
+                while (accept(','));
+
+                expect('}');
+            }
+        }
+        else
+        if (c == '[')
+        {
+            result.kind = json::array;
+            ++m_pos;
+
+            if (!accept(']'))
+            {
+                do result.items.push_back(value()); while (accept(','));
+                expect(']');
+            }
+        }
+        else
+        if (c == '"')
+        {
+            result.kind = json::string;
+            result.str  = text();
+        }
+        else
+        if (keyword("true"))
+        {
+            result.kind = json::boolean;
+            result.num  = 1.0;
+        }
+        else
+        if (keyword("false"))
+            result.kind = json::boolean;
+        else
+        if (keyword("null"))
+            result.kind = json::null;
+        else
+        {
+            const char* begin = m_text.c_str() + m_pos;
+            char*       end   = 0;
+            result.kind = json::number;
+            result.num  = std::strtod(begin, &end);
+
+            if (end == begin)
+                fail("unexpected character");
+
+            m_pos += end - begin;
+        }
+
+        return result;
+    }
+
+    const std::string& m_text;
+    std::string::size_type m_pos;
+};
+
+//------------------------------------------------------------------------------
+
+json read_json(const std::string& path)
+{
+    std::ifstream file(path.c_str());
+
+    if (!file)
+        throw std::runtime_error("cannot open " + path);
+
+    const std::string text((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    try
+    {
+        return json_reader(text).read();
+    }
+    catch (const std::runtime_error& e)
+    {
+        throw std::runtime_error(path + ": " + e.what());
+    }
+}
+
+//------------------------------------------------------------------------------
+
+/// A verdict of a program, identified by the program and its position there
+struct entry
+{
+    std::string program;
+    size_t      index;
+    std::string first;
+    std::string second;
+    double      iterations;
+    double      ratio;
+    double      ratio_low;
+    double      ratio_high;
+
+    std::string key() const
+    {
+        std::ostringstream os;
+        os << program << '#' << index;
+        return os.str();
+    }
+};
+
+entry make_entry(const std::string& program, size_t index, const json& v)
+{
+    entry e = {program, index, v["first"].str, v["second"].str, v["iterations"].num, v["ratio"].num, v["ratio_low"].num, v["ratio_high"].num};
+    return e;
+}
+
+//------------------------------------------------------------------------------
+
+/// Combines results of the same verdict from several runs of a program
+entry combine(std::vector<entry> runs)
+{
+    if (runs.size() == 1)
+        return runs[0]; // Only the confidence interval of a single run is known
+
+    std::vector<double> ratios;
+
+    for (size_t i = 0; i < runs.size(); ++i)
+        ratios.push_back(runs[i].ratio);
+
+    std::sort(ratios.begin(), ratios.end());
+
+    const size_t n = ratios.size();
+    entry result = runs[0];
+    result.ratio      = n % 2 ? ratios[n/2] : (ratios[n/2-1] + ratios[n/2]) / 2;
+    result.ratio_low  = ratios.front();
+    result.ratio_high = ratios.back();
+    return result;
+}
+
+//------------------------------------------------------------------------------
+
+void write_baseline(std::ostream& os, const std::vector<entry>& entries)
+{
+    os << "{\n  \"verdicts\": [";
+
+    for (size_t i = 0; i < entries.size(); ++i)
+    {
+        const entry& e = entries[i];
+        os << (i ? ",\n    " : "\n    ")
+           << "{\"program\": \""   << e.program << '"'
+           << ", \"index\": "      << e.index
+           << ", \"first\": \""    << e.first  << '"'
+           << ", \"second\": \""   << e.second << '"'
+           << ", \"iterations\": " << e.iterations
+           << ", \"ratio\": "      << e.ratio
+           << ", \"ratio_low\": "  << e.ratio_low
+           << ", \"ratio_high\": " << e.ratio_high << '}';
+    }
+
+    os << "\n  ]\n}" << std::endl;
+}
+
+//------------------------------------------------------------------------------
+
+int main(int argc, char* argv[])
+{
+    double tolerance = 0.05;
+    bool   update    = false;
+    std::vector<std::string> paths;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+
+        if (arg == "--tolerance" && i+1 < argc)
+            tolerance = std::atof(argv[++i]);
+        else
+        if (arg == "--update")
+            update = true;
+        else
+            paths.push_back(arg);
+    }
+
+    if (paths.size() < 2)
+    {
+        std::cerr << "Usage: " << argv[0] << " [--tolerance T] [--update] baseline.json results.json..." << std::endl;
+        return 2;
+    }
+
+    try
+    {
+        std::vector<std::vector<entry> > runs;  // All results of the same verdict
+        std::map<std::string,size_t>     index; // Key of a verdict to its position in runs
+
+        for (size_t i = 1; i < paths.size(); ++i)
+        {
+            const json  results  = read_json(paths[i]);
+            const json& verdicts = results["verdicts"];
+
+            for (size_t j = 0; j < verdicts.items.size(); ++j)
+            {
+                const entry e = make_entry(results["program"].str, j, verdicts.items[j]);
+                std::map<std::string,size_t>::const_iterator p = index.find(e.key());
+
+                if (p == index.end())
+                {
+                    index[e.key()] = runs.size();
+                    runs.push_back(std::vector<entry>(1, e));
+                }
+                else
+                    runs[p->second].push_back(e);
+            }
+        }
+
+        std::vector<entry> current;
+        current.reserve(runs.size());
+
+        for (size_t i = 0; i < runs.size(); ++i)
+            current.push_back(combine(runs[i]));
+
+        if (update)
+        {
+            std::ofstream file(paths[0].c_str());
+
+            if (!file)
+                throw std::runtime_error("cannot write " + paths[0]);
+
+            write_baseline(file, current);
+            std::cout << "Wrote " << current.size() << " verdicts to " << paths[0] << std::endl;
+            return 0;
+        }
+
+        const json  base_file = read_json(paths[0]);
+        const json& baseline  = base_file["verdicts"];
+        std::vector<bool> seen(current.size());
+        size_t regressions = 0, improvements = 0, missing = 0;
+
+        std::cout << std::left << std::setw(40) << "Verdict" << std::right 
+                  << std::setw(24) << "Baseline [range]" 
+                  << std::setw(24) << "Current [range]" << "  Status" << std::endl;
+
+        for (size_t i = 0; i < baseline.items.size(); ++i)
+        {
+            const json& b = baseline.items[i];
+            const entry base = make_entry(b["program"].str, size_t(b["index"].num), b);
+            std::map<std::string,size_t>::const_iterator p = index.find(base.key());
+            std::ostringstream was, now;
+
+            was << std::fixed << std::setprecision(2) << base.ratio << " [" << base.ratio_low << ',' << base.ratio_high << ']';
+            std::cout << std::left << std::setw(40) << base.key() + " " + base.second + "/" + base.first 
+                      << std::right << std::setw(24) << was.str();
+
+            if (p == index.end())
+            {
+                ++missing;
+                std::cout << std::setw(24) << "-" << "  MISSING" << std::endl;
+                continue;
+            }
+
+            const entry& cur = current[p->second];
+            seen[p->second] = true;
+            now << std::fixed << std::setprecision(2) << cur.ratio << " [" << cur.ratio_low << ',' << cur.ratio_high << ']';
+            std::cout << std::setw(24) << now.str();
+
+            if (base.ratio <= 0.0 || cur.ratio <= 0.0)
+                std::cout << "  SKIPPED (no timings)";
+            else
+            if (cur.ratio_low > base.ratio_high && cur.ratio > base.ratio*(1.0+tolerance))
+            {
+                ++regressions;
+                std::cout << "  REGRESSED by " << std::fixed << std::setprecision(1) << (cur.ratio/base.ratio-1.0)*100 << '%';
+            }
+            else
+            if (cur.ratio_high < base.ratio_low && cur.ratio*(1.0+tolerance) < base.ratio)
+            {
+                ++improvements;
+                std::cout << "  improved by " << std::fixed << std::setprecision(1) << (1.0-cur.ratio/base.ratio)*100 << '%';
+            }
+            else
+                std::cout << "  ok";
+
+            std::cout << std::endl;
+        }
+
+        for (size_t i = 0; i < current.size(); ++i)
+            if (!seen[i])
+                std::cout << std::left << std::setw(40) << current[i].key() << std::right << std::setw(48) << "" << "  new (not in baseline)" << std::endl;
+
+        std::cout << regressions << " regressed, " << improvements << " improved, " << missing << " missing out of " << baseline.items.size() << " verdicts in the baseline" << std::endl;
+        return regressions || missing ? 1 : 0;
+    }
+    catch (const std::runtime_error& e)
+    {
+        std::cerr << "ERROR: " << e.what() << std::endl;
+        return 2;
+    }
+}
+
+//------------------------------------------------------------------------------
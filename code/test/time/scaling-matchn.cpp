@@ -0,0 +1,183 @@
+//
+//  Mach7: Pattern Matching Library for C++
+//
+//  Copyright 2011-2013, Texas A&M University.
+//  Copyright 2014 Yuriy Solodkyy.
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are met:
+//
+//      * Redistributions of source code must retain the above copyright
+//        notice, this list of conditions and the following disclaimer.
+//
+//      * Redistributions in binary form must reproduce the above copyright
+//        notice, this list of conditions and the following disclaimer in the
+//        documentation and/or other materials provided with the distribution.
+//
+//      * Neither the names of Mach7 project nor the names of its contributors
+//        may be used to endorse or promote products derived from this software
+//        without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+//  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+//  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+//  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY
+//  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+//  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+//  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+///
+/// \file
+///
+/// This file is a part of Mach7 library test suite. It measures how the N-ary
+/// Match on two subjects scales with the number of threads.
+///
+/// \author Yuriy Solodkyy <yuriy.solodkyy@gmail.com>
+///
+/// \see https://parasol.tamu.edu/mach7/
+/// \see https://github.com/solodon4/Mach7
+/// \see https://github.com/solodon4/SELL
+///
+
+#include "testscaling.hpp"
+#include <mach7/type_switchN.hpp>          // Support for N-ary type switch statement
+#include "testrepeat.hpp"
+
+#undef  NUMBER_OF_DERIVED
+#define NUMBER_OF_DERIVED 10
+
+//------------------------------------------------------------------------------
+
+template <size_t N>
+struct shape_kind : OtherBase, Shape
+{
+    typedef Shape base_class;
+    shape_kind(size_t n = N) : base_class(n) {}
+    void accept(ShapeVisitor&) const;
+};
+
+//------------------------------------------------------------------------------
+
+struct ShapeVisitor
+{
+    #define FOR_EACH_MAX NUMBER_OF_DERIVED-1
+    #define FOR_EACH_N(N) virtual void visit(const shape_kind<N>&) {}
+    #include "loop_over_numbers.hpp"
+    #undef  FOR_EACH_N
+    #undef  FOR_EACH_MAX
+};
+
+//------------------------------------------------------------------------------
+
+template <size_t N> void shape_kind<N>::accept(ShapeVisitor& v) const { v.visit(*this); }
+
+//------------------------------------------------------------------------------
+
+#define MY_CASE_N_M(M,...) Case(shape_kind<__VA_ARGS__>,shape_kind<M>) return (__VA_ARGS__)*100 + M;
+
+XTL_TIMED_FUNC_BEGIN
+size_t do_match(const Shape& s1, const Shape& s2, size_t)
+{
+    Match(s1,s2)
+    {
+        #define FOR_EACH_MAX  NUMBER_OF_DERIVED-1
+        #define FOR_EACH_N(N) XTL_TEST_REPEAT(10, MY_CASE_N_M, N)
+        #include "loop_over_numbers.hpp"
+        #undef  FOR_EACH_N
+        #undef  FOR_EACH_MAX
+    }
+    EndMatch
+    return invalid;
+}
+XTL_TIMED_FUNC_END
+
+//------------------------------------------------------------------------------
+
+template <size_t M>
+struct VisitorFor : ShapeVisitor
+{
+    VisitorFor(const shape_kind<M>& s) : first(s), result(invalid) {}
+
+    #define FOR_EACH_MAX  NUMBER_OF_DERIVED-1
+    #define FOR_EACH_N(N) virtual void visit(const shape_kind<N>&) { result = M*100 + N; }
+    #include "loop_over_numbers.hpp"
+    #undef  FOR_EACH_N
+    #undef  FOR_EACH_MAX
+
+    const shape_kind<M>& first;
+    size_t               result;
+
+private:
+    VisitorFor& operator=(const VisitorFor&); ///< No assignment operator
+};
+
+//------------------------------------------------------------------------------
+
+struct Visitor : ShapeVisitor
+{
+    Visitor(const Shape& s) : second(s), result(invalid) {}
+
+    #define FOR_EACH_MAX  NUMBER_OF_DERIVED-1
+    #define FOR_EACH_N(N) virtual void visit(const shape_kind<N>& first) { VisitorFor<N> v(first); second.accept(v); result = v.result; }
+    #include "loop_over_numbers.hpp"
+    #undef  FOR_EACH_N
+    #undef  FOR_EACH_MAX
+
+    const Shape& second;
+    size_t       result;
+
+private:
+    Visitor& operator=(const Visitor&); ///< No assignment operator
+};
+
+//------------------------------------------------------------------------------
+
+XTL_TIMED_FUNC_BEGIN
+size_t do_visit(const Shape& s1, const Shape& s2, size_t)
+{
+    Visitor v(s2);
+    s1.accept(v);
+    return v.result;
+}
+XTL_TIMED_FUNC_END
+
+//------------------------------------------------------------------------------
+
+Shape* make_shape(size_t i)
+{
+    switch (i % NUMBER_OF_DERIVED)
+    {
+        #define FOR_EACH_MAX  NUMBER_OF_DERIVED-1
+        #define FOR_EACH_N(N) case N: return new shape_kind<N>;
+        #include "loop_over_numbers.hpp"
+        #undef  FOR_EACH_N
+        #undef  FOR_EACH_MAX
+    }
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+
+// Subjects come in pairs as there is an even number of both classes and random subjects
+size_t visit_subjects(size_t i) { return do_visit(*mch::subjects[i], *mch::subjects[i^1], i); }
+size_t match_subjects(size_t i) { return do_match(*mch::subjects[i], *mch::subjects[i^1], i); }
+
+//------------------------------------------------------------------------------
+
+int main()
+{
+    using namespace mch; // Mach7's library namespace
+
+    const std::vector<size_t> counts = thread_counts();
+    scaling_context ctx(counts.back());
+
+    make_subjects(make_shape, NUMBER_OF_DERIVED);
+    test_scaling(ctx, "Visitor", visit_subjects, "Match2", match_subjects, false);
+}
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,111 @@
+//
+//  Mach7: Pattern Matching Library for C++
+//
+//  Copyright 2011-2013, Texas A&M University.
+//  Copyright 2014 Yuriy Solodkyy.
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are met:
+//
+//      * Redistributions of source code must retain the above copyright
+//        notice, this list of conditions and the following disclaimer.
+//
+//      * Redistributions in binary form must reproduce the above copyright
+//        notice, this list of conditions and the following disclaimer in the
+//        documentation and/or other materials provided with the distribution.
+//
+//      * Neither the names of Mach7 project nor the names of its contributors
+//        may be used to endorse or promote products derived from this software
+//        without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+//  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+//  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+//  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY
+//  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+//  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+//  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+///
+/// \file
+///
+/// This file is a part of Mach7 library test suite. It measures how 
+/// memoized_cast scales with the number of threads in comparison to 
+/// dynamic_cast, which it memoizes.
+///
+/// \author Yuriy Solodkyy <yuriy.solodkyy@gmail.com>
+///
+/// \see https://parasol.tamu.edu/mach7/
+/// \see https://github.com/solodon4/Mach7
+/// \see https://github.com/solodon4/SELL
+///
+
+#include "testscaling.hpp"
+#include <mach7/memoized_cast.hpp>         // Support for memoized dynamic_cast
+
+//------------------------------------------------------------------------------
+
+template <size_t N>
+struct shape_kind : OtherBase, Shape
+{
+    shape_kind() : Shape(N) {}
+    void accept(ShapeVisitor&) const {}
+};
+
+//------------------------------------------------------------------------------
+
+Shape* make_shape(size_t i)
+{
+    switch (i % NUMBER_OF_DERIVED)
+    {
+        #define FOR_EACH_MAX  NUMBER_OF_DERIVED-1
+        #define FOR_EACH_N(N) case N: return new shape_kind<N>;
+        #include "loop_over_numbers.hpp"
+        #undef  FOR_EACH_N
+        #undef  FOR_EACH_MAX
+    }
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+
+// A cross-cast that always succeeds and a down-cast that mostly fails
+XTL_TIMED_FUNC_BEGIN
+size_t do_dynamic_cast(const Shape& s, size_t)
+{
+    return (dynamic_cast<const OtherBase*>(&s) != nullptr) + (dynamic_cast<const shape_kind<1>*>(&s) != nullptr);
+}
+XTL_TIMED_FUNC_END
+
+XTL_TIMED_FUNC_BEGIN
+size_t do_memoized_cast(const Shape& s, size_t)
+{
+    return (memoized_cast<const OtherBase*>(&s) != nullptr) + (memoized_cast<const shape_kind<1>*>(&s) != nullptr);
+}
+XTL_TIMED_FUNC_END
+
+//------------------------------------------------------------------------------
+
+size_t dynamic_cast_subject(size_t i)  { return do_dynamic_cast(*mch::subjects[i], i); }
+size_t memoized_cast_subject(size_t i) { return do_memoized_cast(*mch::subjects[i], i); }
+
+//------------------------------------------------------------------------------
+
+int main()
+{
+    using namespace mch; // Mach7's library namespace
+
+    const std::vector<size_t> counts = thread_counts();
+    scaling_context ctx(counts.back());
+
+    make_subjects(make_shape, NUMBER_OF_DERIVED);
+    // Offsets of each class are kept in a std::vector growing on demand
+    test_scaling(ctx, "dynamic_cast", dynamic_cast_subject, "memoized_cast", memoized_cast_subject, false);
+}
+
+//------------------------------------------------------------------------------
@@ -44,7 +44,7 @@
 
 #include <mach7/match.hpp>                 // Support for Match statement
 #include <mach7/patterns/constructor.hpp>  // Support for constructor patterns
-#include "timing.hpp"
+#include "testutils.hpp"
 #include "../unit/shape_bindings.hpp"
 #include <cmath>
 #include <iostream>
@@ -232,78 +232,49 @@ int dummy_vis(Shape* s)
     return v.result;
 }
 
+/// Compares f1 (visitors) against f2 (matching) on shape with the benchmark 
+/// harness, where both return a value of type R accumulated as an invariant
+template <typename R, typename F1, typename F2>
+void compare(Shape& shape, F1 f1, F2 f2)
+{
+    const size_t N = 10000;
+
+    mch::verdict v = mch::run_experiments<R>(
+        [&](std::vector<long long>& timings1, std::vector<long long>& timings2, R& a1, R& a2)
+        {
+            for (size_t m = 0; m < timings1.size(); ++m)
+            {
+                timings1[m] = mch::benchmark::instance().measure(0, [&] { for (size_t i = 0; i < N; ++i) a1 += f1(shape); });
+                timings2[m] = mch::benchmark::instance().measure(1, [&] { for (size_t i = 0; i < N; ++i) a2 += f2(shape); });
+            }
+
+            return N;
+        }
+    );
+
+    std::cout << "Verdict: \t" << v << std::endl;
+}
+
 void time_area(Shape& s)
 {
-    const int N = 10000;
-    double a1,a2;
-    mch::time_stamp liStart1 = mch::get_time_stamp();
-    for (int i = 0; i < N; ++i)
-        a1 = area_vis(s);
-    mch::time_stamp liFinish1 = mch::get_time_stamp();
-
-    mch::time_stamp liStart2 = mch::get_time_stamp();
-    for (int i = 0; i < N; ++i)
-        a2 = area(s);
-    mch::time_stamp liFinish2 = mch::get_time_stamp();
-
-    XTL_ASSERT(a1==a2); XTL_UNUSED(a1); XTL_UNUSED(a2); 
-
-    std::cout << "AreaV Time:" << mch::microseconds(liFinish1-liStart1) << std::endl;
-    std::cout << "AreaM Time:" << mch::microseconds(liFinish2-liStart2) << std::endl;
-    std::cout << (liFinish2-liStart2)*100/(liFinish1-liStart1)-100 << "% slower" << std::endl;
+    compare<double>(s, [](Shape& x) { return area_vis(x); }, [](Shape& x) { return area(x); });
 }
 
 void time_center(Shape& s)
 {
-    const int N = 10000;
-    loc c1,c2;
-    mch::time_stamp liStart1 = mch::get_time_stamp();
-    for (int i = 0; i < N; ++i)
-        c1 = center_vis(s);
-    mch::time_stamp liFinish1 = mch::get_time_stamp();
-
-    mch::time_stamp liStart2 = mch::get_time_stamp();
-    for (int i = 0; i < N; ++i)
-        c2 = center(s);
-    mch::time_stamp liFinish2 = mch::get_time_stamp();
-
-    XTL_ASSERT(c1==c2); XTL_UNUSED(c1); XTL_UNUSED(c2); 
-
-    std::cout << "CenterV Time:" << mch::microseconds(liFinish1-liStart1) << std::endl;
-    std::cout << "CenterM Time:" << mch::microseconds(liFinish2-liStart2) << std::endl;
-    std::cout << (liFinish2-liStart2)*100/(liFinish1-liStart1)-100 << "% slower" << std::endl;
+    // Centers are compared by the sum of their coordinates
+    compare<double>(s, [](Shape& x) { loc c = center_vis(x); return c.first+c.second; }, 
+                       [](Shape& x) { loc c = center(x);     return c.first+c.second; });
 }
 
 void time_dummy(Shape& s)
 {
-    const int N = 10000;
-    int c1,c2;
-    mch::time_stamp liStart1 = mch::get_time_stamp();
-    for (int i = 0; i < N; ++i)
-        c1 = dummy_vis(&s);
-    mch::time_stamp liFinish1 = mch::get_time_stamp();
-
-    mch::time_stamp liStart2 = mch::get_time_stamp();
-    for (int i = 0; i < N; ++i)
-        c2 = dummy(&s);
-    mch::time_stamp liFinish2 = mch::get_time_stamp();
-
-    mch::time_stamp liStart3 = mch::get_time_stamp();
-    for (int i = 0; i < N; ++i)
-        c2 = dummy_dyn(&s);
-    mch::time_stamp liFinish3 = mch::get_time_stamp();
-
-    XTL_ASSERT(c1==c2); XTL_UNUSED(c1); XTL_UNUSED(c2);
-
-    std::cout << "DummyV Time:" << mch::microseconds(liFinish1-liStart1) << std::endl;
-    std::cout << "DummyD Time:" << mch::microseconds(liFinish3-liStart3) << std::endl;
-    std::cout << "DummyM Time:" << mch::microseconds(liFinish2-liStart2) << std::endl;
-    
-    std::cout << (liFinish3-liStart3)*100/(liFinish1-liStart1)-100 << "% slower" << std::endl;
-    std::cout << (liFinish2-liStart2)*100/(liFinish1-liStart1)-100 << "% slower" << std::endl;
+    std::cout << "Dynamic cast" << std::endl;
+    compare<int>(s, [](Shape& x) { return dummy_vis(&x); }, [](Shape& x) { return dummy_dyn(&x); });
+    std::cout << "Matching" << std::endl;
+    compare<int>(s, [](Shape& x) { return dummy_vis(&x); }, [](Shape& x) { return dummy(&x); });
 }
 
-
 int main()
 {
     Shape* c = new Circle(loc(1,1),7);
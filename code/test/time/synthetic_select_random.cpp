@@ -70,30 +70,6 @@ template <size_t N> void shape_kind<N>::accept(ShapeVisitor& v) const { v.visit(
 
 //------------------------------------------------------------------------------
 
-#if XTL_USE_VTBL_FREQUENCY
-size_t frequency(const Shape& s)
-{
-    MatchP(s)
-    {
-        #define FOR_EACH_MAX  NUMBER_OF_DERIVED-1
-        #define FOR_EACH_N(N) CaseP(shape_kind<N>) return 10*N+7;
-        #include "loop_over_numbers.hpp"
-        #undef  FOR_EACH_N
-        #undef  FOR_EACH_MAX
-    }
-    EndMatchP
-    return invalid;
-}
-
-//size_t frequency(intptr_t vtbl) { return frequency(*reinterpret_cast<const Shape*>(&vtbl)); }
-namespace mch ///< Mach7 library namespace
-{
-template <> struct bindings<Shape> { FQS(frequency); };
-} // of namespace mch
-#endif
-
-//------------------------------------------------------------------------------
-
 #if 1
 XTL_TIMED_FUNC_BEGIN
 size_t do_match(const Shape& s, size_t)
@@ -166,10 +142,12 @@ int main()
     verdict pp = test_repetitive();
     verdict ps = test_sequential();
     verdict pr = test_randomized();
+    verdict pz = test_zipfian();
     std::cout << "OVERALL: "
               << "Repetitive: " << pp << "; "
               << "Sequential: " << ps << "; "
-              << "Random: "     << pr 
+              << "Random: "     << pr << "; "
+              << "Zipfian: "    << pz 
               << std::endl; 
 }
 
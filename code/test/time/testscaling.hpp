@@ -0,0 +1,536 @@
+//
+//  Mach7: Pattern Matching Library for C++
+//
+//  Copyright 2011-2013, Texas A&M University.
+//  Copyright 2014 Yuriy Solodkyy.
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are met:
+//
+//      * Redistributions of source code must retain the above copyright
+//        notice, this list of conditions and the following disclaimer.
+//
+//      * Redistributions in binary form must reproduce the above copyright
+//        notice, this list of conditions and the following disclaimer in the
+//        documentation and/or other materials provided with the distribution.
+//
+//      * Neither the names of Mach7 project nor the names of its contributors
+//        may be used to endorse or promote products derived from this software
+//        without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+//  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+//  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+//  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY
+//  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+//  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+//  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+///
+/// \file
+///
+/// Utilities of the scaling tests, which measure how the throughput of a type
+/// switch changes with the number of threads using it at the same time.
+///
+/// Each measurement processes all the items of a workload by a team of threads
+/// created once per program. Items are split in chunks: every thread first
+/// takes chunks of its own share of items and then steals chunks from shares
+/// of other threads, so that a thread delayed by the OS does not delay the
+/// whole measurement. Results are accumulated per thread in variables that
+/// occupy separate cache lines and are only summed once all threads are done.
+///
+/// Thread counts are swept from 1 to the number of hardware threads (or to
+/// MACH7_SCALING_THREADS when set) in powers of 2. Setting MACH7_BENCH_CPU
+/// is not recommended here as all the threads would inherit that pinning.
+/// Hardware counters of the harness only account for the main thread.
+///
+/// \author Yuriy Solodkyy <yuriy.solodkyy@gmail.com>
+///
+/// \see https://parasol.tamu.edu/mach7/
+/// \see https://github.com/solodon4/Mach7
+/// \see https://github.com/solodon4/SELL
+///
+
+#pragma once
+
+#include "testshape.hpp"
+#include <mach7/vtblstats.hpp>             // Misses of all vtbl maps to check their stability
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+namespace mch ///< Mach7 library namespace
+{
+
+//------------------------------------------------------------------------------
+
+/// A function processing item i of the workload
+typedef size_t (*scaling_kernel)(size_t i);
+
+/// Subjects of the workload: one object of each class followed by N random ones
+std::vector<Shape*> subjects;
+
+/// Number of different classes among the subjects, which come first in #subjects
+size_t subject_classes = 0;
+
+//------------------------------------------------------------------------------
+
+inline void make_subjects(Shape* (*make)(size_t), size_t classes)
+{
+    srand(unsigned(get_time_stamp()/get_frequency())); // Randomize pseudo random number generator
+
+    subject_classes = classes;
+    subjects.resize(classes + N);
+
+    for (size_t i = 0; i < classes; ++i)
+        subjects[i] = make(i);
+
+    for (size_t i = classes; i < subjects.size(); ++i)
+        subjects[i] = make(rand());
+}
+
+//------------------------------------------------------------------------------
+
+/// A value taking a cache line of its own when stored in an array, so that
+/// threads updating neighbouring values do not contend for the same line
+template <typename T>
+struct padded
+{
+    enum { cache_line = 64 };
+    padded() : value() {}
+    T    value;
+    char padding[cache_line > sizeof(T) ? cache_line - sizeof(T) : 1];
+};
+
+//------------------------------------------------------------------------------
+
+/// Distribution of items [0,n) among threads in chunks with work stealing
+class work_distribution
+{
+public:
+
+    enum { chunk = 64 }; ///< Number of items a thread claims at once
+
+    explicit work_distribution(size_t max_threads) : m_shares(new share[max_threads]), m_threads(0) {}
+
+    /// Splits items [first,last) into equal shares of the given number of threads
+    void reset(size_t first, size_t last, size_t threads)
+    {
+        const size_t n = last - first;
+        m_threads = threads;
+
+        for (size_t t = 0; t < threads; ++t)
+        {
+            m_shares[t].next.store(first + n*t/threads, std::memory_order_relaxed);
+            m_shares[t].end = first + n*(t+1)/threads;
+        }
+    }
+
+    /// Calls f(b,e) on chunks of items claimed by thread t: first from its own
+    /// share and then from shares of the other threads
+    template <typename F>
+    void run(size_t t, F f)
+    {
+        for (size_t k = 0; k < m_threads; ++k)
+        {
+            share& s = m_shares[(t + k) % m_threads];
+
+            for (;;)
+            {
+                const size_t b = s.next.fetch_add(chunk, std::memory_order_relaxed);
+
+                if (b >= s.end)
+                    break;
+
+                f(b, std::min(b + size_t(chunk), s.end));
+            }
+        }
+    }
+
+private:
+
+    struct share
+    {
+        share() : next(0), end(0) {}
+        std::atomic<size_t> next; ///< First item not claimed yet
+        size_t              end;  ///< End of the share
+        char                padding[64 - sizeof(std::atomic<size_t>) - sizeof(size_t)];
+    };
+
+    std::unique_ptr<share[]> m_shares;
+    size_t                   m_threads;
+};
+
+//------------------------------------------------------------------------------
+
+/// Threads created once and reused by all the measurements. The calling
+/// thread takes part in each run as thread 0.
+class thread_team
+{
+public:
+
+    explicit thread_team(size_t max_threads) : m_generation(0), m_active(0), m_pending(0), m_stop(false)
+    {
+        for (size_t t = 1; t < max_threads; ++t)
+            m_threads.push_back(std::thread(&thread_team::work, this, t));
+    }
+
+   ~thread_team()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+
+        m_start.notify_all();
+
+        for (size_t t = 0; t < m_threads.size(); ++t)
+            m_threads[t].join();
+    }
+
+    /// Calls job(t) for t in [0,threads) on different threads and waits for all of them
+    void run(size_t threads, const std::function<void(size_t)>& job)
+    {
+        XTL_ASSERT(threads <= m_threads.size()+1);
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_job     = &job;
+            m_active  = threads;
+            m_pending = threads-1;
+            ++m_generation;
+        }
+
+        if (threads > 1)
+            m_start.notify_all();
+
+        job(0);
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_done.wait(lock, [this] { return m_pending == 0; });
+    }
+
+private:
+
+    void work(size_t t)
+    {
+        size_t seen = 0; // Last generation of jobs seen by this thread
+
+        for (;;)
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_start.wait(lock, [this,seen] { return m_stop || m_generation != seen; });
+
+            if (m_stop)
+                return;
+
+            seen = m_generation;
+
+            if (t >= m_active)
+                continue;
+
+            const std::function<void(size_t)>& job = *m_job;
+            lock.unlock();
+            job(t);
+            lock.lock();
+
+            if (--m_pending == 0)
+                m_done.notify_one();
+        }
+    }
+
+    thread_team(const thread_team&);            ///< No copy constructor
+    thread_team& operator=(const thread_team&); ///< No assignment operator
+
+    std::vector<std::thread>           m_threads;
+    std::mutex                         m_mutex;
+    std::condition_variable            m_start;
+    std::condition_variable            m_done;
+    const std::function<void(size_t)>* m_job;
+    size_t                             m_generation;
+    size_t                             m_active;
+    size_t                             m_pending;
+    bool                               m_stop;
+};
+
+//------------------------------------------------------------------------------
+
+/// Thread counts of the sweep: powers of 2 below the maximum and the maximum
+inline std::vector<size_t> thread_counts()
+{
+    size_t max_threads = std::thread::hardware_concurrency();
+
+    if (const char* v = std::getenv("MACH7_SCALING_THREADS"))
+        max_threads = size_t(std::atoi(v));
+
+    if (max_threads == 0)
+        max_threads = 1;
+
+    std::vector<size_t> counts;
+
+    for (size_t t = 1; t < max_threads; t *= 2)
+        counts.push_back(t);
+
+    counts.push_back(max_threads);
+    return counts;
+}
+
+//------------------------------------------------------------------------------
+
+/// Everything a scaling test needs to run a kernel over items with some threads
+struct scaling_context
+{
+    explicit scaling_context(size_t max_threads) : team(max_threads), distribution(max_threads), results(max_threads) {}
+
+    /// Runs kernel f over items [first,last) with the given number of threads
+    /// and returns the sum of its results
+    size_t run(size_t threads, size_t first, size_t last, scaling_kernel f)
+    {
+        distribution.reset(first, last, threads);
+
+        team.run(threads, [this,f](size_t t)
+        {
+            size_t a = 0;
+
+            distribution.run(t, [&a,f](size_t b, size_t e)
+            {
+                for (size_t i = b; i < e; ++i)
+                    a += f(i);
+            });
+
+            results[t].value = a;
+        });
+
+        size_t a = 0;
+
+        for (size_t t = 0; t < threads; ++t)
+            a += results[t].value;
+
+        return a;
+    }
+
+    thread_team                   team;
+    work_distribution             distribution;
+    std::vector<padded<size_t> >  results;
+};
+
+//------------------------------------------------------------------------------
+
+/// Sum of misses of all the vtbl maps in the program
+inline size_t total_vtbl_map_misses()
+{
+    std::vector<vtbl_map_stats> maps = snapshot_vtbl_maps();
+    size_t misses = 0;
+
+    for (size_t i = 0; i < maps.size(); ++i)
+        misses += maps[i].misses;
+
+    return misses;
+}
+
+//------------------------------------------------------------------------------
+
+/// Warms up the tables of f by a pass over all the subjects in the calling
+/// thread and checks that a second pass does not miss in any vtbl map. Once
+/// this holds, f only reads its tables and can be used by several threads
+/// even when the tables do not support concurrent updates.
+inline bool warm_up(scaling_kernel f)
+{
+    size_t a = 0;
+
+    for (size_t i = 0; i < subjects.size(); ++i)
+        a += f(i);
+
+    const size_t misses = total_vtbl_map_misses();
+
+    for (size_t i = 0; i < subjects.size(); ++i)
+        a -= f(i);
+
+    XTL_ASSERT(a == 0);
+    XTL_UNUSED(a);
+    return total_vtbl_map_misses() == misses;
+}
+
+//------------------------------------------------------------------------------
+
+inline std::string with_threads(const char* name, size_t threads)
+{
+    std::ostringstream os;
+    os << name << '@' << threads;
+    return os.str();
+}
+
+//------------------------------------------------------------------------------
+
+inline long long median_of(std::vector<long long> v)
+{
+    std::sort(v.begin(), v.end());
+    return v[v.size()/2];
+}
+
+//------------------------------------------------------------------------------
+
+/// Compares throughput of kernels f1 and f2 over N random subjects for each
+/// thread count of the sweep. Both kernels share their tables among threads,
+/// which are warmed up in advance. When concurrent_updates is false, those
+/// tables do not support updates from several threads, so the kernels are
+/// only run by several threads when warming up left them read-only.
+inline void test_scaling(scaling_context& ctx, const char* first, scaling_kernel f1, const char* second, scaling_kernel f2, bool concurrent_updates)
+{
+    std::cout << "=================== Scaling: " << second << " vs. " << first << " ===================" << std::endl;
+
+    const bool stable = warm_up(f1) & warm_up(f2);
+
+    if (!stable && !concurrent_updates)
+        std::cout << "WARNING: Tables keep changing after warm up and do not support concurrent updates: only 1 thread will be used" << std::endl;
+
+    const std::vector<size_t> counts = thread_counts();
+    const size_t first_item = subject_classes, last_item = subjects.size();
+    long long base1 = 0, base2 = 0;
+
+    std::cout << "Wall time in cycles per item, speedup over 1 thread and verdict on thread time per item" << std::endl
+              << std::setw(7) << "Threads"
+              << std::setw(14) << first  << std::setw(10) << "Speedup"
+              << std::setw(14) << second << std::setw(10) << "Speedup"
+              << "  Verdict" << std::endl;
+
+    for (size_t c = 0; c < counts.size(); ++c)
+    {
+        const size_t threads = counts[c];
+
+        if (threads > 1 && !stable && !concurrent_updates)
+            break;
+
+        std::vector<long long> timings1(K*M), timings2(K*M), medians1(K), medians2(K);
+        size_t a1 = 0, a2 = 0;
+
+        for (size_t k = 0; k < K; ++k)
+        {
+            for (size_t m = 0; m < M; ++m)
+            {
+                timings1[k*M+m] = benchmark::instance().measure(0, [&] { a1 += ctx.run(threads, first_item, last_item, f1); });
+                timings2[k*M+m] = benchmark::instance().measure(1, [&] { a2 += ctx.run(threads, first_item, last_item, f2); });
+            }
+
+            medians1[k] = median_of(std::vector<long long>(timings1.begin()+k*M, timings1.begin()+(k+1)*M));
+            medians2[k] = median_of(std::vector<long long>(timings2.begin()+k*M, timings2.begin()+(k+1)*M));
+        }
+
+        XTL_ASSERT(a1 == a2);
+        XTL_UNUSED(a1);
+        XTL_UNUSED(a2);
+
+        const std::string name1 = with_threads(first,  threads);
+        const std::string name2 = with_threads(second, threads);
+        benchmark::instance().record(name1.c_str(), timings1, N, 0);
+        benchmark::instance().record(name2.c_str(), timings2, N, 1);
+        benchmark::instance().verdict(name1.c_str(), name2.c_str(), N, medians1, medians2);
+
+        const long long v = median_of(medians1), m = median_of(medians2);
+
+        if (c == 0)
+        {
+            base1 = v;
+            base2 = m;
+        }
+
+        std::cout << std::setw(7) << threads
+                  << std::setw(14) << cycles(v)/N << std::setw(9) << std::fixed << std::setprecision(2) << double(base1)/v << 'x'
+                  << std::setw(14) << cycles(m)/N << std::setw(9) << std::fixed << std::setprecision(2) << double(base2)/m << 'x'
+                  << "  " << verdict(N, v*threads, m*threads) << std::endl;
+    }
+}
+
+//------------------------------------------------------------------------------
+
+/// Measures a cold start of a shared table: all the threads start at once to
+/// look up every class, none of which has been seen by the table. Each kernel
+/// in kernels has a table of its own and is used for one measurement only.
+/// The verdict compares the time of a cold pass to that of the next (warm)
+/// pass over the same subjects. Tables that do not support concurrent updates
+/// are only measured with 1 thread.
+inline void test_cold_start(scaling_context& ctx, const char* name, const scaling_kernel* kernels, size_t rounds, bool concurrent_updates)
+{
+    std::cout << "=================== Cold start: " << name << " ===================" << std::endl;
+
+    if (!concurrent_updates)
+        std::cout << "WARNING: Tables do not support concurrent updates: only 1 thread will be used" << std::endl;
+
+    const std::vector<size_t> counts = thread_counts();
+    const size_t used_counts = concurrent_updates ? counts.size() : 1;
+    const size_t per_count   = std::max(size_t(1), rounds / used_counts);
+    const size_t classes     = subject_classes;
+    size_t       next        = 0; // Next fresh kernel
+
+    std::cout << "Time of the slowest thread in cycles per class" << std::endl
+              << std::setw(7) << "Threads" << std::setw(14) << "Cold" << std::setw(14) << "Warm"
+              << "  Verdict" << std::endl;
+
+    for (size_t c = 0; c < used_counts && next < rounds; ++c)
+    {
+        const size_t threads = counts[c];
+        std::vector<long long> cold, warm;
+
+        for (size_t r = 0; r < per_count && next < rounds; ++r)
+        {
+            const scaling_kernel f = kernels[next++];
+            std::vector<padded<long long> > durations(threads);
+            std::atomic<size_t> arrived(0);
+
+            // Once all the threads have arrived, each of them looks up all the
+            // classes starting from a different one and times only that
+            const std::function<void(size_t)> pass = [&](size_t t)
+            {
+                for (arrived.fetch_add(1); arrived.load() % threads != 0; )
+                    std::this_thread::yield();
+
+                const time_stamp start = get_time_stamp();
+                size_t a = 0;
+
+                for (size_t i = 0; i < classes; ++i)
+                    a += f((i + t*classes/threads) % classes);
+
+                durations[t].value = get_time_stamp() - start;
+                ctx.results[t].value = a;
+            };
+
+            // The time of a pass is that of the slowest thread
+            for (size_t p = 0; p < 2; ++p)
+            {
+                ctx.team.run(threads, pass);
+
+                long long slowest = 0;
+
+                for (size_t t = 0; t < threads; ++t)
+                    slowest = std::max(slowest, durations[t].value);
+
+                (p ? warm : cold).push_back(slowest);
+            }
+        }
+
+        const std::string name1 = with_threads("Warm", threads);
+        const std::string name2 = with_threads("Cold", threads);
+        benchmark::instance().record(name1.c_str(), warm, classes, 0);
+        benchmark::instance().record(name2.c_str(), cold, classes, 1);
+        benchmark::instance().verdict(name1.c_str(), name2.c_str(), classes, warm, cold);
+
+        const long long w = median_of(warm), m = median_of(cold);
+
+        std::cout << std::setw(7) << threads
+                  << std::setw(14) << cycles(m)/classes
+                  << std::setw(14) << cycles(w)/classes
+                  << "  " << verdict(classes, w, m) << std::endl;
+    }
+}
+
+//------------------------------------------------------------------------------
+
+} // of namespace mch
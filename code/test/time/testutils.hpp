@@ -58,7 +58,7 @@
 #include <vector>
 #include <mach7/config.hpp>                // Mach7 configuration
 #include <mach7/metatools.hpp>             // Support of mch::underlying<T>::type
-#include "timing.hpp"                      // Support of get_time_stamp and get_frequency
+#include "benchmark.hpp"                   // Support of warm-up, pinning, counters and JSON output
 
 #define NO_RANDOMIZATION
 
@@ -107,8 +107,8 @@ const size_t M = 5;     // Number of times time measuring is done
 const size_t K = 1;     // Number of experiment repetitions. Each experiment is M*N iterations
 #else
 const size_t N = 10000; // Number of times visitor and matching procedure is invoked in one time measuring
-const size_t M = 101;   // Number of times time measuring is done
-const size_t K = 100;   // Number of experiment repetitions. Each experiment is M*N iterations
+const size_t M = benchmark::instance().measurements(); // Number of times time measuring is done (101 by default)
+const size_t K = benchmark::instance().repetitions();  // Number of experiment repetitions. Each experiment is M*N iterations (100 by default)
 #endif
 
 //------------------------------------------------------------------------------
@@ -180,10 +180,14 @@ inline void statistics(std::vector<T>& measurements, T& min, T& max, T& avg, T&
 
 //------------------------------------------------------------------------------
 
-inline long long display(const char* name, std::vector<long long>& timings, size_t N)
+/// Prints statistics of the timings and records them with the benchmark harness.
+/// Hardware counters accumulated for the given side (0 or 1) are attributed to
+/// these timings.
+inline long long display(const char* name, std::vector<long long>& timings, size_t N, size_t side = size_t(-1))
 {
     long long min, max, avg, med, dev;
 
+    benchmark_summary summary = benchmark::instance().record(name, timings, N, side);
     statistics(timings, min, max, avg, med, dev); // Get statistics from timings
 
     std::fstream file;
@@ -224,6 +228,9 @@ inline long long display(const char* name, std::vector<long long>& timings, size
               << std::setw(7) << (med) << " --"
               << std::setw(8) << (max) << "]"
 #endif
+              << " Median CI95: ["
+              << std::setw(4) << summary.ci_low/N << " --"
+              << std::setw(4) << summary.ci_high/N << "]/iteration"
               << std::endl;
 
     return med;
@@ -277,16 +284,14 @@ inline long long test(Object* (*make)(int), int (*match)(Object*))
             for (size_t n = 0; n < N; ++n)
                 objects[n] = unique_objects[j++ % unique_objects_size];
 
-            time_stamp liStart  = get_time_stamp();
-
-            for (size_t i = 0; i < N; ++i)
-                a += match(objects[i]);
-
-            time_stamp liFinish = get_time_stamp();
-            timings[m] = liFinish-liStart;
+            timings[m] = benchmark::instance().measure(0, [&]
+            {
+                for (size_t i = 0; i < N; ++i)
+                    a += match(objects[i]);
+            });
         }
 
-        medians[k] = display("test", timings, N); // We are looking for a median per N iterations
+        medians[k] = display("test", timings, N, 0); // We are looking for a median per N iterations
     }
 
     // Destroy all the unique objects
@@ -320,17 +325,15 @@ inline long long test(Object* (*make)(int), int (*match)(Object*,Object*))
             for (size_t n = 0; n < N; ++n)
                 objects[n] = unique_objects[j++ % unique_objects_size];
 
-            time_stamp liStart  = get_time_stamp();
-
-            for (size_t i = 0; i < N; ++i)
-            for (size_t j = 0; j < N; ++j)
-                a += match(objects[i],objects[j]);
-
-            time_stamp liFinish = get_time_stamp();
-            timings[m] = liFinish-liStart;
+            timings[m] = benchmark::instance().measure(0, [&]
+            {
+                for (size_t i = 0; i < N; ++i)
+                for (size_t j = 0; j < N; ++j)
+                    a += match(objects[i],objects[j]);
+            });
         }
 
-        medians[k] = display("test", timings, N); // We are looking for a median per N iterations
+        medians[k] = display("test", timings, N, 0); // We are looking for a median per N iterations
     }
 
     // Destroy all the unique objects
@@ -364,18 +367,16 @@ inline long long test(Object* (*make)(int), int (*match)(Object*,Object*,Object*
             for (size_t n = 0; n < N; ++n)
                 objects[n] = unique_objects[j++ % unique_objects_size];
 
-            time_stamp liStart  = get_time_stamp();
-
-            for (size_t i = 0; i < N; ++i)
-            for (size_t j = 0; j < N; ++j)
-            for (size_t l = 0; l < N; ++l)
-                a += match(objects[i],objects[j],objects[l]);
-
-            time_stamp liFinish = get_time_stamp();
-            timings[m] = liFinish-liStart;
+            timings[m] = benchmark::instance().measure(0, [&]
+            {
+                for (size_t i = 0; i < N; ++i)
+                for (size_t j = 0; j < N; ++j)
+                for (size_t l = 0; l < N; ++l)
+                    a += match(objects[i],objects[j],objects[l]);
+            });
         }
 
-        medians[k] = display("test", timings, N); // We are looking for a median per N iterations
+        medians[k] = display("test", timings, N, 0); // We are looking for a median per N iterations
     }
 
     // Destroy all the unique objects
@@ -409,19 +410,17 @@ inline long long test(Object* (*make)(int), int (*match)(Object*,Object*,Object*
             for (size_t n = 0; n < N; ++n)
                 objects[n] = unique_objects[j++ % unique_objects_size];
 
-            time_stamp liStart  = get_time_stamp();
-
-            for (size_t i = 0; i < N; ++i)
-            for (size_t j = 0; j < N; ++j)
-            for (size_t l = 0; l < N; ++l)
-            for (size_t h = 0; h < N; ++h)
-                a += match(objects[i],objects[j],objects[l],objects[h]);
-
-            time_stamp liFinish = get_time_stamp();
-            timings[m] = liFinish-liStart;
+            timings[m] = benchmark::instance().measure(0, [&]
+            {
+                for (size_t i = 0; i < N; ++i)
+                for (size_t j = 0; j < N; ++j)
+                for (size_t l = 0; l < N; ++l)
+                for (size_t h = 0; h < N; ++h)
+                    a += match(objects[i],objects[j],objects[l],objects[h]);
+            });
         }
 
-        medians[k] = display("test", timings, N); // We are looking for a median per N iterations
+        medians[k] = display("test", timings, N, 0); // We are looking for a median per N iterations
     }
 
     // Destroy all the unique objects
@@ -434,51 +433,14 @@ inline long long test(Object* (*make)(int), int (*match)(Object*,Object*,Object*
 
 //------------------------------------------------------------------------------
 
-template <typename R, typename A, R (&f1)(A), R (&f2)(A)>
-inline size_t get_timings1(
-        std::vector<typename underlying<A>::type>& arguments,
-        std::vector<long long>& timings1, 
-        std::vector<long long>& timings2,
-        R&                      a1,
-        R&                      a2
-     )
-{
-    XTL_ASSERT(timings1.size() == timings2.size());
-
-    size_t N = arguments.size();
-    size_t M = timings1.size();
-
-    for (size_t m = 0; m < M; ++m)
-    {
-        time_stamp liStart1 = get_time_stamp();
-
-        for (size_t i = 0; i < N; ++i)
-            a1 += f1(arguments[i]);
-
-        time_stamp liFinish1 = get_time_stamp();
-
-        time_stamp liStart2 = get_time_stamp();
-
-        for (size_t i = 0; i < N; ++i)
-            a2 += f2(arguments[i]);
-
-        time_stamp liFinish2 = get_time_stamp();
-
-        XTL_ASSERT(a1==a2);
-
-        timings1[m] = liFinish1-liStart1;
-        timings2[m] = liFinish2-liStart2;
-    }
-
-	return N; // Number of iterations per measurement
-}
-
-//------------------------------------------------------------------------------
-
-template <typename R, typename A, R (&f1)(A), R (&f2)(A)>
-inline verdict get_timings1(std::vector<typename underlying<A>::type>& arguments)
+/// Runs K experiments comparing two functions, where each experiment calls
+/// measure(timings1, timings2, a1, a2) to get M timings of each function and
+/// the number of iterations they represent. Every experiment is displayed and
+/// the final comparison is recorded with the benchmark harness.
+template <typename R, typename F>
+inline verdict run_experiments(F measure)
 {
-	size_t N = 0;
+    size_t N = 0;
     std::vector<long long> medians1(K); // Final verdict of medians for each of the K experiments with visitors
     std::vector<long long> medians2(K); // Final verdict of medians for each of the K experiments with matching
     std::vector<long long> timings1(M); 
@@ -488,9 +450,9 @@ inline verdict get_timings1(std::vector<typename underlying<A>::type>& arguments
 
     for (size_t k = 0; k < K; ++k)
     {
-        N = get_timings1<R,A,f1,f2>(arguments, timings1, timings2, a1, a2);
-        medians1[k] = display("F1", timings1, N);
-        medians2[k] = display("F2", timings2, N);
+        N = measure(timings1, timings2, a1, a2);
+        medians1[k] = display("F1", timings1, N, 0);
+        medians2[k] = display("F2", timings2, N, 1);
         
         std::ios_base::fmtflags fmt = std::cout.flags(); // use cout flags function to save original format
         std::cout << "\t\t" << verdict(N, medians1[k], medians2[k]) << "\t\t" 
@@ -506,6 +468,8 @@ inline verdict get_timings1(std::vector<typename underlying<A>::type>& arguments
         exit(42);
     }
 
+    benchmark::instance().verdict("F1", "F2", N, medians1, medians2);
+
     std::sort(medians1.begin(), medians1.end());
     std::sort(medians2.begin(), medians2.end());
     return verdict(N,medians1[K/2],medians2[K/2]);
@@ -513,8 +477,8 @@ inline verdict get_timings1(std::vector<typename underlying<A>::type>& arguments
 
 //------------------------------------------------------------------------------
 
-template <typename R, typename A, R (&f1)(A,A), R (&f2)(A,A)>
-inline size_t get_timings2(
+template <typename R, typename A, R (&f1)(A), R (&f2)(A)>
+inline size_t get_timings1(
         std::vector<typename underlying<A>::type>& arguments,
         std::vector<long long>& timings1, 
         std::vector<long long>& timings2,
@@ -529,24 +493,68 @@ inline size_t get_timings2(
 
     for (size_t m = 0; m < M; ++m)
     {
-        time_stamp liStart1 = get_time_stamp();
+        timings1[m] = benchmark::instance().measure(0, [&]
+        {
+            for (size_t i = 0; i < N; ++i)
+                a1 += f1(arguments[i]);
+        });
 
-        for (size_t i = 0; i < N-1; i += 2)
-            a1 += f1(arguments[i],arguments[i+1]);
+        timings2[m] = benchmark::instance().measure(1, [&]
+        {
+            for (size_t i = 0; i < N; ++i)
+                a2 += f2(arguments[i]);
+        });
 
-        time_stamp liFinish1 = get_time_stamp();
+        XTL_ASSERT(a1==a2);
+    }
 
-        time_stamp liStart2 = get_time_stamp();
+	return N; // Number of iterations per measurement
+}
 
-        for (size_t i = 0; i < N-1; i += 2)
-            a2 += f2(arguments[i],arguments[i+1]);
+//------------------------------------------------------------------------------
 
-        time_stamp liFinish2 = get_time_stamp();
+template <typename R, typename A, R (&f1)(A), R (&f2)(A)>
+inline verdict get_timings1(std::vector<typename underlying<A>::type>& arguments)
+{
+    return run_experiments<R>(
+               [&arguments](std::vector<long long>& timings1, std::vector<long long>& timings2, R& a1, R& a2)
+               {
+                   return get_timings1<R,A,f1,f2>(arguments, timings1, timings2, a1, a2);
+               }
+           );
+}
 
-        XTL_ASSERT(a1==a2);
+//------------------------------------------------------------------------------
+
+template <typename R, typename A, R (&f1)(A,A), R (&f2)(A,A)>
+inline size_t get_timings2(
+        std::vector<typename underlying<A>::type>& arguments,
+        std::vector<long long>& timings1, 
+        std::vector<long long>& timings2,
+        R&                      a1,
+        R&                      a2
+     )
+{
+    XTL_ASSERT(timings1.size() == timings2.size());
+
+    size_t N = arguments.size();
+    size_t M = timings1.size();
 
-        timings1[m] = liFinish1-liStart1;
-        timings2[m] = liFinish2-liStart2;
+    for (size_t m = 0; m < M; ++m)
+    {
+        timings1[m] = benchmark::instance().measure(0, [&]
+        {
+            for (size_t i = 0; i < N-1; i += 2)
+                a1 += f1(arguments[i],arguments[i+1]);
+        });
+
+        timings2[m] = benchmark::instance().measure(1, [&]
+        {
+            for (size_t i = 0; i < N-1; i += 2)
+                a2 += f2(arguments[i],arguments[i+1]);
+        });
+
+        XTL_ASSERT(a1==a2);
     }
 
 	return N/2; // Number of iterations per measurement
@@ -557,37 +565,12 @@ inline size_t get_timings2(
 template <typename R, typename A, R (&f1)(A,A), R (&f2)(A,A)>
 inline verdict get_timings2(std::vector<typename underlying<A>::type>& arguments)
 {
-	size_t N = 0;
-    std::vector<long long> medians1(K); // Final verdict of medians for each of the K experiments with visitors
-    std::vector<long long> medians2(K); // Final verdict of medians for each of the K experiments with matching
-    std::vector<long long> timings1(M); 
-    std::vector<long long> timings2(M);
-    R a1 = R();
-    R a2 = R();
-
-    for (size_t k = 0; k < K; ++k)
-    {
-        N = get_timings2<R,A,f1,f2>(arguments, timings1, timings2, a1, a2);
-        medians1[k] = display("F1", timings1, N);
-        medians2[k] = display("F2", timings2, N);
-        
-        std::ios_base::fmtflags fmt = std::cout.flags(); // use cout flags function to save original format
-        std::cout << "\t\t" << verdict(N, medians1[k], medians2[k]) << "\t\t" 
-                  << " a1=" << std::setw(8) << std::hex << a1 
-                  << " a2=" << std::setw(8) << std::hex << a2 
-                  << std::endl;
-        std::cout.flags(fmt); // restore format
-    }
-
-    if (a1 != a2)
-    {
-        std::cout << "ERROR: Invariant " << a1 << "==" << a2 << " doesn't hold." << std::endl;
-        exit(42);
-    }
-
-    std::sort(medians1.begin(), medians1.end());
-    std::sort(medians2.begin(), medians2.end());
-    return verdict(N,medians1[K/2],medians2[K/2]);
+    return run_experiments<R>(
+               [&arguments](std::vector<long long>& timings1, std::vector<long long>& timings2, R& a1, R& a2)
+               {
+                   return get_timings2<R,A,f1,f2>(arguments, timings1, timings2, a1, a2);
+               }
+           );
 }
 
 //------------------------------------------------------------------------------
@@ -608,24 +591,19 @@ inline size_t get_timings3(
 
     for (size_t m = 0; m < M; ++m)
     {
-        time_stamp liStart1 = get_time_stamp();
-
-        for (size_t i = 0; i < N-2; i += 3)
-            a1 += f1(arguments[i],arguments[i+1],arguments[i+2]);
-
-        time_stamp liFinish1 = get_time_stamp();
-
-        time_stamp liStart2 = get_time_stamp();
-
-        for (size_t i = 0; i < N-2; i += 3)
-            a2 += f2(arguments[i],arguments[i+1],arguments[i+2]);
+        timings1[m] = benchmark::instance().measure(0, [&]
+        {
+            for (size_t i = 0; i < N-2; i += 3)
+                a1 += f1(arguments[i],arguments[i+1],arguments[i+2]);
+        });
 
-        time_stamp liFinish2 = get_time_stamp();
+        timings2[m] = benchmark::instance().measure(1, [&]
+        {
+            for (size_t i = 0; i < N-2; i += 3)
+                a2 += f2(arguments[i],arguments[i+1],arguments[i+2]);
+        });
 
         XTL_ASSERT(a1==a2);
-
-        timings1[m] = liFinish1-liStart1;
-        timings2[m] = liFinish2-liStart2;
     }
 
 	return N/3; // Number of iterations per measurement
@@ -636,37 +614,12 @@ inline size_t get_timings3(
 template <typename R, typename A, R (&f1)(A,A,A), R (&f2)(A,A,A)>
 inline verdict get_timings3(std::vector<typename underlying<A>::type>& arguments)
 {
-	size_t N = 0;
-    std::vector<long long> medians1(K); // Final verdict of medians for each of the K experiments with visitors
-    std::vector<long long> medians2(K); // Final verdict of medians for each of the K experiments with matching
-    std::vector<long long> timings1(M); 
-    std::vector<long long> timings2(M);
-    R a1 = R();
-    R a2 = R();
-
-    for (size_t k = 0; k < K; ++k)
-    {
-        N = get_timings3<R,A,f1,f2>(arguments, timings1, timings2, a1, a2);
-        medians1[k] = display("F1", timings1, N);
-        medians2[k] = display("F2", timings2, N);
-        
-        std::ios_base::fmtflags fmt = std::cout.flags(); // use cout flags function to save original format
-        std::cout << "\t\t" << verdict(N, medians1[k], medians2[k]) << "\t\t" 
-                  << " a1=" << std::setw(8) << std::hex << a1 
-                  << " a2=" << std::setw(8) << std::hex << a2 
-                  << std::endl;
-        std::cout.flags(fmt); // restore format
-    }
-
-    if (a1 != a2)
-    {
-        std::cout << "ERROR: Invariant " << a1 << "==" << a2 << " doesn't hold." << std::endl;
-        exit(42);
-    }
-
-    std::sort(medians1.begin(), medians1.end());
-    std::sort(medians2.begin(), medians2.end());
-    return verdict(N,medians1[K/2],medians2[K/2]);
+    return run_experiments<R>(
+               [&arguments](std::vector<long long>& timings1, std::vector<long long>& timings2, R& a1, R& a2)
+               {
+                   return get_timings3<R,A,f1,f2>(arguments, timings1, timings2, a1, a2);
+               }
+           );
 }
 
 //------------------------------------------------------------------------------
@@ -687,24 +640,19 @@ inline size_t get_timings4(
 
     for (size_t m = 0; m < M; ++m)
     {
-        time_stamp liStart1 = get_time_stamp();
-
-        for (size_t i = 0; i < N-3; i += 4)
-            a1 += f1(arguments[i],arguments[i+1],arguments[i+2],arguments[i+3]);
-
-        time_stamp liFinish1 = get_time_stamp();
-
-        time_stamp liStart2 = get_time_stamp();
-
-        for (size_t i = 0; i < N-3; i += 4)
-            a2 += f2(arguments[i],arguments[i+1],arguments[i+2],arguments[i+3]);
+        timings1[m] = benchmark::instance().measure(0, [&]
+        {
+            for (size_t i = 0; i < N-3; i += 4)
+                a1 += f1(arguments[i],arguments[i+1],arguments[i+2],arguments[i+3]);
+        });
 
-        time_stamp liFinish2 = get_time_stamp();
+        timings2[m] = benchmark::instance().measure(1, [&]
+        {
+            for (size_t i = 0; i < N-3; i += 4)
+                a2 += f2(arguments[i],arguments[i+1],arguments[i+2],arguments[i+3]);
+        });
 
         XTL_ASSERT(a1==a2);
-
-        timings1[m] = liFinish1-liStart1;
-        timings2[m] = liFinish2-liStart2;
     }
 
 	return N/4; // Number of iterations per measurement
@@ -715,37 +663,12 @@ inline size_t get_timings4(
 template <typename R, typename A, R (&f1)(A,A,A,A), R (&f2)(A,A,A,A)>
 inline verdict get_timings4(std::vector<typename underlying<A>::type>& arguments)
 {
-    size_t N = 0;
-    std::vector<long long> medians1(K); // Final verdict of medians for each of the K experiments with visitors
-    std::vector<long long> medians2(K); // Final verdict of medians for each of the K experiments with matching
-    std::vector<long long> timings1(M); 
-    std::vector<long long> timings2(M);
-    R a1 = R();
-    R a2 = R();
-
-    for (size_t k = 0; k < K; ++k)
-    {
-        N = get_timings4<R,A,f1,f2>(arguments, timings1, timings2, a1, a2);
-        medians1[k] = display("F1", timings1, N);
-        medians2[k] = display("F2", timings2, N);
-        
-        std::ios_base::fmtflags fmt = std::cout.flags(); // use cout flags function to save original format
-        std::cout << "\t\t" << verdict(N, medians1[k], medians2[k]) << "\t\t" 
-                  << " a1=" << std::setw(8) << std::hex << a1 
-                  << " a2=" << std::setw(8) << std::hex << a2 
-                  << std::endl;
-        std::cout.flags(fmt); // restore format
-    }
-
-    if (a1 != a2)
-    {
-        std::cout << "ERROR: Invariant " << a1 << "==" << a2 << " doesn't hold." << std::endl;
-        exit(42);
-    }
-
-    std::sort(medians1.begin(), medians1.end());
-    std::sort(medians2.begin(), medians2.end());
-    return verdict(N,medians1[K/2],medians2[K/2]);
+    return run_experiments<R>(
+               [&arguments](std::vector<long long>& timings1, std::vector<long long>& timings2, R& a1, R& a2)
+               {
+                   return get_timings4<R,A,f1,f2>(arguments, timings1, timings2, a1, a2);
+               }
+           );
 }
 
 //------------------------------------------------------------------------------
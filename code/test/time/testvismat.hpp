@@ -160,56 +160,51 @@ size_t run_timings_parallel(
         //unsigned char j = 0;
         size_t l = 0;
 
-        time_stamp liStart1 = get_time_stamp();   // <- Begin timing
-
-        std::thread threadsV[num_extra_threads];
-
-        aa = 0; // Reset atomic accumulator
+        timingsV[m] = benchmark::instance().measure(0, [&]   // <- Timed
+        {
+            std::thread threadsV[num_extra_threads];
 
-        // Launch num_extra_threads additional threads given each of them chunk from l to l+c:
-        for (size_t i = 0; i < num_extra_threads; ++i, l += C) 
-            threadsV[i] = std::thread(partial_do_visit, std::ref(shapes), l, l+C, std::ref(aa));
+            aa = 0; // Reset atomic accumulator
 
-        // Do the last chunk in the main thread
-        partial_do_visit(shapes, l, N, aa);
+            // Launch num_extra_threads additional threads given each of them chunk from l to l+c:
+            for (size_t i = 0; i < num_extra_threads; ++i, l += C) 
+                threadsV[i] = std::thread(partial_do_visit, std::ref(shapes), l, l+C, std::ref(aa));
 
-        // Join the threads with the main thread
-        for (size_t i = 0; i < num_extra_threads; ++i)
-            threadsV[i].join(); 
+            // Do the last chunk in the main thread
+            partial_do_visit(shapes, l, N, aa);
 
-        aV += aa;
+            // Join the threads with the main thread
+            for (size_t i = 0; i < num_extra_threads; ++i)
+                threadsV[i].join(); 
 
-        time_stamp liFinish1 = get_time_stamp();  // <- End timing
+            aV += aa;
+        });
 
         //j = 0;
         l  = 0;
         aa = 0; // Reset atomic accumulator
 
-        time_stamp liStart2 = get_time_stamp();   // <- Begin timing
-
-        std::thread threadsM[num_extra_threads];
-
-        aa = 0; // Reset atomic accumulator
+        timingsM[m] = benchmark::instance().measure(1, [&]   // <- Timed
+        {
+            std::thread threadsM[num_extra_threads];
 
-        // Launch num_extra_threads additional threads given each of them chunk from l to l+c:
-        for (size_t i = 0; i < num_extra_threads; ++i, l += C) 
-            threadsM[i] = std::thread(partial_do_match, std::ref(shapes), l, l+C, std::ref(aa));
+            aa = 0; // Reset atomic accumulator
 
-        // Do the last chunk in the main thread
-        partial_do_match(shapes, l, N, aa);
+            // Launch num_extra_threads additional threads given each of them chunk from l to l+c:
+            for (size_t i = 0; i < num_extra_threads; ++i, l += C) 
+                threadsM[i] = std::thread(partial_do_match, std::ref(shapes), l, l+C, std::ref(aa));
 
-        // Join the threads with the main thread
-        for (size_t i = 0; i < num_extra_threads; ++i)
-            threadsM[i].join(); 
+            // Do the last chunk in the main thread
+            partial_do_match(shapes, l, N, aa);
 
-        aM += aa;
+            // Join the threads with the main thread
+            for (size_t i = 0; i < num_extra_threads; ++i)
+                threadsM[i].join(); 
 
-        time_stamp liFinish2 = get_time_stamp();  // <- End timing
+            aM += aa;
+        });
 
         XTL_ASSERT(aV==aM);
-
-        timingsV[m] = liFinish1-liStart1;
-        timingsM[m] = liFinish2-liStart2;
     }
 
     return N; // Number of iterations per measurement
@@ -236,8 +231,8 @@ verdict test_sequential()
     for (size_t k = 0; k < K; ++k)
     {
         n = run_timings(shapes, timingsV, timingsM, a1, a2);
-        mediansV[k] = display("AreaVisSeq", timingsV, n);
-        mediansM[k] = display("AreaMatSeq", timingsM, n);
+        mediansV[k] = display("AreaVisSeq", timingsV, n, 0);
+        mediansM[k] = display("AreaMatSeq", timingsM, n, 1);
 
         std::ios_base::fmtflags fmt = std::cout.flags(); // use cout flags function to save original format
         std::cout << "\t\t" << verdict(n, mediansV[k], mediansM[k]) << "\t\t" 
@@ -259,6 +254,8 @@ verdict test_sequential()
         exit(42);
     }
 
+    benchmark::instance().verdict("AreaVisSeq", "AreaMatSeq", n, mediansV, mediansM);
+
     std::sort(mediansV.begin(), mediansV.end());
     std::sort(mediansM.begin(), mediansM.end());
     return verdict(n,mediansV[K/2],mediansM[K/2]);
@@ -286,8 +283,79 @@ verdict test_randomized()
     for (size_t k = 0; k < K; ++k)
     {
         n = run_timings(shapes, timingsV, timingsM, a1, a2);
-        mediansV[k] = display("AreaVisRnd", timingsV, n);
-        mediansM[k] = display("AreaMatRnd", timingsM, n);
+        mediansV[k] = display("AreaVisRnd", timingsV, n, 0);
+        mediansM[k] = display("AreaMatRnd", timingsM, n, 1);
+        
+        std::ios_base::fmtflags fmt = std::cout.flags(); // use cout flags function to save original format
+        std::cout << "\t\t" << verdict(n, mediansV[k], mediansM[k]) << "\t\t" 
+                  << " a1=" << std::setw(8) << std::hex << a1 
+                  << " a2=" << std::setw(8) << std::hex << a2 
+                  << std::endl;
+        std::cout.flags(fmt); // restore format
+    }
+
+    for (size_t i = 0; i < N; ++i)
+    {
+        delete shapes[i];
+        shapes[i] = 0;
+    }
+
+    if (a1 != a2)
+    {
+        std::cout << "ERROR: Invariant " << a1 << "==" << a2 << " doesn't hold." << std::endl;
+        exit(42);
+    }
+
+    benchmark::instance().verdict("AreaVisRnd", "AreaMatRnd", n, mediansV, mediansM);
+
+    std::sort(mediansV.begin(), mediansV.end());
+    std::sort(mediansM.begin(), mediansM.end());
+    return verdict(n,mediansV[K/2],mediansM[K/2]);
+}
+
+//------------------------------------------------------------------------------
+
+/// Draws shapes with Zipfian (s=1) distribution over the NUMBER_OF_DERIVED kinds:
+/// the kind of rank r is picked with probability proportional to 1/r. Ranks are
+/// assigned to kinds in random order, so the hot classes are scattered around
+/// the hierarchy rather than being its first few members. This is the workload
+/// XTL_USE_VTBL_FREQUENCY is meant for.
+verdict test_zipfian()
+{
+#if !defined(NO_RANDOMIZATION)
+    srand (unsigned(get_time_stamp()/get_frequency())); // Randomize pseudo random number generator
+#endif
+    std::cout << "==================== Zipfian Test =====================" << std::endl;
+
+    size_t n = 0, a1 = 0, a2 = 0;
+    std::vector<long long> mediansV(K); // Final verdict of medians for each of the K experiments with visitors
+    std::vector<long long> mediansM(K); // Final verdict of medians for each of the K experiments with matching
+    std::vector<long long> timingsV(M);
+    std::vector<long long> timingsM(M);
+    std::vector<Shape*>    shapes(N);
+    std::vector<size_t>    kinds(NUMBER_OF_DERIVED);
+    std::vector<double>    cdf(NUMBER_OF_DERIVED);
+
+    for (size_t r = 0; r < kinds.size(); ++r)
+    {
+        kinds[r] = r;
+        cdf[r]   = (r ? cdf[r-1] : 0.0) + 1.0/(r+1);
+    }
+
+    for (size_t r = kinds.size(); r > 1; --r)
+        std::swap(kinds[r-1], kinds[rand() % r]);
+
+    for (size_t i = 0; i < N; ++i)
+    {
+        double u = cdf.back() * rand() / (double(RAND_MAX)+1);
+        shapes[i] = make_shape(kinds[std::upper_bound(cdf.begin(), cdf.end(), u) - cdf.begin()]);
+    }
+
+    for (size_t k = 0; k < K; ++k)
+    {
+        n = run_timings(shapes, timingsV, timingsM, a1, a2);
+        mediansV[k] = display("AreaVisZpf", timingsV, n, 0);
+        mediansM[k] = display("AreaMatZpf", timingsM, n, 1);
         
         std::ios_base::fmtflags fmt = std::cout.flags(); // use cout flags function to save original format
         std::cout << "\t\t" << verdict(n, mediansV[k], mediansM[k]) << "\t\t" 
@@ -309,6 +377,8 @@ verdict test_randomized()
         exit(42);
     }
 
+    benchmark::instance().verdict("AreaVisZpf", "AreaMatZpf", n, mediansV, mediansM);
+
     std::sort(mediansV.begin(), mediansV.end());
     std::sort(mediansM.begin(), mediansM.end());
     return verdict(n,mediansV[K/2],mediansM[K/2]);
@@ -333,8 +403,8 @@ verdict test_repetitive()
             shapes[i] = make_shape((k+i)*2-k-2*i);
 
         n = run_timings(shapes, timingsV, timingsM, a1, a2);
-        mediansV[k] = display("AreaVisRep", timingsV, n);
-        mediansM[k] = display("AreaMatRep", timingsM, n);
+        mediansV[k] = display("AreaVisRep", timingsV, n, 0);
+        mediansM[k] = display("AreaMatRep", timingsM, n, 1);
         
         std::ios_base::fmtflags fmt = std::cout.flags(); // use cout flags function to save original format
         std::cout << "\t\t" << verdict(n, mediansV[k], mediansM[k]) << "\t\t" 
@@ -356,6 +426,8 @@ verdict test_repetitive()
         exit(42);
     }
 
+    benchmark::instance().verdict("AreaVisRep", "AreaMatRep", n, mediansV, mediansM);
+
     std::sort(mediansV.begin(), mediansV.end());
     std::sort(mediansM.begin(), mediansM.end());
     return verdict(n,mediansV[K/2],mediansM[K/2]);
@@ -71,26 +71,22 @@ size_t run_timings(
     for (size_t m = 0; m < M; ++m)
     {
         unsigned char j = 0;
-        time_stamp liStart1 = get_time_stamp();
 
-        for (size_t i = 0; i < N-3; i += 4)
-            aV += do_visit(*shapes[i],*shapes[i+1],*shapes[i+2],*shapes[i+3],some_numbers[j++]);
-
-        time_stamp liFinish1 = get_time_stamp();
+        timingsV[m] = benchmark::instance().measure(0, [&]
+        {
+            for (size_t i = 0; i < N-3; i += 4)
+                aV += do_visit(*shapes[i],*shapes[i+1],*shapes[i+2],*shapes[i+3],some_numbers[j++]);
+        });
 
         j = 0;
 
-        time_stamp liStart2 = get_time_stamp();
-
-        for (size_t i = 0; i < N-3; i += 4)
-            aM += do_match(*shapes[i],*shapes[i+1],*shapes[i+2],*shapes[i+3],some_numbers[j++]);
-
-        time_stamp liFinish2 = get_time_stamp();
+        timingsM[m] = benchmark::instance().measure(1, [&]
+        {
+            for (size_t i = 0; i < N-3; i += 4)
+                aM += do_match(*shapes[i],*shapes[i+1],*shapes[i+2],*shapes[i+3],some_numbers[j++]);
+        });
 
         XTL_ASSERT(aV==aM);
-
-        timingsV[m] = liFinish1-liStart1;
-        timingsM[m] = liFinish2-liStart2;
     }
 
     return N/4; // Number of iterations per measurement
@@ -0,0 +1,136 @@
+//
+//  Mach7: Pattern Matching Library for C++
+//
+//  Copyright 2011-2013, Texas A&M University.
+//  Copyright 2014 Yuriy Solodkyy.
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are met:
+//
+//      * Redistributions of source code must retain the above copyright
+//        notice, this list of conditions and the following disclaimer.
+//
+//      * Redistributions in binary form must reproduce the above copyright
+//        notice, this list of conditions and the following disclaimer in the
+//        documentation and/or other materials provided with the distribution.
+//
+//      * Neither the names of Mach7 project nor the names of its contributors
+//        may be used to endorse or promote products derived from this software
+//        without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+//  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+//  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+//  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY
+//  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+//  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+//  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+///
+/// \file
+///
+/// This file is a part of Mach7 library test suite.
+///
+/// \author Yuriy Solodkyy <yuriy.solodkyy@gmail.com>
+///
+/// \see https://parasol.tamu.edu/mach7/
+/// \see https://github.com/solodon4/Mach7
+/// \see https://github.com/solodon4/SELL
+///
+
+#define XTL_REORDER_PATTERNS 1 // Evaluate cheaper sub-patterns of && and || first
+
+#include <iostream>
+#include <mach7/type_switchN-patterns.hpp> // Support for N-ary Match statement on patterns
+#include <mach7/patterns/combinators.hpp>  // Support for pattern combinators &&, || and !
+#include <mach7/patterns/predicate.hpp>    // Support for predicate patterns
+#include <mach7/patterns/primitive.hpp>    // Wildcard, variable and value patterns
+#include "testutils.hpp"
+
+//------------------------------------------------------------------------------
+
+using namespace mch;
+
+//------------------------------------------------------------------------------
+
+/// Deliberately expensive predicates that users tend to write first
+XTL_TIMED_FUNC_BEGIN
+bool is_prime(int n)
+{
+    if (n < 2)
+        return false;
+
+    for (int d = 2; d*d <= n; ++d)
+        if (n % d == 0)
+            return false;
+
+    return true;
+}
+XTL_TIMED_FUNC_END
+
+XTL_TIMED_FUNC_BEGIN
+bool is_square(int n)
+{
+    int r = 0;
+
+    while (r*r < n)
+        ++r;
+
+    return r*r == n;
+}
+XTL_TIMED_FUNC_END
+
+//------------------------------------------------------------------------------
+
+/// Hand-written conditions in the same order as the patterns in #classify2
+XTL_TIMED_FUNC_BEGIN
+int classify1(int n)
+{
+    if (is_prime(n)  && n == 7)    return 1;
+    if (is_square(n) && n == 16)   return 2;
+    if (is_square(n) && n == 25)   return 3;
+    if (!is_prime(n) && n == 1000) return 4;
+    return 0;
+}
+XTL_TIMED_FUNC_END
+
+//------------------------------------------------------------------------------
+
+XTL_TIMED_FUNC_BEGIN
+int classify2(int n)
+{
+    auto prime  = filter(is_prime);
+    auto square = filter(is_square);
+
+    Match(n)
+    {
+      Case(prime  && 7)    return 1;
+      Case(square && 16)   return 2;
+      Case(square && 25)   return 3;
+      Case(!prime && 1000) return 4;
+      Otherwise()          return 0;
+    }
+    EndMatch
+
+    XTL_UNREACHABLE; // To avoid warning that control may reach end of a non-void function
+}
+XTL_TIMED_FUNC_END
+
+//------------------------------------------------------------------------------
+
+int main()
+{
+    std::vector<int> arguments(N);
+
+    for (size_t i = 0; i < N; ++i)
+        arguments[i] = rand() % 5000;
+
+    verdict v = get_timings1<int,int,classify1,classify2>(arguments);
+    std::cout << "Verdict: \t" << v << std::endl;
+}
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,134 @@
+//
+//  Mach7: Pattern Matching Library for C++
+//
+//  Copyright 2011-2013, Texas A&M University.
+//  Copyright 2014 Yuriy Solodkyy.
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are met:
+//
+//      * Redistributions of source code must retain the above copyright
+//        notice, this list of conditions and the following disclaimer.
+//
+//      * Redistributions in binary form must reproduce the above copyright
+//        notice, this list of conditions and the following disclaimer in the
+//        documentation and/or other materials provided with the distribution.
+//
+//      * Neither the names of Mach7 project nor the names of its contributors
+//        may be used to endorse or promote products derived from this software
+//        without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+//  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+//  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+//  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY
+//  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+//  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+//  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+///
+/// \file
+///
+/// This file is a part of Mach7 library test suite.
+///
+/// \author Yuriy Solodkyy <yuriy.solodkyy@gmail.com>
+///
+/// \see https://parasol.tamu.edu/mach7/
+/// \see https://github.com/solodon4/Mach7
+/// \see https://github.com/solodon4/SELL
+///
+
+#include <iostream>
+#include <mach7/type_switchN-patterns.hpp> // Support for N-ary Match statement on patterns
+#include <mach7/patterns/guard.hpp>        // Support for guard patterns
+#include <mach7/patterns/n+k.hpp>          // Generalized n+k patterns
+#include <mach7/patterns/primitive.hpp>    // Wildcard, variable and value patterns
+#include <mach7/patterns/sequence.hpp>     // Sequence patterns
+#include "testutils.hpp"
+
+//------------------------------------------------------------------------------
+
+using namespace mch;
+
+//------------------------------------------------------------------------------
+
+/// Message buffer, whose first element determines the kind of the message
+typedef std::vector<int> message;
+
+//------------------------------------------------------------------------------
+
+XTL_TIMED_FUNC_BEGIN
+int decode1(const message& m)
+{
+    const size_t n = m.size();
+
+    if (n == 3 && m[0] == 1)
+        return m[1] + m[2];
+    if (n >= 3 && m[0] == 2 && m[n-1] == 0)
+        return m[1] * int(n-3);
+    if (n >= 2 && m[0] == 3 && m[1] > 10)
+        return m[1];
+    if (n >= 1 && m[n-1] == 255)
+        return n >= 2 ? -m[n-2] : 0;
+    if (n >= 2)
+        return m[n-2] - m[n-1];
+
+    return 0;
+}
+XTL_TIMED_FUNC_END
+
+//------------------------------------------------------------------------------
+
+XTL_TIMED_FUNC_BEGIN
+int decode2(const message& m)
+{
+    var<int>             x, y;
+    var<array_view<int>> payload;
+
+    Match(m)
+    {
+      Case(seq(1, x, y))                return x + y;
+      Case(seq(2, x, rest(payload), 0)) return x * int(payload.value().size());
+      Case(prefix(3, x |= x > 10))      return x;
+      Case(suffix(255))                 return m.size() >= 2 ? -m[m.size()-2] : 0;
+      Case(suffix(x, y))                return x - y;
+      Otherwise()                       return 0;
+    }
+    EndMatch
+
+    XTL_UNREACHABLE; // To avoid warning that control may reach end of a non-void function
+}
+XTL_TIMED_FUNC_END
+
+//------------------------------------------------------------------------------
+
+int main()
+{
+    std::vector<message> arguments(N);
+
+    for (size_t i = 0; i < N; ++i)
+    {
+        message& m = arguments[i];
+        m.resize(rand() % 8 + 1);
+
+        for (size_t j = 0; j < m.size(); ++j)
+            m[j] = rand() % 16;
+
+        switch (rand() % 5)
+        {
+        case 0: m[0] = 1;                   break;
+        case 1: m[0] = 2; m.back() = 0;     break;
+        case 2: m[0] = 3;                   break;
+        case 3: m.back() = 255;             break;
+        }
+    }
+
+    verdict v = get_timings1<int,const message&,decode1,decode2>(arguments);
+    std::cout << "Verdict: \t" << v << std::endl;
+}
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,367 @@
+//
+//  Mach7: Pattern Matching Library for C++
+//
+//  Copyright 2011-2013, Texas A&M University.
+//  Copyright 2014 Yuriy Solodkyy.
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are met:
+//
+//      * Redistributions of source code must retain the above copyright
+//        notice, this list of conditions and the following disclaimer.
+//
+//      * Redistributions in binary form must reproduce the above copyright
+//        notice, this list of conditions and the following disclaimer in the
+//        documentation and/or other materials provided with the distribution.
+//
+//      * Neither the names of Mach7 project nor the names of its contributors
+//        may be used to endorse or promote products derived from this software
+//        without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+//  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+//  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+//  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY
+//  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+//  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+//  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+///
+/// \file
+///
+/// This file is a part of Mach7 library test suite.
+///
+/// \author Yuriy Solodkyy <yuriy.solodkyy@gmail.com>
+///
+/// \see https://parasol.tamu.edu/mach7/
+/// \see https://github.com/solodon4/Mach7
+/// \see https://github.com/solodon4/SELL
+///
+
+#include <iostream>
+#include <string>
+#include <mach7/type_switchN-patterns.hpp> // Support for N-ary Match statement on patterns
+#include <mach7/patterns/primitive.hpp>    // Wildcard, variable and value patterns
+#include "testutils.hpp"
+
+//------------------------------------------------------------------------------
+
+using namespace mch;
+
+//------------------------------------------------------------------------------
+
+/// Command names of a made-up command-line tool
+static const char* commands[] = {
+    "get-user", "get-group", "get-file", "get-node", "get-link", "get-task",
+    "set-user", "set-group", "set-file", "set-node", "set-link", "set-task",
+    "add-user", "add-group", "add-file", "add-node", "add-link", "add-task",
+    "del-user", "del-group", "del-file", "del-node", "del-link", "del-task",
+    "list-user", "list-group", "list-file", "list-node", "list-link", "list-task",
+    "show-user", "show-group", "show-file", "show-node", "show-link", "show-task",
+    "load-user", "load-group", "load-file", "load-node", "load-link", "load-task",
+    "save-user", "save-group", "save-file", "save-node", "save-link", "save-task",
+    "push-user", "push-group", "push-file", "push-node", "push-link", "push-task",
+    "pull-user", "pull-group", "pull-file", "pull-node", "pull-link", "pull-task",
+    "open-user", "open-group", "open-file", "open-node", "open-link", "open-task",
+    "close-user", "close-group", "close-file", "close-node", "close-link", "close-task",
+    "start", "stop", "help", "quit", "status", "reset",
+    "sync", "ping", "dump", "trace", "grant", "revoke",
+    "get-users", "get-groups", "get-files", "get-nodes", "get-links", "get-tasks",
+    "set-users", "set-groups", "set-files", "set-nodes", "set-links", "set-tasks",
+    "add-users", "add-groups", "add-files", "add-nodes", "add-links", "add-tasks",
+    "del-users", "del-groups", "del-files", "del-nodes", "del-links", "del-tasks",
+    "config-get", "config-set", "config-list", "config-unset", "config-edit", "config-import",
+    "config-export", "config-diff", "config-check", "config-path", "config-show", "config-reset",
+};
+
+//------------------------------------------------------------------------------
+
+/// Hand-written dispatcher comparing the command with each name in turn
+XTL_TIMED_FUNC_BEGIN
+int command1(const std::string& s)
+{
+    if (s == "get-user"     ) return 1;
+    if (s == "get-group"    ) return 2;
+    if (s == "get-file"     ) return 3;
+    if (s == "get-node"     ) return 4;
+    if (s == "get-link"     ) return 5;
+    if (s == "get-task"     ) return 6;
+    if (s == "set-user"     ) return 7;
+    if (s == "set-group"    ) return 8;
+    if (s == "set-file"     ) return 9;
+    if (s == "set-node"     ) return 10;
+    if (s == "set-link"     ) return 11;
+    if (s == "set-task"     ) return 12;
+    if (s == "add-user"     ) return 13;
+    if (s == "add-group"    ) return 14;
+    if (s == "add-file"     ) return 15;
+    if (s == "add-node"     ) return 16;
+    if (s == "add-link"     ) return 17;
+    if (s == "add-task"     ) return 18;
+    if (s == "del-user"     ) return 19;
+    if (s == "del-group"    ) return 20;
+    if (s == "del-file"     ) return 21;
+    if (s == "del-node"     ) return 22;
+    if (s == "del-link"     ) return 23;
+    if (s == "del-task"     ) return 24;
+    if (s == "list-user"    ) return 25;
+    if (s == "list-group"   ) return 26;
+    if (s == "list-file"    ) return 27;
+    if (s == "list-node"    ) return 28;
+    if (s == "list-link"    ) return 29;
+    if (s == "list-task"    ) return 30;
+    if (s == "show-user"    ) return 31;
+    if (s == "show-group"   ) return 32;
+    if (s == "show-file"    ) return 33;
+    if (s == "show-node"    ) return 34;
+    if (s == "show-link"    ) return 35;
+    if (s == "show-task"    ) return 36;
+    if (s == "load-user"    ) return 37;
+    if (s == "load-group"   ) return 38;
+    if (s == "load-file"    ) return 39;
+    if (s == "load-node"    ) return 40;
+    if (s == "load-link"    ) return 41;
+    if (s == "load-task"    ) return 42;
+    if (s == "save-user"    ) return 43;
+    if (s == "save-group"   ) return 44;
+    if (s == "save-file"    ) return 45;
+    if (s == "save-node"    ) return 46;
+    if (s == "save-link"    ) return 47;
+    if (s == "save-task"    ) return 48;
+    if (s == "push-user"    ) return 49;
+    if (s == "push-group"   ) return 50;
+    if (s == "push-file"    ) return 51;
+    if (s == "push-node"    ) return 52;
+    if (s == "push-link"    ) return 53;
+    if (s == "push-task"    ) return 54;
+    if (s == "pull-user"    ) return 55;
+    if (s == "pull-group"   ) return 56;
+    if (s == "pull-file"    ) return 57;
+    if (s == "pull-node"    ) return 58;
+    if (s == "pull-link"    ) return 59;
+    if (s == "pull-task"    ) return 60;
+    if (s == "open-user"    ) return 61;
+    if (s == "open-group"   ) return 62;
+    if (s == "open-file"    ) return 63;
+    if (s == "open-node"    ) return 64;
+    if (s == "open-link"    ) return 65;
+    if (s == "open-task"    ) return 66;
+    if (s == "close-user"   ) return 67;
+    if (s == "close-group"  ) return 68;
+    if (s == "close-file"   ) return 69;
+    if (s == "close-node"   ) return 70;
+    if (s == "close-link"   ) return 71;
+    if (s == "close-task"   ) return 72;
+    if (s == "start"        ) return 73;
+    if (s == "stop"         ) return 74;
+    if (s == "help"         ) return 75;
+    if (s == "quit"         ) return 76;
+    if (s == "status"       ) return 77;
+    if (s == "reset"        ) return 78;
+    if (s == "sync"         ) return 79;
+    if (s == "ping"         ) return 80;
+    if (s == "dump"         ) return 81;
+    if (s == "trace"        ) return 82;
+    if (s == "grant"        ) return 83;
+    if (s == "revoke"       ) return 84;
+    if (s == "get-users"    ) return 85;
+    if (s == "get-groups"   ) return 86;
+    if (s == "get-files"    ) return 87;
+    if (s == "get-nodes"    ) return 88;
+    if (s == "get-links"    ) return 89;
+    if (s == "get-tasks"    ) return 90;
+    if (s == "set-users"    ) return 91;
+    if (s == "set-groups"   ) return 92;
+    if (s == "set-files"    ) return 93;
+    if (s == "set-nodes"    ) return 94;
+    if (s == "set-links"    ) return 95;
+    if (s == "set-tasks"    ) return 96;
+    if (s == "add-users"    ) return 97;
+    if (s == "add-groups"   ) return 98;
+    if (s == "add-files"    ) return 99;
+    if (s == "add-nodes"    ) return 100;
+    if (s == "add-links"    ) return 101;
+    if (s == "add-tasks"    ) return 102;
+    if (s == "del-users"    ) return 103;
+    if (s == "del-groups"   ) return 104;
+    if (s == "del-files"    ) return 105;
+    if (s == "del-nodes"    ) return 106;
+    if (s == "del-links"    ) return 107;
+    if (s == "del-tasks"    ) return 108;
+    if (s == "config-get"   ) return 109;
+    if (s == "config-set"   ) return 110;
+    if (s == "config-list"  ) return 111;
+    if (s == "config-unset" ) return 112;
+    if (s == "config-edit"  ) return 113;
+    if (s == "config-import") return 114;
+    if (s == "config-export") return 115;
+    if (s == "config-diff"  ) return 116;
+    if (s == "config-check" ) return 117;
+    if (s == "config-path"  ) return 118;
+    if (s == "config-show"  ) return 119;
+    if (s == "config-reset" ) return 120;
+    return 0;
+}
+XTL_TIMED_FUNC_END
+
+//------------------------------------------------------------------------------
+
+XTL_TIMED_FUNC_BEGIN
+int command2(const std::string& s)
+{
+    Match(s)
+    {
+      Case("get-user"     ) return 1;
+      Case("get-group"    ) return 2;
+      Case("get-file"     ) return 3;
+      Case("get-node"     ) return 4;
+      Case("get-link"     ) return 5;
+      Case("get-task"     ) return 6;
+      Case("set-user"     ) return 7;
+      Case("set-group"    ) return 8;
+      Case("set-file"     ) return 9;
+      Case("set-node"     ) return 10;
+      Case("set-link"     ) return 11;
+      Case("set-task"     ) return 12;
+      Case("add-user"     ) return 13;
+      Case("add-group"    ) return 14;
+      Case("add-file"     ) return 15;
+      Case("add-node"     ) return 16;
+      Case("add-link"     ) return 17;
+      Case("add-task"     ) return 18;
+      Case("del-user"     ) return 19;
+      Case("del-group"    ) return 20;
+      Case("del-file"     ) return 21;
+      Case("del-node"     ) return 22;
+      Case("del-link"     ) return 23;
+      Case("del-task"     ) return 24;
+      Case("list-user"    ) return 25;
+      Case("list-group"   ) return 26;
+      Case("list-file"    ) return 27;
+      Case("list-node"    ) return 28;
+      Case("list-link"    ) return 29;
+      Case("list-task"    ) return 30;
+      Case("show-user"    ) return 31;
+      Case("show-group"   ) return 32;
+      Case("show-file"    ) return 33;
+      Case("show-node"    ) return 34;
+      Case("show-link"    ) return 35;
+      Case("show-task"    ) return 36;
+      Case("load-user"    ) return 37;
+      Case("load-group"   ) return 38;
+      Case("load-file"    ) return 39;
+      Case("load-node"    ) return 40;
+      Case("load-link"    ) return 41;
+      Case("load-task"    ) return 42;
+      Case("save-user"    ) return 43;
+      Case("save-group"   ) return 44;
+      Case("save-file"    ) return 45;
+      Case("save-node"    ) return 46;
+      Case("save-link"    ) return 47;
+      Case("save-task"    ) return 48;
+      Case("push-user"    ) return 49;
+      Case("push-group"   ) return 50;
+      Case("push-file"    ) return 51;
+      Case("push-node"    ) return 52;
+      Case("push-link"    ) return 53;
+      Case("push-task"    ) return 54;
+      Case("pull-user"    ) return 55;
+      Case("pull-group"   ) return 56;
+      Case("pull-file"    ) return 57;
+      Case("pull-node"    ) return 58;
+      Case("pull-link"    ) return 59;
+      Case("pull-task"    ) return 60;
+      Case("open-user"    ) return 61;
+      Case("open-group"   ) return 62;
+      Case("open-file"    ) return 63;
+      Case("open-node"    ) return 64;
+      Case("open-link"    ) return 65;
+      Case("open-task"    ) return 66;
+      Case("close-user"   ) return 67;
+      Case("close-group"  ) return 68;
+      Case("close-file"   ) return 69;
+      Case("close-node"   ) return 70;
+      Case("close-link"   ) return 71;
+      Case("close-task"   ) return 72;
+      Case("start"        ) return 73;
+      Case("stop"         ) return 74;
+      Case("help"         ) return 75;
+      Case("quit"         ) return 76;
+      Case("status"       ) return 77;
+      Case("reset"        ) return 78;
+      Case("sync"         ) return 79;
+      Case("ping"         ) return 80;
+      Case("dump"         ) return 81;
+      Case("trace"        ) return 82;
+      Case("grant"        ) return 83;
+      Case("revoke"       ) return 84;
+      Case("get-users"    ) return 85;
+      Case("get-groups"   ) return 86;
+      Case("get-files"    ) return 87;
+      Case("get-nodes"    ) return 88;
+      Case("get-links"    ) return 89;
+      Case("get-tasks"    ) return 90;
+      Case("set-users"    ) return 91;
+      Case("set-groups"   ) return 92;
+      Case("set-files"    ) return 93;
+      Case("set-nodes"    ) return 94;
+      Case("set-links"    ) return 95;
+      Case("set-tasks"    ) return 96;
+      Case("add-users"    ) return 97;
+      Case("add-groups"   ) return 98;
+      Case("add-files"    ) return 99;
+      Case("add-nodes"    ) return 100;
+      Case("add-links"    ) return 101;
+      Case("add-tasks"    ) return 102;
+      Case("del-users"    ) return 103;
+      Case("del-groups"   ) return 104;
+      Case("del-files"    ) return 105;
+      Case("del-nodes"    ) return 106;
+      Case("del-links"    ) return 107;
+      Case("del-tasks"    ) return 108;
+      Case("config-get"   ) return 109;
+      Case("config-set"   ) return 110;
+      Case("config-list"  ) return 111;
+      Case("config-unset" ) return 112;
+      Case("config-edit"  ) return 113;
+      Case("config-import") return 114;
+      Case("config-export") return 115;
+      Case("config-diff"  ) return 116;
+      Case("config-check" ) return 117;
+      Case("config-path"  ) return 118;
+      Case("config-show"  ) return 119;
+      Case("config-reset" ) return 120;
+      Otherwise() return 0;
+    }
+    EndMatch
+
+    XTL_UNREACHABLE; // To avoid warning that control may reach end of a non-void function
+}
+XTL_TIMED_FUNC_END
+
+//------------------------------------------------------------------------------
+
+int main()
+{
+    std::vector<std::string> arguments(N);
+
+    // Only known commands first, so that no call has reached the end of the 
+    // Match yet when they are measured
+    for (size_t i = 0; i < N; ++i)
+        arguments[i] = commands[rand() % XTL_ARR_SIZE(commands)];
+
+    verdict k = get_timings1<int,const std::string&,command1,command2>(arguments);
+
+    // Every 16th argument is not a known command
+    for (size_t i = 0; i < N; ++i)
+        arguments[i] = i % 16 ? commands[rand() % XTL_ARR_SIZE(commands)] : "unknown";
+
+    verdict v = get_timings1<int,const std::string&,command1,command2>(arguments);
+    std::cout << "Verdict: \t" << v << "\tKnown only: \t" << k << std::endl;
+}
+
+//------------------------------------------------------------------------------
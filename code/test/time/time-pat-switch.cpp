@@ -0,0 +1,197 @@
+//
+//  Mach7: Pattern Matching Library for C++
+//
+//  Copyright 2011-2013, Texas A&M University.
+//  Copyright 2014 Yuriy Solodkyy.
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are met:
+//
+//      * Redistributions of source code must retain the above copyright
+//        notice, this list of conditions and the following disclaimer.
+//
+//      * Redistributions in binary form must reproduce the above copyright
+//        notice, this list of conditions and the following disclaimer in the
+//        documentation and/or other materials provided with the distribution.
+//
+//      * Neither the names of Mach7 project nor the names of its contributors
+//        may be used to endorse or promote products derived from this software
+//        without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+//  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+//  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+//  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY
+//  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+//  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+//  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+///
+/// \file
+///
+/// This file is a part of Mach7 library test suite.
+///
+/// \author Yuriy Solodkyy <yuriy.solodkyy@gmail.com>
+///
+/// \see https://parasol.tamu.edu/mach7/
+/// \see https://github.com/solodon4/Mach7
+/// \see https://github.com/solodon4/SELL
+///
+
+#include <iostream>
+#include <mach7/type_switchN-patterns.hpp> // Support for N-ary Match statement on patterns
+#include <mach7/patterns/n+k.hpp>          // Generalized n+k patterns
+#include <mach7/patterns/primitive.hpp>    // Wildcard, variable and value patterns
+#include "testutils.hpp"
+
+//------------------------------------------------------------------------------
+
+using namespace mch;
+
+//------------------------------------------------------------------------------
+
+/// Native switch with dense case labels the compiler turns into a jump table
+XTL_TIMED_FUNC_BEGIN
+int opcode1(int n)
+{
+    switch (n)
+    {
+    case  0: return 11;
+    case  1: return 23;
+    case  2: return 37;
+    case  3: return 41;
+    case  4: return 53;
+    case  5: return 67;
+    case  6: return 71;
+    case  7: return 83;
+    case  8: return 97;
+    case  9: return 101;
+    case 10: return 113;
+    case 11: return 127;
+    case 12: return 131;
+    case 13: return 149;
+    case 14: return 151;
+    case 15: return 163;
+    default: return n % 2 == 0 ? n/2 : -n;
+    }
+}
+XTL_TIMED_FUNC_END
+
+//------------------------------------------------------------------------------
+
+XTL_TIMED_FUNC_BEGIN
+int opcode2(int n)
+{
+    var<int> m;
+
+    Match(n)
+    {
+      Case( 0)  return 11;
+      Case( 1)  return 23;
+      Case( 2)  return 37;
+      Case( 3)  return 41;
+      Case( 4)  return 53;
+      Case( 5)  return 67;
+      Case( 6)  return 71;
+      Case( 7)  return 83;
+      Case( 8)  return 97;
+      Case( 9)  return 101;
+      Case(10)  return 113;
+      Case(11)  return 127;
+      Case(12)  return 131;
+      Case(13)  return 149;
+      Case(14)  return 151;
+      Case(15)  return 163;
+      Case(2*m) return m;
+      Otherwise() return -n;
+    }
+    EndMatch
+
+    XTL_UNREACHABLE; // To avoid warning that control may reach end of a non-void function
+}
+XTL_TIMED_FUNC_END
+
+//------------------------------------------------------------------------------
+
+/// Native switch with sparse case labels the compiler turns into a binary search
+XTL_TIMED_FUNC_BEGIN
+int status1(int n)
+{
+    switch (n)
+    {
+    case 100: return 1;
+    case 101: return 2;
+    case 200: return 3;
+    case 201: return 4;
+    case 204: return 5;
+    case 301: return 6;
+    case 302: return 7;
+    case 304: return 8;
+    case 400: return 9;
+    case 401: return 10;
+    case 403: return 11;
+    case 404: return 12;
+    case 500: return 13;
+    case 502: return 14;
+    case 503: return 15;
+    default:  return 0;
+    }
+}
+XTL_TIMED_FUNC_END
+
+//------------------------------------------------------------------------------
+
+XTL_TIMED_FUNC_BEGIN
+int status2(int n)
+{
+    Match(n)
+    {
+      Case(100) return 1;
+      Case(101) return 2;
+      Case(200) return 3;
+      Case(201) return 4;
+      Case(204) return 5;
+      Case(301) return 6;
+      Case(302) return 7;
+      Case(304) return 8;
+      Case(400) return 9;
+      Case(401) return 10;
+      Case(403) return 11;
+      Case(404) return 12;
+      Case(500) return 13;
+      Case(502) return 14;
+      Case(503) return 15;
+      Otherwise() return 0;
+    }
+    EndMatch
+
+    XTL_UNREACHABLE; // To avoid warning that control may reach end of a non-void function
+}
+XTL_TIMED_FUNC_END
+
+//------------------------------------------------------------------------------
+
+int main()
+{
+    static const int statuses[] = {100,101,200,201,204,301,302,304,400,401,403,404,500,502,503,418};
+
+    std::vector<int> opcodes(N);
+    std::vector<int> codes(N);
+
+    for (size_t i = 0; i < N; ++i)
+    {
+        opcodes[i] = rand() % 20;
+        codes[i]   = statuses[rand() % XTL_ARR_SIZE(statuses)];
+    }
+
+    verdict v1 = get_timings1<int,int,opcode1,opcode2>(opcodes);
+    std::cout << "Verdict: \t" << v1 << std::endl;
+    verdict v2 = get_timings1<int,int,status1,status2>(codes);
+    std::cout << "Verdict: \t" << v2 << std::endl;
+}
+
+//------------------------------------------------------------------------------
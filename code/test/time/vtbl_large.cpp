@@ -0,0 +1,193 @@
+//
+//  Mach7: Pattern Matching Library for C++
+//
+//  Copyright 2011-2013, Texas A&M University.
+//  Copyright 2014 Yuriy Solodkyy.
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are met:
+//
+//      * Redistributions of source code must retain the above copyright
+//        notice, this list of conditions and the following disclaimer.
+//
+//      * Redistributions in binary form must reproduce the above copyright
+//        notice, this list of conditions and the following disclaimer in the
+//        documentation and/or other materials provided with the distribution.
+//
+//      * Neither the names of Mach7 project nor the names of its contributors
+//        may be used to endorse or promote products derived from this software
+//        without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+//  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+//  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+//  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY
+//  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+//  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+//  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+///
+/// \file
+///
+/// This file is a part of Mach7 library test suite. It measures how the vtbl 
+/// maps behind type switches scale to open hierarchies of 10^5 and more 
+/// classes. Since compiling that many classes is impractical, vtbl-pointers of
+/// the classes are synthesized the way a loader would lay them out: modules at
+/// random 64K-aligned addresses, each with a run of vtbls of varying sizes.
+/// For each number of classes the benchmark reports the time to populate a map
+/// with all of them, the longest single lookup during that (i.e. the cost of 
+/// the largest rebuild), the number of updates and the average cost of a 
+/// lookup of a class chosen at random.
+///
+/// By default it measures vtbl_map<1,T> behind Match statements of 
+/// type_switchN.hpp. When built with VTBL_LARGE_VTBLMAP (vtbl_large-vtblmap)
+/// it measures vtblmap<T> behind MatchP, MatchQ and memoized_cast instead.
+///
+/// Usage: vtbl_large [classes [modules]]
+///
+/// \author Yuriy Solodkyy <yuriy.solodkyy@gmail.com>
+///
+/// \see https://parasol.tamu.edu/mach7/
+/// \see https://github.com/solodon4/Mach7
+/// \see https://github.com/solodon4/SELL
+///
+
+#if defined(VTBL_LARGE_VTBLMAP)
+#include <mach7/vtblmap.hpp>               // vtblmap<T> used by MatchP, MatchQ and memoized_cast
+#else
+#include <mach7/vtblmap4.hpp>              // vtbl_map<N,T> used by type_switchN.hpp
+#endif
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+//------------------------------------------------------------------------------
+
+typedef std::chrono::steady_clock clock_type;
+
+#if defined(VTBL_LARGE_VTBLMAP)
+    typedef mch::vtblmap<size_t> map_type;
+    static const char* const map_name = "vtblmap<T>";
+    inline size_t& lookup(map_type& m, const intptr_t& vtbl) { return m.get(&vtbl); } // get() dereferences the object to find its vtbl-pointer
+#else
+    typedef mch::vtbl_map<1,size_t> map_type;
+    static const char* const map_name = "vtbl_map<1,T>";
+    inline size_t& lookup(map_type& m, const intptr_t& vtbl) { const intptr_t key[1] = {vtbl}; return m.get(key); }
+#endif
+
+//------------------------------------------------------------------------------
+
+/// Synthesizes vtbl-pointers of the given number of classes spread over modules
+std::vector<intptr_t> make_vtbls(size_t classes, size_t modules, std::mt19937_64& rnd)
+{
+    std::vector<intptr_t> result;
+    result.reserve(classes);
+
+    for (size_t m = 0; m < modules; ++m)
+    {
+        intptr_t vtbl = intptr_t((rnd() & 0x7FFFFFF) << 16); // Modules are loaded at 64K boundary
+
+        for (size_t c = m*classes/modules; c < (m+1)*classes/modules; ++c)
+            result.push_back(vtbl += 16 + 8*(rnd() % 12)); // vtbls of 2 to 13 virtual functions
+    }
+
+    return result;
+}
+
+//------------------------------------------------------------------------------
+
+/// Populates a map with the given vtbls and measures lookups in it
+bool measure(size_t classes, size_t modules)
+{
+    std::mt19937_64 rnd(classes);
+    const std::vector<intptr_t> vtbls = make_vtbls(classes, modules, rnd);
+    std::string name = "vtbl_large_" + std::to_string(classes) + "_" + std::to_string(modules);
+    map_type map(1, name.c_str(), __FILE__, __LINE__); // One case clause or one expected vtbl
+
+    double worst = 0.0;
+    clock_type::time_point start = clock_type::now();
+
+    for (size_t i = 0; i < vtbls.size(); ++i)
+    {
+        clock_type::time_point t = clock_type::now();
+        lookup(map, vtbls[i]) = i;
+        worst = std::max(worst, std::chrono::duration<double,std::micro>(clock_type::now()-t).count());
+    }
+
+    const double fill = std::chrono::duration<double,std::milli>(clock_type::now()-start).count();
+    bool correct = true;
+
+    for (size_t i = 0; i < vtbls.size(); ++i)
+        correct &= lookup(map, vtbls[i]) == i;
+
+    // Random order of lookups is the worst case for the cache: consecutive 
+    // lookups are for different classes and hit different cache lines.
+    const size_t lookups = size_t(1) << 22;
+    std::vector<uint32_t> order(lookups);
+
+    for (size_t i = 0; i < lookups; ++i)
+        order[i] = uint32_t(rnd() % vtbls.size());
+
+    size_t sum = 0;
+    start = clock_type::now();
+
+    for (size_t i = 0; i < lookups; ++i)
+        sum += lookup(map, vtbls[order[i]]);
+
+    const double per_lookup = std::chrono::duration<double,std::nano>(clock_type::now()-start).count()/lookups;
+
+    size_t updates = 0, log_size = 0;
+
+    for (const mch::vtbl_map_stats& s : mch::snapshot_vtbl_maps())
+        if (s.func == name)
+        {
+            updates  = s.updates;
+            log_size = s.log_size;
+        }
+
+    std::cout << std::setw(8) << classes 
+              << std::setw(9) << modules 
+              << std::setw(12) << std::fixed << std::setprecision(2) << fill << "ms" 
+              << std::setw(12) << worst << "us"
+              << std::setw(9) << updates
+              << std::setw(6) << log_size
+              << std::setw(10) << per_lookup << "ns"
+              << (correct ? "" : "  INCORRECT") 
+              << (sum == 0 ? " " : "") << std::endl; // Use sum to not let the lookups be optimized away
+
+    return correct;
+}
+
+//------------------------------------------------------------------------------
+
+int main(int argc, char* argv[])
+{
+    std::cout << "Open type switch over " << map_name << std::endl
+              << " classes  modules        fill     worst lookup  updates  log    lookup" << std::endl;
+
+    bool correct = true;
+
+    if (argc > 1)
+    {
+        size_t classes = std::strtoul(argv[1], 0, 10);
+        correct &= measure(classes, argc > 2 ? std::strtoul(argv[2], 0, 10) : std::max(size_t(1), classes/1000));
+    }
+    else
+        for (size_t classes = 1000; classes <= 1000000; classes *= 10)
+            for (size_t modules = 1; modules <= classes/100; modules *= 10)
+                correct &= measure(classes, modules);
+
+    return correct ? 0 : 1;
+}
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,102 @@
+//
+//  Mach7: Pattern Matching Library for C++
+//
+//  Copyright 2011-2013, Texas A&M University.
+//  Copyright 2014 Yuriy Solodkyy.
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are met:
+//
+//      * Redistributions of source code must retain the above copyright
+//        notice, this list of conditions and the following disclaimer.
+//
+//      * Redistributions in binary form must reproduce the above copyright
+//        notice, this list of conditions and the following disclaimer in the
+//        documentation and/or other materials provided with the distribution.
+//
+//      * Neither the names of Mach7 project nor the names of its contributors
+//        may be used to endorse or promote products derived from this software
+//        without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+//  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+//  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+//  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY
+//  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+//  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+//  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+///
+/// \file
+///
+/// This file is a part of Mach7 library test suite.
+///
+/// \author Yuriy Solodkyy <yuriy.solodkyy@gmail.com>
+///
+/// \see https://parasol.tamu.edu/mach7/
+/// \see https://github.com/solodon4/Mach7
+/// \see https://github.com/solodon4/SELL
+///
+
+#define XTL_TRACE_LIKELINESS        1  // Count evaluations of XTL_LIKELY and XTL_UNLIKELY conditions
+#define XTL_TRACE_LIKELINESS_PERIOD 16 // ... but only sample 1 in 16 of them on average
+
+#include <mach7/type_switchN-patterns.hpp> // Support for N-ary Match statement on patterns
+#include <mach7/patterns/primitive.hpp>    // Wildcard, variable and value patterns
+
+#include <iostream>
+#include <thread>
+
+//------------------------------------------------------------------------------
+
+struct Shape                   { virtual ~Shape() {} };
+struct Circle   : Shape        {};
+struct Square   : Shape        {};
+
+//------------------------------------------------------------------------------
+
+int kind(const Shape* shape)
+{
+    mch::var<const Circle&> c;
+    mch::var<const Square&> s;
+
+    Match(shape)
+    {
+      Case(c) return 1;
+      Case(s) return 2;
+    }
+    EndMatch
+
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+
+int main()
+{
+    Circle c;
+    Square s;
+    const Shape* shapes[] = {&c, &s};
+
+    size_t n = 0, m = 0;
+
+    // Tracing is thread-safe, so conditions may be evaluated concurrently
+    std::thread t([&n,&shapes]() { for (size_t i = 0; i < 100000; ++i) n += kind(shapes[i % 2]); });
+
+    for (size_t i = 0; i < 100000; ++i)
+        if (XTL_LIKELY(i % 4 == 0)) // Deliberately mispredicted hint
+            m += kind(shapes[i % 3 == 0]);
+
+    t.join();
+
+    std::cout << n << ' ' << m << std::endl;
+
+    mch::write_likeliness_report(std::cout);
+    mch::write_likeliness_hints(std::cout);
+}
+
+//------------------------------------------------------------------------------
@@ -42,8 +42,13 @@
 /// \see https://github.com/solodon4/SELL
 ///
 
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <iomanip>
+#include <vector>
 #include <mach7/ptrtools.hpp>              // Mach7 pointer tools
 
 
@@ -136,10 +141,112 @@ void MortonTable4()
     }
 }
 
-int main()
+/// Checks the generic interleave against the bit-by-bit reference for random
+/// numbers as well as against the hand-written versions in the (up to) 32 
+/// bits they compute.
+template <size_t N>
+bool test_generic()
 {
-    MortonTable4();
+    bool ok = true;
+
+    for (int k = 0; k < 100000; ++k)
+    {
+        intptr_t v[N];
+
+        for (size_t n = 0; n < N; ++n)
+            v[n] = intptr_t(std::rand()) << 32 ^ std::rand();
+
+        intptr_t g = mch::interleave<intptr_t,N>(v);
+        intptr_t m = my_interleave(v);
+        intptr_t h = mch::interleave(v); // Hand-written version for N <= 4
+        intptr_t d = mch::interleave_vtbls(v); // PDEP if enabled and supported
+
+        const uint32_t mask = uint32_t(~0) >> (32 % N); // All versions take 32/N bits of each
+
+        if ((uint32_t(g) & mask) != (uint32_t(m) & mask) || g != h || g != d)
+        {
+            std::cout << "Generic interleave of " << N << " numbers failed: " << g << '|' << m << '|' << h << '|' << d << std::endl;
+            ok = false;
+            break;
+        }
+    }
+
+    return ok;
+}
+
+/// Median time in nanoseconds of a call to f over a set of random vtbl tuples
+template <size_t N, typename F>
+double time_interleave(F f)
+{
+    const size_t M = 4096;
+    std::vector<intptr_t> data(M*N);
+
+    for (size_t i = 0; i < data.size(); ++i)
+        data[i] = intptr_t(std::rand()) << 4; // Vtbl pointers are aligned
+
+    std::vector<double> times;
+    volatile intptr_t sink = 0;
+
+    for (int r = 0; r < 21; ++r)
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        intptr_t acc = 0;
+
+        for (int k = 0; k < 100; ++k)
+            for (size_t i = 0; i < M; ++i)
+                acc ^= f(*reinterpret_cast<const intptr_t(*)[N]>(&data[i*N]));
+
+        sink = acc;
+        times.push_back(std::chrono::duration<double,std::nano>(std::chrono::steady_clock::now() - start).count() / (100*M));
+    }
+
+    std::sort(times.begin(), times.end());
+    return times[times.size()/2];
+}
+
+template <size_t N> intptr_t hand_written(const intptr_t (&v)[N]) { return mch::interleave(v); }
+template <size_t N> intptr_t generic     (const intptr_t (&v)[N]) { return mch::interleave<intptr_t,N>(v); }
+template <size_t N> intptr_t bit_by_bit  (const intptr_t (&v)[N]) { return my_interleave(v); }
+template <size_t N> intptr_t dispatched  (const intptr_t (&v)[N]) { return mch::interleave_vtbls(v); }
+
+/// Compares generic interleave to the hand-written one, to the bit by bit loop
+/// that was used for N > 4 before and to what vtbl_map uses (\see XTL_USE_BMI2).
+template <size_t N>
+void time_generic()
+{
+    double h = time_interleave<N>(hand_written<N>);
+    double g = time_interleave<N>(generic<N>);
+    double b = time_interleave<N>(bit_by_bit<N>);
+    double d = time_interleave<N>(dispatched<N>);
+    std::cout << "N=" << N << std::fixed << std::setprecision(2)
+              << "\tportable: "   << h << "ns"
+              << "\tgeneric: "    << g << "ns"
+              << "\tbit by bit: " << b << "ns"
+              << "\tvtbl_map: "   << d << "ns" << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc > 1 && std::strcmp(argv[1], "--table") == 0)
+    {
+        MortonTable4();
+        return 0;
+    }
+
     //test2();
     //test3();
     //test4();
+
+    bool ok = test_generic<2>() && test_generic<3>() && test_generic<4>() && test_generic<5>() 
+           && test_generic<6>() && test_generic<7>() && test_generic<8>();
+
+    if (!ok)
+        return 1;
+
+    time_generic<2>();
+    time_generic<3>();
+    time_generic<4>();
+    time_generic<5>();
+    time_generic<6>();
+    time_generic<8>();
 }
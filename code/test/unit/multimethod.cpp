@@ -0,0 +1,116 @@
+//
+//  Mach7: Pattern Matching Library for C++
+//
+//  Copyright 2011-2013, Texas A&M University.
+//  Copyright 2014 Yuriy Solodkyy.
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are met:
+//
+//      * Redistributions of source code must retain the above copyright
+//        notice, this list of conditions and the following disclaimer.
+//
+//      * Redistributions in binary form must reproduce the above copyright
+//        notice, this list of conditions and the following disclaimer in the
+//        documentation and/or other materials provided with the distribution.
+//
+//      * Neither the names of Mach7 project nor the names of its contributors
+//        may be used to endorse or promote products derived from this software
+//        without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+//  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+//  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+//  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY
+//  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+//  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+//  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///
+/// \file
+///
+/// This file is a part of Mach7 library test suite. It checks which overloads
+/// of open multimethods get called, including overloads registered after the
+/// multimethod has already been called and classes with several bases.
+///
+/// \author Yuriy Solodkyy <yuriy.solodkyy@gmail.com>
+///
+/// \see https://parasol.tamu.edu/mach7/
+/// \see https://github.com/solodon4/Mach7
+/// \see https://github.com/solodon4/SELL
+///
+
+#include <mach7/multimethod.hpp>
+#include <iostream>
+#include <string>
+
+//------------------------------------------------------------------------------
+
+struct Shape  { virtual ~Shape() {} };
+struct Circle : Shape  { double r = 1; };
+struct Square : Shape  { double s = 2; };
+struct Tagged { virtual ~Tagged() {} int tag = 42; };
+struct Badge  : Tagged, Square { };       // Square is not the first base: needs offsets
+struct Dot    : Circle {};                // No overloads of its own
+
+//------------------------------------------------------------------------------
+
+int main()
+{
+    bool ok = true;
+
+    mch::multimethod<std::string(mch::virtual_<const Shape&>, mch::virtual_<const Shape&>)> collide;
+
+    collide.add([](const Shape&,  const Shape&)  { return std::string("SS"); });
+    collide.add([](const Circle&, const Shape&)  { return std::string("CS"); });
+    collide.add([](const Shape&,  const Circle&) { return std::string("SC"); });
+    collide.add([](const Circle&, const Circle&) { return std::string("CC"); });
+    collide.add([](const Square& a, const Square& b) { return a.s == 2 && b.s == 2 ? std::string("QQ") : std::string("bad offset"); });
+
+    Circle c; Square s; Badge b; Dot d;
+
+    ok &= collide(c, c) == "CC";
+    ok &= collide(c, s) == "CS";
+    ok &= collide(s, c) == "SC";
+    ok &= collide(d, s) == "CS";    // Dot is a Circle
+    ok &= collide(d, d) == "CC";
+    ok &= collide(b, s) == "QQ";    // Badge is a Square at non-zero offset
+    ok &= collide(s, b) == "QQ";
+    ok &= collide(c, c) == "CC";    // Memoized
+
+    // Overloads registered after calls are considered
+    collide.add([](const Dot&, const Shape&) { return std::string("DS"); });
+    ok &= collide(d, s) == "DS";
+    ok &= collide(d, d) == "CC";    // Circle,Circle is closer to Dot,Dot than Dot,Shape is
+    ok &= collide(c, s) == "CS";
+
+    // Non-virtual parameters and pointers
+    mch::multimethod<int(mch::virtual_<Shape*>, int)> area;
+    area.add([](Circle* p, int k) { return int(p->r) * k; });
+    area.add([](Square* p, int k) { return int(p->s) * k; });
+    area.add([](Badge*  p, int k) { return static_cast<Tagged*>(p)->tag + k; });
+
+    ok &= area(&c, 3) == 3;
+    ok &= area(&s, 3) == 6;
+    ok &= area(&b, 3) == 45;
+    ok &= area(&d, 5) == 5;
+
+    // Calls without applicable overloads
+    Shape sh;
+    bool thrown = false;
+    try { area(&sh, 1); } catch (const mch::bad_multimethod_call&) { thrown = true; }
+    ok &= thrown;
+    thrown = false;
+    try { area(nullptr, 1); } catch (const mch::bad_multimethod_call&) { thrown = true; }
+    ok &= thrown;
+
+    if (!ok)
+        std::cerr << "Wrong overloads of multimethods were called" << std::endl;
+
+    return ok ? 0 : 1;
+}
+
+//------------------------------------------------------------------------------
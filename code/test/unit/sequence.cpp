@@ -0,0 +1,148 @@
+//
+//  Mach7: Pattern Matching Library for C++
+//
+//  Copyright 2011-2013, Texas A&M University.
+//  Copyright 2014 Yuriy Solodkyy.
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are met:
+//
+//      * Redistributions of source code must retain the above copyright
+//        notice, this list of conditions and the following disclaimer.
+//
+//      * Redistributions in binary form must reproduce the above copyright
+//        notice, this list of conditions and the following disclaimer in the
+//        documentation and/or other materials provided with the distribution.
+//
+//      * Neither the names of Mach7 project nor the names of its contributors
+//        may be used to endorse or promote products derived from this software
+//        without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+//  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+//  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+//  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY
+//  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+//  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+//  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+///
+/// \file
+///
+/// This file is a part of Mach7 library test suite.
+///
+/// \author Yuriy Solodkyy <yuriy.solodkyy@gmail.com>
+///
+/// \see https://parasol.tamu.edu/mach7/
+/// \see https://github.com/solodon4/Mach7
+/// \see https://github.com/solodon4/SELL
+///
+
+#include <mach7/type_switchN-patterns.hpp> // Support for N-ary Match statement on patterns
+#include <mach7/patterns/equivalence.hpp>  // Equivalence combinator +
+#include <mach7/patterns/guard.hpp>        // Support for guard patterns
+#include <mach7/patterns/n+k.hpp>          // Generalized n+k patterns
+#include <mach7/patterns/primitive.hpp>    // Wildcard, variable and value patterns
+#include <mach7/patterns/sequence.hpp>     // Sequence patterns
+
+#include <array>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace mch;
+
+//------------------------------------------------------------------------------
+
+template <typename T>
+std::ostream& operator<<(std::ostream& os, const array_view<T>& v)
+{
+    os << '[';
+
+    for (const T* p = v.begin(); p != v.end(); ++p)
+        os << (p == v.begin() ? "" : ",") << *p;
+
+    return os << ']';
+}
+
+//------------------------------------------------------------------------------
+
+/// Sums elements of a sequence recursively without copying any of its parts
+int sum(const array_view<int>& v)
+{
+    var<int>             x;
+    var<array_view<int>> xs;
+
+    Match(v)
+    {
+      Case(seq())            return 0;
+      Case(seq(x, rest(xs))) return x + sum(xs);
+    }
+    EndMatch
+
+    XTL_UNREACHABLE; // To avoid warning that control may reach end of a non-void function
+}
+
+//------------------------------------------------------------------------------
+
+/// Decodes a simple message format where the first byte is the message type
+int decode(const std::vector<int>& msg)
+{
+    var<int>             x, y;
+    var<array_view<int>> payload;
+
+    Match(msg)
+    {
+      Case(seq(1, x, y))                return x + y;
+      Case(seq(2, x, rest(payload), 0)) return x * int(payload.value().size());
+      Case(prefix(3, x |= x > 10))      return x;
+      Case(suffix(x, 255))              return -x;
+      Case(slice(1, 2, seq(x, +(x+1)))) return 100 + x;
+      Otherwise()                       return 0;
+    }
+    EndMatch
+
+    XTL_UNREACHABLE; // To avoid warning that control may reach end of a non-void function
+}
+
+//------------------------------------------------------------------------------
+
+int main()
+{
+    int                arr[] = {1, 2, 3, 4, 5};
+    std::vector<int>   vec(arr, arr+5);
+    std::array<int,3>  a3 = {{7, 8, 9}};
+
+    std::cout << sum(arr) << ' ' << sum(vec) << ' ' << sum(a3) << std::endl;
+
+    const int msgs[][5] = {
+        {1, 3, 4, 0, 0},
+        {2, 6, 7, 8, 0},
+        {3, 42, 0, 0, 0},
+        {3, 5, 0, 0, 255},
+        {9, 5, 6, 0, 0},
+        {9, 9, 9, 9, 9},
+    };
+    const size_t lens[] = {3, 5, 2, 5, 3, 5};
+
+    for (size_t i = 0; i < XTL_ARR_SIZE(msgs); ++i)
+        std::cout << decode(std::vector<int>(msgs[i], msgs[i]+lens[i])) << std::endl;
+
+    var<array_view<int>> init, tail;
+    var<int>             first, last;
+    std::string          s = "hello";
+
+    if (seq(first, rest(tail))(vec) && suffix(last)(vec) && seq(rest(init), _)(vec))
+        std::cout << first << ' ' << tail.value() << ' ' << init.value() << ' ' << last << std::endl;
+
+    var<char> c;
+
+    if (prefix('h', c)(s))
+        std::cout << "starts with h, followed by " << c << std::endl;
+}
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,184 @@
+//
+//  Mach7: Pattern Matching Library for C++
+//
+//  Copyright 2011-2013, Texas A&M University.
+//  Copyright 2014 Yuriy Solodkyy.
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are met:
+//
+//      * Redistributions of source code must retain the above copyright
+//        notice, this list of conditions and the following disclaimer.
+//
+//      * Redistributions in binary form must reproduce the above copyright
+//        notice, this list of conditions and the following disclaimer in the
+//        documentation and/or other materials provided with the distribution.
+//
+//      * Neither the names of Mach7 project nor the names of its contributors
+//        may be used to endorse or promote products derived from this software
+//        without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+//  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+//  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+//  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY
+//  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+//  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+//  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///
+/// \file
+///
+/// This file is a part of Mach7 library test suite.
+///
+/// Checks the branch-free linear solver used by n+k patterns against a 
+/// reference that does the arithmetic in a wider type, and against brute 
+/// force enumeration of roots around interesting values.
+///
+/// \author Yuriy Solodkyy <yuriy.solodkyy@gmail.com>
+///
+/// \see https://parasol.tamu.edu/mach7/
+/// \see https://github.com/solodon4/Mach7
+/// \see https://github.com/solodon4/SELL
+///
+
+#include <mach7/patterns/n+k.hpp>          // Support for n+k patterns and their solvers
+
+#include <climits>
+#include <iostream>
+#include <limits>
+#include <vector>
+
+//------------------------------------------------------------------------------
+
+static int failures = 0;
+
+/// Wider type in which a*x+b over T can be computed exactly
+template <typename T> struct wider;
+template <> struct wider<int>      { typedef long long type; };
+template <> struct wider<unsigned> { typedef long long type; };
+#if defined(__SIZEOF_INT128__)
+template <> struct wider<long long>          { typedef __int128 type; };
+template <> struct wider<unsigned long long> { typedef __int128 type; };
+#endif
+
+template <typename T, typename W>
+bool fits(W v) { return W(std::numeric_limits<T>::min()) <= v && v <= W(std::numeric_limits<T>::max()); }
+
+/// Reference solver: x is a root when a*x+b == r over integers and neither 
+/// a*x nor a*x+b leave the range of T.
+template <typename T>
+bool reference(T a, T b, T r, T& x)
+{
+    typedef typename wider<T>::type W;
+    const W n = W(r) - W(b);
+
+    if (!fits<T>(n) || n % W(a) != 0)
+        return false;
+
+    x = T(n / W(a));
+    return true;
+}
+
+/// Checks solve_linear on a*x+b == r against the reference
+template <typename T>
+void check(T a, T b, T r)
+{
+    mch::var<T> x;
+    T expected = 0;
+    const bool solved = mch::solve_linear(x, a, b, r);
+    const bool exists = reference(a, b, r, expected);
+
+    if (solved != exists || (solved && T(x) != expected))
+    {
+        std::cerr << "solve_linear(" << a << "*x+" << b << " == " << r << ") gave ";
+        if (solved) std::cerr << "x=" << T(x); else std::cerr << "no root";
+        std::cerr << " while expected ";
+        if (exists) std::cerr << "x=" << expected; else std::cerr << "no root";
+        std::cerr << std::endl;
+        ++failures;
+    }
+}
+
+//------------------------------------------------------------------------------
+
+/// Checks all combinations of the given coefficients and offsets on right-hand
+/// sides around edge values and on those produced by roots around edge values.
+template <typename T>
+void check_all(const std::vector<T>& coefficients, const std::vector<T>& offsets)
+{
+    typedef typename wider<T>::type W;
+    const T lo = std::numeric_limits<T>::min();
+    const T hi = std::numeric_limits<T>::max();
+    const T edges[] = {T(0), T(1), T(2), T(lo), T(lo+1), T(hi), T(hi-1), T(hi/2), T(hi/2+1), T(lo/2), T(lo/2-1)};
+
+    for (T a : coefficients)
+        for (T b : offsets)
+        {
+            std::vector<T> rhs;
+
+            for (int i = -300; i <= 300; ++i)
+                rhs.push_back(T(i));
+
+            for (T e : edges)
+                for (int i = -3; i <= 3; ++i)
+                {
+                    rhs.push_back(T(e+T(i)));
+
+                    // Brute force: every root around an edge must be found
+                    const W x = W(e) + i;
+                    const W r = W(a)*x + W(b);
+
+                    if (fits<T>(x) && fits<T>(W(a)*x) && fits<T>(r))
+                    {
+                        mch::var<T> v;
+
+                        if (!mch::solve_linear(v, a, b, T(r)) || T(v) != T(x))
+                        {
+                            std::cerr << "solve_linear(" << a << "*x+" << b << " == " << T(r) << ") missed root " << T(x) << std::endl;
+                            ++failures;
+                        }
+                    }
+                }
+
+            for (T r : rhs)
+                check(a, b, r);
+        }
+}
+
+//------------------------------------------------------------------------------
+
+int main()
+{
+    check_all<int>(
+        {1, -1, 2, -2, 3, -3, 5, 6, -6, 7, 8, -8, 12, -12, 1024, -1024, (1<<30)+1, -(1<<30)-1, INT_MAX, -INT_MAX, INT_MIN},
+        {0, 1, -1, 7, -13, INT_MAX, INT_MIN}
+    );
+    check_all<unsigned>(
+        {1u, 2u, 3u, 5u, 6u, 7u, 8u, 12u, 1024u, (1u<<31)+1u, 1u<<31, UINT_MAX},
+        {0u, 1u, 7u, 13u, UINT_MAX}
+    );
+#if defined(__SIZEOF_INT128__)
+    check_all<long long>({1, -1, 3, -6, 1024, LLONG_MAX, LLONG_MIN}, {0, -1, 7, LLONG_MIN});
+    check_all<unsigned long long>({1, 3, 6, 1ull<<63, ULLONG_MAX}, {0, 7, ULLONG_MAX});
+#endif
+
+    // Patterns that end up in solve_linear
+    mch::var<int>      i;
+    mch::var<unsigned> u;
+
+    if (!mch::solve(u+5u, 5u) || u != 0u) { std::cerr << "x+5 == 5 must have root 0 over unsigned" << std::endl; ++failures; }
+    if ( mch::solve(u+5u, 4u))            { std::cerr << "x+5 == 4 must have no roots over unsigned" << std::endl; ++failures; }
+    if (!mch::solve(2*i-1, -7) || i != -3) { std::cerr << "2*x-1 == -7 must have root -3" << std::endl; ++failures; }
+    if (!mch::solve(-3*i+1, 10) || i != -3){ std::cerr << "-3*x+1 == 10 must have root -3" << std::endl; ++failures; }
+    if ( mch::solve(2*i-1, INT_MAX))      { std::cerr << "2*x-1 == INT_MAX must not have a wrapped root " << int(i) << std::endl; ++failures; }
+    if ( mch::solve(i+1, INT_MIN))        { std::cerr << "x+1 == INT_MIN must not have a wrapped root " << int(i) << std::endl; ++failures; }
+
+    std::cout << (failures ? "FAILED" : "OK") << std::endl;
+    return failures != 0;
+}
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,153 @@
+//
+//  Mach7: Pattern Matching Library for C++
+//
+//  Copyright 2011-2013, Texas A&M University.
+//  Copyright 2014 Yuriy Solodkyy.
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are met:
+//
+//      * Redistributions of source code must retain the above copyright
+//        notice, this list of conditions and the following disclaimer.
+//
+//      * Redistributions in binary form must reproduce the above copyright
+//        notice, this list of conditions and the following disclaimer in the
+//        documentation and/or other materials provided with the distribution.
+//
+//      * Neither the names of Mach7 project nor the names of its contributors
+//        may be used to endorse or promote products derived from this software
+//        without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+//  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+//  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+//  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY
+//  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+//  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+//  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+///
+/// \file
+///
+/// This file is a part of Mach7 library test suite.
+///
+/// \author Yuriy Solodkyy <yuriy.solodkyy@gmail.com>
+///
+/// \see https://parasol.tamu.edu/mach7/
+/// \see https://github.com/solodon4/Mach7
+/// \see https://github.com/solodon4/SELL
+///
+
+#include <mach7/type_switchN-patterns.hpp> // Support for N-ary Match statement on patterns
+#include <mach7/patterns/primitive.hpp>    // Wildcard, variable and value patterns
+
+#include <iostream>
+#include <string>
+
+//------------------------------------------------------------------------------
+
+static const char* const words[] = {"add", "sub", "mul", "div", "mod", "neg", "abs", "min", "max", "pow"};
+
+/// Enough literal clauses to be dispatched through a hash table, with a 
+/// duplicate that must never be reached.
+int literal(const std::string& s)
+{
+    Match(s)
+    {
+      Case("add") return 0;
+      Case("sub") return 1;
+      Case("mul") return 2;
+      Case("div") return 3;
+      Case("mod") return 4;
+      Case("add") return 100;
+      Case("neg") return 5;
+      Case("abs") return 6;
+      Case("min") return 7;
+      Case("max") return 8;
+      Case("pow") return 9;
+    }
+    EndMatch
+
+    return -1;
+}
+
+//------------------------------------------------------------------------------
+
+/// A clause on an array of characters that is not a literal. Its content 
+/// changes from call to call, so it must not be learned.
+int local(const std::string& s, const char* key)
+{
+    const char k[3] = {key[0], key[1], 0};
+
+    Match(s)
+    {
+      Case("add") return 0;
+      Case("sub") return 1;
+      Case("mul") return 2;
+      Case("div") return 3;
+      Case("mod") return 4;
+      Case("neg") return 5;
+      Case("abs") return 6;
+      Case("min") return 7;
+      Case(k)     return 100;
+      Case("max") return 8;
+    }
+    EndMatch
+
+    return -1;
+}
+
+//------------------------------------------------------------------------------
+
+int main()
+{
+    int errors = 0;
+
+    // Only known words first: the table is learned without ever being closed
+    for (size_t i = 0; i < 1000; ++i)
+    {
+        const size_t j = (i*7) % XTL_ARR_SIZE(words);
+
+        if (literal(words[j]) != int(j))
+        {
+            std::cout << "ERROR: literal(" << words[j] << ") = " << literal(words[j]) << std::endl;
+            ++errors;
+        }
+    }
+
+    if (literal("unknown") != -1 || literal("ad") != -1 || literal("") != -1)
+    {
+        std::cout << "ERROR: literal matched an unknown word" << std::endl;
+        ++errors;
+    }
+
+    const char* keys[] = {"xy", "zw", "ab", "xy"};
+
+    for (size_t i = 0; i < 100; ++i)
+    {
+        const char* key = keys[i % XTL_ARR_SIZE(keys)];
+
+        for (size_t j = 0; j < XTL_ARR_SIZE(keys); ++j)
+        {
+            const int expected = std::string(keys[j]) == key ? 100 : -1;
+
+            if (local(keys[j], key) != expected)
+            {
+                std::cout << "ERROR: local(" << keys[j] << ',' << key << ") = " << local(keys[j], key) << std::endl;
+                ++errors;
+            }
+        }
+
+        if (local("max", key) != 8 || local("add", key) != 0)
+        {
+            std::cout << "ERROR: local clause shadows literals" << std::endl;
+            ++errors;
+        }
+    }
+
+    std::cout << (errors ? "FAILED" : "PASSED") << std::endl;
+    return errors != 0;
+}
+
+//------------------------------------------------------------------------------
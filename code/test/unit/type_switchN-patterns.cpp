@@ -304,6 +304,33 @@ void do_match(Shape* s0, Shape* s1, Shape* s2, Shape* s3)
 
 //------------------------------------------------------------------------------
 
+/// Beyond 4 subjects and with a non-polymorphic one in the middle, which is not
+/// a part of the key of the vtbl map.
+void do_match(Shape* s0, Shape* s1, int n, Shape* s2, Shape* s3, Shape* s4)
+{
+    const char* text = "unknown";
+
+    mch::var<const Circle&>   c;
+    mch::var<const Square&>   s;
+    mch::var<const Triangle&> t;
+    mch::wildcard             _;
+
+    Match(s0,s1,n,s2,s3,s4)
+    {
+    Case(c, c, 0, c, c, c) text = "C,C,0,C,C,C"; break;
+    Case(c, c, _, c, c, c) text = "C,C,_,C,C,C"; break;
+    Case(c, s, _, t, c, s) text = "C,S,_,T,C,S"; break;
+    Case(t, s, 1, c, t, s) text = "T,S,1,C,T,S"; break;
+    Case(t, _, _, _, _, t) text = "T,_,_,_,_,T"; break;
+    Otherwise()            text = "other"; break;
+    }
+    EndMatch
+
+    std::cout << text << std::endl;
+}
+
+//------------------------------------------------------------------------------
+
 int main()
 {
     Shape* c = new Circle(loc(1,1),7);
@@ -335,6 +362,14 @@ int main()
         for (size_t k = 0; k < 3; ++k)
         for (size_t l = 0; l < 3; ++l)
             do_match(shapes[i], shapes[j], shapes[k], shapes[l]);
+
+        // 5 polymorphic arguments and 1 non-polymorphic
+        for (size_t i = 0; i < 3; ++i)
+        for (size_t j = 0; j < 3; ++j)
+        for (size_t k = 0; k < 3; ++k)
+        for (size_t l = 0; l < 3; ++l)
+        for (size_t m = 0; m < 3; ++m)
+            do_match(shapes[i], shapes[j], int(n % 2), shapes[k], shapes[l], shapes[m]);
     }
 }
 
@@ -0,0 +1,155 @@
+//
+//  Mach7: Pattern Matching Library for C++
+//
+//  Copyright 2011-2013, Texas A&M University.
+//  Copyright 2014 Yuriy Solodkyy.
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are met:
+//
+//      * Redistributions of source code must retain the above copyright
+//        notice, this list of conditions and the following disclaimer.
+//
+//      * Redistributions in binary form must reproduce the above copyright
+//        notice, this list of conditions and the following disclaimer in the
+//        documentation and/or other materials provided with the distribution.
+//
+//      * Neither the names of Mach7 project nor the names of its contributors
+//        may be used to endorse or promote products derived from this software
+//        without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+//  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+//  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+//  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY
+//  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+//  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+//  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///
+/// \file
+///
+/// This file is a part of Mach7 library test suite.
+///
+/// \author Yuriy Solodkyy <yuriy.solodkyy@gmail.com>
+///
+/// \see https://parasol.tamu.edu/mach7/
+/// \see https://github.com/solodon4/Mach7
+/// \see https://github.com/solodon4/SELL
+///
+
+#define XTL_DEFERRED_VTBL_UPDATE 1
+
+#include <mach7/vtblmap4.hpp> // vtbl_map and its deferred updates
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+//------------------------------------------------------------------------------
+
+typedef mch::vtbl_map<1,int,mch::shift_mask_hash> map_type;
+
+/// Fake vtbl-pointers of classes of a single module: close to each other, but
+/// with their lowest bits, which the initial layout of a map uses, all equal.
+std::vector<intptr_t> make_vtbls(size_t classes, std::mt19937_64& rnd)
+{
+    std::vector<intptr_t> result;
+    intptr_t base = intptr_t((rnd() & 0x7FFFFFF) << 16);
+
+    for (size_t c = 0; c < classes; ++c)
+        result.push_back(base += 64 * intptr_t(1 + rnd() % 4));
+
+    return result;
+}
+
+/// Misses of the map with the given uid so far
+size_t misses(const char* uid)
+{
+    std::vector<mch::vtbl_map_stats> stats = mch::snapshot_vtbl_maps();
+
+    for (size_t i = 0; i < stats.size(); ++i)
+        if (stats[i].func == uid)
+            return stats[i].misses;
+
+    return 0;
+}
+
+/// Looks up all the keys once, checking their values, and returns the number
+/// of misses. Also records the longest lookup.
+size_t pass(map_type& map, const char* uid, const std::vector<intptr_t>& vtbls, bool& ok, double& worst)
+{
+    size_t before = misses(uid);
+
+    for (size_t i = 0; i < vtbls.size(); ++i)
+    {
+        const intptr_t key[1] = {vtbls[i]};
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        int& v = map.get(key);
+        worst = std::max(worst, std::chrono::duration<double,std::micro>(std::chrono::steady_clock::now() - start).count());
+
+        if (v == 0) v = int(i+1); else ok &= v == int(i+1);
+    }
+
+    return misses(uid) - before;
+}
+
+//------------------------------------------------------------------------------
+
+int main()
+{
+    std::mt19937_64 rnd(42);
+    std::vector<intptr_t> vtbls = make_vtbls(64, rnd);
+    bool   ok    = true;
+    double worst = 0;
+    size_t best  = 0; // Misses per pass with the layout found by maintenance
+
+    // Explicit maintenance
+    {
+        static const char uid[] = "explicit";
+        map_type map(0, uid);
+
+        for (int i = 0; i < 4; ++i) pass(map, uid, vtbls, ok, worst);
+
+        size_t before = pass(map, uid, vtbls, ok, worst);
+        size_t runs   = mch::maintain_caches();
+
+        pass(map, uid, vtbls, ok, worst); // Adopts the layout found
+        size_t after = best = pass(map, uid, vtbls, ok, worst);
+
+        std::cout << "explicit:   misses per pass " << before << " -> " << after 
+                  << " after " << runs << " maintenance run(s)" << std::endl;
+        ok &= runs > 0 && after < before;
+    }
+
+    // Background maintenance
+    {
+        static const char uid[] = "background";
+        mch::cache_maintainer maintainer;
+        map_type map(0, uid);
+        size_t after = 0;
+
+        // The maintainer runs concurrently, so we only wait for the map to 
+        // reach the layout explicit maintenance has found for the same keys
+        for (int i = 0; i < 1000 && (after = pass(map, uid, vtbls, ok, worst)) > best; ++i)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1)); // Let maintainer run
+
+        std::cout << "background: misses per pass " << after << std::endl;
+        ok &= after <= best;
+    }
+
+    std::cout << "longest lookup: " << worst << "us" << std::endl;
+
+    if (!ok)
+        std::cerr << "Deferred updates did not improve the maps or lost values" << std::endl;
+
+    return ok ? 0 : 1;
+}
+
+//------------------------------------------------------------------------------
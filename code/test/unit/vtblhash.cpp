@@ -0,0 +1,222 @@
+//
+//  Mach7: Pattern Matching Library for C++
+//
+//  Copyright 2011-2013, Texas A&M University.
+//  Copyright 2014 Yuriy Solodkyy.
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are met:
+//
+//      * Redistributions of source code must retain the above copyright
+//        notice, this list of conditions and the following disclaimer.
+//
+//      * Redistributions in binary form must reproduce the above copyright
+//        notice, this list of conditions and the following disclaimer in the
+//        documentation and/or other materials provided with the distribution.
+//
+//      * Neither the names of Mach7 project nor the names of its contributors
+//        may be used to endorse or promote products derived from this software
+//        without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+//  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+//  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+//  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY
+//  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+//  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+//  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+///
+/// \file
+///
+/// This file is a part of Mach7 library test suite.
+///
+/// \author Yuriy Solodkyy <yuriy.solodkyy@gmail.com>
+///
+/// \see https://parasol.tamu.edu/mach7/
+/// \see https://github.com/solodon4/Mach7
+/// \see https://github.com/solodon4/SELL
+///
+
+#include <mach7/vtblmap4.hpp> // vtbl_map and its hashing policies
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+//------------------------------------------------------------------------------
+
+/// Fake vtbl-pointers of a program in which classes come from a given number
+/// of modules. Vtbls of classes within a module are close to each other, while
+/// modules are loaded at random, far apart addresses, like with ASLR.
+std::vector<intptr_t> make_vtbls(size_t modules, size_t classes, std::mt19937_64& rnd)
+{
+    std::vector<intptr_t> result;
+
+    for (size_t m = 0; m < modules; ++m)
+    {
+        intptr_t base = intptr_t((rnd() & 0x7FFFFFF) << 16); // 64KB-aligned base below 2^43
+
+        for (size_t c = 0; c < classes / modules; ++c)
+        {
+            base += intptr_t(16 + 8 * (rnd() % 12)); // Size of the previous vtbl
+            result.push_back(base);
+        }
+    }
+
+    return result;
+}
+
+//------------------------------------------------------------------------------
+
+/// Results of running a set of keys through a vtbl_map with a given hash
+struct hash_result
+{
+    const char* hash;       ///< Hash function in use after all the updates
+    size_t      log_size;   ///< Log of the cache size after all the updates
+    size_t      collisions; ///< Keys that were not found at their cache index once all were known
+    double      ns;         ///< Time per lookup in random order
+    bool        ok;         ///< Whether every key got the value it was first associated with
+};
+
+template <size_t N, typename H>
+hash_result run(const char* uid, const std::vector<intptr_t>& vtbls, std::mt19937_64& rnd)
+{
+    static const mch::vtbl_count_t clauses = 0;
+    mch::vtbl_map<N,int,H> map(clauses, uid);
+
+    // Keys are all N-tuples of some of the vtbls
+    size_t per_position = 1;
+    while (std::pow(double(per_position+1), double(N)) <= double(vtbls.size())) ++per_position;
+
+    std::vector<std::array<intptr_t,N>> keys;
+    std::array<intptr_t,N> key;
+    std::vector<size_t> digits(N+1);
+
+    for (; digits[N] == 0; )
+    {
+        for (size_t i = 0; i < N; ++i) key[i] = vtbls[digits[i] * (vtbls.size() / per_position)];
+        keys.push_back(key);
+        size_t q = 0;
+        while (++digits[q] == per_position && q < N) digits[q++] = 0;
+    }
+
+    hash_result r = {};
+    r.ok = true;
+
+    // Associate every key with its number and let the map reconfigure
+    for (int pass = 0; pass < 8; ++pass)
+        for (size_t k = 0; k < keys.size(); ++k)
+        {
+            int& v = map.get(reinterpret_cast<const intptr_t (&)[N]>(keys[k]));
+            if (pass == 0) v = int(k); else r.ok &= v == int(k);
+        }
+
+    std::vector<mch::vtbl_map_stats> before = mch::snapshot_vtbl_maps();
+
+    for (size_t k = 0; k < keys.size(); ++k)
+        r.ok &= map.get(reinterpret_cast<const intptr_t (&)[N]>(keys[k])) == int(k);
+
+    std::vector<mch::vtbl_map_stats> after = mch::snapshot_vtbl_maps();
+
+    for (size_t i = 0; i < after.size(); ++i)
+        if (after[i].func == uid)
+        {
+            r.log_size   = after[i].log_size;
+            r.collisions = after[i].misses;
+
+            for (size_t j = 0; j < before.size(); ++j)
+                if (before[j].func == uid)
+                    r.collisions -= before[j].misses;
+        }
+
+    // Time lookups in random order
+    const size_t M = 4096;
+    std::vector<size_t> order(M);
+    for (size_t i = 0; i < M; ++i) order[i] = size_t(rnd() % keys.size());
+
+    std::vector<double> times;
+
+    for (int t = 0; t < 9; ++t)
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        int acc = 0;
+
+        for (int k = 0; k < 50; ++k)
+            for (size_t i = 0; i < M; ++i)
+                acc += map.get(reinterpret_cast<const intptr_t (&)[N]>(keys[order[i]]));
+
+        times.push_back(std::chrono::duration<double,std::nano>(std::chrono::steady_clock::now() - start).count() / (50*M));
+        r.ok &= acc != -1; // Keeps the loop from being optimized away
+    }
+
+    std::sort(times.begin(), times.end());
+    r.ns   = times[times.size()/2];
+    r.hash = map.hash_name();
+    return r;
+}
+
+//------------------------------------------------------------------------------
+
+template <size_t N>
+bool compare(size_t modules, size_t classes)
+{
+    std::mt19937_64 rnd(modules * 1000 + classes);
+    std::vector<intptr_t> vtbls = make_vtbls(modules, classes, rnd);
+
+    hash_result results[] = {
+        run<N,mch::shift_mask_hash>("shift-mask", vtbls, rnd),
+        run<N,mch::fibonacci_hash> ("fibonacci",  vtbls, rnd),
+        run<N,mch::tabulation_hash>("tabulation", vtbls, rnd),
+        run<N,mch::adaptive_hash>  ("adaptive",   vtbls, rnd)
+    };
+    const char* policies[] = {"shift-mask", "fibonacci", "tabulation", "adaptive"};
+    bool ok = true;
+
+    for (size_t i = 0; i < XTL_ARR_SIZE(results); ++i)
+    {
+        std::cout << "N=" << N << " modules=" << std::setw(2) << modules << " classes=" << classes
+                  << '\t' << std::setw(10) << policies[i]
+                  << ": collisions=" << std::setw(3) << results[i].collisions
+                  << " log_size="    << std::setw(2) << results[i].log_size
+                  << std::fixed << std::setprecision(2)
+                  << " lookup="      << results[i].ns << "ns";
+        if (std::strcmp(policies[i], results[i].hash) != 0)
+            std::cout << " (uses " << results[i].hash << ')';
+        std::cout << std::endl;
+        ok &= results[i].ok;
+    }
+
+    return ok;
+}
+
+//------------------------------------------------------------------------------
+
+int main()
+{
+    bool ok = true;
+
+    ok &= compare<1>( 1, 64);
+    ok &= compare<1>(16, 64);
+    ok &= compare<2>( 1, 64);
+    ok &= compare<2>(16, 64);
+    ok &= compare<3>( 1, 64);
+    ok &= compare<3>( 8, 64);
+
+    if (!ok)
+        std::cerr << "Values associated with keys were lost" << std::endl;
+
+    return ok ? 0 : 1;
+}
+
+//------------------------------------------------------------------------------
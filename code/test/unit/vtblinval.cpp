@@ -0,0 +1,169 @@
+//
+//  Mach7: Pattern Matching Library for C++
+//
+//  Copyright 2011-2013, Texas A&M University.
+//  Copyright 2014 Yuriy Solodkyy.
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are met:
+//
+//      * Redistributions of source code must retain the above copyright
+//        notice, this list of conditions and the following disclaimer.
+//
+//      * Redistributions in binary form must reproduce the above copyright
+//        notice, this list of conditions and the following disclaimer in the
+//        documentation and/or other materials provided with the distribution.
+//
+//      * Neither the names of Mach7 project nor the names of its contributors
+//        may be used to endorse or promote products derived from this software
+//        without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+//  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+//  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+//  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY
+//  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+//  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+//  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///
+/// \file
+///
+/// This file is a part of Mach7 library test suite. It unloads a fake module
+/// and checks that only the entries of its vtbls get purged from vtbl-maps.
+/// By default it checks vtbl_map<N,T> behind Match statements of type_switchN.hpp,
+/// while built with VTBLINVAL_VTBLMAP (vtblinval-vtblmap) it checks vtblmap<T>
+/// behind MatchP, MatchQ and memoized_cast.
+///
+/// \author Yuriy Solodkyy <yuriy.solodkyy@gmail.com>
+///
+/// \see https://parasol.tamu.edu/mach7/
+/// \see https://github.com/solodon4/Mach7
+/// \see https://github.com/solodon4/SELL
+///
+
+#if defined(VTBLINVAL_VTBLMAP)
+#include <mach7/memoized_cast.hpp> // memoized_cast and vtblmap it uses
+#else
+#include <mach7/vtblmap4.hpp>      // vtbl_map
+#endif
+#include <mach7/vtblmodules.hpp>   // Registration and invalidation of modules
+
+#include <iostream>
+#include <random>
+#include <vector>
+
+//------------------------------------------------------------------------------
+
+#if defined(VTBLINVAL_VTBLMAP)
+typedef mch::vtblmap<int> map_type;
+inline int& lookup(map_type& m, const intptr_t& vtbl) { return m.get(&vtbl); } // get() dereferences the object to find its vtbl-pointer
+#else
+typedef mch::vtbl_map<1,int> map_type;
+inline int& lookup(map_type& m, const intptr_t& vtbl) { const intptr_t key[1] = {vtbl}; return m.get(key); }
+#endif
+
+/// Fake vtbl-pointers of classes of a module loaded at base
+std::vector<intptr_t> make_vtbls(intptr_t base, size_t classes, std::mt19937_64& rnd)
+{
+    std::vector<intptr_t> result;
+
+    for (size_t c = 0; c < classes; ++c)
+        result.push_back(base += 16 + 8*intptr_t(rnd() % 8));
+
+    return result;
+}
+
+/// Looks up all the vtbls, setting values of new ones to their index plus 
+/// offset and checking those of known ones. Returns the number of new ones.
+size_t pass(map_type& map, const std::vector<intptr_t>& vtbls, int offset, bool& ok)
+{
+    size_t added = 0;
+
+    for (size_t i = 0; i < vtbls.size(); ++i)
+    {
+        int& v = lookup(map, vtbls[i]);
+
+        if (v == 0) { v = int(i) + offset; ++added; } else ok &= v == int(i) + offset;
+    }
+
+    return added;
+}
+
+//------------------------------------------------------------------------------
+
+#if defined(VTBLINVAL_VTBLMAP)
+struct A { virtual ~A() {} };
+struct B : A {};
+struct C : B {};
+#endif
+
+//------------------------------------------------------------------------------
+
+int main()
+{
+    std::mt19937_64 rnd(7);
+    const intptr_t base = intptr_t(0x7F12) << 32; // Far from our own vtbls
+    const intptr_t size = intptr_t(1) << 20;
+
+    std::vector<intptr_t> plugin = make_vtbls(base,      300, rnd); // Module to be unloaded
+    std::vector<intptr_t> stable = make_vtbls(base+size, 300, rnd); // Module that stays
+    bool ok = true;
+
+    mch::vtbl_module_id plugin_id = mch::register_module(reinterpret_cast<const void*>(base),      reinterpret_cast<const void*>(base+size),   "plugin");
+    mch::vtbl_module_id stable_id = mch::register_module(reinterpret_cast<const void*>(base+size), reinterpret_cast<const void*>(base+2*size), "stable");
+    ok &= plugin_id && stable_id && plugin_id != stable_id && mch::registered_modules().size() == 2;
+
+    map_type map(0, "vtblinval");
+
+    for (int i = 0; i < 3; ++i) // Repeat to let the map settle on a layout
+    {
+        pass(map, plugin, 1,    ok);
+        pass(map, stable, 1000, ok);
+    }
+
+    // Unloading the plugin forgets exactly its vtbls
+    size_t purged = mch::unregister_module(plugin_id);
+    std::cout << "purged " << purged << " of " << plugin.size() << " vtbls of the plugin" << std::endl;
+    ok &= purged == plugin.size() && mch::registered_modules().size() == 1;
+    ok &= pass(map, stable, 1000, ok) == 0; // The other module keeps its entries and values
+
+    // Another plugin loaded at the same address has its classes learned anew
+    std::vector<intptr_t> reloaded = make_vtbls(base, 300, rnd);
+    size_t added = pass(map, reloaded, 5000, ok);
+    std::cout << "learned " << added << " of " << reloaded.size() << " vtbls of the reloaded plugin" << std::endl;
+    ok &= added == reloaded.size() && pass(map, reloaded, 5000, ok) == 0;
+    ok &= pass(map, stable, 1000, ok) == 0;
+
+#if defined(VTBLINVAL_VTBLMAP)
+    // memoized_cast relearns casts of classes whose vtbls got purged
+    C c;
+    A* a = &c;
+    ok &= memoized_cast<B*>(a) == static_cast<B*>(&c);
+#endif
+
+#if XTL_HAS_DL_ITERATE_PHDR
+    // Our own executable can be found by any address in it
+    mch::vtbl_module_id self = mch::register_module_of(reinterpret_cast<const void*>(&make_vtbls), "self");
+    ok &= self != 0;
+    #if defined(VTBLINVAL_VTBLMAP)
+        ok &= mch::unregister_module(self) > 0; // At least the entry of C in memoized_cast
+        ok &= memoized_cast<B*>(a) == static_cast<B*>(&c);
+    #else
+        mch::unregister_module(self);
+    #endif
+#endif
+
+    mch::unregister_module(stable_id);
+    ok &= mch::registered_modules().empty();
+
+    if (!ok)
+        std::cerr << "Invalidation of vtbls of unloaded modules failed" << std::endl;
+
+    return ok ? 0 : 1;
+}
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,192 @@
+//
+//  Mach7: Pattern Matching Library for C++
+//
+//  Copyright 2011-2013, Texas A&M University.
+//  Copyright 2014 Yuriy Solodkyy.
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions are met:
+//
+//      * Redistributions of source code must retain the above copyright
+//        notice, this list of conditions and the following disclaimer.
+//
+//      * Redistributions in binary form must reproduce the above copyright
+//        notice, this list of conditions and the following disclaimer in the
+//        documentation and/or other materials provided with the distribution.
+//
+//      * Neither the names of Mach7 project nor the names of its contributors
+//        may be used to endorse or promote products derived from this software
+//        without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+//  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+//  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+//  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY
+//  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+//  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+//  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+///
+/// \file
+///
+/// This file is a part of Mach7 library test suite.
+///
+/// \author Yuriy Solodkyy <yuriy.solodkyy@gmail.com>
+///
+/// \see https://parasol.tamu.edu/mach7/
+/// \see https://github.com/solodon4/Mach7
+/// \see https://github.com/solodon4/SELL
+///
+
+#include <mach7/type_switchN-patterns.hpp> // Support for N-ary Match statement on patterns
+#include <mach7/patterns/primitive.hpp>    // Wildcard, variable and value patterns
+#include <mach7/vtblexport.hpp>            // JSON and CSV writers of vtbl map statistics
+
+#include <iostream>
+
+//------------------------------------------------------------------------------
+
+struct Shape                   { virtual ~Shape() {} };
+struct Circle   : Shape        { double radius; Circle(double r) : radius(r) {} };
+struct Square   : Shape        { double side;   Square(double s) : side(s)   {} };
+struct Triangle : Shape        { double a, b;   Triangle(double x, double y) : a(x), b(y) {} };
+struct Cube     : Square       { Cube(double s) : Square(s) {} };
+template <int I>
+struct Poly     : Shape        {};
+
+//------------------------------------------------------------------------------
+
+double area(const Shape* shape)
+{
+    mch::var<const Circle&>   c;
+    mch::var<const Square&>   s;
+    mch::var<const Triangle&> t;
+
+    Match(shape)
+    {
+      Case(c) { const Circle&   x = c; return 3.14 * x.radius * x.radius; }
+      Case(s) { const Square&   x = s; return x.side * x.side; }
+      Case(t) { const Triangle& x = t; return x.a * x.b / 2; }
+    }
+    EndMatch
+
+    return 0.0;
+}
+
+//------------------------------------------------------------------------------
+
+bool intersect(const Shape* a, const Shape* b)
+{
+    mch::var<const Circle&> c1, c2;
+    mch::var<const Square&> s1, s2;
+
+    Match(a, b)
+    {
+      Case(c1, c2) return true;
+      Case(s1, s2) return true;
+      Otherwise()  return false;
+    }
+    EndMatch
+
+    return false;
+}
+
+//------------------------------------------------------------------------------
+
+int sides(const Shape* shape)
+{
+    mch::var<const Poly<3>&>  p3;  mch::var<const Poly<4>&>  p4;  mch::var<const Poly<5>&>  p5;
+    mch::var<const Poly<6>&>  p6;  mch::var<const Poly<7>&>  p7;  mch::var<const Poly<8>&>  p8;
+    mch::var<const Poly<9>&>  p9;  mch::var<const Poly<10>&> p10; mch::var<const Poly<11>&> p11;
+
+    Match(shape)
+    {
+      Case(p3)  return 3;  Case(p4)  return 4;  Case(p5)  return 5;
+      Case(p6)  return 6;  Case(p7)  return 7;  Case(p8)  return 8;
+      Case(p9)  return 9;  Case(p10) return 10; Case(p11) return 11;
+    }
+    EndMatch
+
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+
+int main()
+{
+    int result = 0;
+
+#if XTL_PRELOAD_LOCAL_STATIC_VARIABLES
+    // Preloaded caches are allocated before main with room for all their clauses
+    std::vector<mch::vtbl_map_stats> initial = mch::snapshot_vtbl_maps();
+
+    for (size_t i = 0; i < initial.size(); ++i)
+        if (initial[i].updates != 0 || (initial[i].line > 0 && initial[i].log_size < XTL_MIN_LOG_SIZE))
+        {
+            std::cerr << "Cache at line " << initial[i].line << " was not presized before use" << std::endl;
+            result = 1;
+        }
+        else
+        if (std::string(mch::demangle(initial[i].func)).find("sides") != std::string::npos && initial[i].log_size != 4)
+        {
+            std::cerr << "Expected log_size=4 for 9 clauses but got " << initial[i].log_size << std::endl;
+            result = 1;
+        }
+#endif
+
+    Poly<7> p7;
+    result |= sides(&p7) != 7;
+
+    Circle   c(1.0);
+    Square   s(2.0);
+    Triangle t(3.0, 4.0);
+    const Shape* shapes[] = {&c, &s, &t};
+
+    double total = 0.0;
+    size_t n = 0;
+
+    for (size_t i = 0; i < 100; ++i)
+        for (size_t j = 0; j < XTL_ARR_SIZE(shapes); ++j)
+        {
+            total += area(shapes[j]);
+            n     += intersect(shapes[j], shapes[(i+j) % XTL_ARR_SIZE(shapes)]);
+        }
+
+    // A new key added to a map that already has room for it does not cause reconfiguration
+    Cube q(5.0);
+    total += area(&q);
+
+    std::cout << total << ' ' << n << std::endl;
+
+    std::vector<mch::vtbl_map_stats> stats = mch::snapshot_vtbl_maps();
+
+    for (size_t i = 0; i < stats.size(); ++i)
+        std::cout << mch::demangle(stats[i].func) << '[' << stats[i].file << ':' << stats[i].line << ']'
+                  << " arity="     << stats[i].arity
+                  << " vtbls="     << stats[i].vtbls
+                  << " log_size="  << stats[i].log_size
+                  << " updates="   << stats[i].updates
+                  << " hits="      << stats[i].hits
+                  << " misses="    << stats[i].misses
+                  << " hit_rate="  << stats[i].hit_rate()
+                  << std::endl;
+
+    mch::write_vtbl_maps_json(std::cout);
+    mch::write_vtbl_maps_csv(std::cout);
+
+    // Every key seen must be counted, including the last one added on a miss
+    for (size_t i = 0; i < stats.size(); ++i)
+        if (stats[i].hits + stats[i].misses > 1 && stats[i].vtbls != (stats[i].arity == 1 ? 4 : 9))
+        {
+            std::cerr << "Expected " << (stats[i].arity == 1 ? 4 : 9) << " vtbls in a map of arity " << stats[i].arity << " but got " << stats[i].vtbls << std::endl;
+            result = 1;
+        }
+
+    return result;
+}
+
+//------------------------------------------------------------------------------